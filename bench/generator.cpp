@@ -0,0 +1,236 @@
+#include "generator.hpp"
+#include <format>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// splitmix64; unlike the <random> distributions its output is fully
+// specified, which keeps the generated programs identical everywhere.
+struct Random {
+  uint64_t State;
+
+  uint64_t next() {
+    uint64_t z = (State += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+  uint32_t below(uint32_t n) { return next() % n; }
+  bool chance(uint32_t percent) { return below(100) < percent; }
+};
+
+struct Generator {
+  const GeneratorConfig &Config;
+  Random Rng;
+  string Out;
+  uint32_t Function = 0; // index of the function being generated
+  uint32_t Locals = 0;   // locals x0..x{Locals-1} in scope
+  int Indent = 0;
+
+  Generator(const GeneratorConfig &Config)
+      : Config(Config), Rng{Config.Seed} {}
+
+  void line(const string &s) {
+    Out.append(Indent * 4, ' ');
+    Out += s;
+    Out += '\n';
+  }
+
+  string operand(uint32_t Budget) {
+    switch (Rng.below(8)) {
+    case 0:
+    case 1:
+      return to_string(Rng.below(1000));
+    case 2:
+      return Rng.chance(50) ? "a" : "b";
+    case 3:
+      return format("arr[{}]", expr(Budget / 2 + 1));
+    case 4:
+      return format("gi[{}]", Rng.below(Config.InitSize));
+    case 5:
+      if (Function > 0) {
+        return format("f{}({}, {}, arr)", Rng.below(Function),
+                      expr(Budget / 2 + 1), expr(Budget / 2 + 1));
+      }
+      [[fallthrough]];
+    default:
+      if (Locals == 0) {
+        return "a";
+      }
+      return format("x{}", Rng.below(Locals));
+    }
+  }
+
+  // An expression with about `Operands` leaves.
+  string expr(uint32_t Operands) {
+    static const char *Ops[] = {" + ", " - ", " * ", " / ", " % "};
+    string s = operand(Operands / 4);
+    for (uint32_t i = 1; i < Operands; ++i) {
+      s += Ops[Rng.below(5)];
+      if (Rng.chance(20) && Operands - i > 2) {
+        uint32_t n = 2 + Rng.below(Operands - i - 1);
+        s += "(" + expr(n) + ")";
+        i += n - 1;
+      } else {
+        s += operand(Operands / 4);
+      }
+    }
+    return s;
+  }
+
+  string cond() {
+    static const char *Cmps[] = {" < ", " <= ", " > ", " >= ", " == ", " != "};
+    string s = expr(Config.ExprSize / 2 + 1) + Cmps[Rng.below(6)] +
+               expr(Config.ExprSize / 2 + 1);
+    if (Rng.chance(30)) {
+      s += Rng.chance(50) ? " && " : " || ";
+      s += "!(" + expr(2) + ")";
+    }
+    return s;
+  }
+
+  void block(uint32_t Depth) {
+    uint32_t Statements = 2 + Rng.below(3);
+    for (uint32_t i = 0; i < Statements; ++i) {
+      uint32_t Kind = Depth == 0 ? Rng.below(2) : Rng.below(5);
+      if (Kind == 0) {
+        line(format("x{} = {};", Rng.below(Locals), expr(Config.ExprSize)));
+      } else if (Kind == 1) {
+        line(format("arr[{}] = {};", expr(2), expr(Config.ExprSize)));
+      } else if (Kind == 2) {
+        line(format("if ({}) {{", cond()));
+        Indent++;
+        block(Depth - 1);
+        Indent--;
+        if (Rng.chance(50)) {
+          line("} else {");
+          Indent++;
+          block(Depth - 1);
+          Indent--;
+        }
+        line("}");
+      } else {
+        line(format("while ({}) {{", cond()));
+        Indent++;
+        block(Depth - 1);
+        if (Rng.chance(30)) {
+          line(format("if (x{} > {}) break;", Rng.below(Locals),
+                      Rng.below(100)));
+        }
+        Indent--;
+        line("}");
+      }
+    }
+  }
+
+  void function() {
+    // Functions return int, so that their calls type-check anywhere an
+    // operand may go: as an array subscript or an operand of '%'.
+    line(format("int f{}(int a, int b, int arr[]) {{", Function));
+    Indent++;
+    Locals = 0;
+    uint32_t NumLocals = 2 + Rng.below(4);
+    for (uint32_t i = 0; i < NumLocals; ++i) {
+      line(format("int x{} = {};", i, expr(Config.ExprSize)));
+      Locals++;
+    }
+    if (Rng.chance(20)) {
+      line(format("const float c{} = {:.6f};", Function,
+                  Rng.below(1000000) / 1000.0));
+    }
+    block(Config.Depth);
+    line(format("return {};", expr(Config.ExprSize)));
+    Indent--;
+    line("}");
+  }
+
+  void table(const char *Type, const char *Name) {
+    Out += format("const {} {}[{}] = {{", Type, Name, Config.InitSize);
+    for (uint32_t i = 0; i < Config.InitSize; ++i) {
+      if (i > 0) {
+        Out += i % 16 == 0 ? ",\n    " : ", ";
+      }
+      if (Type[0] == 'i') {
+        Out += to_string(Rng.below(1u << 31));
+      } else {
+        Out += format("{:.6e}", Rng.below(1u << 30) / 1024.0);
+      }
+    }
+    Out += "};\n";
+  }
+
+  // `Open` repeated N times, then `Leaf`, then `Close` repeated N times.
+  void nested(const char *Open, const char *Leaf, const char *Close,
+              uint32_t N) {
+    Out.append(Indent * 4, ' ');
+    Out += "x = ";
+    for (uint32_t i = 0; i < N; ++i)
+      Out += Open;
+    Out += Leaf;
+    for (uint32_t i = 0; i < N; ++i)
+      Out += Close;
+    Out += ";\n";
+  }
+
+  string nesting() {
+    static const char *Ops[] = {" + ", " - ", " * ", " / ", " % "};
+    Out += "// Generated SysY nesting benchmark program.\n";
+    Out += "int f(int v) { return v; }\n\n";
+    line("int main() {");
+    Indent++;
+    line("int a = 1;");
+    line("int x;");
+    line("int arr[4];");
+    Out.append(Indent * 4, ' ');
+    Out += "x = a";
+    for (uint32_t i = 1; i < Config.Nesting; ++i) {
+      Out += Ops[Rng.below(5)];
+      Out += 'a';
+    }
+    Out += ";\n";
+    nested("a + (", "a", ")", Config.Nesting);
+    nested("-", "a", "", Config.Nesting);
+    nested("!", "a", "", Config.Nesting);
+    nested("f(", "a", ")", Config.Nesting);
+    nested("arr[", "0", "]", Config.Nesting);
+    line("return x;");
+    Indent--;
+    line("}");
+    return std::move(Out);
+  }
+
+  string run() {
+    if (Config.Nesting > 0) {
+      return nesting();
+    }
+    Out += "// Generated SysY benchmark program.\n";
+    table("int", "gi");
+    table("float", "gf");
+    Out += "int counter = 0;\n\n";
+    for (Function = 0; Function < Config.Functions; ++Function) {
+      function();
+      Out += '\n';
+    }
+    line("int main() {");
+    Indent++;
+    line(format("int arr[{}];", Config.InitSize));
+    line("int s = 0;");
+    for (uint32_t i = 0; i < Config.Functions && i < 64; ++i) {
+      line(format("s = s + f{}({}, s, arr);", Rng.below(Config.Functions),
+                  Rng.below(100)));
+    }
+    line("putint(s);");
+    line("return 0;");
+    Indent--;
+    line("}");
+    return std::move(Out);
+  }
+};
+
+} // namespace
+
+string GenerateProgram(const GeneratorConfig &Config) {
+  return Generator(Config).run();
+}
@@ -0,0 +1,23 @@
+#ifndef __generator_hpp
+#define __generator_hpp
+#include <cstdint>
+#include <string>
+
+// Shape of a synthetic SysY program.
+struct GeneratorConfig {
+  uint32_t Functions = 1000; // number of functions besides main
+  uint32_t Depth = 3;        // nesting depth of if/while blocks
+  uint32_t ExprSize = 8;     // operands per generated expression
+  uint32_t InitSize = 1024;  // elements of each global initializer table
+  uint64_t Seed = 1;
+  // When nonzero, main() instead holds one statement per nesting shape
+  // (operator chain, parentheses, prefix operators, calls, subscripts),
+  // each this many levels deep, to check that nothing recurses on them.
+  uint32_t Nesting = 0;
+};
+
+// Generates a well-formed SysY program. The output only depends on the
+// config, so runs on different machines and commits see the same input.
+std::string GenerateProgram(const GeneratorConfig &);
+
+#endif
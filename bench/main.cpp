@@ -0,0 +1,501 @@
+// minic-bench: times the front-end phases on a synthetic (or given) SysY
+// program and writes the results as JSON, so runs can be compared across
+// commits.
+//
+//   minic-bench [--functions N] [--depth N] [--expr-size N] [--init-size N]
+//               [--seed N] [--repeat N] [--input FILE] [--emit FILE]
+//               [--nesting N] [--threads N] [--output FILE]
+#include "arrayinit.hpp"
+#include "ast.hpp"
+#include "astdump.hpp"
+#include "binast.hpp"
+#include "codegen.hpp"
+#include "consteval.hpp"
+#include "flatast.hpp"
+#include "generator.hpp"
+#include "hir.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "passes.hpp"
+#include "resolve.hpp"
+#include "source.hpp"
+#include "ssa.hpp"
+#include "treeprinter.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <new>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace ast;
+
+// Every allocation of the process goes through here so that phases can
+// report how many they made. Atomic, as the parallel phases allocate from
+// their worker threads.
+static atomic<uint64_t> Allocations{0};
+
+void *operator new(size_t Size) {
+  Allocations.fetch_add(1, memory_order_relaxed);
+  if (void *p = malloc(Size == 0 ? 1 : Size)) {
+    return p;
+  }
+  throw bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static long PeakRSSKB() {
+  struct rusage Usage;
+  getrusage(RUSAGE_SELF, &Usage);
+#ifdef __APPLE__
+  return Usage.ru_maxrss / 1024;
+#else
+  return Usage.ru_maxrss;
+#endif
+}
+
+// Counts the expressions, statements and functions of a program.
+struct NodeCounter : ASTWalker {
+  uint64_t Nodes = 0;
+
+  void enter(NodeRef N) {
+    Nodes += N.Cls == NodeRef::Class::Expr || N.Cls == NodeRef::Class::Stmt ||
+             N.Cls == NodeRef::Class::Func;
+  }
+  void accept(Program &P) {
+    for (auto &I : P.instrs) {
+      if (auto F = get_if<Func>(&I))
+        walk(F);
+      else
+        walk(&get<DeclStmt>(I));
+    }
+  }
+};
+
+// NodeCounter with the hooks dispatched statically.
+struct StaticNodeCounter : RecursiveASTVisitor<StaticNodeCounter> {
+  uint64_t Nodes = 0;
+
+  void enterExpr(Expr *) { Nodes++; }
+  void enterStmt(Stmt *) { Nodes++; }
+  void enterFunc(Func *) { Nodes++; }
+};
+
+// Lays out the initializers of the declarations whose dims are literals.
+struct InitLayouter : RecursiveASTVisitor<InitLayouter> {
+  ASTContext Ctx;
+  vector<uint32_t> Shape;
+  uint64_t Elements = 0;
+
+  void enterDeclStmt(DeclStmt *D) {
+    Shape.clear();
+    for (Expr *Dim : D->Dims) {
+      auto *Literal = dyn_cast<IntegerExpr>(Dim);
+      if (Literal == nullptr) {
+        return;
+      }
+      Shape.push_back(Literal->Value);
+    }
+    ArrayInit *Init =
+        LayoutInit(*D, Span<const uint32_t>(Shape.data(), Shape.size()), Ctx);
+    Elements += Init->NumElements;
+  }
+};
+
+struct Phase {
+  string Name;
+  double Seconds = 0;        // best of the repetitions
+  uint64_t Allocations = 0;  // made by one repetition
+  long PeakRSSKB = 0;        // of the process, after the phase
+  vector<pair<string, double>> Stats;
+};
+
+// Runs `Body` `Repeat` times and keeps the fastest run. `Setup` runs before
+// every repetition and is not timed.
+static Phase Measure(const string &Name, int Repeat,
+                     const function<void()> &Body,
+                     const function<void()> &Setup = [] {}) {
+  Phase Result;
+  Result.Name = Name;
+  Result.Seconds = 1e30;
+  for (int i = 0; i < Repeat; ++i) {
+    Setup();
+    uint64_t Before = Allocations.load();
+    auto Start = chrono::steady_clock::now();
+    Body();
+    chrono::duration<double> Elapsed = chrono::steady_clock::now() - Start;
+    Result.Seconds = min(Result.Seconds, Elapsed.count());
+    Result.Allocations = Allocations.load() - Before;
+  }
+  Result.PeakRSSKB = PeakRSSKB();
+  return Result;
+}
+
+static void Stat(Phase &P, const char *Name, double Value) {
+  P.Stats.emplace_back(Name, Value);
+}
+
+static void Rate(Phase &P, const char *Name, double Amount) {
+  Stat(P, Name, Amount / P.Seconds);
+}
+
+static string ToJSON(const GeneratorConfig *Config, const string &Input,
+                     size_t Bytes, size_t Tokens, uint64_t Nodes,
+                     const vector<Phase> &Phases) {
+  string Out = "{\n  \"benchmark\": \"minic-bench\",\n";
+  if (Config != nullptr && Config->Nesting > 0) {
+    Out += format("  \"config\": {{\"nesting\": {}}},\n", Config->Nesting);
+  } else if (Config != nullptr) {
+    Out += format("  \"config\": {{\"functions\": {}, \"depth\": {}, "
+                  "\"expr_size\": {}, \"init_size\": {}, \"seed\": {}}},\n",
+                  Config->Functions, Config->Depth, Config->ExprSize,
+                  Config->InitSize, Config->Seed);
+  } else {
+    Out += "  \"input\": \"";
+    for (char c : Input) {
+      if (c == '"' || c == '\\')
+        Out += '\\';
+      Out += c;
+    }
+    Out += "\",\n";
+  }
+  Out += format("  \"bytes\": {},\n  \"tokens\": {},\n  \"nodes\": {},\n",
+                Bytes, Tokens, Nodes);
+  Out += "  \"phases\": [\n";
+  for (size_t i = 0; i < Phases.size(); ++i) {
+    const Phase &P = Phases[i];
+    Out += format("    {{\"name\": \"{}\", \"seconds\": {:.6f}, "
+                  "\"allocations\": {}, \"peak_rss_kb\": {}",
+                  P.Name, P.Seconds, P.Allocations, P.PeakRSSKB);
+    for (auto &[Name, Value] : P.Stats) {
+      Out += format(", \"{}\": {:.1f}", Name, Value);
+    }
+    Out += i + 1 < Phases.size() ? "},\n" : "}\n";
+  }
+  Out += "  ]\n}\n";
+  return Out;
+}
+
+int main(int argc, char **argv) {
+  GeneratorConfig Config;
+  int Repeat = 3;
+  unsigned Threads = max(1u, thread::hardware_concurrency());
+  string Input, Emit, Output;
+  for (int i = 1; i < argc; ++i) {
+    auto Value = [&](const char *Flag) -> const char * {
+      if (strcmp(argv[i], Flag) != 0 || i + 1 >= argc)
+        return nullptr;
+      return argv[++i];
+    };
+    if (auto v = Value("--functions")) {
+      Config.Functions = atoi(v);
+    } else if (auto v = Value("--depth")) {
+      Config.Depth = atoi(v);
+    } else if (auto v = Value("--expr-size")) {
+      Config.ExprSize = max(1, atoi(v));
+    } else if (auto v = Value("--init-size")) {
+      Config.InitSize = max(1, atoi(v));
+    } else if (auto v = Value("--seed")) {
+      Config.Seed = strtoull(v, nullptr, 10);
+    } else if (auto v = Value("--nesting")) {
+      Config.Nesting = atoi(v);
+    } else if (auto v = Value("--threads")) {
+      Threads = max(1, atoi(v));
+    } else if (auto v = Value("--repeat")) {
+      Repeat = max(1, atoi(v));
+    } else if (auto v = Value("--input")) {
+      Input = v;
+    } else if (auto v = Value("--emit")) {
+      Emit = v;
+    } else if (auto v = Value("--output")) {
+      Output = v;
+    } else {
+      cerr << "Unknown option '" << argv[i] << "'.\n";
+      return 1;
+    }
+  }
+
+  // The driver phase reads from disk like minic does, so a generated
+  // program is written out first, to a temporary file unless --emit
+  // names one to keep.
+  bool Generated = Input.empty();
+  string Temporary;
+  try {
+    if (Generated) {
+      string Text = GenerateProgram(Config);
+      if (Emit.empty()) {
+        llvm::SmallString<128> Path;
+        if (llvm::sys::fs::createTemporaryFile("minic-bench", "sysy", Path)) {
+          throw string("Cannot create a temporary input file.");
+        }
+        Input = Temporary = Path.str().str();
+      } else {
+        Input = Emit;
+      }
+      ofstream(Input, ios::binary) << Text;
+      if (!Emit.empty()) {
+        return 0;
+      }
+    }
+
+    SourceManager SM;
+    const SourceFile &File = SM.getFile(SM.LoadFile(Input.c_str()));
+    double MB = File.text().size() / 1e6;
+    // The printers write through an OutputSink to /dev/null, so these
+    // phases include the formatting and the write calls but no disk.
+    unique_ptr<FILE, int (*)(FILE *)> Null(fopen("/dev/null", "w"), fclose);
+    if (Null == nullptr) {
+      throw string("Cannot open /dev/null.");
+    }
+    vector<Phase> Phases;
+
+    size_t Tokens = 0;
+    Phases.push_back(Measure("lex", Repeat, [&] {
+      Lexer lexer(File);
+      Tokens = 1;
+      while (!lexer.NextToken().isKind(TokenType::Eof)) {
+        Tokens++;
+      }
+    }));
+    Rate(Phases.back(), "tokens_per_sec", Tokens);
+    Rate(Phases.back(), "mb_per_sec", MB);
+
+    Lexer lexer(File);
+    Parser parser(lexer);
+    Program AST;
+    Phases.push_back(Measure(
+        "parse", Repeat, [&] { AST = parser.ParseProgram(); },
+        [&] { AST = {}; }));
+    NodeCounter Counter;
+    Counter.accept(AST);
+    Rate(Phases.back(), "tokens_per_sec", Tokens);
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+    Stat(Phases.back(), "bytes", AST.Context->BytesReserved());
+
+    Phases.push_back(Measure(
+        "parse-parallel", Repeat, [&] { AST = parser.ParseProgram(Threads); },
+        [&] { AST = {}; }));
+    Stat(Phases.back(), "threads", Threads);
+    Rate(Phases.back(), "tokens_per_sec", Tokens);
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+    Stat(Phases.back(), "bytes", AST.Context->BytesReserved());
+
+    Phases.push_back(Measure(
+        "free", Repeat, [&] { AST = {}; },
+        [&] { AST = parser.ParseProgram(); }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+    AST = parser.ParseProgram();
+
+    Phases.push_back(Measure("print", Repeat, [&] {
+      OutputSink Out(Null.get());
+      TreePrinter Printer(Out);
+      Printer.accept(AST);
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+
+    Phases.push_back(Measure("emit-sexpr", Repeat, [&] {
+      OutputSink Out(Null.get());
+      EmitAST(AST, ASTFormat::SExpr, Out);
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+
+    Phases.push_back(Measure("emit-json", Repeat, [&] {
+      OutputSink Out(Null.get());
+      EmitAST(AST, ASTFormat::JSON, Out);
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+
+    FlatAST Flat;
+    Phases.push_back(Measure("flatten", Repeat, [&] { Flat = Flatten(AST); }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+    Stat(Phases.back(), "bytes", Flat.bytes());
+
+    // These count the nodes: the tree by visiting every node, through
+    // virtual hooks (walk) or static ones (visit), the flat form by
+    // scanning its kind array.
+    Phases.push_back(Measure("walk", Repeat, [&] {
+      NodeCounter Walker;
+      Walker.accept(AST);
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+
+    Phases.push_back(Measure("visit", Repeat, [&] {
+      StaticNodeCounter Visitor;
+      Visitor.traverse(AST);
+      if (Visitor.Nodes != Counter.Nodes) {
+        throw format("visit counted {} nodes, the walk {}.", Visitor.Nodes,
+                     Counter.Nodes);
+      }
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+
+    uint64_t InitElements = 0, InitBytes = 0;
+    Phases.push_back(Measure("init-layout", Repeat, [&] {
+      InitLayouter Layouter;
+      Layouter.traverse(AST);
+      InitElements = Layouter.Elements;
+      InitBytes = Layouter.Ctx.BytesReserved();
+    }));
+    Stat(Phases.back(), "elements", InitElements);
+    Stat(Phases.back(), "bytes", InitBytes);
+
+    Phases.push_back(
+        Measure("resolve", Repeat, [&] { ResolveNames(AST, SM); }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+
+    uint64_t GlobalBytes = 0;
+    Phases.push_back(Measure("const-eval", Repeat, [&] {
+      ConstEvaluator Consts(SM);
+      Consts.run(AST);
+      GlobalBytes = Consts.globalBytes();
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+    Stat(Phases.back(), "global_bytes", GlobalBytes);
+
+    // Against the parse phase: the HIR of the same program, with its
+    // loads, conversions and types explicit.
+    ConstEvaluator Consts(SM);
+    Consts.run(AST);
+    uint64_t HIRBytes = 0, NumTypes = 0;
+    Phases.push_back(Measure("lower-hir", Repeat, [&] {
+      hir::Module M = hir::LowerToHIR(AST, Consts, SM);
+      HIRBytes = M.BytesReserved();
+      NumTypes = M.Types.size();
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+    Stat(Phases.back(), "bytes", HIRBytes);
+    Stat(Phases.back(), "ast_bytes", AST.Context->BytesReserved());
+    Stat(Phases.back(), "types", NumTypes);
+
+    // Unoptimized LLVM IR from the HIR, verified.
+    hir::Module HIR = hir::LowerToHIR(AST, Consts, SM);
+    uint64_t Instructions = 0;
+    Phases.push_back(Measure("emit-llvm", Repeat, [&] {
+      llvm::LLVMContext Ctx;
+      auto IR = hir::EmitLLVM(HIR, Ctx, Input);
+      Instructions = IR->getInstructionCount();
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+    Stat(Phases.back(), "instructions", Instructions);
+
+    // minic's own SSA IR from the HIR; verified once, outside the timing.
+    uint64_t SSAInstrs = 0, SSABytes = 0;
+    Phases.push_back(Measure("build-ssa", Repeat, [&] {
+      ssa::Module S = ssa::BuildSSA(HIR);
+      SSAInstrs = S.numInstrs();
+      SSABytes = S.bytesReserved();
+    }));
+    Rate(Phases.back(), "instructions_per_sec", SSAInstrs);
+    Stat(Phases.back(), "instructions", SSAInstrs);
+    Stat(Phases.back(), "bytes", SSABytes);
+    ssa::Verify(ssa::BuildSSA(HIR));
+
+    ssa::Module Opt;
+    Phases.push_back(Measure(
+        "opt-ssa", Repeat,
+        [&] {
+          ssa::PassManager PM;
+          ssa::AddScalarPasses(PM);
+          ssa::AddLoopPasses(PM, 0);
+          ssa::AddScalarPasses(PM);
+          PM.run(Opt);
+        },
+        [&] { Opt = ssa::BuildSSA(HIR); }));
+    Rate(Phases.back(), "instructions_per_sec", SSAInstrs);
+    Stat(Phases.back(), "instructions_left", Opt.numInstrs());
+    ssa::Verify(Opt);
+
+    Phases.push_back(Measure("flat-scan", Repeat, [&] {
+      uint64_t Nodes = 0;
+      for (FlatKind Kind : Flat.Kinds) {
+        Nodes += Kind != FlatKind::InitList && Kind != FlatKind::Param;
+      }
+      if (Nodes != Counter.Nodes) {
+        throw format("flat-scan counted {} nodes, the tree has {}.", Nodes,
+                     Counter.Nodes);
+      }
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+
+    Phases.push_back(Measure("flat-print", Repeat, [&] {
+      OutputSink Out(Null.get());
+      FlatPrinter Printer(Flat, Out);
+      Printer.print();
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+
+    // The binary AST goes through a file next to the input, as it would
+    // between --emit-ast=bin and --from-ast. Loading maps and checks it;
+    // load-tree also rebuilds the Program from it.
+    string ASTPath = Input + ".ast";
+    Phases.push_back(Measure("save-bin", Repeat, [&] {
+      unique_ptr<FILE, int (*)(FILE *)> Stream(fopen(ASTPath.c_str(), "wb"),
+                                                fclose);
+      if (Stream == nullptr) {
+        throw format("Cannot write '{}'.", ASTPath);
+      }
+      OutputSink Out(Stream.get());
+      WriteBinaryAST(Flat, &File, Out);
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+
+    Phases.push_back(Measure("load-bin", Repeat, [&] {
+      BinaryAST Loaded(ASTPath.c_str());
+      if (Loaded.ref().size() != Flat.size()) {
+        throw format("load-bin read {} nodes, not {}.", Loaded.ref().size(),
+                     Flat.size());
+      }
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+
+    Phases.push_back(Measure("load-bin-tree", Repeat, [&] {
+      BinaryAST Loaded(ASTPath.c_str());
+      Program Tree = Unflatten(Loaded.ref());
+    }));
+    Rate(Phases.back(), "nodes_per_sec", Counter.Nodes);
+    remove(ASTPath.c_str());
+
+    Phases.push_back(Measure("driver", Repeat, [&] {
+      SourceManager SM;
+      Lexer lexer(SM.getFile(SM.LoadFile(Input.c_str())));
+      Parser parser(lexer);
+      Program AST = parser.ParseProgram(Threads);
+      OutputSink Out(Null.get());
+      EmitAST(AST, ASTFormat::Text, Out);
+    }));
+    Rate(Phases.back(), "mb_per_sec", MB);
+    Rate(Phases.back(), "tokens_per_sec", Tokens);
+
+    string JSON = ToJSON(Generated ? &Config : nullptr, Input,
+                         File.text().size(), Tokens, Counter.Nodes, Phases);
+    if (Output.empty()) {
+      cout << JSON;
+    } else {
+      ofstream(Output) << JSON;
+    }
+  } catch (string s) {
+    cerr << "Exception : " << s << '\n';
+    if (!Temporary.empty()) {
+      remove(Temporary.c_str());
+    }
+    return 1;
+  }
+  if (!Temporary.empty()) {
+    remove(Temporary.c_str());
+  }
+  return 0;
+}
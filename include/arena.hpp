@@ -0,0 +1,131 @@
+#ifndef __arena_hpp
+#define __arena_hpp
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A view of `Size` contiguous elements, usually owned by an Arena. Unlike
+// std::span it may name an incomplete type, so a struct can hold a Span of
+// itself.
+template <typename T> struct Span {
+  T *Data = nullptr;
+  uint32_t Size = 0;
+
+  Span() = default;
+  Span(T *Data, size_t Size) : Data(Data), Size(Size) {}
+
+  T *begin() const { return Data; }
+  T *end() const { return Data + Size; }
+  size_t size() const { return Size; }
+  bool empty() const { return Size == 0; }
+  T &operator[](size_t i) const { return Data[i]; }
+};
+
+// Bump-pointer allocator. Memory is handed out from large slabs and only
+// released all at once when the arena is destroyed; nothing allocated here
+// ever has its destructor run.
+struct Arena {
+  static constexpr size_t SlabSize = 64 * 1024;
+
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  Arena(Arena &&) = default;
+  Arena &operator=(Arena &&) = default;
+
+  void *Allocate(size_t Size, size_t Align) {
+    uintptr_t p = (Cur + Align - 1) & ~(uintptr_t)(Align - 1);
+    if (p + Size > End || Cur == 0) {
+      return AllocateSlow(Size, Align);
+    }
+    Cur = p + Size;
+    return reinterpret_cast<void *>(p);
+  }
+
+  template <typename T, typename... Args> T *New(Args &&...args) {
+    return new (Allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  // Copies `Size` elements starting at `Elements` into the arena.
+  template <typename T> Span<T> Copy(const T *Elements, size_t Size) {
+    if (Size == 0) {
+      return {};
+    }
+    T *p = static_cast<T *>(Allocate(Size * sizeof(T), alignof(T)));
+    std::uninitialized_copy_n(Elements, Size, p);
+    return Span<T>(p, Size);
+  }
+
+  // Copies `s` into the arena, followed by a '\0'.
+  std::string_view CopyString(std::string_view s) {
+    char *p = static_cast<char *>(Allocate(s.size() + 1, 1));
+    memcpy(p, s.data(), s.size());
+    p[s.size()] = '\0';
+    return std::string_view(p, s.size());
+  }
+
+  size_t BytesReserved() const { return Reserved; }
+
+private:
+  void *AllocateSlow(size_t Size, size_t Align) {
+    size_t Bytes = Size + Align;
+    if (Bytes > SlabSize / 2) {
+      // Oversized requests get a slab of their own so the current one
+      // keeps being filled.
+      Slabs.emplace_back(new char[Bytes]);
+      Reserved += Bytes;
+      uintptr_t p = reinterpret_cast<uintptr_t>(Slabs.back().get());
+      return reinterpret_cast<void *>((p + Align - 1) &
+                                      ~(uintptr_t)(Align - 1));
+    }
+    Slabs.emplace_back(new char[SlabSize]);
+    Reserved += SlabSize;
+    Cur = reinterpret_cast<uintptr_t>(Slabs.back().get());
+    End = Cur + SlabSize;
+    return Allocate(Size, Align);
+  }
+
+  std::vector<std::unique_ptr<char[]>> Slabs;
+  uintptr_t Cur = 0, End = 0;
+  size_t Reserved = 0;
+};
+
+// A growable array of trivially copyable elements in an Arena. Growing
+// abandons the old storage to the arena, which suits the short lists that
+// rarely grow, like the predecessors of a block.
+template <typename T> struct ArenaVector {
+  T *Data = nullptr;
+  uint32_t Size = 0, Capacity = 0;
+
+  T *begin() const { return Data; }
+  T *end() const { return Data + Size; }
+  size_t size() const { return Size; }
+  bool empty() const { return Size == 0; }
+  T &operator[](size_t i) const { return Data[i]; }
+  T &back() const { return Data[Size - 1]; }
+
+  void push_back(Arena &A, const T &V) {
+    if (Size == Capacity) {
+      Capacity = Capacity == 0 ? 2 : Capacity * 2;
+      T *New = static_cast<T *>(A.Allocate(Capacity * sizeof(T), alignof(T)));
+      if (Size != 0) {
+        memcpy(New, Data, Size * sizeof(T));
+      }
+      Data = New;
+    }
+    Data[Size++] = V;
+  }
+  void erase(size_t i) {
+    memmove(Data + i, Data + i + 1, (Size - i - 1) * sizeof(T));
+    Size--;
+  }
+  void clear() { Size = 0; }
+};
+
+#endif
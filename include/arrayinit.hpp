@@ -0,0 +1,56 @@
+#ifndef __arrayinit_hpp
+#define __arrayinit_hpp
+#include "ast.hpp"
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+namespace ast {
+
+// An initializer laid out against the shape of its array, in row-major
+// element order, with the braces resolved. Elements not set here are zero,
+// so the size is that of the non-zero initializers, whatever the size of
+// the array: `int a[1024][1024] = {1}` is one run of one element.
+struct ArrayInit {
+  // Constant elements [Start, Start + Size), whose values are at Offset in
+  // Ints or Floats, whichever matches the declared type.
+  struct Run {
+    uint64_t Start;
+    uint32_t Size;
+    uint32_t Offset;
+  };
+  // An element that is not a literal, evaluated at run time.
+  struct Element {
+    uint64_t Index;
+    Expr *Value;
+  };
+
+  uint64_t NumElements = 0;
+  Span<Run> Runs; // in order of Start, disjoint
+  Span<int32_t> Ints;
+  Span<float> Floats;
+  Span<Element> Exprs; // in order of Index, which is evaluation order
+
+  // The constant at `Index`, as an int array element; 0 if it is unset or
+  // set by an expression.
+  int32_t intAt(uint64_t Index) const;
+  float floatAt(uint64_t Index) const;
+};
+
+// The constant an initializer element folds to, or nullopt to keep it as
+// an expression.
+using InitFolder = std::function<std::optional<ConstValue>(Expr *)>;
+
+// Folds literals, negated or not.
+std::optional<ConstValue> FoldLiteral(Expr *E);
+
+// Lays out the initializer of `D`, whose dims evaluate to `Shape`
+// (outermost first; empty for a scalar), in `Ctx`. The elements `Fold`
+// folds are stored converted to the declared type, and zeros are dropped.
+// Throws if the initializer does not fit the shape.
+ArrayInit *LayoutInit(const DeclStmt &D, Span<const uint32_t> Shape,
+                      ASTContext &Ctx, const InitFolder &Fold = FoldLiteral);
+
+} // namespace ast
+
+#endif
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "arena.hpp"
+#include "source.hpp"
+#include "symbol.hpp"
 #include "token.hpp"
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -12,32 +16,120 @@
 #endif
 #include <cassert>
 
+#include "casting.hpp"
+
 using namespace std;
 
 namespace ast {
 struct TreeVisitor;
+struct Expr;
+struct Stmt;
+struct InitVals;
+struct Param;
+struct Func;
+
+// A reference to any node of the tree, or to nothing.
+struct NodeRef {
+  enum class Class : uint8_t { None, Expr, Stmt, InitVals, Param, Func };
+  Class Cls = Class::None;
+  void *Ptr = nullptr;
+
+  NodeRef() = default;
+  NodeRef(ast::Expr *E) : Cls(E ? Class::Expr : Class::None), Ptr(E) {}
+  NodeRef(ast::Stmt *S) : Cls(S ? Class::Stmt : Class::None), Ptr(S) {}
+  NodeRef(ast::InitVals *IV)
+      : Cls(IV ? Class::InitVals : Class::None), Ptr(IV) {}
+  NodeRef(ast::Param *P) : Cls(Class::Param), Ptr(P) {}
+  NodeRef(ast::Func *F) : Cls(Class::Func), Ptr(F) {}
+
+  bool isNull() const { return Cls == Class::None; }
+  ast::Expr *expr() const { return static_cast<ast::Expr *>(Ptr); }
+  ast::Stmt *stmt() const { return static_cast<ast::Stmt *>(Ptr); }
+  ast::InitVals *initVals() const { return static_cast<ast::InitVals *>(Ptr); }
+  ast::Param *param() const { return static_cast<ast::Param *>(Ptr); }
+  ast::Func *func() const { return static_cast<ast::Func *>(Ptr); }
+};
+
+// Owns the nodes of a Program. They are bump-allocated and released all at
+// once with the context, so a node may only hold raw pointers, Spans and
+// other trivially destructible members.
+struct ASTContext {
+  Arena Nodes;
+  // Arenas taken over from other contexts, such as the ones ParseProgram's
+  // threads allocate into. Their nodes live as long as this context.
+  vector<Arena> Adopted;
+
+  template <typename T, typename... Args> T *New(Args &&...args) {
+    static_assert(is_trivially_destructible_v<T>,
+                  "AST nodes are never destroyed");
+    return Nodes.New<T>(std::forward<Args>(args)...);
+  }
+
+  // Copies Elements[From..] into the context.
+  template <typename T>
+  Span<T> Copy(const vector<T> &Elements, size_t From = 0) {
+    return Nodes.Copy(Elements.data() + From, Elements.size() - From);
+  }
+
+  void adopt(ASTContext &&Other) {
+    Adopted.push_back(std::move(Other.Nodes));
+    Other.Nodes = Arena();
+    for (Arena &A : Other.Adopted) {
+      Adopted.push_back(std::move(A));
+    }
+    Other.Adopted.clear();
+  }
+
+  size_t BytesReserved() const {
+    size_t Bytes = Nodes.BytesReserved();
+    for (const Arena &A : Adopted) {
+      Bytes += A.BytesReserved();
+    }
+    return Bytes;
+  }
+};
+
+enum class ExprKind : uint8_t {
+  Integer,
+  Float,
+  Negate,
+  Binop,
+  Cmp,
+  Not,
+  Logical,
+  Variable,
+  Index,
+  Assign,
+  FunctionCall,
+};
 
 struct Expr {
-  virtual ~Expr() {};
+  SourceLoc Loc;
+  const ExprKind Kind;
+
+  Expr(ExprKind Kind) : Kind(Kind) {}
   virtual void accept(TreeVisitor &) = 0;
 };
 struct IntegerExpr : public Expr {
   int Value;
-  IntegerExpr(int v) : Value(v) {};
+  IntegerExpr(int v) : Expr(ExprKind::Integer), Value(v) {};
 
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Integer; }
   void accept(TreeVisitor &);
 };
 struct FloatExpr : public Expr {
   float Value;
-  FloatExpr(float v) : Value(v) {};
+  FloatExpr(float v) : Expr(ExprKind::Float), Value(v) {};
 
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Float; }
   void accept(TreeVisitor &);
 };
 
 struct NegateExpr : public Expr {
-  shared_ptr<Expr> operand;
+  Expr *operand;
 
-  NegateExpr(shared_ptr<Expr> operand) : operand(operand) {};
+  NegateExpr(Expr *operand) : Expr(ExprKind::Negate), operand(operand) {};
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Negate; }
   void accept(TreeVisitor &);
 };
 
@@ -53,10 +145,11 @@ BinOpKind BinOpKindFromTokenType(TokenType);
 
 struct BinopExpr : public Expr {
   BinOpKind op;
-  shared_ptr<Expr> lhs, rhs;
+  Expr *lhs, *rhs;
 
-  BinopExpr(BinOpKind op, shared_ptr<Expr> lhs, shared_ptr<Expr> rhs)
-      : op(op), lhs(lhs), rhs(rhs) {};
+  BinopExpr(BinOpKind op, Expr *lhs, Expr *rhs)
+      : Expr(ExprKind::Binop), op(op), lhs(lhs), rhs(rhs) {};
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Binop; }
   void accept(TreeVisitor &);
 };
 
@@ -72,15 +165,17 @@ enum class CmpOpKind {
 CmpOpKind CmpKindFromTokenType(TokenType);
 struct CmpExpr : public Expr {
   CmpOpKind op;
-  shared_ptr<Expr> lhs, rhs;
-  CmpExpr(CmpOpKind op, shared_ptr<Expr> lhs, shared_ptr<Expr> rhs)
-      : op(op), lhs(lhs), rhs(rhs) {};
+  Expr *lhs, *rhs;
+  CmpExpr(CmpOpKind op, Expr *lhs, Expr *rhs)
+      : Expr(ExprKind::Cmp), op(op), lhs(lhs), rhs(rhs) {};
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Cmp; }
   void accept(TreeVisitor &);
 };
 
 struct NotExpr : public Expr {
-  shared_ptr<Expr> operand;
-  NotExpr(shared_ptr<Expr> operand) : operand(operand) {};
+  Expr *operand;
+  NotExpr(Expr *operand) : Expr(ExprKind::Not), operand(operand) {};
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Not; }
   void accept(TreeVisitor &);
 };
 
@@ -91,157 +186,231 @@ enum class LogicalOpKind {
 LogicalOpKind LogicalOpKindFromTokenType(TokenType);
 struct LogicalExpr : public Expr {
   LogicalOpKind op;
-  shared_ptr<Expr> lhs, rhs;
-  LogicalExpr(LogicalOpKind op, shared_ptr<Expr> lhs, shared_ptr<Expr> rhs)
-      : op(op), lhs(lhs), rhs(rhs) {}
+  Expr *lhs, *rhs;
+  LogicalExpr(LogicalOpKind op, Expr *lhs, Expr *rhs)
+      : Expr(ExprKind::Logical), op(op), lhs(lhs), rhs(rhs) {}
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Logical; }
   void accept(TreeVisitor &);
 };
 
 struct VariableExpr : public Expr {
-  string VariName;
+  Symbol VariName;
+  NodeRef Decl; // the DeclStmt or Param named, once names are resolved
 
-  VariableExpr(string &name) : VariName(name) {}
+  VariableExpr(Symbol name) : Expr(ExprKind::Variable), VariName(name) {}
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Variable; }
   void accept(TreeVisitor &);
 };
 
 struct IndexExpr : public Expr {
-  string BaseArrayName;
-  shared_ptr<VariableExpr> BaseArray;
-  shared_ptr<IndexExpr> SubArray;
-  shared_ptr<Expr> Index;
-
-  IndexExpr(shared_ptr<VariableExpr> VE, shared_ptr<Expr> Index)
-      : BaseArrayName(VE->VariName), BaseArray(VE), Index(Index) {};
-  IndexExpr(shared_ptr<IndexExpr> SubArray, shared_ptr<Expr> Index)
-      : BaseArrayName(SubArray->BaseArrayName), SubArray(SubArray),
+  Symbol BaseArrayName;
+  VariableExpr *BaseArray = nullptr;
+  IndexExpr *SubArray = nullptr;
+  Expr *Index;
+
+  IndexExpr(VariableExpr *VE, Expr *Index)
+      : Expr(ExprKind::Index), BaseArrayName(VE->VariName), BaseArray(VE),
         Index(Index) {};
+  IndexExpr(IndexExpr *SubArray, Expr *Index)
+      : Expr(ExprKind::Index), BaseArrayName(SubArray->BaseArrayName),
+        SubArray(SubArray), Index(Index) {};
 
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Index; }
   void accept(TreeVisitor &);
 };
 
 struct AssignExpr : public Expr {
-  shared_ptr<VariableExpr> Target;
-  shared_ptr<IndexExpr> ArrayTarget;
-  shared_ptr<Expr> Assignment;
-
-  AssignExpr(shared_ptr<VariableExpr> Target, shared_ptr<Expr> Assignment)
-      : Target(Target), Assignment(Assignment) {};
-  AssignExpr(shared_ptr<IndexExpr> ArrayTarget, shared_ptr<Expr> Assignment)
-      : ArrayTarget(ArrayTarget), Assignment(Assignment) {};
+  VariableExpr *Target = nullptr;
+  IndexExpr *ArrayTarget = nullptr;
+  Expr *Assignment;
+
+  AssignExpr(VariableExpr *Target, Expr *Assignment)
+      : Expr(ExprKind::Assign), Target(Target), Assignment(Assignment) {};
+  AssignExpr(IndexExpr *ArrayTarget, Expr *Assignment)
+      : Expr(ExprKind::Assign), ArrayTarget(ArrayTarget),
+        Assignment(Assignment) {};
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Assign; }
   void accept(TreeVisitor &);
 };
 
 struct FunctionCallExpr : public Expr {
-  string FuncName;
-  std::vector<shared_ptr<Expr>> RealParameters;
-
-  FunctionCallExpr(string FuncName, vector<shared_ptr<Expr>> RealParameters)
-      : FuncName(FuncName), RealParameters(std::move(RealParameters)) {};
+  Symbol FuncName;
+  Span<Expr *> RealParameters;
+  Func *Callee = nullptr; // once names are resolved
+
+  FunctionCallExpr(Symbol FuncName, Span<Expr *> RealParameters)
+      : Expr(ExprKind::FunctionCall), FuncName(FuncName),
+        RealParameters(RealParameters) {};
+  static bool classof(const Expr *E) {
+    return E->Kind == ExprKind::FunctionCall;
+  }
   void accept(TreeVisitor &);
 };
 
+enum class StmtKind : uint8_t {
+  Expr,
+  If,
+  Decl,
+  Return,
+  Block,
+  Continue,
+  Break,
+  While,
+};
+
 struct Stmt {
-  virtual ~Stmt() {};
+  SourceLoc Loc;
+  const StmtKind Kind;
+
+  Stmt(StmtKind Kind) : Kind(Kind) {}
   virtual void accept(TreeVisitor &) = 0;
 };
 
 struct ExprStmt : public Stmt {
-  shared_ptr<Expr> E;
-  ExprStmt(shared_ptr<Expr> E) : E(E) {};
+  Expr *E;
+  ExprStmt(Expr *E) : Stmt(StmtKind::Expr), E(E) {};
 
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::Expr; }
   void accept(TreeVisitor &);
 };
 
 struct IfStmt : public Stmt {
-  shared_ptr<Expr> cond;
-  shared_ptr<Stmt> IfBranch;
-  shared_ptr<Stmt> ElseBranch;
+  Expr *cond;
+  Stmt *IfBranch;
+  Stmt *ElseBranch;
 
-  IfStmt(shared_ptr<Expr> cond, shared_ptr<Stmt> IfBranch,
-         shared_ptr<Stmt> ElseBranch = nullptr)
-      : cond(cond), IfBranch(IfBranch), ElseBranch(ElseBranch) {
+  IfStmt(Expr *cond, Stmt *IfBranch, Stmt *ElseBranch = nullptr)
+      : Stmt(StmtKind::If), cond(cond), IfBranch(IfBranch),
+        ElseBranch(ElseBranch) {
     assert(cond != nullptr);
     assert(IfBranch != nullptr);
   };
 
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::If; }
   void accept(TreeVisitor &);
 };
 
 enum class BaseType { INT, FLOAT };
 
+// The value of a constant expression.
+struct ConstValue {
+  BaseType Type;
+  union {
+    int32_t Int;
+    float Float;
+  };
+
+  static ConstValue ofInt(int32_t V) {
+    ConstValue C;
+    C.Type = BaseType::INT;
+    C.Int = V;
+    return C;
+  }
+  static ConstValue ofFloat(float V) {
+    ConstValue C;
+    C.Type = BaseType::FLOAT;
+    C.Float = V;
+    return C;
+  }
+
+  bool isFloat() const { return Type == BaseType::FLOAT; }
+  // Converted as by an assignment; a float out of the range of int,
+  // whose conversion is undefined, becomes 0.
+  int32_t asInt() const {
+    if (!isFloat()) {
+      return Int;
+    }
+    bool InRange = Float > -2147483904.0f && Float < 2147483648.0f;
+    return InRange ? int32_t(Float) : 0;
+  }
+  float asFloat() const { return isFloat() ? Float : float(Int); }
+  ConstValue to(BaseType T) const {
+    return T == BaseType::FLOAT ? ofFloat(asFloat()) : ofInt(asInt());
+  }
+};
+
 struct InitVals {
-  shared_ptr<Expr> val;
-  vector<InitVals> vals;
+  Expr *val = nullptr;
+  Span<InitVals> vals;
 
-  InitVals(InitVals &) = default;
-  InitVals(InitVals &&) = default;
-  InitVals(shared_ptr<Expr> val) : val(val) {};
-  InitVals(vector<InitVals> &&vals) : vals(vals) {};
+  InitVals(Expr *val) : val(val) {};
+  InitVals(Span<InitVals> vals) : vals(vals) {};
 };
 
 struct DeclStmt : public Stmt {
   bool isConst;
   BaseType basetype_;
-  string VarName;
-  std::vector<shared_ptr<Expr>> Dims;
-  shared_ptr<InitVals> initvals_;
+  Symbol VarName;
+  Span<Expr *> Dims;
+  InitVals *initvals_;
 
-  DeclStmt(bool isConst, BaseType basetype_, string VarName,
-           vector<shared_ptr<Expr>> Dims, shared_ptr<InitVals> initvals_)
-      : isConst(isConst), basetype_(basetype_), VarName(VarName), Dims(Dims),
-        initvals_(initvals_) {};
+  DeclStmt(bool isConst, BaseType basetype_, Symbol VarName,
+           Span<Expr *> Dims, InitVals *initvals_)
+      : Stmt(StmtKind::Decl), isConst(isConst), basetype_(basetype_),
+        VarName(VarName), Dims(Dims), initvals_(initvals_) {};
 
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::Decl; }
   void accept(TreeVisitor &);
 };
 
 struct ReturnStmt : public Stmt {
-  shared_ptr<Expr> ReturnExpr;
+  Expr *ReturnExpr;
 
-  ReturnStmt(shared_ptr<Expr> e) : ReturnExpr(e) {};
+  ReturnStmt(Expr *e) : Stmt(StmtKind::Return), ReturnExpr(e) {};
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::Return; }
   void accept(TreeVisitor &);
 };
 struct BlockStmt : public Stmt {
-  vector<shared_ptr<Stmt>> Stmts;
+  Span<Stmt *> Stmts;
 
-  BlockStmt(vector<shared_ptr<Stmt>> Stmts) : Stmts(std::move(Stmts)) {};
+  BlockStmt(Span<Stmt *> Stmts) : Stmt(StmtKind::Block), Stmts(Stmts) {};
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::Block; }
   void accept(TreeVisitor &);
 };
 struct ContinueStmt : public Stmt {
+  ContinueStmt() : Stmt(StmtKind::Continue) {}
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::Continue; }
   void accept(TreeVisitor &);
 };
 struct BreakStmt : public Stmt {
+  BreakStmt() : Stmt(StmtKind::Break) {}
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::Break; }
   void accept(TreeVisitor &);
 };
 struct WhileStmt : public Stmt {
-  shared_ptr<Expr> LoopCond;
-  shared_ptr<Stmt> LoopBody;
+  Expr *LoopCond;
+  Stmt *LoopBody;
 
-  WhileStmt(shared_ptr<Expr> LoopCond, shared_ptr<Stmt> LoopBody)
-      : LoopCond(LoopCond), LoopBody(LoopBody) {};
+  WhileStmt(Expr *LoopCond, Stmt *LoopBody)
+      : Stmt(StmtKind::While), LoopCond(LoopCond), LoopBody(LoopBody) {};
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::While; }
   void accept(TreeVisitor &);
 };
 
 enum class ReturnType { INT, FLOAT, VOID };
 struct Param {
   BaseType basetype_;
-  string paraname_;
-  vector<shared_ptr<Expr>> dims_; // only first element can be nullptr.
+  Symbol paraname_;
+  Span<Expr *> dims_; // only first element can be nullptr.
+  SourceLoc Loc;
 };
 
 struct Func {
   ReturnType return_type_;
-  string function_name_;
-  vector<Param> formal_paras_;
-  shared_ptr<BlockStmt> body_; // nullptr if it's a function declaration
+  Symbol function_name_;
+  Span<Param> formal_paras_;
+  BlockStmt *body_; // nullptr if it's a function declaration
+  SourceLoc Loc;
 
-  Func(ReturnType return_type_, string function_name_,
-       vector<Param> formal_paras_, shared_ptr<BlockStmt> body_)
+  Func(ReturnType return_type_, Symbol function_name_,
+       Span<Param> formal_paras_, BlockStmt *body_)
       : return_type_(return_type_), function_name_(function_name_),
         formal_paras_(formal_paras_), body_(body_) {};
   void accept(TreeVisitor &);
 };
 
 struct Program {
+  unique_ptr<ASTContext> Context; // owns every node below
   vector<variant<Func, DeclStmt>> instrs;
 
   void accept(TreeVisitor &);
@@ -274,34 +443,36 @@ struct TreeVisitor {
   virtual void accept(Program &) = 0;
 };
 
-struct TreePrinter : public TreeVisitor {
-  int IndentDepth = 0;
-
-  void Indent();
-
-  void accept(Expr &);
-  void accept(IntegerExpr &);
-  void accept(FloatExpr &);
-  void accept(NegateExpr &);
-  void accept(BinopExpr &);
-  void accept(CmpExpr &);
-  void accept(NotExpr &);
-  void accept(LogicalExpr &);
-  void accept(VariableExpr &);
-  void accept(IndexExpr &);
-  void accept(AssignExpr &);
-  void accept(FunctionCallExpr &);
-
-  void accept(Stmt &);
-  void accept(ExprStmt &);
-  void accept(IfStmt &);
-  void accept(DeclStmt &);
-  void accept(ReturnStmt &);
-  void accept(BlockStmt &);
-  void accept(ContinueStmt &);
-  void accept(BreakStmt &);
-  void accept(WhileStmt &);
-  void accept(Func &);
-  void accept(Program &);
+// The child slots of a node, in source order. A slot may be empty: the
+// missing 'else' of an IfStmt, the value of a bare 'return;', the leading
+// '[]' of an array parameter, the initializer of a DeclStmt or the body of
+// a function declaration. Appends them to `Out`.
+void children(NodeRef, vector<NodeRef> &Out);
+
+// Visits a tree depth-first using a stack on the heap, so arbitrarily deep
+// trees (say a + b + ... with a million operands) do not exhaust the
+// native stack. For every node N it calls enter(N); then for each child
+// slot i, before(N, i, C), the walk of C if it isn't empty, and
+// after(N, i, C); and finally leave(N).
+struct ASTWalker {
+  virtual ~ASTWalker() = default;
+
+  virtual void enter(NodeRef) {}
+  virtual void before(NodeRef, unsigned, NodeRef) {}
+  virtual void after(NodeRef, unsigned, NodeRef) {}
+  virtual void leave(NodeRef) {}
+
+  void walk(NodeRef Root);
+
+private:
+  // The slots of the nodes on Stack live in Children, Frame::First on.
+  struct Frame {
+    NodeRef Node;
+    uint32_t First;
+    unsigned Next;
+  };
+  vector<Frame> Stack;
+  vector<NodeRef> Children;
 };
+
 } // namespace ast
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef __astdump_hpp
+#define __astdump_hpp
+#include "ast.hpp"
+#include "outputsink.hpp"
+#include "source.hpp"
+#include <string_view>
+
+namespace ast {
+
+// The formats of --emit-ast:
+//
+//   text   the program as SysY, fully parenthesized (TreePrinter)
+//   sexpr  one S-expression per top-level item, one statement per line:
+//            (func int main (params)
+//              (block
+//                (decl int a (dims 4) (list 1 2))
+//                (return (+ a 1))))
+//   json   an array of the top-level items; each node is an object with
+//          a "kind" and one field per operand, e.g.
+//            {"kind":"Binop","op":"+","lhs":...,"rhs":...}
+//          empty slots (a missing else, a bare return) are null.
+//   bin    the binary AST of binast.hpp, for --from-ast to load back
+enum class ASTFormat { Text, SExpr, JSON, Binary };
+
+// Sets `Format` from its name; returns false if there is no such format.
+bool ParseASTFormat(std::string_view Name, ASTFormat &Format);
+
+// Streams `P` to `Out` in `Format`. `Source` is the file `P` was parsed
+// from; the binary format records locations only if it is given.
+void EmitAST(Program &P, ASTFormat Format, OutputSink &Out,
+             const SourceFile *Source = nullptr);
+
+} // namespace ast
+
+#endif
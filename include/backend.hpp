@@ -0,0 +1,27 @@
+#ifndef __backend_hpp
+#define __backend_hpp
+#include <memory>
+
+namespace llvm {
+class Module;
+class TargetMachine;
+} // namespace llvm
+
+// A TargetMachine for the host CPU that generates code at -O`Level`
+// (0 to 3). Throws if LLVM cannot target the host.
+std::unique_ptr<llvm::TargetMachine> HostTargetMachine(unsigned Level);
+
+// Sets `M` up for `TM` and runs LLVM's default new-pass-manager pipeline
+// for -O`Level` on it, the same one clang uses.
+void OptimizeModule(llvm::Module &M, llvm::TargetMachine &TM, unsigned Level);
+
+// Writes the machine code for `M` as an object file at `Path`, leaving
+// nothing there if it fails.
+void WriteObjectFile(llvm::Module &M, llvm::TargetMachine &TM,
+                     const char *Path);
+
+// Links `Object` with the SysY runtime (runtime/sylib.c) into the
+// executable `Output`, using the system C compiler.
+void LinkExecutable(const char *Object, const char *Output);
+
+#endif
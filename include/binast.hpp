@@ -0,0 +1,76 @@
+#ifndef __binast_hpp
+#define __binast_hpp
+#include "flatast.hpp"
+#include "outputsink.hpp"
+#include "source.hpp"
+#include <cstdint>
+#include <string_view>
+
+namespace ast {
+
+// The binary AST format, a FlatAST written out array by array so that a
+// mapped file can be handed to FlatASTRef passes without decoding:
+//
+//   BinaryASTHeader
+//   Kinds          uint8_t[NumNodes]
+//   Ops            uint8_t[NumNodes]
+//   A, B           uint32_t[NumNodes] each
+//   Locs           uint32_t[NumNodes], a byte offset into the source plus
+//                  one, or 0 if unknown
+//   Extra          uint32_t[NumExtra]
+//   Roots          uint32_t[NumRoots]
+//   StringOffsets  uint32_t[NumStrings + 1]
+//   StringData     the names, back to back
+//
+// The header gives the offset of every section from the start of the file;
+// each is aligned to 8 bytes. Symbol ids in A index the file's own string
+// table, so a file does not depend on the interner of the process that
+// wrote it. Integers are in the writer's byte order, and a reader with the
+// other one rejects the file.
+struct BinaryASTHeader {
+  static constexpr char MagicBytes[8] = {'M', 'I', 'N', 'I',
+                                         'C', 'A', 'S', 'T'};
+  static constexpr uint32_t CurrentVersion = 1;
+  static constexpr uint32_t ByteOrderMark = 0x01020304;
+
+  char Magic[8];
+  uint32_t Version;
+  uint32_t ByteOrder;
+  uint32_t NumNodes, NumExtra, NumRoots, NumStrings;
+  uint32_t SourceName; // the string id of the source file's path
+  uint32_t SourceSize; // to tell whether the source changed since
+  uint64_t Kinds, Ops, A, B, Locs, Extra, Roots, StringOffsets, StringData;
+  uint64_t FileSize;
+};
+
+// Writes `F` to `Out`. Its locations are recorded if they are in `Source`,
+// the file it was parsed from.
+void WriteBinaryAST(FlatASTRef F, const SourceFile *Source, OutputSink &Out);
+
+// A binary AST file, mapped read-only. The constructor checks the header
+// and every node, so passes can trust ref() as they would a FlatAST; it
+// throws if the file cannot be read or is not valid.
+struct BinaryAST {
+  explicit BinaryAST(const char *Path);
+  BinaryAST(const BinaryAST &) = delete;
+  BinaryAST &operator=(const BinaryAST &) = delete;
+  ~BinaryAST();
+
+  const FlatASTRef &ref() const { return AST; }
+  std::string_view sourceName() const { return AST.name(Header->SourceName); }
+
+  // Rebases the locations onto `Source`, the file the AST was parsed from.
+  // Returns false, and leaves them unknown, if the file has changed size.
+  bool attachSource(const SourceFile &Source);
+
+private:
+  void *Mapping = nullptr;
+  size_t Size = 0;
+  const BinaryASTHeader *Header = nullptr;
+  FlatASTRef AST;
+  Span<const SourceLoc> Locs; // set aside until a source is attached
+};
+
+} // namespace ast
+
+#endif
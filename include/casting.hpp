@@ -0,0 +1,38 @@
+#ifndef __casting_hpp
+#define __casting_hpp
+#include <cassert>
+
+// LLVM-style type queries on class hierarchies that carry their own kind
+// tag. A class `To` opts in with
+//
+//   static bool classof(const Base *);
+//
+// which tests the tag, so isa<> is a byte compare instead of an RTTI walk.
+
+template <typename To, typename From> bool isa(const From *V) {
+  assert(V != nullptr && "isa<> on a null pointer");
+  return To::classof(V);
+}
+
+template <typename To, typename From> To *cast(From *V) {
+  assert(isa<To>(V) && "cast<> to the wrong kind");
+  return static_cast<To *>(V);
+}
+template <typename To, typename From> const To *cast(const From *V) {
+  assert(isa<To>(V) && "cast<> to the wrong kind");
+  return static_cast<const To *>(V);
+}
+
+template <typename To, typename From> To *dyn_cast(From *V) {
+  return isa<To>(V) ? static_cast<To *>(V) : nullptr;
+}
+template <typename To, typename From> const To *dyn_cast(const From *V) {
+  return isa<To>(V) ? static_cast<const To *>(V) : nullptr;
+}
+
+// Like dyn_cast<>, but passes a null pointer through.
+template <typename To, typename From> To *dyn_cast_or_null(From *V) {
+  return V != nullptr && isa<To>(V) ? static_cast<To *>(V) : nullptr;
+}
+
+#endif
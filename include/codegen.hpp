@@ -0,0 +1,36 @@
+#ifndef __codegen_hpp
+#define __codegen_hpp
+#include "hir.hpp"
+#include "ssa.hpp"
+#include <memory>
+#include <string_view>
+
+namespace llvm {
+class LLVMContext;
+class Module;
+} // namespace llvm
+
+namespace hir {
+
+// Translates `M` to LLVM IR in `Ctx`, shaped the way LLVM's pipelines
+// expect: every variable has an alloca in the entry block for mem2reg to
+// promote, int arithmetic is `nsw` since overflow is undefined as in C,
+// and array parameters are `noalias` and `dereferenceable` where every
+// call site allows it. Functions other than main are internal; the
+// runtime functions are left as external declarations.
+std::unique_ptr<llvm::Module> EmitLLVM(const Module &M, llvm::LLVMContext &Ctx,
+                                       std::string_view Name);
+
+} // namespace hir
+
+namespace ssa {
+
+// Translates `M` to LLVM IR in `Ctx`, instruction for instruction. Memory
+// is i8*, so allocas are byte arrays and PtrAdd a byte offset; int
+// arithmetic is `nsw` and linkage is as hir::EmitLLVM gives it.
+std::unique_ptr<llvm::Module> EmitLLVM(const Module &M, llvm::LLVMContext &Ctx,
+                                       std::string_view Name);
+
+} // namespace ssa
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef __consteval_hpp
+#define __consteval_hpp
+#include "arrayinit.hpp"
+#include "ast.hpp"
+#include "source.hpp"
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace ast {
+
+// What is known about a declaration before run time.
+struct DeclLayout {
+  Span<uint32_t> Shape;     // the dims, evaluated; empty for a scalar
+  ArrayInit *Init;          // the initializer, or nullptr if there is none
+  uint64_t Bytes;           // of storage
+};
+
+// Evaluates the constant expressions of a program once, for the stages
+// after it to look up: the dims of every declaration and parameter, and
+// the initializers of declarations, which must be constant for `const`
+// and global ones.
+//
+// Expressions fold with SysY semantics: int arithmetic wraps at 32 bits, an
+// operation with a float operand is done in float, comparisons and logical
+// operators give int 0 or 1, and a name folds if it refers to a `const`
+// scalar, or is an element of a `const` array indexed by constants. The
+// names must have been resolved with ResolveNames.
+struct ConstEvaluator {
+  explicit ConstEvaluator(const SourceManager &SM) : SM(SM) {}
+
+  // Evaluates `P`; throws the first error, with its location.
+  void run(Program &P);
+
+  // The value of a dim or initializer element run() evaluated, or nullopt
+  // if it is not constant.
+  std::optional<ConstValue> value(const Expr *E) const;
+
+  const DeclLayout &layout(const DeclStmt *D) const { return Decls.at(D); }
+  // The first dim of an array parameter, which is not given, is 0.
+  Span<uint32_t> shape(const Param *P) const { return Params.at(P); }
+
+  // Storage for the global variables, and the most a function needs for
+  // its locals at any one point; blocks that do not overlap share space.
+  uint64_t globalBytes() const { return GlobalBytes; }
+  uint64_t frameBytes(const Func *F) const { return Frames.at(F); }
+
+private:
+  friend struct ConstFolder;
+  friend struct ConstPass;
+
+  const SourceManager &SM;
+  ASTContext Storage; // shapes and initializer layouts
+  std::unordered_map<const Expr *, std::optional<ConstValue>> Values;
+  std::unordered_map<const DeclStmt *, DeclLayout> Decls;
+  std::unordered_map<const Param *, Span<uint32_t>> Params;
+  std::unordered_map<const Func *, uint64_t> Frames;
+  uint64_t GlobalBytes = 0;
+};
+
+} // namespace ast
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef __dominators_hpp
+#define __dominators_hpp
+#include "ssa.hpp"
+#include <vector>
+
+namespace ssa {
+
+// The dominator tree of a function, by the iterative algorithm of Cooper,
+// Harvey and Kennedy over the reverse postorder. Facts are kept in flat
+// arrays by Block::Id; unreachable blocks are in no tree. It goes stale
+// when the CFG changes.
+struct DomTree {
+  std::vector<Block *> RPO;              // the reachable blocks
+  std::vector<uint32_t> Order;           // index in RPO, or ~0u
+  std::vector<Block *> IDom;             // the entry's is nullptr
+  std::vector<std::vector<Block *>> Children;
+  std::vector<uint32_t> In, Out;         // a preorder walk of the tree
+
+  explicit DomTree(const Function &F);
+
+  bool reachable(const Block *B) const { return Order[B->Id] != ~0u; }
+  // Whether every path from the entry to the reachable block `B` goes
+  // through `A`. A block dominates itself.
+  bool dominates(const Block *A, const Block *B) const {
+    return reachable(A) && In[A->Id] <= In[B->Id] && Out[B->Id] <= Out[A->Id];
+  }
+};
+
+} // namespace ssa
+
+#endif
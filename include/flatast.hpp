@@ -0,0 +1,196 @@
+#ifndef __flatast_hpp
+#define __flatast_hpp
+#include "ast.hpp"
+#include "outputsink.hpp"
+#include "source.hpp"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace ast {
+
+// A second layout for a Program: every node is a 32-bit index into a set
+// of parallel arrays, and nodes are stored in post-order, children before
+// their parent, the same order the Pratt parser finishes them in. A pass
+// that only needs its operands' results (folding, type checking, lowering)
+// is a single forward scan over `Kinds` with a value stack; passes that
+// need the shape follow the child indices in `A`/`B`/`Extra`.
+//
+// Per kind, the operand slots hold:
+//
+//   Integer, Float    A = the value's bits
+//   Variable          A = Symbol id
+//   Negate, Not       A = operand
+//   Binop, Cmp,       Op = BinOpKind/CmpOpKind/LogicalOpKind,
+//   Logical           A = lhs, B = rhs
+//   Index             A = base (a Variable or Index node), B = index
+//   Assign            A = target (a Variable or Index node), B = value
+//   Call              A = Symbol id, B = list of arguments
+//   ExprStmt          A = expression
+//   If                A = condition, B = Extra[B] then, Extra[B+1] else
+//   While             A = condition, B = body
+//   Return            A = expression or None
+//   Block             B = list of statements
+//   Continue, Break   -
+//   Decl              Op = DeclConst | DeclFloat, A = Symbol id,
+//                     B = list of dims followed by Extra[..] = init or None
+//   InitList          B = list of initializers (InitList or expressions)
+//   Param             Op = BaseType, A = Symbol id, B = list of dims
+//                     (None for the leading '[]')
+//   Func              Op = ReturnType, A = Symbol id,
+//                     B = list of Params followed by Extra[..] = body or None
+//
+// A "list" at B is Extra[B] = N followed by the N element indices.
+enum class FlatKind : uint8_t {
+  Integer,
+  Float,
+  Variable,
+  Negate,
+  Not,
+  Binop,
+  Cmp,
+  Logical,
+  Index,
+  Assign,
+  Call,
+
+  ExprStmt,
+  If,
+  While,
+  Return,
+  Block,
+  Continue,
+  Break,
+  Decl,
+  InitList,
+  Param,
+  Func,
+};
+
+struct FlatAST;
+
+// A read-only FlatAST whose arrays live elsewhere: in a FlatAST, or in a
+// mapped binary AST file (see binast.hpp). Passes that only read the tree
+// take one of these, so they run on either without a copy.
+struct FlatASTRef {
+  static constexpr uint32_t None = ~0u;
+
+  Span<const FlatKind> Kinds;
+  Span<const uint8_t> Ops;
+  Span<const uint32_t> A, B;
+  Span<const SourceLoc> Locs; // empty if the locations are unknown
+  Span<const uint32_t> Extra;
+  Span<const uint32_t> Roots;
+
+  // The names of the Symbol ids in A. A FlatAST uses the global interner;
+  // a file has its own string table, where name i is
+  // StringData[StringOffsets[i]..StringOffsets[i + 1]).
+  const char *StringData = nullptr;
+  Span<const uint32_t> StringOffsets;
+  // Added to every valid location, to rebase them onto a SourceFile.
+  uint32_t LocBase = 0;
+
+  FlatASTRef() = default;
+  FlatASTRef(const FlatAST &);
+
+  uint32_t size() const { return Kinds.size(); }
+
+  std::string_view name(uint32_t Id) const {
+    if (StringData == nullptr) {
+      return Symbol{Id}.str();
+    }
+    return std::string_view(StringData + StringOffsets[Id],
+                            StringOffsets[Id + 1] - StringOffsets[Id]);
+  }
+
+  SourceLoc loc(uint32_t Node) const {
+    if (Locs.empty() || !Locs[Node].isValid()) {
+      return SourceLoc();
+    }
+    return SourceLoc{Locs[Node].Raw + LocBase};
+  }
+
+  // The child slots of `Node` in source order, as TreePrinter and
+  // ASTWalker see them; an empty slot is None.
+  unsigned numChildren(uint32_t Node) const;
+  uint32_t child(uint32_t Node, unsigned i) const;
+
+  // The N elements of the list at Extra[At].
+  Span<const uint32_t> list(uint32_t At) const {
+    return Span<const uint32_t>(Extra.Data + At + 1, Extra[At]);
+  }
+  // The slot following the list at Extra[At].
+  uint32_t afterList(uint32_t At) const { return Extra[At + 1 + Extra[At]]; }
+};
+
+struct FlatAST {
+  static constexpr uint32_t None = FlatASTRef::None;
+  static constexpr uint8_t DeclConst = 1, DeclFloat = 2;
+
+  vector<FlatKind> Kinds;
+  vector<uint8_t> Ops;
+  vector<uint32_t> A, B;
+  vector<SourceLoc> Locs;
+  vector<uint32_t> Extra;
+  vector<uint32_t> Roots; // the Func and Decl nodes of the program, in order
+
+  uint32_t size() const { return Kinds.size(); }
+
+  // Bytes held by the arrays.
+  size_t bytes() const;
+
+  uint32_t addNode(FlatKind Kind, uint8_t Op, uint32_t A, uint32_t B,
+                   SourceLoc Loc) {
+    Kinds.push_back(Kind);
+    Ops.push_back(Op);
+    this->A.push_back(A);
+    this->B.push_back(B);
+    Locs.push_back(Loc);
+    return Kinds.size() - 1;
+  }
+};
+
+inline FlatASTRef::FlatASTRef(const FlatAST &F)
+    : Kinds(F.Kinds.data(), F.Kinds.size()), Ops(F.Ops.data(), F.Ops.size()),
+      A(F.A.data(), F.A.size()), B(F.B.data(), F.B.size()),
+      Locs(F.Locs.data(), F.Locs.size()),
+      Extra(F.Extra.data(), F.Extra.size()),
+      Roots(F.Roots.data(), F.Roots.size()) {}
+
+// Lays `P` out in post-order.
+FlatAST Flatten(Program &P);
+
+// Builds the tree a FlatAST was flattened from, in a new context.
+Program Unflatten(FlatASTRef F);
+
+// Prints a FlatAST exactly the way TreePrinter prints the tree it came from.
+// Like ASTWalker, it keeps its stack on the heap.
+struct FlatPrinter {
+  FlatASTRef AST;
+  OutputSink &Out;
+  int IndentDepth = 0;
+
+  FlatPrinter(FlatASTRef AST, OutputSink &Out) : AST(AST), Out(Out) {}
+
+  void Indent();
+  void print();
+  void print(uint32_t Node);
+
+private:
+  void enter(uint32_t Node);
+  void before(uint32_t Node, unsigned i, uint32_t Child);
+  void after(uint32_t Node, unsigned i);
+  void leave(uint32_t Node);
+
+  struct Frame {
+    uint32_t Node;
+    unsigned Next, Count;
+  };
+  vector<Frame> Stack;
+};
+
+} // namespace ast
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef __hir_hpp
+#define __hir_hpp
+#include "arena.hpp"
+#include "arrayinit.hpp"
+#include "casting.hpp"
+#include "outputsink.hpp"
+#include "source.hpp"
+#include "symbol.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ast {
+struct Program;
+struct ConstEvaluator;
+} // namespace ast
+
+// The typed high-level IR: the program after name resolution and type
+// checking, still structured (blocks, if, while) but with every type
+// worked out and nothing left implicit. Reads of variables are Load nodes,
+// int <-> float conversions are Convert nodes and arrays passed to
+// functions are Decay nodes, so a back end only has to translate what it
+// sees.
+namespace hir {
+
+// A type. Types are uniqued in a TypeContext, so two types are the same if
+// and only if their pointers are.
+struct Type {
+  enum class Kind : uint8_t { Void, Int, Float, Array, Pointer };
+  Kind K;
+  uint32_t Size = 0;          // Array: the number of elements
+  const Type *Elem = nullptr; // Array: the element; Pointer: the pointee
+
+  bool isVoid() const { return K == Kind::Void; }
+  bool isInt() const { return K == Kind::Int; }
+  bool isFloat() const { return K == Kind::Float; }
+  bool isScalar() const { return isInt() || isFloat(); }
+  bool isArray() const { return K == Kind::Array; }
+  bool isPointer() const { return K == Kind::Pointer; }
+
+  // The scalar type at the bottom of arrays and pointers.
+  const Type *base() const;
+  uint64_t bytes() const;
+  // As SysY would spell it: "int", "float[2][3]", and a decayed array
+  // parameter like `int a[][3]` as "int[][3]".
+  std::string str() const;
+};
+
+// Owns and uniques the types of a module.
+struct TypeContext {
+  TypeContext();
+  TypeContext(TypeContext &&) = default;
+
+  const Type *getVoid() const { return Void; }
+  const Type *getInt() const { return Int; }
+  const Type *getFloat() const { return Float; }
+  const Type *getArray(const Type *Elem, uint32_t Size);
+  const Type *getPointer(const Type *Pointee);
+
+  size_t size() const { return Uniqued.size() + 3; }
+
+private:
+  struct Key {
+    Type::Kind K;
+    uint32_t Size;
+    const Type *Elem;
+    bool operator==(const Key &) const = default;
+  };
+  struct KeyHash {
+    size_t operator()(const Key &K) const;
+  };
+  const Type *get(const Key &K);
+
+  Arena Storage;
+  const Type *Void, *Int, *Float;
+  std::unordered_map<Key, const Type *, KeyHash> Uniqued;
+};
+
+struct Function;
+struct While;
+
+// A variable: a global, a local or a parameter. Array parameters have a
+// Pointer type.
+struct Var {
+  enum class Storage : uint8_t { Global, Local, Param };
+  Symbol Name;
+  const Type *Ty;
+  Storage S;
+  bool IsConst;
+  uint32_t Id; // among the globals, or the params and locals of a function
+  struct Initializer *Init = nullptr;
+  SourceLoc Loc;
+};
+
+enum class ExprKind : uint8_t {
+  IntConst,
+  FloatConst,
+  VarRef,  // the storage of a variable (an lvalue)
+  Index,   // an element of an array or pointer (an lvalue)
+  Decay,   // an array lvalue as a pointer to its first element
+  Load,    // the value of a scalar lvalue
+  Convert, // int -> float or float -> int, as by assignment
+  Unary,
+  Binary,
+  Logical, // && and ||, which evaluate the rhs only if needed
+  Assign,
+  Call,
+};
+
+enum class Op : uint8_t {
+  Neg,
+  Not,
+  Add,
+  Sub,
+  Mul,
+  Div,
+  Mod,
+  Lt,
+  Le,
+  Gt,
+  Ge,
+  Eq,
+  Ne,
+  And,
+  Or,
+};
+const char *OpName(Op);
+
+struct Expr {
+  const ExprKind Kind;
+  const Type *Ty;
+  SourceLoc Loc;
+
+  Expr(ExprKind Kind, const Type *Ty, SourceLoc Loc)
+      : Kind(Kind), Ty(Ty), Loc(Loc) {}
+  bool isLValue() const {
+    return Kind == ExprKind::VarRef || Kind == ExprKind::Index;
+  }
+  // The operands, in evaluation order.
+  unsigned numOperands() const;
+  Expr *operand(unsigned i) const;
+};
+
+struct IntConst : Expr {
+  int32_t Value;
+  IntConst(const Type *Ty, int32_t Value, SourceLoc Loc)
+      : Expr(ExprKind::IntConst, Ty, Loc), Value(Value) {}
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::IntConst; }
+};
+
+struct FloatConst : Expr {
+  float Value;
+  FloatConst(const Type *Ty, float Value, SourceLoc Loc)
+      : Expr(ExprKind::FloatConst, Ty, Loc), Value(Value) {}
+  static bool classof(const Expr *E) {
+    return E->Kind == ExprKind::FloatConst;
+  }
+};
+
+struct VarRef : Expr {
+  Var *V;
+  VarRef(Var *V, SourceLoc Loc) : Expr(ExprKind::VarRef, V->Ty, Loc), V(V) {}
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::VarRef; }
+};
+
+// Base is an Array or Pointer lvalue; the element is an lvalue of Ty.
+struct Index : Expr {
+  Expr *Base, *Idx;
+  Index(const Type *Ty, Expr *Base, Expr *Idx, SourceLoc Loc)
+      : Expr(ExprKind::Index, Ty, Loc), Base(Base), Idx(Idx) {}
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Index; }
+};
+
+// Kinds with a single operand: Decay, Load, Convert and Unary.
+struct UnaryExpr : Expr {
+  Op O; // Unary only
+  Expr *Operand;
+  UnaryExpr(ExprKind Kind, const Type *Ty, Op O, Expr *Operand, SourceLoc Loc)
+      : Expr(Kind, Ty, Loc), O(O), Operand(Operand) {}
+  UnaryExpr(ExprKind Kind, const Type *Ty, Expr *Operand, SourceLoc Loc)
+      : UnaryExpr(Kind, Ty, Op::Neg, Operand, Loc) {}
+  static bool classof(const Expr *E) {
+    return E->Kind == ExprKind::Decay || E->Kind == ExprKind::Load ||
+           E->Kind == ExprKind::Convert || E->Kind == ExprKind::Unary;
+  }
+};
+
+// Binary and Logical. The operands of a Binary have the same type; the
+// result is that type for arithmetic and int for comparisons. Logical
+// operands are scalars of either type and the result is int.
+struct BinaryExpr : Expr {
+  Op O;
+  Expr *LHS, *RHS;
+  BinaryExpr(ExprKind Kind, const Type *Ty, Op O, Expr *LHS, Expr *RHS,
+             SourceLoc Loc)
+      : Expr(Kind, Ty, Loc), O(O), LHS(LHS), RHS(RHS) {}
+  static bool classof(const Expr *E) {
+    return E->Kind == ExprKind::Binary || E->Kind == ExprKind::Logical;
+  }
+};
+
+// Stores Value, already of the target's type, and yields it.
+struct Assign : Expr {
+  Expr *Target, *Value;
+  Assign(Expr *Target, Expr *Value, SourceLoc Loc)
+      : Expr(ExprKind::Assign, Value->Ty, Loc), Target(Target), Value(Value) {}
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Assign; }
+};
+
+// Arguments have exactly the types of the callee's parameters.
+struct Call : Expr {
+  Function *Callee;
+  Span<Expr *> Args;
+  Call(const Type *Ty, Function *Callee, Span<Expr *> Args, SourceLoc Loc)
+      : Expr(ExprKind::Call, Ty, Loc), Callee(Callee), Args(Args) {}
+  static bool classof(const Expr *E) { return E->Kind == ExprKind::Call; }
+};
+
+// The initial value of a variable, laid out as ast::ArrayInit is. Every
+// element not listed is zero.
+struct Initializer {
+  struct Element {
+    uint64_t Index;
+    Expr *Value; // of the element type
+  };
+  uint64_t NumElements;
+  Span<ast::ArrayInit::Run> Runs;
+  Span<int32_t> Ints;
+  Span<float> Floats;
+  Span<Element> Exprs; // in evaluation order; empty for globals
+};
+
+enum class StmtKind : uint8_t {
+  Expr,
+  Init, // initializes a local where it is declared
+  If,
+  While,
+  Break,
+  Continue,
+  Return,
+  Block,
+};
+
+struct Stmt {
+  const StmtKind Kind;
+  SourceLoc Loc;
+  Stmt(StmtKind Kind, SourceLoc Loc) : Kind(Kind), Loc(Loc) {}
+};
+
+struct ExprStmt : Stmt {
+  Expr *E;
+  ExprStmt(Expr *E, SourceLoc Loc) : Stmt(StmtKind::Expr, Loc), E(E) {}
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::Expr; }
+};
+
+struct InitStmt : Stmt {
+  Var *V; // a local with an Init
+  InitStmt(Var *V, SourceLoc Loc) : Stmt(StmtKind::Init, Loc), V(V) {}
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::Init; }
+};
+
+// Conditions are scalars of either type, compared against zero.
+struct If : Stmt {
+  Expr *Cond;
+  Stmt *Then, *Else; // Else may be nullptr
+  If(Expr *Cond, Stmt *Then, Stmt *Else, SourceLoc Loc)
+      : Stmt(StmtKind::If, Loc), Cond(Cond), Then(Then), Else(Else) {}
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::If; }
+};
+
+struct While : Stmt {
+  Expr *Cond;
+  Stmt *Body = nullptr;
+  While(Expr *Cond, SourceLoc Loc) : Stmt(StmtKind::While, Loc), Cond(Cond) {}
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::While; }
+};
+
+// Break and Continue.
+struct Jump : Stmt {
+  While *Loop; // the innermost loop around it
+  Jump(StmtKind Kind, While *Loop, SourceLoc Loc)
+      : Stmt(Kind, Loc), Loop(Loop) {}
+  static bool classof(const Stmt *S) {
+    return S->Kind == StmtKind::Break || S->Kind == StmtKind::Continue;
+  }
+};
+
+struct Return : Stmt {
+  Expr *Value; // of the return type, or nullptr in a void function
+  Return(Expr *Value, SourceLoc Loc)
+      : Stmt(StmtKind::Return, Loc), Value(Value) {}
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::Return; }
+};
+
+struct Block : Stmt {
+  Span<Stmt *> Stmts;
+  Block(Span<Stmt *> Stmts, SourceLoc Loc)
+      : Stmt(StmtKind::Block, Loc), Stmts(Stmts) {}
+  static bool classof(const Stmt *S) { return S->Kind == StmtKind::Block; }
+};
+
+struct Function {
+  Symbol Name;
+  const Type *RetTy;
+  Span<Var *> Params;
+  Span<Var *> Locals; // every local of the body, in declaration order
+  Block *Body;        // nullptr for a runtime function
+  SourceLoc Loc;
+};
+
+// A lowered program. The nodes live in the module's arena and the types in
+// its TypeContext.
+struct Module {
+  TypeContext Types;
+  Arena Nodes;
+  std::vector<Var *> Globals;
+  // In the order they are first declared or called, which puts the
+  // runtime functions the program uses where it first calls them.
+  std::vector<Function *> Functions;
+
+  Module() = default;
+  Module(Module &&) = default;
+  size_t BytesReserved() const { return Nodes.BytesReserved(); }
+};
+
+// Lowers `P` in one pass, checking the types as it goes; throws the first
+// error with its location. The names of `P` must be resolved and `Consts`
+// must have been run on it.
+Module LowerToHIR(ast::Program &P, const ast::ConstEvaluator &Consts,
+                  const SourceManager &SM);
+
+// Prints `M` with every node's type; for debugging.
+void PrintHIR(const Module &M, OutputSink &Out);
+
+} // namespace hir
+
+#endif
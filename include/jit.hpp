@@ -0,0 +1,18 @@
+#ifndef __jit_hpp
+#define __jit_hpp
+#include <memory>
+
+namespace llvm {
+class LLVMContext;
+class Module;
+} // namespace llvm
+
+// Runs `IR`, which lives in `Ctx`, in-process: optimizes it at -O`Level`
+// and hands it to an ORC LLLazyJIT, which compiles each function to
+// machine code only when it is first called. The runtime functions are
+// bound to the host's own (runtime/sylib.c). Returns what main returns;
+// throws if the program cannot be compiled or has no main.
+int RunJIT(std::unique_ptr<llvm::LLVMContext> Ctx,
+           std::unique_ptr<llvm::Module> IR, unsigned Level);
+
+#endif
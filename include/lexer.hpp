@@ -1,25 +1,32 @@
 #ifndef __lexer_hpp
 #define __lexer_hpp
+#include "source.hpp"
 #include "token.hpp"
 #include <cstdint>
-#include <string>
+#include <string_view>
 using namespace std;
 struct Lexer {
-  string src;
+  const SourceFile &File;
+  // A view of File's text. It is followed by SourcePadding '\0' sentinels;
+  // the scanners read whole 32-byte blocks and stop at the first '\0', so
+  // they never check bounds.
+  string_view src;
   uint32_t CurrentPosition;
   uint32_t BeginingPosition;
   uint32_t LineNo;
 
-  Lexer(string &src)
-      : src(src), CurrentPosition(0), BeginingPosition(0), LineNo(1) {};
+  Lexer(const SourceFile &File)
+      : File(File), src(File.text()), CurrentPosition(0), BeginingPosition(0),
+        LineNo(1) {};
 
   Token NextToken();
 
 private:
+  Token LexToken();
   char peek(int);
   char next();
   bool match(char);
   void SkipWhitespaces();
 };
 
-#endif
\ No newline at end of file
+#endif
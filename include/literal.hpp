@@ -0,0 +1,30 @@
+#ifndef __literal_hpp
+#define __literal_hpp
+#include <cstdint>
+
+// A numeric literal scanned from the source.
+struct NumericLiteral {
+  bool isFloat;
+  const char *End;   // first character after the literal
+  const char *Error; // nullptr if the literal is well-formed
+  union {
+    int IntValue;
+    float FloatValue;
+  };
+};
+
+// Scans the SysY numeric literal starting at `p`, which points at a digit or
+// at a '.' followed by a digit. Accepts decimal, octal (`017`) and
+// hexadecimal (`0x1F`) integers, and decimal (`1.5e-3`, `.5`, `2e3`) and
+// hexadecimal (`0x1.8p3`) floats.
+//
+// Integers must fit in 32 bits: decimal literals up to 2147483648 (the
+// operand of `-2147483648`), octal and hexadecimal ones up to 0xFFFFFFFF,
+// both wrapping to the int with the same bit pattern. Floats are correctly
+// rounded to the nearest `float`.
+//
+// The text must be terminated by a character that cannot continue a
+// literal, such as the lexer's '\0' sentinel.
+NumericLiteral ScanNumber(const char *p);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef __loops_hpp
+#define __loops_hpp
+#include "dominators.hpp"
+#include <memory>
+#include <vector>
+
+namespace ssa {
+
+// A natural loop: its header and the blocks that reach one of its latches
+// without going through the header. Loops with the same header are one.
+struct Loop {
+  Block *Header;
+  std::vector<Block *> Blocks;  // the header first, inner loops' included
+  std::vector<Block *> Latches; // the blocks that jump back to the header
+  Loop *Parent = nullptr;
+  std::vector<Loop *> Children;
+  unsigned Depth = 1;
+
+  explicit Loop(Block *Header) : Header(Header) {}
+};
+
+// The loops of a function and how they nest. Like DomTree, it goes stale
+// when the CFG changes.
+struct LoopInfo {
+  std::vector<std::unique_ptr<Loop>> Loops; // inner loops before outer
+  std::vector<Loop *> Of; // the innermost loop of each block, by Block::Id
+
+  LoopInfo(const Function &F, const DomTree &DT);
+
+  bool contains(const Loop *L, const Block *B) const {
+    for (Loop *In = Of[B->Id]; In != nullptr; In = In->Parent) {
+      if (In == L) {
+        return true;
+      }
+    }
+    return false;
+  }
+  // The block outside `L` that is the only way into its header and only
+  // jumps there, or nullptr.
+  Block *preheader(const Loop &L) const;
+};
+
+// Gives every loop a preheader and a single latch, adding blocks where it
+// has to. Returns whether it changed the CFG.
+bool NormalizeLoops(Function &F);
+
+} // namespace ssa
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef __outputsink_hpp
+#define __outputsink_hpp
+#include "symbol.hpp"
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+// Buffered output to a FILE. Text collects in a fixed buffer that goes out
+// with one fwrite whenever it fills up, so writing a dump of any size
+// holds at most BufferSize bytes of it. Numbers are formatted with
+// to_chars; none of this goes through iostreams or locales.
+struct OutputSink {
+  static constexpr size_t BufferSize = 64 * 1024;
+
+  explicit OutputSink(FILE *File);
+  OutputSink(const OutputSink &) = delete;
+  OutputSink &operator=(const OutputSink &) = delete;
+  ~OutputSink();
+
+  void write(const char *Data, size_t Size) {
+    if (Size > size_t(End - Cur)) {
+      return writeSlow(Data, Size);
+    }
+    memcpy(Cur, Data, Size);
+    Cur += Size;
+  }
+
+  void put(char c) {
+    if (Cur == End) {
+      drain();
+    }
+    *Cur++ = c;
+  }
+
+  // `N` copies of `c`.
+  void fill(char c, size_t N);
+
+  // Formats like `std::cout << V` does by default, i.e. printf("%g").
+  void writeFloat(float V);
+  // The shortest form that reads back as `V`.
+  void writeFloatExact(float V);
+
+  template <std::integral T> void writeInt(T V) {
+    if (End - Cur < 24) {
+      drain();
+    }
+    Cur = std::to_chars(Cur, End, V).ptr;
+  }
+
+  OutputSink &operator<<(char c) {
+    put(c);
+    return *this;
+  }
+  OutputSink &operator<<(std::string_view s) {
+    write(s.data(), s.size());
+    return *this;
+  }
+  OutputSink &operator<<(const char *s) { return *this << std::string_view(s); }
+  OutputSink &operator<<(Symbol S) { return *this << S.str(); }
+  OutputSink &operator<<(float V) {
+    writeFloat(V);
+    return *this;
+  }
+  template <std::integral T> OutputSink &operator<<(T V) {
+    writeInt(V);
+    return *this;
+  }
+
+  // Writes out everything so far and flushes the FILE.
+  void flush();
+
+private:
+  // Hands the buffered text to the FILE.
+  void drain();
+  void writeSlow(const char *Data, size_t Size);
+
+  FILE *File;
+  std::unique_ptr<char[]> Buffer;
+  char *Cur, *End;
+};
+
+#endif
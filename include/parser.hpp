@@ -5,32 +5,83 @@
 #include "token.hpp"
 #include <cstdint>
 #include <memory>
+#include <variant>
 #include <vector>
 
 struct Parser {
 
   Parser(Lexer &);
+  // A parser over tokens lexed elsewhere, which must outlive it.
+  Parser(const vector<Token> &, const SourceFile &);
 
-  ast::Program ParseProgram();
+  // With Threads > 1, the top-level items are parsed on that many threads
+  // once the input is large enough to be worth splitting.
+  ast::Program ParseProgram(unsigned Threads = 1);
 
-  vector<Token> src;
-  int Current;
+  vector<Token> Tokens;     // owned when constructed from a Lexer
+  const vector<Token> &src; // Tokens, or those of another parser
+  const SourceFile &File;   // the file the tokens point into
+  size_t Current;           // the next token, an index into src
 
-  shared_ptr<ast::Expr> ParseExpr();
-  shared_ptr<ast::Expr> ParseExpr(int8_t min_bp);
+  // Set on the parsers of ParseProgram's threads: syntax errors throw
+  // instead of exiting, and the program is parsed again on one thread to
+  // report the first of them.
+  bool Worker = false;
+
+  // Where the nodes go; set while ParseProgram runs.
+  ast::ASTContext *Ctx = nullptr;
+
+  // Lists being parsed are collected here and copied into Ctx once their
+  // length is known. Nested lists push above their parent's elements and
+  // pop them again, so the stacks are reused across the whole program.
+  vector<ast::Expr *> ExprStack;
+  vector<ast::Stmt *> StmtStack;
+  vector<ast::InitVals> InitStack;
+
+  // The elements of string initializers: one shared node per character
+  // value and context, rather than one per character. Reset with Ctx.
+  ast::IntegerExpr *CharNodes[256] = {};
+  ast::IntegerExpr *CharNode(char c);
+
+  // A suspended ParseExpr: what to do with the operand being parsed.
+  struct ExprFrame {
+    enum : uint8_t { Prefix, Paren, Argument, Index, Infix } Kind;
+    int8_t MinBp; // of the expression the operand belongs to
+    Token Tok;    // the operator, '[', '(' or the called function
+    size_t Mark = 0;          // Argument: first argument on ExprStack
+    ast::Expr *Lhs = nullptr; // Index, Infix: the left operand
+  };
+  vector<ExprFrame> ExprFrames;
+
+  template <typename T> Span<T> Take(vector<T> &Stack, size_t Mark) {
+    Span<T> Result = Ctx->Copy(Stack, Mark);
+    Stack.erase(Stack.begin() + Mark, Stack.end());
+    return Result;
+  }
+
+  ast::Expr *ParseExpr();
+  ast::Expr *ParseExpr(int8_t min_bp);
+  bool ResumeExpr(ExprFrame &, ast::Expr *&, int8_t &);
+
+  // Parses top-level items into `instrs` until Current reaches End.
+  void ParseItems(size_t End, vector<variant<ast::Func, ast::DeclStmt>> &);
+  vector<uint32_t> SplitItems() const;
+  bool ParseParallel(unsigned Threads, ast::Program &);
 
   ast::Func ParseFunction();
-  shared_ptr<ast::Stmt> ParseStmt();
-  shared_ptr<ast::IfStmt> ParseIfStmt();
+  ast::Stmt *ParseStmt();
+  ast::IfStmt *ParseIfStmt();
   ast::DeclStmt ParseDeclStmt();
-  shared_ptr<ast::ReturnStmt> ParseReturnStmt();
-  shared_ptr<ast::BlockStmt> ParseBlockStmt();
-  shared_ptr<ast::WhileStmt> ParseWhileStmt();
+  ast::ReturnStmt *ParseReturnStmt();
+  ast::BlockStmt *ParseBlockStmt();
+  ast::WhileStmt *ParseWhileStmt();
 
   Token next();
   Token expect(TokenType, const char *);
+  // Reports a syntax error at the current token.
+  [[noreturn]] void error(const char *);
   bool match(TokenType);
-  Token &peek(int);
+  const Token &peek(int);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef __passes_hpp
+#define __passes_hpp
+#include "ssa.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Optimizations on the SSA IR. Each pass works on one function, keeps it
+// valid for ssa::Verify and returns whether it changed anything.
+namespace ssa {
+
+// Sparse conditional constant propagation (Wegman and Zadeck): folds the
+// values that are constant on every path that can run, loads from const
+// globals included, and removes the branches and blocks that cannot.
+bool SCCP(Function &F);
+// Global value numbering over the dominator tree: removes instructions
+// that compute what a dominating one already has, simplifies algebraic
+// identities, and forwards stored and loaded values to later loads of
+// the same address that no store or call in between can change.
+bool GVN(Function &F);
+// Aggressive dead code elimination: assumes an instruction is dead until
+// a side effect needs it, branches included, and turns the branches
+// nothing needs into jumps to their nearest needed post-dominator. Loops
+// are kept, since removing one could remove an infinite loop.
+bool ADCE(Function &F);
+// Merges a block into its only predecessor when that ends in a jump to
+// it, and folds single-operand phis.
+bool SimplifyCFG(Function &F);
+
+// Turns while loops into do-while loops behind a guard, copying the test
+// in the header to the preheader and the latch, so the body runs first
+// and the loop has a preheader that only runs if the body does.
+bool RotateLoops(Function &F);
+// Loop-invariant code motion: hoists the computations and the loads that
+// are the same on every iteration into the preheader.
+bool LICM(Function &F);
+// Induction variable strength reduction: gives multiplications and
+// addresses that grow linearly with a loop their own phis, stepped by an
+// addition per iteration, so array walks become pointer increments.
+bool StrengthReduce(Function &F);
+
+// Sets Function::WritesMemory for every function of `M`: whether a call
+// to it may store to memory the caller can see.
+void ComputeEffects(Module &M);
+
+// Drops the blocks of `F` that are not `Live`, by Block::Id, along with
+// their edges into live blocks; no live block may use their values.
+void RemoveBlocks(Function &F, const std::vector<bool> &Live);
+// Removes the blocks no path from the entry reaches; returns whether
+// there were any.
+bool RemoveUnreachable(Function &F);
+// Replaces the terminator of `B` with a jump to `To`. If `B` did not
+// branch to `To` already, the phis of `To` get undef for the new edge.
+void JumpTo(Function &F, Block *B, Block *To);
+// Moves the edges from the blocks `From` into `To` to a new block that
+// jumps to `To`, with phis for what they brought to the phis of `To`.
+Block *SplitPreds(Function &F, Block *To, const std::vector<Block *> &From);
+// The object a pointer points into: the alloca, argument or global that
+// its chain of PtrAdds and phis starts from, or the pointer itself if
+// that is not one value.
+Value *PointerRoot(Value *P);
+// Folds `I`, whose operands `Ops` are all ConstInts or ConstFloats, to a
+// constant; nullptr if the result is undefined or `I` does not fold.
+Value *Fold(Function &F, const Instr *I, Value *const *Ops);
+
+// Runs function passes in order over every function of a module, timing
+// each one.
+struct PassManager {
+  struct Entry {
+    const char *Name;
+    bool (*Run)(Function &);
+    double Seconds = 0;
+    size_t Changed = 0;       // functions it changed
+    int64_t InstrsRemoved = 0; // only counted if Counting
+  };
+  std::vector<Entry> Passes;
+  // Counts the instructions around every pass, which costs a walk of
+  // each function; for --time-passes.
+  bool Counting = false;
+
+  void add(const char *Name, bool (*Run)(Function &)) {
+    Passes.push_back({Name, Run});
+  }
+  void run(Module &M);
+  // A table of the time and effect of each pass.
+  void report(FILE *Out) const;
+};
+
+// The passes --opt-ssa runs: the scalar ones, then the loop ones and the
+// scalar ones again to clean up after them. Strength reduction only runs
+// for -O0: LLVM vectorizes indexed loops that it cannot once they walk
+// pointers, and reduces what is left in its own backend.
+void AddScalarPasses(PassManager &PM);
+void AddLoopPasses(PassManager &PM, unsigned OptLevel);
+
+} // namespace ssa
+
+#endif
@@ -0,0 +1,421 @@
+#ifndef __recursiveastvisitor_hpp
+#define __recursiveastvisitor_hpp
+#include "ast.hpp"
+#include "casting.hpp"
+#include "common.hpp"
+#include <cstdint>
+#include <variant>
+#include <vector>
+
+using namespace std;
+
+namespace ast {
+
+// Every node type, with the group its hooks fall back to.
+#define AST_NODES(X)                                                           \
+  X(IntegerExpr, Expr)                                                         \
+  X(FloatExpr, Expr)                                                           \
+  X(NegateExpr, Expr)                                                          \
+  X(BinopExpr, Expr)                                                           \
+  X(CmpExpr, Expr)                                                             \
+  X(NotExpr, Expr)                                                             \
+  X(LogicalExpr, Expr)                                                         \
+  X(VariableExpr, Expr)                                                        \
+  X(IndexExpr, Expr)                                                           \
+  X(AssignExpr, Expr)                                                          \
+  X(FunctionCallExpr, Expr)                                                    \
+  X(ExprStmt, Stmt)                                                            \
+  X(IfStmt, Stmt)                                                              \
+  X(DeclStmt, Stmt)                                                            \
+  X(ReturnStmt, Stmt)                                                          \
+  X(BlockStmt, Stmt)                                                           \
+  X(ContinueStmt, Stmt)                                                        \
+  X(BreakStmt, Stmt)                                                           \
+  X(WhileStmt, Stmt)                                                           \
+  X(InitVals, Node)                                                            \
+  X(Param, Node)                                                               \
+  X(Func, Node)
+
+// The statically dispatched counterpart of ASTWalker. Derived hides the
+// hooks it cares about; the rest are empty inline functions, so a
+// traversal compiles down to a kind switch per node and the code of the
+// hooks that do something. For every node N of type X it calls
+//
+//   enterX(N); then for each child slot i (in the order of children()):
+//   beforeX(N, i, C), the traversal of C unless it is empty,
+//   afterX(N, i, C); and finally leaveX(N).
+//
+// enterX and leaveX default to enterExpr/enterStmt (or leave...), and
+// those to enterNode/leaveNode, so a pass can hook a whole group at once.
+//
+// The traversal recurses on the native stack, which is the fastest way to
+// walk ordinary trees. Past MaxDepth nodes it continues that subtree on a
+// stack on the heap, calling the same hooks in the same order, so deep
+// trees (a + (a + (...)) nested a million times) are still safe.
+template <typename Derived> struct RecursiveASTVisitor {
+  static constexpr unsigned MaxDepth = 1024;
+
+  void traverse(Program &P) {
+    for (auto &Item : P.instrs) {
+      if (auto *F = get_if<Func>(&Item)) {
+        traverse(F);
+      } else {
+        traverse(&get<DeclStmt>(Item));
+      }
+    }
+  }
+
+  void traverse(Expr *E) {
+    if (E == nullptr) {
+      return;
+    }
+    if (Depth == MaxDepth) {
+      return walkOnHeap(E);
+    }
+    Depth++;
+    switch (E->Kind) {
+    case ExprKind::Integer:
+      traverseNode(cast<IntegerExpr>(E));
+      break;
+    case ExprKind::Float:
+      traverseNode(cast<FloatExpr>(E));
+      break;
+    case ExprKind::Negate:
+      traverseNode(cast<NegateExpr>(E));
+      break;
+    case ExprKind::Binop:
+      traverseNode(cast<BinopExpr>(E));
+      break;
+    case ExprKind::Cmp:
+      traverseNode(cast<CmpExpr>(E));
+      break;
+    case ExprKind::Not:
+      traverseNode(cast<NotExpr>(E));
+      break;
+    case ExprKind::Logical:
+      traverseNode(cast<LogicalExpr>(E));
+      break;
+    case ExprKind::Variable:
+      traverseNode(cast<VariableExpr>(E));
+      break;
+    case ExprKind::Index:
+      traverseNode(cast<IndexExpr>(E));
+      break;
+    case ExprKind::Assign:
+      traverseNode(cast<AssignExpr>(E));
+      break;
+    case ExprKind::FunctionCall:
+      traverseNode(cast<FunctionCallExpr>(E));
+      break;
+    }
+    Depth--;
+  }
+
+  void traverse(Stmt *S) {
+    if (S == nullptr) {
+      return;
+    }
+    if (Depth == MaxDepth) {
+      return walkOnHeap(S);
+    }
+    Depth++;
+    switch (S->Kind) {
+    case StmtKind::Expr:
+      traverseNode(cast<ExprStmt>(S));
+      break;
+    case StmtKind::If:
+      traverseNode(cast<IfStmt>(S));
+      break;
+    case StmtKind::Decl:
+      traverseNode(cast<DeclStmt>(S));
+      break;
+    case StmtKind::Return:
+      traverseNode(cast<ReturnStmt>(S));
+      break;
+    case StmtKind::Block:
+      traverseNode(cast<BlockStmt>(S));
+      break;
+    case StmtKind::Continue:
+      traverseNode(cast<ContinueStmt>(S));
+      break;
+    case StmtKind::Break:
+      traverseNode(cast<BreakStmt>(S));
+      break;
+    case StmtKind::While:
+      traverseNode(cast<WhileStmt>(S));
+      break;
+    }
+    Depth--;
+  }
+
+  void traverse(InitVals *IV) { traverseGuarded(IV); }
+  void traverse(Param *P) { traverseGuarded(P); }
+  void traverse(Func *F) { traverseGuarded(F); }
+
+  void traverse(NodeRef N) {
+    switch (N.Cls) {
+    case NodeRef::Class::None:
+      break;
+    case NodeRef::Class::Expr:
+      return traverse(N.expr());
+    case NodeRef::Class::Stmt:
+      return traverse(N.stmt());
+    case NodeRef::Class::InitVals:
+      return traverse(N.initVals());
+    case NodeRef::Class::Param:
+      return traverse(N.param());
+    case NodeRef::Class::Func:
+      return traverse(N.func());
+    }
+  }
+
+  // Group hooks.
+  void enterNode(NodeRef) {}
+  void leaveNode(NodeRef) {}
+  void enterExpr(Expr *E) { derived().enterNode(E); }
+  void leaveExpr(Expr *E) { derived().leaveNode(E); }
+  void enterStmt(Stmt *S) { derived().enterNode(S); }
+  void leaveStmt(Stmt *S) { derived().leaveNode(S); }
+
+  // Per-node hooks.
+#define AST_VISITOR_HOOKS(Node, Group)                                         \
+  void enter##Node(Node *N) { derived().enter##Group(N); }                     \
+  void before##Node(Node *, unsigned, NodeRef) {}                              \
+  void after##Node(Node *, unsigned, NodeRef) {}                               \
+  void leave##Node(Node *N) { derived().leave##Group(N); }
+  AST_NODES(AST_VISITOR_HOOKS)
+#undef AST_VISITOR_HOOKS
+
+private:
+  Derived &derived() { return *static_cast<Derived *>(this); }
+
+  // Overloads that route a node to its hooks by its static type.
+#define AST_VISITOR_DISPATCH(Node, Group)                                      \
+  void enter(Node *N) { derived().enter##Node(N); }                            \
+  void before(Node *N, unsigned i, NodeRef C) {                                \
+    derived().before##Node(N, i, C);                                           \
+  }                                                                            \
+  void after(Node *N, unsigned i, NodeRef C) {                                 \
+    derived().after##Node(N, i, C);                                            \
+  }                                                                            \
+  void leave(Node *N) { derived().leave##Node(N); }
+  AST_NODES(AST_VISITOR_DISPATCH)
+#undef AST_VISITOR_DISPATCH
+
+  template <typename N> void traverseGuarded(N *Node) {
+    if (Node == nullptr) {
+      return;
+    }
+    if (Depth == MaxDepth) {
+      return walkOnHeap(Node);
+    }
+    Depth++;
+    traverseNode(Node);
+    Depth--;
+  }
+
+  template <typename N> void traverseNode(N *Node) {
+    enter(Node);
+    traverseChildren(Node);
+    leave(Node);
+  }
+
+  template <typename N, typename C> void slot(N *Node, unsigned i, C *Child) {
+    before(Node, i, Child);
+    traverse(Child);
+    after(Node, i, Child);
+  }
+
+  // The child slots of each node, as children() lists them.
+  void traverseChildren(IntegerExpr *) {}
+  void traverseChildren(FloatExpr *) {}
+  void traverseChildren(VariableExpr *) {}
+  void traverseChildren(NegateExpr *E) { slot(E, 0, E->operand); }
+  void traverseChildren(NotExpr *E) { slot(E, 0, E->operand); }
+  void traverseChildren(BinopExpr *E) {
+    slot(E, 0, E->lhs);
+    slot(E, 1, E->rhs);
+  }
+  void traverseChildren(CmpExpr *E) {
+    slot(E, 0, E->lhs);
+    slot(E, 1, E->rhs);
+  }
+  void traverseChildren(LogicalExpr *E) {
+    slot(E, 0, E->lhs);
+    slot(E, 1, E->rhs);
+  }
+  void traverseChildren(IndexExpr *E) {
+    if (E->BaseArray) {
+      slot(E, 0, E->BaseArray);
+    } else {
+      slot(E, 0, E->SubArray);
+    }
+    slot(E, 1, E->Index);
+  }
+  void traverseChildren(AssignExpr *E) {
+    if (E->Target) {
+      slot(E, 0, E->Target);
+    } else {
+      slot(E, 0, E->ArrayTarget);
+    }
+    slot(E, 1, E->Assignment);
+  }
+  void traverseChildren(FunctionCallExpr *E) {
+    for (unsigned i = 0; i < E->RealParameters.size(); ++i) {
+      slot(E, i, E->RealParameters[i]);
+    }
+  }
+  void traverseChildren(ExprStmt *S) { slot(S, 0, S->E); }
+  void traverseChildren(IfStmt *S) {
+    slot(S, 0, S->cond);
+    slot(S, 1, S->IfBranch);
+    slot(S, 2, S->ElseBranch);
+  }
+  void traverseChildren(DeclStmt *S) {
+    unsigned Dims = S->Dims.size();
+    for (unsigned i = 0; i < Dims; ++i) {
+      slot(S, i, S->Dims[i]);
+    }
+    slot(S, Dims, S->initvals_);
+  }
+  void traverseChildren(ReturnStmt *S) { slot(S, 0, S->ReturnExpr); }
+  void traverseChildren(BlockStmt *S) {
+    for (unsigned i = 0; i < S->Stmts.size(); ++i) {
+      slot(S, i, S->Stmts[i]);
+    }
+  }
+  void traverseChildren(ContinueStmt *) {}
+  void traverseChildren(BreakStmt *) {}
+  void traverseChildren(WhileStmt *S) {
+    slot(S, 0, S->LoopCond);
+    slot(S, 1, S->LoopBody);
+  }
+  void traverseChildren(InitVals *IV) {
+    if (IV->val) {
+      slot(IV, 0, IV->val);
+      return;
+    }
+    for (unsigned i = 0; i < IV->vals.size(); ++i) {
+      slot(IV, i, &IV->vals[i]);
+    }
+  }
+  void traverseChildren(Param *P) {
+    for (unsigned i = 0; i < P->dims_.size(); ++i) {
+      slot(P, i, P->dims_[i]);
+    }
+  }
+  void traverseChildren(Func *F) {
+    unsigned Params = F->formal_paras_.size();
+    for (unsigned i = 0; i < Params; ++i) {
+      slot(F, i, &F->formal_paras_[i]);
+    }
+    slot(F, Params, F->body_);
+  }
+
+  // Calls `Fn` with `N` cast to its node type.
+  template <typename Fn> void dispatch(NodeRef N, Fn &&F) {
+    switch (N.Cls) {
+    case NodeRef::Class::None:
+      return;
+    case NodeRef::Class::Expr:
+      switch (N.expr()->Kind) {
+      case ExprKind::Integer:
+        return F(cast<IntegerExpr>(N.expr()));
+      case ExprKind::Float:
+        return F(cast<FloatExpr>(N.expr()));
+      case ExprKind::Negate:
+        return F(cast<NegateExpr>(N.expr()));
+      case ExprKind::Binop:
+        return F(cast<BinopExpr>(N.expr()));
+      case ExprKind::Cmp:
+        return F(cast<CmpExpr>(N.expr()));
+      case ExprKind::Not:
+        return F(cast<NotExpr>(N.expr()));
+      case ExprKind::Logical:
+        return F(cast<LogicalExpr>(N.expr()));
+      case ExprKind::Variable:
+        return F(cast<VariableExpr>(N.expr()));
+      case ExprKind::Index:
+        return F(cast<IndexExpr>(N.expr()));
+      case ExprKind::Assign:
+        return F(cast<AssignExpr>(N.expr()));
+      case ExprKind::FunctionCall:
+        return F(cast<FunctionCallExpr>(N.expr()));
+      }
+      break;
+    case NodeRef::Class::Stmt:
+      switch (N.stmt()->Kind) {
+      case StmtKind::Expr:
+        return F(cast<ExprStmt>(N.stmt()));
+      case StmtKind::If:
+        return F(cast<IfStmt>(N.stmt()));
+      case StmtKind::Decl:
+        return F(cast<DeclStmt>(N.stmt()));
+      case StmtKind::Return:
+        return F(cast<ReturnStmt>(N.stmt()));
+      case StmtKind::Block:
+        return F(cast<BlockStmt>(N.stmt()));
+      case StmtKind::Continue:
+        return F(cast<ContinueStmt>(N.stmt()));
+      case StmtKind::Break:
+        return F(cast<BreakStmt>(N.stmt()));
+      case StmtKind::While:
+        return F(cast<WhileStmt>(N.stmt()));
+      }
+      break;
+    case NodeRef::Class::InitVals:
+      return F(N.initVals());
+    case NodeRef::Class::Param:
+      return F(N.param());
+    case NodeRef::Class::Func:
+      return F(N.func());
+    }
+    unreachable("Unknown node.");
+  }
+
+  // ASTWalker::walk with the hooks above. Rarely runs, so it shares
+  // children() with ASTWalker instead of being specialized per kind.
+  void walkOnHeap(NodeRef Root) {
+    size_t Base = Stack.size();
+    dispatch(Root, [&](auto *N) { enter(N); });
+    Stack.push_back({Root, uint32_t(Children.size()), 0});
+    children(Root, Children);
+    while (Stack.size() > Base) {
+      Frame F = Stack.back();
+      if (F.First + F.Next == Children.size()) {
+        Stack.pop_back();
+        Children.resize(F.First);
+        dispatch(F.Node, [&](auto *N) { leave(N); });
+        if (Stack.size() > Base) {
+          Frame &Parent = Stack.back();
+          unsigned i = Parent.Next++;
+          dispatch(Parent.Node, [&](auto *N) { after(N, i, F.Node); });
+        }
+        continue;
+      }
+      NodeRef Child = Children[F.First + F.Next];
+      dispatch(F.Node, [&](auto *N) { before(N, F.Next, Child); });
+      if (Child.isNull()) {
+        Stack.back().Next++;
+        dispatch(F.Node, [&](auto *N) { after(N, F.Next, Child); });
+        continue;
+      }
+      dispatch(Child, [&](auto *N) { enter(N); });
+      Stack.push_back({Child, uint32_t(Children.size()), 0});
+      children(Child, Children);
+    }
+  }
+
+  struct Frame {
+    NodeRef Node;
+    uint32_t First;
+    unsigned Next;
+  };
+  vector<Frame> Stack;
+  vector<NodeRef> Children;
+  unsigned Depth = 0;
+};
+
+} // namespace ast
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef __resolve_hpp
+#define __resolve_hpp
+#include "ast.hpp"
+#include "source.hpp"
+
+namespace ast {
+
+// Binds every use of a name to its declaration: sets VariableExpr::Decl
+// to the DeclStmt or Param it refers to and FunctionCallExpr::Callee to
+// the Func it calls, as declared or defined before the call, or to one of
+// the SysY runtime functions (getint, putarray, ...), which are always
+// declared.
+//
+// Scoping is C's: a declaration is visible from the end of its dims, so
+// its initializer already sees it, to the end of the enclosing block; a
+// function's parameters share the scope of its body; functions and
+// variables have separate names. Throws the first error with its
+// location: an undeclared name, or a name declared twice in one scope.
+void ResolveNames(Program &P, const SourceManager &SM);
+
+// The SysY runtime functions calls may bind to. They have no body.
+Span<Func> RuntimeFunctions();
+
+} // namespace ast
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef __source_hpp
+#define __source_hpp
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Every buffer handed out by SourceManager is followed by this many '\0'
+// bytes, which the lexer uses as sentinels.
+constexpr uint32_t SourcePadding = 32;
+
+// A position in the source, packed into 32 bits. Every file owns a
+// contiguous range of the location space (see SourceFile::Base), so the raw
+// value encodes both the file and the byte offset within it. Line and
+// column are only computed when a location is printed.
+struct SourceLoc {
+  uint32_t Raw = 0; // 0 is the invalid location
+
+  bool isValid() const { return Raw != 0; }
+  bool operator==(const SourceLoc &) const = default;
+};
+
+// One input file. The contents are either mapped read-only from disk or,
+// for pipes, read into an owned buffer; in both cases they are padded.
+struct SourceFile {
+  std::string Name;
+
+  SourceFile(std::string Name) : Name(std::move(Name)) {}
+  SourceFile(const SourceFile &) = delete;
+  SourceFile &operator=(const SourceFile &) = delete;
+  ~SourceFile();
+
+  std::string_view text() const { return std::string_view(Data, Size); }
+
+  // Locations of this file are [Base, Base + Size]; the last one is the
+  // end of file.
+  SourceLoc getLoc(uint32_t Offset) const { return SourceLoc{Base + Offset}; }
+  uint32_t getOffset(SourceLoc Loc) const { return Loc.Raw - Base; }
+  bool contains(SourceLoc Loc) const {
+    return Loc.Raw >= Base && Loc.Raw - Base <= Size;
+  }
+
+  // 1-based line and column of a byte offset. The line table is only built
+  // the first time this is called, i.e. when a diagnostic is printed.
+  std::pair<uint32_t, uint32_t> getLineCol(uint32_t Offset) const;
+
+private:
+  friend struct SourceManager;
+
+  uint32_t Base = 0;
+  const char *Data = nullptr;
+  uint32_t Size = 0;
+  void *Mapping = nullptr; // mmap'd region, if any
+  size_t MappingSize = 0;
+  std::unique_ptr<char[]> Buffer; // owned copy otherwise
+
+  mutable std::vector<uint32_t> LineOffsets; // start offset of every line
+};
+
+// Owns all source buffers of a compilation; files are identified by their
+// index in `Files`.
+struct SourceManager {
+  std::vector<std::unique_ptr<SourceFile>> Files;
+
+  // Maps `Path` ("-" for stdin). Throws a message if it cannot be read.
+  uint32_t LoadFile(const char *Path);
+  // Copies an in-memory buffer, e.g. generated source.
+  uint32_t AddBuffer(std::string Name, std::string_view Contents);
+
+  const SourceFile &getFile(uint32_t FileId) const { return *Files[FileId]; }
+  // The file a valid location belongs to.
+  const SourceFile &getFile(SourceLoc Loc) const;
+  // "file:line:col", or "<unknown>" for an invalid location.
+  std::string describe(SourceLoc Loc) const;
+
+private:
+  uint32_t addFile(std::unique_ptr<SourceFile> File);
+
+  uint32_t NextBase = 1;
+};
+
+#endif
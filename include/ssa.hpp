@@ -0,0 +1,364 @@
+#ifndef __ssa_hpp
+#define __ssa_hpp
+#include "arena.hpp"
+#include "arrayinit.hpp"
+#include "casting.hpp"
+#include "outputsink.hpp"
+#include "symbol.hpp"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// minic's own SSA IR, built for fast passes:
+//
+// - Everything a function owns lives in its arena and is freed with it.
+// - Every value of a function (arguments, constants, instructions) has a
+//   dense 32-bit Id, so analyses keep their facts in flat arrays and
+//   bitvectors indexed by Id instead of hash maps. Blocks have dense Ids
+//   of their own.
+// - Operands are Uses stored inline after their instruction. Each Use is
+//   also a node of its value's intrusive use list, so uses are found and
+//   rewritten without searching.
+// - A block holds its instructions in an intrusive doubly linked list, so
+//   inserting and removing one is O(1).
+//
+// Types are scalar: memory is untyped bytes addressed by Ptr values, and
+// PtrAdd scales an index by the element size it carries.
+namespace hir {
+struct Module;
+} // namespace hir
+
+namespace ssa {
+
+enum class Type : uint8_t { Void, I1, I32, F32, Ptr };
+const char *TypeName(Type);
+
+enum class Opcode : uint8_t {
+  // Values that are not instructions.
+  Argument,
+  ConstInt,   // I32 or I1
+  ConstFloat,
+  GlobalAddr, // the address of a Global
+  Undef,
+  // Instructions, from here on.
+  Add,
+  Sub,
+  Mul,
+  SDiv,
+  SRem,
+  FAdd,
+  FSub,
+  FMul,
+  FDiv,
+  FNeg,
+  ICmp,   // signed, I1
+  FCmp,   // ordered, except Ne; I1
+  ZExt,   // I1 -> I32
+  SIToFP,
+  FPToSI,
+  Alloca, // Imm bytes of stack
+  Load,   // (Ptr)
+  Store,  // (Value, Ptr)
+  Zero,   // (Ptr): clears Imm bytes
+  PtrAdd, // (Ptr, I32 index): Ptr + index * Imm
+  Call,
+  Phi,
+  // Terminators.
+  Br,
+  CondBr, // (I1)
+  Ret,    // () or (Value)
+};
+const char *OpcodeName(Opcode);
+
+enum class Pred : uint8_t { Eq, Ne, Lt, Le, Gt, Ge };
+const char *PredName(Pred);
+
+struct Value;
+struct Instr;
+struct Block;
+struct Function;
+struct Global;
+
+// An operand: a node of the use list of `Val`.
+struct Use {
+  Value *Val = nullptr;
+  Instr *User = nullptr;
+  Use *Next = nullptr;
+  Use **Prev = nullptr; // the pointer that points at this Use
+
+  // Moves this use from its value's list to that of `V`, which may be
+  // nullptr.
+  void set(Value *V);
+};
+
+struct Value {
+  const Opcode Op;
+  Type Ty;
+  Pred P = Pred::Eq; // ICmp and FCmp
+  uint32_t Id;
+  Use *Uses = nullptr;
+
+  Value(Opcode Op, Type Ty, uint32_t Id) : Op(Op), Ty(Ty), Id(Id) {}
+  bool hasUses() const { return Uses != nullptr; }
+  bool hasOneUse() const { return Uses != nullptr && Uses->Next == nullptr; }
+  void replaceAllUsesWith(Value *V) {
+    while (Uses != nullptr) {
+      Uses->set(V);
+    }
+  }
+  bool isConstant() const {
+    return Op >= Opcode::ConstInt && Op <= Opcode::Undef;
+  }
+};
+
+struct Argument : Value {
+  uint32_t Index;
+  Argument(Type Ty, uint32_t Id, uint32_t Index)
+      : Value(Opcode::Argument, Ty, Id), Index(Index) {}
+  static bool classof(const Value *V) { return V->Op == Opcode::Argument; }
+};
+
+struct ConstInt : Value {
+  int32_t V;
+  ConstInt(Type Ty, uint32_t Id, int32_t V)
+      : Value(Opcode::ConstInt, Ty, Id), V(V) {}
+  static bool classof(const Value *V) { return V->Op == Opcode::ConstInt; }
+};
+
+struct ConstFloat : Value {
+  float V;
+  ConstFloat(uint32_t Id, float V)
+      : Value(Opcode::ConstFloat, Type::F32, Id), V(V) {}
+  static bool classof(const Value *V) { return V->Op == Opcode::ConstFloat; }
+};
+
+struct GlobalAddr : Value {
+  Global *G;
+  GlobalAddr(uint32_t Id, Global *G)
+      : Value(Opcode::GlobalAddr, Type::Ptr, Id), G(G) {}
+  static bool classof(const Value *V) { return V->Op == Opcode::GlobalAddr; }
+};
+
+struct Undef : Value {
+  Undef(Type Ty, uint32_t Id) : Value(Opcode::Undef, Ty, Id) {}
+  static bool classof(const Value *V) { return V->Op == Opcode::Undef; }
+};
+
+struct Instr : Value {
+  Block *Parent = nullptr;
+  Instr *Prev = nullptr, *Next = nullptr;
+  Use *Ops = nullptr; // inline after the instruction, except for grown phis
+  uint32_t NumOps = 0, Capacity = 0;
+  uint32_t Imm = 0; // Alloca and Zero: bytes; PtrAdd: the element size
+
+  Instr(Opcode Op, Type Ty, uint32_t Id) : Value(Op, Ty, Id) {}
+  static bool classof(const Value *V) { return V->Op >= Opcode::Add; }
+
+  Value *operand(unsigned i) const { return Ops[i].Val; }
+  void setOperand(unsigned i, Value *V) { Ops[i].set(V); }
+  bool isTerminator() const { return Op >= Opcode::Br; }
+  // Whether removing it, unused, could change what the program does.
+  bool hasSideEffects() const {
+    return Op == Opcode::Store || Op == Opcode::Zero || Op == Opcode::Call ||
+           isTerminator();
+  }
+  unsigned numSuccessors() const;
+  Block *successor(unsigned i) const;
+  void setSuccessor(unsigned i, Block *B);
+};
+
+// Br and CondBr; CondBr goes to Succ[0] if its operand is true.
+struct Branch : Instr {
+  Block *Succ[2] = {nullptr, nullptr};
+  Branch(Opcode Op, Type Ty, uint32_t Id) : Instr(Op, Ty, Id) {}
+  static bool classof(const Value *V) {
+    return V->Op == Opcode::Br || V->Op == Opcode::CondBr;
+  }
+};
+
+struct CallInstr : Instr {
+  Function *Callee = nullptr;
+  CallInstr(Opcode Op, Type Ty, uint32_t Id) : Instr(Op, Ty, Id) {}
+  static bool classof(const Value *V) { return V->Op == Opcode::Call; }
+};
+
+// Phis are at the start of their block and have one operand per
+// predecessor, in the order of Block::Preds.
+struct Phi : Instr {
+  Phi(Opcode Op, Type Ty, uint32_t Id) : Instr(Op, Ty, Id) {}
+  static bool classof(const Value *V) { return V->Op == Opcode::Phi; }
+};
+
+struct Block {
+  uint32_t Id;
+  Function *Parent;
+  Instr *First = nullptr, *Last = nullptr;
+  ArenaVector<Block *> Preds; // one entry per edge, in phi operand order
+
+  Block(uint32_t Id, Function *Parent) : Id(Id), Parent(Parent) {}
+
+  // Inserts `I` before `Before`, or at the end for nullptr.
+  void insert(Instr *I, Instr *Before = nullptr);
+  // Unlinks `I`, which keeps its operands.
+  void unlink(Instr *I);
+  Instr *terminator() const {
+    return Last != nullptr && Last->isTerminator() ? Last : nullptr;
+  }
+  Instr *firstNonPhi() const;
+  // Removes predecessor `i` and the matching operand of every phi.
+  void removePred(size_t i);
+
+  struct iterator {
+    Instr *I;
+    Instr *operator*() const { return I; }
+    // Reads the next one first, so the current one may be erased.
+    iterator &operator++() {
+      I = Next;
+      Next = I ? I->Next : nullptr;
+      return *this;
+    }
+    bool operator!=(const iterator &O) const { return I != O.I; }
+    Instr *Next;
+  };
+  iterator begin() const { return {First, First ? First->Next : nullptr}; }
+  iterator end() const { return {nullptr, nullptr}; }
+};
+
+// A global variable: `Bytes` of `Elem`s, zero except for its runs, whose
+// elements are in Words as the bit patterns of their type.
+struct Global {
+  Symbol Name;
+  Type Elem;
+  bool IsConst;
+  uint64_t Bytes;
+  Span<ast::ArrayInit::Run> Runs;
+  Span<uint32_t> Words;
+};
+
+struct Function {
+  Symbol Name;
+  Type RetTy;
+  std::vector<Argument *> Args;
+  std::vector<Block *> Blocks; // the entry first; empty for a declaration
+  Arena Storage;
+  uint32_t NumValues = 0; // the Ids in use are below it
+  uint32_t NumBlocks = 0;
+  // Whether a call may store to memory the caller can see; conservative
+  // until ComputeEffects has run.
+  bool WritesMemory = true;
+
+  Function(Symbol Name, Type RetTy) : Name(Name), RetTy(RetTy) {}
+  bool isDeclaration() const { return Blocks.empty(); }
+  Block *entry() const { return Blocks.front(); }
+
+  Argument *addArg(Type Ty);
+  // A block that is not in Blocks yet; appendBlock places it.
+  Block *createBlock();
+  void appendBlock(Block *B) { Blocks.push_back(B); }
+  Block *addBlock() {
+    appendBlock(createBlock());
+    return Blocks.back();
+  }
+
+  // Constants are uniqued per function, so two are equal if and only if
+  // they are the same Value.
+  ConstInt *getInt(int32_t V);
+  ConstInt *getBool(bool V);
+  ConstFloat *getFloat(float V);
+  GlobalAddr *getGlobal(Global *G);
+  Undef *getUndef(Type Ty);
+
+  // A detached instruction with `NumOps` operands, all nullptr.
+  template <typename T = Instr>
+  T *create(Opcode Op, Type Ty, unsigned NumOps) {
+    void *Mem = Storage.Allocate(sizeof(T) + NumOps * sizeof(Use), alignof(T));
+    T *I = new (Mem) T(Op, Ty, NumValues++);
+    I->Ops = reinterpret_cast<Use *>(I + 1);
+    I->NumOps = I->Capacity = NumOps;
+    for (unsigned i = 0; i < NumOps; ++i) {
+      new (&I->Ops[i]) Use{nullptr, I, nullptr, nullptr};
+    }
+    return I;
+  }
+  // Adds an operand to the phi `P`, moving its operands if they are full.
+  void addIncoming(Phi *P, Value *V);
+  // Drops the operands of `I` and unlinks it; it must be unused.
+  void erase(Instr *I);
+  // Removes the blocks that are not in `Keep`, by Block::Id, after their
+  // instructions have been dropped.
+  void removeBlocks(const std::vector<bool> &Keep);
+  size_t numInstrs() const;
+
+private:
+  std::unordered_map<uint64_t, Value *> Constants;
+  Value *constant(uint64_t Key, Value *(*Make)(Function &, uint64_t));
+};
+
+struct Module {
+  Arena Storage;
+  std::vector<Global *> Globals;
+  // Definitions and the runtime functions they call, in HIR order.
+  std::vector<std::unique_ptr<Function>> Functions;
+
+  Module() = default;
+  Module(Module &&) = default;
+  Module &operator=(Module &&) = default;
+  size_t numInstrs() const;
+  size_t bytesReserved() const;
+};
+
+// Appends instructions at the end of a block, or inserts them before an
+// instruction.
+struct Builder {
+  Function &F;
+  Block *BB = nullptr;
+  Instr *Before = nullptr; // nullptr for the end of BB
+
+  explicit Builder(Function &F) : F(F) {}
+  void setBlock(Block *B) {
+    BB = B;
+    Before = nullptr;
+  }
+  void setInsertPoint(Instr *I) {
+    BB = I->Parent;
+    Before = I;
+  }
+
+  Instr *binary(Opcode Op, Value *L, Value *R);
+  Instr *unary(Opcode Op, Type Ty, Value *X);
+  Instr *cmp(Pred P, Value *L, Value *R);
+  Instr *alloca(uint32_t Bytes);
+  Instr *load(Type Ty, Value *Ptr);
+  Instr *store(Value *V, Value *Ptr);
+  Instr *zero(Value *Ptr, uint32_t Bytes);
+  Instr *ptrAdd(Value *Ptr, Value *Index, uint32_t Size);
+  CallInstr *call(Function *Callee, Span<Value *> Args);
+  // A phi with no operands yet, at the start of `B`.
+  Phi *phi(Type Ty, Block *B);
+  Branch *br(Block *To);
+  Branch *condBr(Value *Cond, Block *Then, Block *Else);
+  Instr *ret(Value *V);
+
+private:
+  template <typename T = Instr>
+  T *append(Opcode Op, Type Ty, std::initializer_list<Value *> Ops);
+};
+
+// Throws a message naming the function and what is wrong if `F` breaks
+// an invariant of the IR: terminators, phis against predecessors, types,
+// use lists, or a definition that does not dominate its uses.
+void Verify(const Function &F);
+void Verify(const Module &M);
+
+void Print(const Function &F, OutputSink &Out);
+void Print(const Module &M, OutputSink &Out);
+
+// Lowers a checked HIR module, building SSA form as it goes: scalar
+// locals and parameters are values and phis, never memory. Only arrays
+// get allocas.
+Module BuildSSA(const hir::Module &M);
+
+} // namespace ssa
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef __symbol_hpp
+#define __symbol_hpp
+#include "arena.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// An interned identifier. Two symbols are equal iff their spellings are, so
+// comparing names is a single integer compare.
+struct Symbol {
+  uint32_t Id;
+
+  bool operator==(const Symbol &) const = default;
+  std::string_view str() const;
+};
+std::ostream &operator<<(std::ostream &, Symbol);
+
+// The global string interner: an open-addressing hash table of symbol ids
+// whose spellings live in an arena, so the views it hands out stay valid for
+// the whole run. The SysY keywords are interned first and take the ids
+// [0, NumKeywords) in the order of TokenType::KW_break..KW_void.
+// Not thread-safe; only the lexer adds symbols.
+struct Interner {
+  static constexpr uint32_t NumKeywords = 10;
+
+  static Interner &global();
+
+  Symbol intern(std::string_view);
+  std::string_view spelling(Symbol S) const { return Spellings[S.Id]; }
+  uint32_t size() const { return Spellings.size(); }
+
+private:
+  Interner();
+  void grow();
+
+  Arena Storage;
+  std::vector<std::string_view> Spellings; // indexed by Symbol::Id
+  std::vector<uint32_t> Hashes;            // indexed by Symbol::Id
+  std::vector<uint32_t> Slots;             // Symbol::Id + 1, or 0 if empty
+};
+
+inline std::string_view Symbol::str() const {
+  return Interner::global().spelling(*this);
+}
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef __symboltable_hpp
+#define __symboltable_hpp
+#include "symbol.hpp"
+#include <cstdint>
+#include <vector>
+
+// A map from symbols to T, open-addressed with linear probing over one
+// power-of-two array of slots, at most half full. Symbol ids are dense, so
+// a multiplicative hash of the id spreads them well, and a lookup is a
+// multiply, a shift and usually a single probe. Erasing shifts the rest of
+// the cluster back, so there are no tombstones and lookups never slow down
+// with churn. T should be cheap to copy.
+template <typename T> struct SymbolMap {
+  SymbolMap() : Slots(16) {}
+
+  T *find(Symbol S) {
+    for (size_t i = home(S.Id);; i = (i + 1) & mask()) {
+      if (Slots[i].Id == S.Id) {
+        return &Slots[i].Value;
+      }
+      if (Slots[i].Id == Empty) {
+        return nullptr;
+      }
+    }
+  }
+  const T *find(Symbol S) const {
+    return const_cast<SymbolMap *>(this)->find(S);
+  }
+
+  // Maps `S` to `Value`, replacing what it mapped to.
+  void set(Symbol S, const T &Value) {
+    size_t i = home(S.Id);
+    while (Slots[i].Id != S.Id && Slots[i].Id != Empty) {
+      i = (i + 1) & mask();
+    }
+    if (Slots[i].Id == Empty) {
+      if ((Count + 1) * 2 > Slots.size()) {
+        grow();
+        return set(S, Value);
+      }
+      Count++;
+    }
+    Slots[i] = {S.Id, Value};
+  }
+
+  void erase(Symbol S) {
+    size_t i = home(S.Id);
+    while (Slots[i].Id != S.Id) {
+      if (Slots[i].Id == Empty) {
+        return;
+      }
+      i = (i + 1) & mask();
+    }
+    // Moves every later entry of the cluster that may not skip the hole
+    // into it, until the cluster ends.
+    for (size_t j = (i + 1) & mask(); Slots[j].Id != Empty;
+         j = (j + 1) & mask()) {
+      size_t Home = home(Slots[j].Id);
+      if (((j - Home) & mask()) >= ((j - i) & mask())) {
+        Slots[i] = Slots[j];
+        i = j;
+      }
+    }
+    Slots[i].Id = Empty;
+    Count--;
+  }
+
+  size_t size() const { return Count; }
+
+private:
+  static constexpr uint32_t Empty = ~0u;
+  struct Slot {
+    uint32_t Id = Empty;
+    T Value{};
+  };
+
+  size_t mask() const { return Slots.size() - 1; }
+  size_t home(uint32_t Id) const {
+    return (uint64_t(Id) * 0x9E3779B97F4A7C15ull >> 32) & mask();
+  }
+  void grow() {
+    std::vector<Slot> Old(Slots.size() * 2);
+    Old.swap(Slots);
+    for (const Slot &E : Old) {
+      if (E.Id != Empty) {
+        size_t i = home(E.Id);
+        while (Slots[i].Id != Empty) {
+          i = (i + 1) & mask();
+        }
+        Slots[i] = E;
+      }
+    }
+  }
+
+  std::vector<Slot> Slots;
+  size_t Count = 0;
+};
+
+// A stack of scopes over one SymbolMap, which always holds the innermost
+// binding of every name. Declaring a name logs what it hid, and popping a
+// scope replays its part of the log backwards, so every operation costs
+// O(1) however deep the nesting and however many names are in scope; a
+// scope costs only the names declared in it.
+template <typename T> struct ScopedSymbolTable {
+  struct Binding {
+    T Value{};
+    uint32_t Depth = 0; // of the scope that declared it
+  };
+
+  void pushScope() { Marks.push_back(Log.size()); }
+  void popScope() {
+    for (size_t Mark = Marks.back(); Log.size() > Mark; Log.pop_back()) {
+      const Hidden &H = Log.back();
+      if (H.Had) {
+        Map.set(H.Name, H.Old);
+      } else {
+        Map.erase(H.Name);
+      }
+    }
+    Marks.pop_back();
+  }
+  // Scopes pushed and not yet popped.
+  uint32_t depth() const { return Marks.size(); }
+
+  // Binds `Name` to `Value` in the innermost scope.
+  void declare(Symbol Name, const T &Value) {
+    const Binding *Old = Map.find(Name);
+    Log.push_back({Name, Old != nullptr, Old ? *Old : Binding()});
+    Map.set(Name, {Value, depth()});
+  }
+
+  // The innermost binding of `Name`, or nullptr if there is none.
+  const Binding *lookup(Symbol Name) const { return Map.find(Name); }
+  // The binding of `Name` in the innermost scope, or nullptr.
+  const Binding *lookupLocal(Symbol Name) const {
+    const Binding *B = Map.find(Name);
+    return B && B->Depth == depth() ? B : nullptr;
+  }
+
+private:
+  struct Hidden {
+    Symbol Name;
+    bool Had;
+    Binding Old;
+  };
+
+  SymbolMap<Binding> Map;
+  std::vector<Hidden> Log;
+  std::vector<size_t> Marks;
+};
+
+#endif
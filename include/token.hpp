@@ -1,9 +1,11 @@
 #ifndef __token_hpp
 #define __token_hpp
+#include "source.hpp"
+#include "symbol.hpp"
+#include <cstdint>
 #include <ostream>
-#include <string>
-#include <variant>
-enum class TokenType {
+#include <string_view>
+enum class TokenType : uint8_t {
   // Punctuations
   LeftParen,    // '('
   RightParen,   // ')'
@@ -35,6 +37,7 @@ enum class TokenType {
   OpOr,  // '||'
 
   // keywords
+  // Same order as the keywords pre-interned by Interner.
   KW_break,
   KW_const,
   KW_continue,
@@ -56,25 +59,66 @@ enum class TokenType {
   Error,
 };
 
-struct Empty {};
+// A lexeme packed into 12 bytes: its kind, where it is in the source, and
+// the value of integer and float literals.
+// Identifiers and strings are not copied out of the source; their spelling
+// is a view that is only materialized when the AST needs it.
 struct Token {
-  TokenType type;
-  std::variant<Empty, int, float, std::string> content;
+  SourceLoc Loc;        // start of the lexeme
+  uint32_t Length : 24; // byte length of the lexeme
+  TokenType type : 8;
+  union {
+    int IntValue;     // TokenType::Integer
+    float FloatValue; // TokenType::Float
+    Symbol Sym;       // TokenType::Identifier
+  };
 
-  bool isKind(TokenType type);
-  bool isBinOp();
-  bool isNegOp();
-  bool isNotOp();
-  bool isCmpOp();
-  bool isLogicOp();
+  std::string_view spelling(const SourceFile &File) const {
+    return File.text().substr(File.getOffset(Loc), Length);
+  }
+  // Content of a string literal, without the quotes.
+  std::string_view stringValue(const SourceFile &File) const {
+    return File.text().substr(File.getOffset(Loc) + 1, Length - 2);
+  }
+
+  bool isKind(TokenType type) const;
+  bool isBinOp() const;
+  bool isNegOp() const;
+  bool isNotOp() const;
+  bool isCmpOp() const;
+  bool isLogicOp() const;
 };
-std::ostream &operator<<(std::ostream &, Token &);
+static_assert(sizeof(Token) == 12, "Token should stay packed");
+std::ostream &operator<<(std::ostream &, const Token &);
+
+// Loc and Length are filled in by the lexer. These are built for every
+// lexeme, so they are kept inline.
+inline Token SimpleToken(TokenType type) {
+  Token Result;
+  Result.Loc = SourceLoc();
+  Result.Length = 0;
+  Result.type = type;
+  Result.IntValue = 0;
+  return Result;
+}
+
+inline Token IntegerToken(int v) {
+  Token Result = SimpleToken(TokenType::Integer);
+  Result.IntValue = v;
+  return Result;
+}
+
+inline Token FloatToken(float v) {
+  Token Result = SimpleToken(TokenType::Float);
+  Result.FloatValue = v;
+  return Result;
+}
 
-Token SimpleToken(TokenType);
-Token IntegerToken(int);
-Token FloatToken(float);
-Token IdentifierToken(std::string);
-Token StringToken(std::string);
+inline Token IdentifierToken(Symbol s) {
+  Token Result = SimpleToken(TokenType::Identifier);
+  Result.Sym = s;
+  return Result;
+}
 // std::string TokenType2String(TokenType type);
 
 bool isBinOp(TokenType);
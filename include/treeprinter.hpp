@@ -0,0 +1,73 @@
+#ifndef __treeprinter_hpp
+#define __treeprinter_hpp
+#include "ast.hpp"
+#include "outputsink.hpp"
+#include "recursiveastvisitor.hpp"
+
+namespace ast {
+
+// Prints the program back as SysY, fully parenthesized.
+struct TreePrinter : public RecursiveASTVisitor<TreePrinter> {
+  OutputSink &Out;
+  int IndentDepth = 0;
+
+  TreePrinter(OutputSink &Out) : Out(Out) {}
+
+  void Indent();
+  void accept(Program &);
+
+  void enterIntegerExpr(IntegerExpr *);
+  void enterFloatExpr(FloatExpr *);
+  void enterVariableExpr(VariableExpr *);
+  void enterNegateExpr(NegateExpr *);
+  void leaveNegateExpr(NegateExpr *);
+  void enterNotExpr(NotExpr *);
+  void leaveNotExpr(NotExpr *);
+  void enterBinopExpr(BinopExpr *);
+  void beforeBinopExpr(BinopExpr *, unsigned, NodeRef);
+  void leaveBinopExpr(BinopExpr *);
+  void enterCmpExpr(CmpExpr *);
+  void beforeCmpExpr(CmpExpr *, unsigned, NodeRef);
+  void leaveCmpExpr(CmpExpr *);
+  void enterLogicalExpr(LogicalExpr *);
+  void beforeLogicalExpr(LogicalExpr *, unsigned, NodeRef);
+  void leaveLogicalExpr(LogicalExpr *);
+  void beforeIndexExpr(IndexExpr *, unsigned, NodeRef);
+  void leaveIndexExpr(IndexExpr *);
+  void beforeAssignExpr(AssignExpr *, unsigned, NodeRef);
+  void enterFunctionCallExpr(FunctionCallExpr *);
+  void beforeFunctionCallExpr(FunctionCallExpr *, unsigned, NodeRef);
+  void leaveFunctionCallExpr(FunctionCallExpr *);
+
+  void leaveExprStmt(ExprStmt *);
+  void enterIfStmt(IfStmt *);
+  void beforeIfStmt(IfStmt *, unsigned, NodeRef);
+  void enterWhileStmt(WhileStmt *);
+  void beforeWhileStmt(WhileStmt *, unsigned, NodeRef);
+  void enterReturnStmt(ReturnStmt *);
+  void leaveReturnStmt(ReturnStmt *);
+  void enterBlockStmt(BlockStmt *);
+  void beforeBlockStmt(BlockStmt *, unsigned, NodeRef);
+  void afterBlockStmt(BlockStmt *, unsigned, NodeRef);
+  void leaveBlockStmt(BlockStmt *);
+  void enterContinueStmt(ContinueStmt *);
+  void enterBreakStmt(BreakStmt *);
+  void enterDeclStmt(DeclStmt *);
+  void beforeDeclStmt(DeclStmt *, unsigned, NodeRef);
+  void afterDeclStmt(DeclStmt *, unsigned, NodeRef);
+  void leaveDeclStmt(DeclStmt *);
+
+  void enterInitVals(InitVals *);
+  void beforeInitVals(InitVals *, unsigned, NodeRef);
+  void leaveInitVals(InitVals *);
+  void enterParam(Param *);
+  void beforeParam(Param *, unsigned, NodeRef);
+  void afterParam(Param *, unsigned, NodeRef);
+  void enterFunc(Func *);
+  void beforeFunc(Func *, unsigned, NodeRef);
+  void leaveFunc(Func *);
+};
+
+} // namespace ast
+
+#endif
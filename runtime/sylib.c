@@ -0,0 +1,84 @@
+#include "sylib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+int getint(void) {
+  int t = 0;
+  scanf("%d", &t);
+  return t;
+}
+
+int input(void) { return getint(); }
+
+int getch(void) { return getchar(); }
+
+float getfloat(void) {
+  float f = 0;
+  scanf("%a", &f);
+  return f;
+}
+
+int getarray(int a[]) {
+  int n = getint();
+  for (int i = 0; i < n; i++) {
+    a[i] = getint();
+  }
+  return n;
+}
+
+int getfarray(float a[]) {
+  int n = getint();
+  for (int i = 0; i < n; i++) {
+    a[i] = getfloat();
+  }
+  return n;
+}
+
+void putint(int a) { printf("%d", a); }
+
+void putch(int a) { putchar(a); }
+
+void putfloat(float a) { printf("%a", a); }
+
+void putarray(int n, int a[]) {
+  printf("%d:", n);
+  for (int i = 0; i < n; i++) {
+    printf(" %d", a[i]);
+  }
+  printf("\n");
+}
+
+void putfarray(int n, float a[]) {
+  printf("%d:", n);
+  for (int i = 0; i < n; i++) {
+    printf(" %a", a[i]);
+  }
+  printf("\n");
+}
+
+// starttime() and stoptime() bracket the timed part of a program; the
+// total is reported on stderr when it exits.
+static struct timeval Start;
+static long long TotalUsec = 0;
+static int Timed = 0;
+
+static void report(void) {
+  fflush(stdout);
+  fprintf(stderr, "TOTAL: %lldH-%lldM-%lldS-%lldus\n", TotalUsec / 3600000000,
+          TotalUsec / 60000000 % 60, TotalUsec / 1000000 % 60,
+          TotalUsec % 1000000);
+}
+
+void starttime(void) { gettimeofday(&Start, NULL); }
+
+void stoptime(void) {
+  struct timeval Stop;
+  gettimeofday(&Stop, NULL);
+  TotalUsec += (Stop.tv_sec - Start.tv_sec) * 1000000LL + Stop.tv_usec -
+               Start.tv_usec;
+  if (!Timed) {
+    Timed = 1;
+    atexit(report);
+  }
+}
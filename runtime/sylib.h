@@ -0,0 +1,28 @@
+#ifndef __sylib_h
+#define __sylib_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The SysY runtime library, which compiled programs link against: input
+// from stdin, output to stdout and a timer reported on stderr.
+int getint(void);
+int getch(void);
+float getfloat(void);
+int getarray(int a[]);
+int getfarray(float a[]);
+int input(void); // getint, as some older tests call it
+void putint(int a);
+void putch(int a);
+void putfloat(float a);
+void putarray(int n, int a[]);
+void putfarray(int n, float a[]);
+void starttime(void);
+void stoptime(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,273 @@
+#include "passes.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace ssa {
+
+namespace {
+// Post-dominators by Cooper, Harvey and Kennedy on the reverse CFG, from
+// a virtual exit after every return. Blocks that cannot return, inside
+// an infinite loop, have none.
+struct PostDomTree {
+  uint32_t Exit;
+  vector<uint32_t> IPDom; // by Block::Id, Exit for the virtual exit
+  vector<uint32_t> Order; // in the reverse postorder, or ~0u
+
+  explicit PostDomTree(const Function &F)
+      : Exit(F.NumBlocks), IPDom(F.NumBlocks + 1, ~0u),
+        Order(F.NumBlocks + 1, ~0u) {
+    vector<Block *> ById(F.NumBlocks);
+    vector<uint32_t> Returns;
+    for (Block *B : F.Blocks) {
+      ById[B->Id] = B;
+      if (B->terminator()->Op == Opcode::Ret) {
+        Returns.push_back(B->Id);
+      }
+    }
+    // The reverse CFG goes from a block to its predecessors.
+    auto Succs = [&](uint32_t N, size_t i) -> uint32_t {
+      if (N == Exit) {
+        return i < Returns.size() ? Returns[i] : ~0u;
+      }
+      const Block *B = ById[N];
+      return i < B->Preds.size() ? B->Preds[i]->Id : ~0u;
+    };
+    vector<uint32_t> RPO;
+    vector<pair<uint32_t, size_t>> Stack{{Exit, 0}};
+    vector<bool> Seen(F.NumBlocks + 1);
+    Seen[Exit] = true;
+    while (!Stack.empty()) {
+      auto &[N, i] = Stack.back();
+      uint32_t S = Succs(N, i++);
+      if (S != ~0u) {
+        if (!Seen[S]) {
+          Seen[S] = true;
+          Stack.push_back({S, 0});
+        }
+        continue;
+      }
+      RPO.push_back(N);
+      Stack.pop_back();
+    }
+    reverse(RPO.begin(), RPO.end());
+    for (size_t i = 0; i < RPO.size(); ++i) {
+      Order[RPO[i]] = i;
+    }
+
+    auto Intersect = [&](uint32_t A, uint32_t B) {
+      while (A != B) {
+        while (Order[A] > Order[B]) {
+          A = IPDom[A];
+        }
+        while (Order[B] > Order[A]) {
+          B = IPDom[B];
+        }
+      }
+      return A;
+    };
+    IPDom[Exit] = Exit;
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (size_t i = 1; i < RPO.size(); ++i) {
+        const Block *B = ById[RPO[i]];
+        uint32_t New = ~0u;
+        // The predecessors in the reverse CFG are the successors.
+        Instr *T = B->terminator();
+        if (T->Op == Opcode::Ret) {
+          New = Exit;
+        }
+        for (unsigned j = 0; j < T->numSuccessors(); ++j) {
+          uint32_t P = T->successor(j)->Id;
+          if (IPDom[P] != ~0u) {
+            New = New == ~0u ? P : Intersect(P, New);
+          }
+        }
+        if (IPDom[B->Id] != New) {
+          IPDom[B->Id] = New;
+          Changed = true;
+        }
+      }
+    }
+  }
+
+  bool returns(const Block *B) const { return Order[B->Id] != ~0u; }
+};
+
+struct ADCEPass {
+  Function &F;
+  PostDomTree PDT;
+  vector<Block *> ById;
+  // The blocks whose branches decide whether each block runs, by Id.
+  vector<vector<Block *>> ControlDeps;
+  vector<bool> Live;      // by Value::Id
+  vector<bool> LiveBlock; // by Block::Id: has a live instruction
+  vector<Instr *> Work;
+
+  explicit ADCEPass(Function &F)
+      : F(F), PDT(F), ById(F.NumBlocks), ControlDeps(F.NumBlocks),
+        Live(F.NumValues), LiveBlock(F.NumBlocks) {
+    // A block depends on the branch of Y if it post-dominates a
+    // successor of Y but not Y: the post-dominance frontier.
+    for (Block *B : F.Blocks) {
+      ById[B->Id] = B;
+    }
+    for (Block *Y : F.Blocks) {
+      Instr *T = Y->terminator();
+      if (T->Op != Opcode::CondBr || !PDT.returns(Y)) {
+        continue;
+      }
+      for (unsigned i = 0; i < 2; ++i) {
+        uint32_t Runner = T->successor(i)->Id;
+        while (Runner != PDT.IPDom[Y->Id] && Runner != PDT.Exit &&
+               Runner != ~0u) {
+          auto &Deps = ControlDeps[Runner];
+          if (Deps.empty() || Deps.back() != Y) {
+            Deps.push_back(Y);
+          }
+          Runner = PDT.IPDom[Runner];
+        }
+      }
+    }
+  }
+
+  void mark(Instr *I) {
+    if (Live[I->Id]) {
+      return;
+    }
+    Live[I->Id] = true;
+    Work.push_back(I);
+  }
+
+  void propagate() {
+    while (!Work.empty()) {
+      Instr *I = Work.back();
+      Work.pop_back();
+      Block *B = I->Parent;
+      if (!LiveBlock[B->Id]) {
+        LiveBlock[B->Id] = true;
+        for (Block *Y : ControlDeps[B->Id]) {
+          mark(Y->terminator());
+        }
+      }
+      for (uint32_t i = 0; i < I->NumOps; ++i) {
+        if (auto *Op = dyn_cast<Instr>(I->operand(i))) {
+          mark(Op);
+        }
+      }
+      if (I->Op == Opcode::Phi) {
+        for (Block *P : B->Preds) {
+          mark(P->terminator());
+        }
+      }
+    }
+  }
+
+  // The nearest post-dominator of `B` that does something, where a dead
+  // branch of `B` can go instead; nullptr if there is none but the exit.
+  Block *target(Block *B) {
+    uint32_t N = PDT.IPDom[B->Id];
+    while (N != PDT.Exit && !LiveBlock[N]) {
+      N = PDT.IPDom[N];
+    }
+    return N == PDT.Exit ? nullptr : ById[N];
+  }
+
+  // Marks the branches that close a loop, found as the edges a depth
+  // first search takes back to a block still on its stack.
+  void markLatches() {
+    vector<uint8_t> State(F.NumBlocks); // 1 on the stack, 2 done
+    vector<pair<Block *, unsigned>> Stack{{F.entry(), 0}};
+    State[F.entry()->Id] = 1;
+    while (!Stack.empty()) {
+      auto &[B, i] = Stack.back();
+      Instr *T = B->terminator();
+      if (i == T->numSuccessors()) {
+        State[B->Id] = 2;
+        Stack.pop_back();
+        continue;
+      }
+      Block *S = T->successor(i++);
+      if (State[S->Id] == 1 && T->Op == Opcode::CondBr) {
+        mark(T);
+      } else if (State[S->Id] == 0) {
+        State[S->Id] = 1;
+        Stack.push_back({S, 0});
+      }
+    }
+  }
+
+  bool run() {
+    // Loops stay, as removing one could remove an infinite loop, and so
+    // do the branches into a loop that never ends.
+    markLatches();
+    for (Block *B : F.Blocks) {
+      Instr *T = B->terminator();
+      bool Endless = !PDT.returns(B);
+      for (unsigned i = 0; i < T->numSuccessors(); ++i) {
+        Endless |= !PDT.returns(T->successor(i));
+      }
+      if (Endless && T->Op == Opcode::CondBr) {
+        mark(T);
+      }
+      for (Instr *I : *B) {
+        if (I->hasSideEffects() && !isa<Branch>(I)) {
+          mark(I);
+        }
+      }
+    }
+    propagate();
+    vector<pair<Block *, Block *>> Jumps;
+    bool Again = true;
+    while (Again) {
+      Again = false;
+      Jumps.clear();
+      for (Block *B : F.Blocks) {
+        Instr *T = B->terminator();
+        if (T->Op != Opcode::CondBr || Live[T->Id]) {
+          continue;
+        }
+        if (Block *To = target(B)) {
+          Jumps.push_back({B, To});
+        } else {
+          mark(T);
+          Again = true;
+        }
+      }
+      propagate();
+    }
+
+    bool Changed = !Jumps.empty();
+    for (auto [B, To] : Jumps) {
+      JumpTo(F, B, To);
+    }
+    vector<Instr *> Dead;
+    for (Block *B : F.Blocks) {
+      for (Instr *I : *B) {
+        if (!Live[I->Id] && !I->isTerminator()) {
+          Dead.push_back(I);
+        }
+      }
+    }
+    for (Instr *I : Dead) {
+      for (uint32_t i = 0; i < I->NumOps; ++i) {
+        I->Ops[i].set(nullptr);
+      }
+    }
+    for (Instr *I : Dead) {
+      F.erase(I);
+    }
+    Changed |= !Dead.empty();
+    return RemoveUnreachable(F) || Changed;
+  }
+};
+} // namespace
+
+bool ADCE(Function &F) {
+  bool Changed = RemoveUnreachable(F);
+  ADCEPass P(F);
+  return P.run() || Changed;
+}
+
+} // namespace ssa
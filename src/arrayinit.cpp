@@ -0,0 +1,179 @@
+#include "arrayinit.hpp"
+#include "casting.hpp"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <vector>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+// Arrays are indexed with 64 bits, but a larger one is a mistake.
+constexpr uint64_t MaxElements = uint64_t(1) << 40;
+
+struct InitLayout {
+  const DeclStmt &D;
+  const InitFolder &Fold;
+  Span<const uint32_t> Shape;
+  vector<uint64_t> Strides; // Strides[d]: elements in a sub-array of dim d
+  bool IsFloat;
+
+  vector<ArrayInit::Run> Runs;
+  vector<int32_t> Ints;
+  vector<float> Floats;
+  vector<ArrayInit::Element> Exprs;
+
+  InitLayout(const DeclStmt &D, Span<const uint32_t> Shape,
+             const InitFolder &Fold)
+      : D(D), Fold(Fold), Shape(Shape), Strides(Shape.size() + 1),
+        IsFloat(D.basetype_ == BaseType::FLOAT) {
+    Strides[Shape.size()] = 1;
+    for (size_t d = Shape.size(); d-- > 0;) {
+      Strides[d] = Strides[d + 1] * Shape[d];
+      if (Strides[d] > MaxElements) {
+        throw format("Array '{}' is too large.", D.VarName.str());
+      }
+    }
+  }
+
+  // Sets element `Index` to `E`. Indices only grow, so runs are extended
+  // at the end or started after it.
+  void place(uint64_t Index, Expr *E) {
+    optional<ConstValue> Value = Fold(E);
+    if (!Value) {
+      Exprs.push_back({Index, E});
+      return;
+    }
+    // The value converts to the element type as in an assignment.
+    ConstValue V = Value->to(D.basetype_);
+    uint32_t Bits;
+    if (IsFloat) {
+      memcpy(&Bits, &V.Float, sizeof(Bits));
+    } else {
+      Bits = uint32_t(V.Int);
+    }
+    if (Bits == 0) {
+      return;
+    }
+    if (Runs.empty() || Runs.back().Start + Runs.back().Size != Index) {
+      uint32_t Offset = IsFloat ? Floats.size() : Ints.size();
+      Runs.push_back({Index, 0, Offset});
+    }
+    Runs.back().Size++;
+    if (IsFloat) {
+      Floats.push_back(V.Float);
+    } else {
+      Ints.push_back(V.Int);
+    }
+  }
+
+  [[noreturn]] void tooMany() {
+    throw format("Too many initializers for '{}'.", D.VarName.str());
+  }
+
+  // Lays out the braced list `IV` over the sub-array of dim `Dim` that
+  // starts at element `Base`. A nested list takes the next sub-array of
+  // the outermost dim it is aligned with; a list in place of a scalar
+  // contributes its first element.
+  void layout(const InitVals &IV, size_t Dim, uint64_t Base) {
+    uint64_t Pos = Base, End = Base + Strides[Dim];
+    for (const InitVals &Item : IV.vals) {
+      if (Pos >= End) {
+        tooMany();
+      }
+      if (Item.val != nullptr) {
+        place(Pos++, Item.val);
+        continue;
+      }
+      size_t Sub = Dim + 1;
+      while (Sub < Shape.size() && (Pos - Base) % Strides[Sub] != 0) {
+        Sub++;
+      }
+      if (Sub >= Shape.size()) {
+        scalar(Item, Pos++);
+        continue;
+      }
+      layout(Item, Sub, Pos);
+      Pos += Strides[Sub];
+    }
+  }
+
+  // `{{{e}}}` and the like in place of a single element.
+  void scalar(const InitVals &IV, uint64_t Index) {
+    const InitVals *Item = &IV;
+    while (Item->val == nullptr) {
+      if (Item->vals.empty()) {
+        return;
+      }
+      if (Item->vals.size() > 1) {
+        tooMany();
+      }
+      Item = &Item->vals[0];
+    }
+    place(Index, Item->val);
+  }
+};
+} // namespace
+
+optional<ConstValue> FoldLiteral(Expr *E) {
+  bool Negate = false;
+  while (auto *N = dyn_cast<NegateExpr>(E)) {
+    Negate = !Negate;
+    E = N->operand;
+  }
+  if (auto *I = dyn_cast<IntegerExpr>(E)) {
+    return ConstValue::ofInt(Negate ? int32_t(0u - uint32_t(I->Value))
+                                    : I->Value);
+  }
+  if (auto *F = dyn_cast<FloatExpr>(E)) {
+    return ConstValue::ofFloat(Negate ? -F->Value : F->Value);
+  }
+  return nullopt;
+}
+
+int32_t ArrayInit::intAt(uint64_t Index) const {
+  auto It = upper_bound(Runs.begin(), Runs.end(), Index,
+                        [](uint64_t I, const Run &R) { return I < R.Start; });
+  if (It == Runs.begin() || Index >= It[-1].Start + It[-1].Size) {
+    return 0;
+  }
+  return Ints[It[-1].Offset + (Index - It[-1].Start)];
+}
+
+float ArrayInit::floatAt(uint64_t Index) const {
+  auto It = upper_bound(Runs.begin(), Runs.end(), Index,
+                        [](uint64_t I, const Run &R) { return I < R.Start; });
+  if (It == Runs.begin() || Index >= It[-1].Start + It[-1].Size) {
+    return 0;
+  }
+  return Floats[It[-1].Offset + (Index - It[-1].Start)];
+}
+
+ArrayInit *LayoutInit(const DeclStmt &D, Span<const uint32_t> Shape,
+                      ASTContext &Ctx, const InitFolder &Fold) {
+  InitLayout L(D, Shape, Fold);
+  if (D.initvals_ != nullptr) {
+    if (D.initvals_->val != nullptr) {
+      if (!Shape.empty()) {
+        throw format("Array '{}' needs a braced initializer.",
+                     D.VarName.str());
+      }
+      L.place(0, D.initvals_->val);
+    } else if (Shape.empty()) {
+      L.scalar(*D.initvals_, 0);
+    } else {
+      L.layout(*D.initvals_, 0, 0);
+    }
+  }
+  ArrayInit *Result = Ctx.New<ArrayInit>();
+  Result->NumElements = L.Strides[0];
+  Result->Runs = Ctx.Copy(L.Runs);
+  Result->Ints = Ctx.Copy(L.Ints);
+  Result->Floats = Ctx.Copy(L.Floats);
+  Result->Exprs = Ctx.Copy(L.Exprs);
+  return Result;
+}
+
+} // namespace ast
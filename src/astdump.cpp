@@ -0,0 +1,429 @@
+#include "astdump.hpp"
+#include "ast.hpp"
+#include "binast.hpp"
+#include "flatast.hpp"
+#include "recursiveastvisitor.hpp"
+#include "treeprinter.hpp"
+#include <cmath>
+#include <variant>
+
+namespace ast {
+
+namespace {
+
+const char *BinOpSpelling[] = {"+", "-", "*", "/", "%"};
+const char *CmpOpSpelling[] = {">", ">=", "<", "<=", "==", "!="};
+const char *LogicalOpSpelling[] = {"&&", "||"};
+
+const char *TypeName(BaseType T) {
+  return T == BaseType::FLOAT ? "float" : "int";
+}
+
+const char *TypeName(ReturnType T) {
+  switch (T) {
+  case ReturnType::INT:
+    return "int";
+  case ReturnType::FLOAT:
+    return "float";
+  case ReturnType::VOID:
+    return "void";
+  }
+  return "";
+}
+
+struct SExprPrinter : RecursiveASTVisitor<SExprPrinter> {
+  OutputSink &Out;
+  int Level = 0; // indentation of the statements being printed
+
+  SExprPrinter(OutputSink &Out) : Out(Out) {}
+
+  // Starts a statement on a line of its own.
+  void newline() {
+    Out << '\n';
+    Out.fill(' ', 2 * Level);
+  }
+  // Starts an operand that is printed even when empty, as '_'.
+  void operand(NodeRef Child) {
+    Out << ' ';
+    if (Child.isNull())
+      Out << '_';
+  }
+
+  void enterIntegerExpr(IntegerExpr *E) { Out << E->Value; }
+  void enterFloatExpr(FloatExpr *E) { Out.writeFloatExact(E->Value); }
+  void enterVariableExpr(VariableExpr *E) { Out << E->VariName; }
+  void enterNegateExpr(NegateExpr *) { Out << "(-"; }
+  void enterNotExpr(NotExpr *) { Out << "(!"; }
+  void enterBinopExpr(BinopExpr *E) {
+    Out << '(' << BinOpSpelling[int(E->op)];
+  }
+  void enterCmpExpr(CmpExpr *E) { Out << '(' << CmpOpSpelling[int(E->op)]; }
+  void enterLogicalExpr(LogicalExpr *E) {
+    Out << '(' << LogicalOpSpelling[int(E->op)];
+  }
+  void enterIndexExpr(IndexExpr *) { Out << "([]"; }
+  void enterAssignExpr(AssignExpr *) { Out << "(="; }
+  void enterFunctionCallExpr(FunctionCallExpr *E) {
+    Out << "(call " << E->FuncName;
+  }
+  void beforeNegateExpr(NegateExpr *, unsigned, NodeRef) { Out << ' '; }
+  void beforeNotExpr(NotExpr *, unsigned, NodeRef) { Out << ' '; }
+  void beforeBinopExpr(BinopExpr *, unsigned, NodeRef) { Out << ' '; }
+  void beforeCmpExpr(CmpExpr *, unsigned, NodeRef) { Out << ' '; }
+  void beforeLogicalExpr(LogicalExpr *, unsigned, NodeRef) { Out << ' '; }
+  void beforeIndexExpr(IndexExpr *, unsigned, NodeRef) { Out << ' '; }
+  void beforeAssignExpr(AssignExpr *, unsigned, NodeRef) { Out << ' '; }
+  void beforeFunctionCallExpr(FunctionCallExpr *, unsigned, NodeRef) {
+    Out << ' ';
+  }
+  void leaveExpr(Expr *E) {
+    if (!isa<IntegerExpr>(E) && !isa<FloatExpr>(E) && !isa<VariableExpr>(E))
+      Out << ')';
+  }
+
+  void enterExprStmt(ExprStmt *) { Out << "(expr"; }
+  void beforeExprStmt(ExprStmt *, unsigned, NodeRef) { Out << ' '; }
+  void enterIfStmt(IfStmt *) {
+    Out << "(if";
+    Level++;
+  }
+  void beforeIfStmt(IfStmt *, unsigned i, NodeRef Child) {
+    if (i == 0) {
+      Out << ' ';
+    } else if (i == 1) {
+      newline();
+      if (Child.isNull())
+        Out << '_';
+    } else if (!Child.isNull()) {
+      newline();
+    }
+  }
+  void leaveIfStmt(IfStmt *) {
+    Level--;
+    Out << ')';
+  }
+  void enterWhileStmt(WhileStmt *) {
+    Out << "(while";
+    Level++;
+  }
+  void beforeWhileStmt(WhileStmt *, unsigned i, NodeRef Child) {
+    if (i == 0) {
+      Out << ' ';
+      return;
+    }
+    newline();
+    if (Child.isNull())
+      Out << '_';
+  }
+  void leaveWhileStmt(WhileStmt *) {
+    Level--;
+    Out << ')';
+  }
+  void enterReturnStmt(ReturnStmt *) { Out << "(return"; }
+  void beforeReturnStmt(ReturnStmt *, unsigned, NodeRef Child) {
+    if (!Child.isNull())
+      Out << ' ';
+  }
+  void enterBlockStmt(BlockStmt *) {
+    Out << "(block";
+    Level++;
+  }
+  void beforeBlockStmt(BlockStmt *, unsigned, NodeRef) { newline(); }
+  void leaveBlockStmt(BlockStmt *) {
+    Level--;
+    Out << ')';
+  }
+  void enterContinueStmt(ContinueStmt *) { Out << "(continue"; }
+  void enterBreakStmt(BreakStmt *) { Out << "(break"; }
+  void enterDeclStmt(DeclStmt *S) {
+    Out << "(decl " << (S->isConst ? "const " : "") << TypeName(S->basetype_)
+        << ' ' << S->VarName;
+  }
+  void beforeDeclStmt(DeclStmt *S, unsigned i, NodeRef Child) {
+    if (i == 0 && !S->Dims.empty())
+      Out << " (dims";
+    if (i < S->Dims.size() || !Child.isNull())
+      Out << ' ';
+  }
+  void afterDeclStmt(DeclStmt *S, unsigned i, NodeRef) {
+    if (i + 1 == S->Dims.size())
+      Out << ')';
+  }
+  void leaveStmt(Stmt *) { Out << ')'; }
+
+  void enterInitVals(InitVals *IV) {
+    if (IV->val == nullptr)
+      Out << "(list";
+  }
+  void beforeInitVals(InitVals *IV, unsigned, NodeRef) {
+    if (IV->val == nullptr)
+      Out << ' ';
+  }
+  void leaveInitVals(InitVals *IV) {
+    if (IV->val == nullptr)
+      Out << ')';
+  }
+
+  void enterParam(Param *P) {
+    Out << "(param " << TypeName(P->basetype_) << ' ' << P->paraname_;
+  }
+  void beforeParam(Param *, unsigned i, NodeRef Child) {
+    if (i == 0)
+      Out << " (dims";
+    operand(Child);
+  }
+  void leaveParam(Param *P) {
+    if (!P->dims_.empty())
+      Out << ')';
+    Out << ')';
+  }
+
+  void enterFunc(Func *F) {
+    Out << "(func " << TypeName(F->return_type_) << ' ' << F->function_name_
+        << " (params";
+    Level++;
+  }
+  void beforeFunc(Func *F, unsigned i, NodeRef Child) {
+    if (i < F->formal_paras_.size()) {
+      Out << ' ';
+      return;
+    }
+    Out << ')';
+    if (!Child.isNull())
+      newline();
+  }
+  void leaveFunc(Func *) {
+    Level--;
+    Out << ')';
+  }
+};
+
+struct JSONPrinter : RecursiveASTVisitor<JSONPrinter> {
+  OutputSink &Out;
+
+  JSONPrinter(OutputSink &Out) : Out(Out) {}
+
+  // Starts the field `Name`; the traversal skips empty slots, so they are
+  // written as null here.
+  void field(const char *Name, NodeRef Child) {
+    Out << ",\"" << Name << "\":";
+    if (Child.isNull())
+      Out << "null";
+  }
+  // Separates the elements of an array; an empty one is null.
+  void element(unsigned i, NodeRef Child) {
+    if (i > 0)
+      Out << ',';
+    if (Child.isNull())
+      Out << "null";
+  }
+  void kind(const char *Kind) { Out << "{\"kind\":\"" << Kind << '"'; }
+  void name(const char *Field, Symbol S) {
+    Out << ",\"" << Field << "\":\"" << S << '"';
+  }
+
+  void enterIntegerExpr(IntegerExpr *E) {
+    kind("Integer");
+    Out << ",\"value\":" << E->Value;
+  }
+  void enterFloatExpr(FloatExpr *E) {
+    kind("Float");
+    Out << ",\"value\":";
+    if (std::isfinite(E->Value))
+      Out.writeFloatExact(E->Value);
+    else
+      Out << "null";
+  }
+  void enterVariableExpr(VariableExpr *E) {
+    kind("Variable");
+    name("name", E->VariName);
+  }
+  void enterNegateExpr(NegateExpr *) { kind("Negate"); }
+  void beforeNegateExpr(NegateExpr *, unsigned, NodeRef C) {
+    field("operand", C);
+  }
+  void enterNotExpr(NotExpr *) { kind("Not"); }
+  void beforeNotExpr(NotExpr *, unsigned, NodeRef C) { field("operand", C); }
+  void enterBinopExpr(BinopExpr *E) {
+    kind("Binop");
+    Out << ",\"op\":\"" << BinOpSpelling[int(E->op)] << '"';
+  }
+  void beforeBinopExpr(BinopExpr *, unsigned i, NodeRef C) {
+    field(i == 0 ? "lhs" : "rhs", C);
+  }
+  void enterCmpExpr(CmpExpr *E) {
+    kind("Cmp");
+    Out << ",\"op\":\"" << CmpOpSpelling[int(E->op)] << '"';
+  }
+  void beforeCmpExpr(CmpExpr *, unsigned i, NodeRef C) {
+    field(i == 0 ? "lhs" : "rhs", C);
+  }
+  void enterLogicalExpr(LogicalExpr *E) {
+    kind("Logical");
+    Out << ",\"op\":\"" << LogicalOpSpelling[int(E->op)] << '"';
+  }
+  void beforeLogicalExpr(LogicalExpr *, unsigned i, NodeRef C) {
+    field(i == 0 ? "lhs" : "rhs", C);
+  }
+  void enterIndexExpr(IndexExpr *) { kind("Index"); }
+  void beforeIndexExpr(IndexExpr *, unsigned i, NodeRef C) {
+    field(i == 0 ? "base" : "index", C);
+  }
+  void enterAssignExpr(AssignExpr *) { kind("Assign"); }
+  void beforeAssignExpr(AssignExpr *, unsigned i, NodeRef C) {
+    field(i == 0 ? "target" : "value", C);
+  }
+  void enterFunctionCallExpr(FunctionCallExpr *E) {
+    kind("Call");
+    name("callee", E->FuncName);
+    Out << ",\"args\":[";
+  }
+  void beforeFunctionCallExpr(FunctionCallExpr *, unsigned i, NodeRef C) {
+    element(i, C);
+  }
+  void leaveFunctionCallExpr(FunctionCallExpr *) { Out << "]}"; }
+  void leaveExpr(Expr *) { Out << '}'; }
+
+  void enterExprStmt(ExprStmt *) { kind("ExprStmt"); }
+  void beforeExprStmt(ExprStmt *, unsigned, NodeRef C) { field("expr", C); }
+  void enterIfStmt(IfStmt *) { kind("If"); }
+  void beforeIfStmt(IfStmt *, unsigned i, NodeRef C) {
+    static const char *Fields[] = {"cond", "then", "else"};
+    field(Fields[i], C);
+  }
+  void enterWhileStmt(WhileStmt *) { kind("While"); }
+  void beforeWhileStmt(WhileStmt *, unsigned i, NodeRef C) {
+    field(i == 0 ? "cond" : "body", C);
+  }
+  void enterReturnStmt(ReturnStmt *) { kind("Return"); }
+  void beforeReturnStmt(ReturnStmt *, unsigned, NodeRef C) {
+    field("value", C);
+  }
+  void enterBlockStmt(BlockStmt *) {
+    kind("Block");
+    Out << ",\"stmts\":[";
+  }
+  void beforeBlockStmt(BlockStmt *, unsigned i, NodeRef C) { element(i, C); }
+  void leaveBlockStmt(BlockStmt *) { Out << "]}"; }
+  void enterContinueStmt(ContinueStmt *) { kind("Continue"); }
+  void enterBreakStmt(BreakStmt *) { kind("Break"); }
+  void enterDeclStmt(DeclStmt *S) {
+    kind("Decl");
+    Out << ",\"const\":" << (S->isConst ? "true" : "false") << ",\"type\":\""
+        << TypeName(S->basetype_) << '"';
+    name("name", S->VarName);
+    Out << ",\"dims\":[";
+  }
+  void beforeDeclStmt(DeclStmt *S, unsigned i, NodeRef C) {
+    if (i < S->Dims.size()) {
+      element(i, C);
+      return;
+    }
+    Out << ']';
+    field("init", C);
+  }
+  void leaveStmt(Stmt *) { Out << '}'; }
+
+  void enterInitVals(InitVals *IV) {
+    if (IV->val == nullptr) {
+      kind("InitList");
+      Out << ",\"elements\":[";
+    }
+  }
+  void beforeInitVals(InitVals *IV, unsigned i, NodeRef C) {
+    if (IV->val == nullptr)
+      element(i, C);
+  }
+  void leaveInitVals(InitVals *IV) {
+    if (IV->val == nullptr)
+      Out << "]}";
+  }
+
+  void enterParam(Param *P) {
+    kind("Param");
+    Out << ",\"type\":\"" << TypeName(P->basetype_) << '"';
+    name("name", P->paraname_);
+    Out << ",\"dims\":[";
+  }
+  void beforeParam(Param *, unsigned i, NodeRef C) { element(i, C); }
+  void leaveParam(Param *) { Out << "]}"; }
+
+  void enterFunc(Func *F) {
+    kind("Func");
+    Out << ",\"type\":\"" << TypeName(F->return_type_) << '"';
+    name("name", F->function_name_);
+    Out << ",\"params\":[";
+  }
+  void beforeFunc(Func *F, unsigned i, NodeRef C) {
+    if (i < F->formal_paras_.size()) {
+      element(i, C);
+      return;
+    }
+    Out << ']';
+    field("body", C);
+  }
+  void leaveFunc(Func *) { Out << '}'; }
+};
+
+template <typename Printer> void EmitItems(Program &P, OutputSink &Out) {
+  Printer Print(Out);
+  for (auto &Item : P.instrs) {
+    if (auto *F = get_if<Func>(&Item)) {
+      Print.traverse(F);
+    } else {
+      Print.traverse(&get<DeclStmt>(Item));
+    }
+    Out << '\n';
+  }
+}
+
+} // namespace
+
+bool ParseASTFormat(std::string_view Name, ASTFormat &Format) {
+  if (Name == "text") {
+    Format = ASTFormat::Text;
+  } else if (Name == "sexpr") {
+    Format = ASTFormat::SExpr;
+  } else if (Name == "json") {
+    Format = ASTFormat::JSON;
+  } else if (Name == "bin") {
+    Format = ASTFormat::Binary;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void EmitAST(Program &P, ASTFormat Format, OutputSink &Out,
+             const SourceFile *Source) {
+  switch (Format) {
+  case ASTFormat::Text: {
+    TreePrinter Printer(Out);
+    Printer.accept(P);
+    break;
+  }
+  case ASTFormat::SExpr:
+    EmitItems<SExprPrinter>(P, Out);
+    break;
+  case ASTFormat::JSON: {
+    JSONPrinter Printer(Out);
+    Out << '[';
+    for (size_t i = 0; i < P.instrs.size(); ++i) {
+      Out << (i == 0 ? "\n" : ",\n");
+      if (auto *F = get_if<Func>(&P.instrs[i])) {
+        Printer.traverse(F);
+      } else {
+        Printer.traverse(&get<DeclStmt>(P.instrs[i]));
+      }
+    }
+    Out << "\n]\n";
+    break;
+  }
+  case ASTFormat::Binary:
+    WriteBinaryAST(Flatten(P), Source, Out);
+    break;
+  }
+  Out.flush();
+}
+
+} // namespace ast
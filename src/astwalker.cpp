@@ -0,0 +1,167 @@
+#include "ast.hpp"
+#include "casting.hpp"
+#include "common.hpp"
+
+namespace ast {
+
+void children(NodeRef N, vector<NodeRef> &Out) {
+  switch (N.Cls) {
+  case NodeRef::Class::None:
+    return;
+  case NodeRef::Class::Expr: {
+    Expr *E = N.expr();
+    switch (E->Kind) {
+    case ExprKind::Integer:
+    case ExprKind::Float:
+    case ExprKind::Variable:
+      return;
+    case ExprKind::Negate:
+      Out.push_back(cast<NegateExpr>(E)->operand);
+      return;
+    case ExprKind::Not:
+      Out.push_back(cast<NotExpr>(E)->operand);
+      return;
+    case ExprKind::Binop: {
+      auto *BE = cast<BinopExpr>(E);
+      Out.push_back(BE->lhs);
+      Out.push_back(BE->rhs);
+      return;
+    }
+    case ExprKind::Cmp: {
+      auto *CE = cast<CmpExpr>(E);
+      Out.push_back(CE->lhs);
+      Out.push_back(CE->rhs);
+      return;
+    }
+    case ExprKind::Logical: {
+      auto *LE = cast<LogicalExpr>(E);
+      Out.push_back(LE->lhs);
+      Out.push_back(LE->rhs);
+      return;
+    }
+    case ExprKind::Index: {
+      auto *IE = cast<IndexExpr>(E);
+      if (IE->BaseArray)
+        Out.push_back(IE->BaseArray);
+      else
+        Out.push_back(IE->SubArray);
+      Out.push_back(IE->Index);
+      return;
+    }
+    case ExprKind::Assign: {
+      auto *AE = cast<AssignExpr>(E);
+      if (AE->Target)
+        Out.push_back(AE->Target);
+      else
+        Out.push_back(AE->ArrayTarget);
+      Out.push_back(AE->Assignment);
+      return;
+    }
+    case ExprKind::FunctionCall:
+      for (Expr *Arg : cast<FunctionCallExpr>(E)->RealParameters)
+        Out.push_back(Arg);
+      return;
+    }
+    break;
+  }
+  case NodeRef::Class::Stmt: {
+    Stmt *S = N.stmt();
+    switch (S->Kind) {
+    case StmtKind::Continue:
+    case StmtKind::Break:
+      return;
+    case StmtKind::Expr:
+      Out.push_back(cast<ExprStmt>(S)->E);
+      return;
+    case StmtKind::Return:
+      Out.push_back(cast<ReturnStmt>(S)->ReturnExpr);
+      return;
+    case StmtKind::While: {
+      auto *WS = cast<WhileStmt>(S);
+      Out.push_back(WS->LoopCond);
+      Out.push_back(WS->LoopBody);
+      return;
+    }
+    case StmtKind::If: {
+      auto *IS = cast<IfStmt>(S);
+      Out.push_back(IS->cond);
+      Out.push_back(IS->IfBranch);
+      Out.push_back(IS->ElseBranch);
+      return;
+    }
+    case StmtKind::Block:
+      for (Stmt *Child : cast<BlockStmt>(S)->Stmts)
+        Out.push_back(Child);
+      return;
+    case StmtKind::Decl: {
+      auto *DS = cast<DeclStmt>(S);
+      for (Expr *Dim : DS->Dims)
+        Out.push_back(Dim);
+      Out.push_back(DS->initvals_);
+      return;
+    }
+    }
+    break;
+  }
+  case NodeRef::Class::InitVals: {
+    InitVals *IV = N.initVals();
+    if (IV->val) {
+      Out.push_back(IV->val);
+      return;
+    }
+    for (InitVals &Elem : IV->vals)
+      Out.push_back(&Elem);
+    return;
+  }
+  case NodeRef::Class::Param:
+    for (Expr *Dim : N.param()->dims_)
+      Out.push_back(Dim);
+    return;
+  case NodeRef::Class::Func: {
+    Func *F = N.func();
+    for (Param &P : F->formal_paras_)
+      Out.push_back(&P);
+    Out.push_back(F->body_);
+    return;
+  }
+  }
+  unreachable("Unknown node.");
+}
+
+void ASTWalker::walk(NodeRef Root) {
+  if (Root.isNull()) {
+    return;
+  }
+  // The hooks may start walks of their own, so no reference into Stack or
+  // Children is held across a call.
+  size_t Base = Stack.size();
+  enter(Root);
+  Stack.push_back({Root, uint32_t(Children.size()), 0});
+  children(Root, Children);
+  while (Stack.size() > Base) {
+    Frame F = Stack.back();
+    if (F.First + F.Next == Children.size()) {
+      Stack.pop_back();
+      Children.resize(F.First);
+      leave(F.Node);
+      if (Stack.size() > Base) {
+        Frame &Parent = Stack.back();
+        unsigned i = Parent.Next++;
+        after(Parent.Node, i, F.Node);
+      }
+      continue;
+    }
+    NodeRef Child = Children[F.First + F.Next];
+    before(F.Node, F.Next, Child);
+    if (Child.isNull()) {
+      Stack.back().Next++;
+      after(F.Node, F.Next, Child);
+      continue;
+    }
+    enter(Child);
+    Stack.push_back({Child, uint32_t(Children.size()), 0});
+    children(Child, Children);
+  }
+}
+
+} // namespace ast
@@ -0,0 +1,116 @@
+#include "backend.hpp"
+#include <format>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <string>
+#if LLVM_VERSION_MAJOR >= 17
+#include <llvm/TargetParser/Host.h>
+#else
+#include <llvm/Support/Host.h>
+#endif
+
+// Where LinkExecutable finds the runtime; xmake points it at the source
+// tree.
+#ifndef MINIC_RUNTIME
+#define MINIC_RUNTIME "runtime/sylib.c"
+#endif
+
+using namespace std;
+
+unique_ptr<llvm::TargetMachine> HostTargetMachine(unsigned Level) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  string Triple = llvm::sys::getDefaultTargetTriple(), Error;
+  const llvm::Target *T = llvm::TargetRegistry::lookupTarget(Triple, Error);
+  if (T == nullptr) {
+    throw format("Cannot generate code for '{}': {}", Triple, Error);
+  }
+#if LLVM_VERSION_MAJOR >= 18
+  using CodeGenLevel = llvm::CodeGenOptLevel;
+#else
+  using CodeGenLevel = llvm::CodeGenOpt::Level;
+#endif
+  static constexpr CodeGenLevel Levels[] = {
+      CodeGenLevel::None, CodeGenLevel::Less, CodeGenLevel::Default,
+      CodeGenLevel::Aggressive};
+  llvm::TargetOptions Options;
+  return unique_ptr<llvm::TargetMachine>(T->createTargetMachine(
+      Triple, llvm::sys::getHostCPUName(), "", Options, llvm::Reloc::PIC_, {},
+      Levels[min(Level, 3u)]));
+}
+
+void OptimizeModule(llvm::Module &M, llvm::TargetMachine &TM, unsigned Level) {
+  M.setTargetTriple(TM.getTargetTriple().str());
+  M.setDataLayout(TM.createDataLayout());
+
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassBuilder PB(&TM);
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  static const llvm::OptimizationLevel Levels[] = {
+      llvm::OptimizationLevel::O0, llvm::OptimizationLevel::O1,
+      llvm::OptimizationLevel::O2, llvm::OptimizationLevel::O3};
+  const llvm::OptimizationLevel &O = Levels[min(Level, 3u)];
+  llvm::ModulePassManager MPM = Level == 0
+                                    ? PB.buildO0DefaultPipeline(O)
+                                    : PB.buildPerModuleDefaultPipeline(O);
+  MPM.run(M, MAM);
+}
+
+void WriteObjectFile(llvm::Module &M, llvm::TargetMachine &TM,
+                     const char *Path) {
+  error_code EC;
+  llvm::raw_fd_ostream Out(Path, EC, llvm::sys::fs::OF_None);
+  if (EC) {
+    throw format("Cannot write '{}': {}", Path, EC.message());
+  }
+#if LLVM_VERSION_MAJOR >= 18
+  auto FileType = llvm::CodeGenFileType::ObjectFile;
+#else
+  auto FileType = llvm::CGFT_ObjectFile;
+#endif
+  llvm::legacy::PassManager PM;
+  if (TM.addPassesToEmitFile(PM, Out, nullptr, FileType)) {
+    Out.close();
+    llvm::sys::fs::remove(Path);
+    throw string("The target cannot emit object files.");
+  }
+  PM.run(M);
+  Out.close();
+  if (Out.has_error()) {
+    string Message = Out.error().message();
+    Out.clear_error();
+    llvm::sys::fs::remove(Path);
+    throw format("Cannot write '{}': {}", Path, Message);
+  }
+}
+
+void LinkExecutable(const char *Object, const char *Output) {
+  auto CC = llvm::sys::findProgramByName("cc");
+  if (!CC) {
+    throw string("Cannot find 'cc' to link with.");
+  }
+  llvm::StringRef Args[] = {*CC, "-o", Output, Object, MINIC_RUNTIME};
+  string Error;
+  int Status = llvm::sys::ExecuteAndWait(*CC, Args, {}, {}, 0, 0, &Error);
+  if (Status != 0) {
+    throw format("Linking '{}' failed.{}{}", Output, Error.empty() ? "" : " ",
+                 Error);
+  }
+}
@@ -0,0 +1,361 @@
+#include "binast.hpp"
+#include "symbol.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace ast {
+
+static uint64_t AlignTo8(uint64_t Offset) { return (Offset + 7) & ~7ull; }
+
+// Whether A holds a Symbol id.
+static bool HasSymbol(FlatKind Kind) {
+  switch (Kind) {
+  case FlatKind::Variable:
+  case FlatKind::Call:
+  case FlatKind::Decl:
+  case FlatKind::Param:
+  case FlatKind::Func:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void WriteBinaryAST(FlatASTRef F, const SourceFile *Source, OutputSink &Out) {
+  // Number the names the tree uses in the order it first uses them.
+  uint32_t NumIds = F.StringData == nullptr ? Interner::global().size()
+                                            : F.StringOffsets.size() - 1;
+  vector<uint32_t> LocalId(NumIds, FlatAST::None);
+  vector<uint32_t> StringOffsets{0};
+  string StringData;
+  auto AddString = [&](string_view Name) {
+    StringData += Name;
+    StringOffsets.push_back(StringData.size());
+    return StringOffsets.size() - 2;
+  };
+  for (uint32_t N = 0; N < F.size(); ++N) {
+    if (HasSymbol(F.Kinds[N]) && LocalId[F.A[N]] == FlatAST::None) {
+      LocalId[F.A[N]] = AddString(F.name(F.A[N]));
+    }
+  }
+
+  BinaryASTHeader H = {};
+  memcpy(H.Magic, BinaryASTHeader::MagicBytes, sizeof(H.Magic));
+  H.Version = BinaryASTHeader::CurrentVersion;
+  H.ByteOrder = BinaryASTHeader::ByteOrderMark;
+  H.NumNodes = F.size();
+  H.NumExtra = F.Extra.size();
+  H.NumRoots = F.Roots.size();
+  H.SourceName = AddString(Source != nullptr ? Source->Name : "");
+  H.SourceSize = Source != nullptr ? Source->text().size() : 0;
+  H.NumStrings = StringOffsets.size() - 1;
+
+  uint64_t At = sizeof(H);
+  auto Place = [&](uint64_t &Offset, uint64_t Bytes) {
+    Offset = AlignTo8(At);
+    At = Offset + Bytes;
+  };
+  Place(H.Kinds, H.NumNodes);
+  Place(H.Ops, H.NumNodes);
+  Place(H.A, H.NumNodes * 4ull);
+  Place(H.B, H.NumNodes * 4ull);
+  Place(H.Locs, H.NumNodes * 4ull);
+  Place(H.Extra, H.NumExtra * 4ull);
+  Place(H.Roots, H.NumRoots * 4ull);
+  Place(H.StringOffsets, StringOffsets.size() * 4ull);
+  Place(H.StringData, StringData.size());
+  H.FileSize = At;
+
+  // The sections go out in file order, each after the padding before it.
+  uint64_t Written = 0;
+  auto Skip = [&](uint64_t Offset) {
+    Out.fill('\0', Offset - Written);
+    Written = Offset;
+  };
+  auto Write = [&](uint64_t Offset, const void *Data, uint64_t Bytes) {
+    Skip(Offset);
+    Out.write(static_cast<const char *>(Data), Bytes);
+    Written += Bytes;
+  };
+  auto WriteWord = [&](uint32_t V) {
+    Out.write(reinterpret_cast<const char *>(&V), 4);
+    Written += 4;
+  };
+  Write(0, &H, sizeof(H));
+  Write(H.Kinds, F.Kinds.Data, H.NumNodes);
+  Write(H.Ops, F.Ops.Data, H.NumNodes);
+  Skip(H.A);
+  for (uint32_t N = 0; N < F.size(); ++N) {
+    WriteWord(HasSymbol(F.Kinds[N]) ? LocalId[F.A[N]] : F.A[N]);
+  }
+  Write(H.B, F.B.Data, H.NumNodes * 4ull);
+  Skip(H.Locs);
+  for (uint32_t N = 0; N < F.size(); ++N) {
+    SourceLoc Loc = F.loc(N);
+    bool Known = Source != nullptr && Loc.isValid() && Source->contains(Loc);
+    WriteWord(Known ? Source->getOffset(Loc) + 1 : 0);
+  }
+  Write(H.Extra, F.Extra.Data, H.NumExtra * 4ull);
+  Write(H.Roots, F.Roots.Data, H.NumRoots * 4ull);
+  Write(H.StringOffsets, StringOffsets.data(), StringOffsets.size() * 4ull);
+  Write(H.StringData, StringData.data(), StringData.size());
+}
+
+namespace {
+// What a child slot may hold.
+enum class Slot { Expr, LValue, Stmt, Block, Init, Param };
+
+bool IsExpr(FlatKind Kind) { return Kind <= FlatKind::Call; }
+
+bool IsStmt(FlatKind Kind) {
+  return Kind >= FlatKind::ExprStmt && Kind <= FlatKind::Decl;
+}
+
+bool Fits(FlatKind Kind, Slot S) {
+  switch (S) {
+  case Slot::Expr:
+    return IsExpr(Kind);
+  case Slot::LValue:
+    return Kind == FlatKind::Variable || Kind == FlatKind::Index;
+  case Slot::Stmt:
+    return IsStmt(Kind);
+  case Slot::Block:
+    return Kind == FlatKind::Block;
+  case Slot::Init:
+    return IsExpr(Kind) || Kind == FlatKind::InitList;
+  case Slot::Param:
+    return Kind == FlatKind::Param;
+  }
+  return false;
+}
+
+// The slot `i` of a `Kind` node, and whether it may be empty.
+Slot SlotOf(FlatKind Kind, unsigned i, unsigned Count, bool &Optional) {
+  Optional = false;
+  switch (Kind) {
+  case FlatKind::Index:
+  case FlatKind::Assign:
+    return i == 0 ? Slot::LValue : Slot::Expr;
+  case FlatKind::If:
+    Optional = i == 2;
+    return i == 0 ? Slot::Expr : Slot::Stmt;
+  case FlatKind::While:
+    return i == 0 ? Slot::Expr : Slot::Stmt;
+  case FlatKind::Return:
+    Optional = true;
+    return Slot::Expr;
+  case FlatKind::Block:
+    return Slot::Stmt;
+  case FlatKind::Decl:
+    Optional = i + 1 == Count;
+    return i + 1 == Count ? Slot::Init : Slot::Expr;
+  case FlatKind::InitList:
+    return Slot::Init;
+  case FlatKind::Param:
+    Optional = i == 0;
+    return Slot::Expr;
+  case FlatKind::Func:
+    Optional = i + 1 == Count;
+    return i + 1 == Count ? Slot::Block : Slot::Param;
+  default:
+    return Slot::Expr;
+  }
+}
+
+// The number of distinct values of Op for each kind.
+unsigned NumOps(FlatKind Kind) {
+  switch (Kind) {
+  case FlatKind::Binop:
+    return 5;
+  case FlatKind::Cmp:
+    return 6;
+  case FlatKind::Logical:
+    return 2;
+  case FlatKind::Decl:
+    return 4;
+  case FlatKind::Param:
+    return 2;
+  case FlatKind::Func:
+    return 3;
+  default:
+    return 1;
+  }
+}
+
+// Checks that every node of `F` is well-formed, so that walking it cannot
+// go out of bounds: children come before their parents and fit their slots,
+// lists lie within Extra, and symbol ids within the string table. Returns
+// what is wrong, or nullptr.
+const char *Verify(const FlatASTRef &F, uint32_t NumStrings) {
+  uint64_t NumExtra = F.Extra.size();
+  for (uint32_t N = 0; N < F.size(); ++N) {
+    FlatKind Kind = F.Kinds[N];
+    if (Kind > FlatKind::Func) {
+      return "unknown node kind";
+    }
+    if (F.Ops[N] >= NumOps(Kind)) {
+      return "unknown operator";
+    }
+    if (HasSymbol(Kind) && F.A[N] >= NumStrings) {
+      return "symbol out of range";
+    }
+    uint64_t B = F.B[N];
+    switch (Kind) {
+    case FlatKind::If:
+      if (B + 2 > NumExtra) {
+        return "branches out of range";
+      }
+      break;
+    case FlatKind::Call:
+    case FlatKind::Block:
+    case FlatKind::InitList:
+    case FlatKind::Param:
+    case FlatKind::Decl:
+    case FlatKind::Func: {
+      bool Trailing = Kind == FlatKind::Decl || Kind == FlatKind::Func;
+      if (B >= NumExtra || B + 1 + F.Extra[B] + Trailing > NumExtra) {
+        return "list out of range";
+      }
+      break;
+    }
+    default:
+      break;
+    }
+    unsigned Count = F.numChildren(N);
+    for (unsigned i = 0; i < Count; ++i) {
+      bool Optional;
+      Slot S = SlotOf(Kind, i, Count, Optional);
+      uint32_t Child = F.child(N, i);
+      if (Child == FlatAST::None) {
+        if (!Optional) {
+          return "missing operand";
+        }
+      } else if (Child >= N) {
+        return "child after its parent";
+      } else if (!Fits(F.Kinds[Child], S)) {
+        return "operand of the wrong kind";
+      }
+    }
+  }
+  for (uint32_t Root : F.Roots) {
+    if (Root >= F.size() ||
+        (F.Kinds[Root] != FlatKind::Func && F.Kinds[Root] != FlatKind::Decl)) {
+      return "bad top-level item";
+    }
+  }
+  return nullptr;
+}
+} // namespace
+
+BinaryAST::BinaryAST(const char *Path) {
+  int fd = open(Path, O_RDONLY);
+  if (fd < 0) {
+    throw format("Cannot open '{}': {}.", Path, strerror(errno));
+  }
+  struct stat St;
+  if (fstat(fd, &St) != 0 || !S_ISREG(St.st_mode) ||
+      size_t(St.st_size) < sizeof(BinaryASTHeader)) {
+    close(fd);
+    throw format("'{}' is not a binary AST.", Path);
+  }
+  Size = St.st_size;
+  Mapping = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+  int Error = errno;
+  close(fd);
+  if (Mapping == MAP_FAILED) {
+    Mapping = nullptr;
+    throw format("Cannot read '{}': {}.", Path, strerror(Error));
+  }
+
+  auto Fail = [&](const char *Why) {
+    munmap(Mapping, Size);
+    Mapping = nullptr;
+    return format("'{}' is not a valid binary AST: {}.", Path, Why);
+  };
+  const char *Base = static_cast<const char *>(Mapping);
+  Header = reinterpret_cast<const BinaryASTHeader *>(Base);
+  const BinaryASTHeader &H = *Header;
+  if (memcmp(H.Magic, BinaryASTHeader::MagicBytes, sizeof(H.Magic)) != 0) {
+    throw Fail("bad magic");
+  }
+  if (H.ByteOrder != BinaryASTHeader::ByteOrderMark) {
+    throw Fail("written with another byte order");
+  }
+  if (H.Version != BinaryASTHeader::CurrentVersion) {
+    throw Fail(format("version {}, expected {}", H.Version,
+                      BinaryASTHeader::CurrentVersion)
+                   .c_str());
+  }
+  if (H.FileSize != Size || H.NumNodes == FlatAST::None) {
+    throw Fail("truncated");
+  }
+  // Each section must be aligned and lie within the file.
+  auto Section = [&](uint64_t Offset, uint64_t Bytes) -> const void * {
+    if (Offset % 8 != 0 || Offset < sizeof(H) || Offset > Size ||
+        Bytes > Size - Offset) {
+      throw Fail("section out of range");
+    }
+    return Base + Offset;
+  };
+  auto Words = [&](uint64_t Offset, uint32_t N) {
+    return Span<const uint32_t>(
+        static_cast<const uint32_t *>(Section(Offset, N * 4ull)), N);
+  };
+  AST.Kinds = Span<const FlatKind>(
+      static_cast<const FlatKind *>(Section(H.Kinds, H.NumNodes)),
+      H.NumNodes);
+  AST.Ops = Span<const uint8_t>(
+      static_cast<const uint8_t *>(Section(H.Ops, H.NumNodes)), H.NumNodes);
+  AST.A = Words(H.A, H.NumNodes);
+  AST.B = Words(H.B, H.NumNodes);
+  AST.Extra = Words(H.Extra, H.NumExtra);
+  AST.Roots = Words(H.Roots, H.NumRoots);
+  static_assert(sizeof(SourceLoc) == 4);
+  Span<const uint32_t> LocWords = Words(H.Locs, H.NumNodes);
+  Locs = Span<const SourceLoc>(
+      reinterpret_cast<const SourceLoc *>(LocWords.Data), H.NumNodes);
+
+  if (H.NumStrings == FlatAST::None) {
+    throw Fail("string table out of range");
+  }
+  AST.StringOffsets = Words(H.StringOffsets, H.NumStrings + 1);
+  uint64_t DataSize = AST.StringOffsets[H.NumStrings];
+  AST.StringData = static_cast<const char *>(Section(H.StringData, DataSize));
+  for (uint32_t i = 0; i < H.NumStrings; ++i) {
+    if (AST.StringOffsets[i] > AST.StringOffsets[i + 1]) {
+      throw Fail("string table out of order");
+    }
+  }
+  if (H.SourceName >= H.NumStrings) {
+    throw Fail("string table out of range");
+  }
+  if (const char *Why = Verify(AST, H.NumStrings)) {
+    throw Fail(Why);
+  }
+}
+
+BinaryAST::~BinaryAST() {
+  if (Mapping != nullptr) {
+    munmap(Mapping, Size);
+  }
+}
+
+bool BinaryAST::attachSource(const SourceFile &Source) {
+  if (Source.text().size() != Header->SourceSize) {
+    return false;
+  }
+  AST.Locs = Locs;
+  // A stored location is its offset plus one.
+  AST.LocBase = Source.getLoc(0).Raw - 1;
+  return true;
+}
+
+} // namespace ast
@@ -0,0 +1,760 @@
+#include "codegen.hpp"
+#include <algorithm>
+#include <format>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+#include <unordered_map>
+
+using namespace std;
+
+namespace hir {
+
+namespace {
+// What every caller passes for an array parameter, which decides the
+// attributes it may have. Both start optimistic and only get weaker until
+// no call site changes them, so recursion keeps what the outside callers
+// allow.
+struct ParamFacts {
+  // Callers pass memory that nothing else reaches during the call: an
+  // array local to the caller, or a parameter of the caller that is
+  // itself noalias, and not twice in one call.
+  bool NoAlias = true;
+  // The bytes known to be valid from the pointer on, as the least over
+  // the call sites; ~0 while there is none.
+  uint64_t Bytes = ~uint64_t(0);
+};
+
+struct ParamAnalysis {
+  unordered_map<const Var *, ParamFacts> Facts;
+  vector<const Call *> Calls; // those with array arguments
+
+  explicit ParamAnalysis(const hir::Module &M) {
+    for (const Function *F : M.Functions) {
+      if (F->Body != nullptr) {
+        collect(F->Body);
+      }
+    }
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (const Call *C : Calls) {
+        Changed |= update(C);
+      }
+    }
+  }
+
+  // Finds the calls with array arguments, without recursion.
+  void collect(const Stmt *Body) {
+    vector<const Stmt *> Stmts{Body};
+    vector<const Expr *> Exprs;
+    while (!Stmts.empty()) {
+      const Stmt *S = Stmts.back();
+      Stmts.pop_back();
+      switch (S->Kind) {
+      case StmtKind::Expr:
+        Exprs.push_back(cast<ExprStmt>(S)->E);
+        break;
+      case StmtKind::Init:
+        for (auto &E : cast<InitStmt>(S)->V->Init->Exprs) {
+          Exprs.push_back(E.Value);
+        }
+        break;
+      case StmtKind::If: {
+        auto *I = cast<If>(S);
+        Exprs.push_back(I->Cond);
+        Stmts.push_back(I->Then);
+        if (I->Else != nullptr) {
+          Stmts.push_back(I->Else);
+        }
+        break;
+      }
+      case StmtKind::While:
+        Exprs.push_back(cast<While>(S)->Cond);
+        Stmts.push_back(cast<While>(S)->Body);
+        break;
+      case StmtKind::Return:
+        if (Expr *Value = cast<Return>(S)->Value) {
+          Exprs.push_back(Value);
+        }
+        break;
+      case StmtKind::Block:
+        for (const Stmt *Child : cast<Block>(S)->Stmts) {
+          Stmts.push_back(Child);
+        }
+        break;
+      case StmtKind::Break:
+      case StmtKind::Continue:
+        break;
+      }
+      while (!Exprs.empty()) {
+        const Expr *E = Exprs.back();
+        Exprs.pop_back();
+        auto *C = dyn_cast<Call>(E);
+        if (C != nullptr && C->Callee->Body != nullptr &&
+            any_of(C->Args.begin(), C->Args.end(),
+                   [](const Expr *A) { return A->Ty->isPointer(); })) {
+          Calls.push_back(C);
+        }
+        for (unsigned i = 0; i < E->numOperands(); ++i) {
+          Exprs.push_back(E->operand(i));
+        }
+      }
+    }
+  }
+
+  // The variable whose memory the array argument `A` points into.
+  static const Var *root(const Expr *A) {
+    while (!isa<VarRef>(A)) {
+      auto *I = dyn_cast<Index>(A);
+      A = I ? I->Base : cast<UnaryExpr>(A)->Operand;
+    }
+    return cast<VarRef>(A)->V;
+  }
+
+  // The bytes known to be valid from the address of the lvalue `E` on:
+  // all of an array variable, or what is left of it after constant
+  // subscripts within bounds.
+  uint64_t bytes(const Expr *E) {
+    if (auto *R = dyn_cast<VarRef>(E)) {
+      if (R->V->Ty->isPointer()) {
+        return Facts[R->V].Bytes;
+      }
+      return R->V->Ty->bytes();
+    }
+    auto *I = dyn_cast<Index>(E);
+    auto *Sub = I ? dyn_cast<IntConst>(I->Idx) : nullptr;
+    if (Sub == nullptr || Sub->Value < 0) {
+      return 0;
+    }
+    uint64_t Size = E->Ty->bytes(), Offset = uint64_t(Sub->Value) * Size;
+    uint64_t Base = bytes(I->Base);
+    return Offset + Size <= Base ? Base - Offset : 0;
+  }
+
+  // Weakens the facts of the callee's parameters by what `C` passes.
+  bool update(const Call *C) {
+    bool Changed = false;
+    for (size_t i = 0; i < C->Args.size(); ++i) {
+      const Expr *A = C->Args[i];
+      if (!A->Ty->isPointer()) {
+        continue;
+      }
+      ParamFacts &P = Facts[C->Callee->Params[i]];
+      const Var *R = root(A);
+      bool NoAlias =
+          R->S == Var::Storage::Local ||
+          (R->S == Var::Storage::Param && Facts[R].NoAlias);
+      for (size_t j = 0; NoAlias && j < C->Args.size(); ++j) {
+        NoAlias = j == i || !C->Args[j]->Ty->isPointer() ||
+                  root(C->Args[j]) != R;
+      }
+      // Decay gives the address of an array lvalue, Load the value of a
+      // parameter.
+      auto *U = cast<UnaryExpr>(A);
+      uint64_t Bytes = U->Kind == ExprKind::Decay ? bytes(U->Operand)
+                                                  : Facts[R].Bytes;
+      if (P.NoAlias && !NoAlias) {
+        P.NoAlias = false;
+        Changed = true;
+      }
+      if (Bytes < P.Bytes) {
+        P.Bytes = Bytes;
+        Changed = true;
+      }
+    }
+    return Changed;
+  }
+};
+
+struct Codegen {
+  const hir::Module &M;
+  llvm::LLVMContext &Ctx;
+  std::unique_ptr<llvm::Module> Out;
+  llvm::IRBuilder<> B;
+  llvm::Type *I32, *I64, *F32;
+
+  vector<llvm::GlobalVariable *> Globals; // by Var::Id
+  unordered_map<const Function *, llvm::Function *> Functions;
+
+  // The function being emitted.
+  llvm::Function *Fn = nullptr;
+  const Function *Current = nullptr;
+  vector<llvm::Value *> Locals; // the allocas, by Var::Id
+  struct Loop {
+    const While *W;
+    llvm::BasicBlock *Continue, *Break;
+  };
+  vector<Loop> Loops;
+
+  // Work stacks for expressions and statements, which are emitted without
+  // recursion since they nest as deep as the source does.
+  struct ExprItem {
+    const Expr *E;
+    unsigned Step;
+  };
+  vector<ExprItem> ExprWork;
+  vector<llvm::Value *> Values;
+  // The block a short-circuit branch left from and the block it joins.
+  vector<pair<llvm::BasicBlock *, llvm::BasicBlock *>> Joins;
+  struct StmtItem {
+    const Stmt *S;
+    unsigned Step;
+    llvm::BasicBlock *Next, *End;
+  };
+  vector<StmtItem> StmtWork;
+
+  Codegen(const hir::Module &M, llvm::LLVMContext &Ctx, string_view Name)
+      : M(M), Ctx(Ctx),
+        Out(std::make_unique<llvm::Module>(llvm::StringRef(Name), Ctx)),
+        B(Ctx), I32(B.getInt32Ty()), I64(B.getInt64Ty()),
+        F32(B.getFloatTy()) {}
+
+  llvm::Type *type(const Type *T) {
+    switch (T->K) {
+    case Type::Kind::Void:
+      return B.getVoidTy();
+    case Type::Kind::Int:
+      return I32;
+    case Type::Kind::Float:
+      return F32;
+    case Type::Kind::Array:
+      return llvm::ArrayType::get(type(T->Elem), T->Size);
+    case Type::Kind::Pointer:
+      return llvm::PointerType::getUnqual(type(T->Elem));
+    }
+    return nullptr;
+  }
+
+  // Element `i` of the run `R` of `Init`, as the scalar type `Elem`.
+  llvm::Constant *element(const Initializer &Init,
+                          const ast::ArrayInit::Run &R, uint64_t i,
+                          const Type *Elem) {
+    if (Elem->isFloat()) {
+      return llvm::ConstantFP::get(F32, Init.Floats[R.Offset + i]);
+    }
+    return B.getInt32(Init.Ints[R.Offset + i]);
+  }
+
+  // The constant for the elements of `Init` from `First` on that make up
+  // a `T`. Parts without runs are zeroinitializer, so a large sparse array
+  // costs about as much as its runs.
+  llvm::Constant *constant(const Type *T, const Initializer &Init,
+                           uint64_t First) {
+    uint64_t N = T->bytes() / 4;
+    auto *Begin = partition_point(Init.Runs.begin(), Init.Runs.end(),
+                                  [&](const ast::ArrayInit::Run &R) {
+                                    return R.Start + R.Size <= First;
+                                  });
+    if (Begin == Init.Runs.end() || Begin->Start >= First + N) {
+      return llvm::Constant::getNullValue(type(T));
+    }
+    const Type *Elem = T->base();
+    if (T->isScalar()) {
+      return element(Init, *Begin, First - Begin->Start, Elem);
+    }
+    vector<llvm::Constant *> Elements;
+    if (T->Elem->isScalar()) {
+      llvm::Constant *Zero = llvm::Constant::getNullValue(type(Elem));
+      Elements.assign(N, Zero);
+      for (auto *R = Begin; R != Init.Runs.end() && R->Start < First + N;
+           ++R) {
+        uint64_t From = max(R->Start, First);
+        uint64_t To = min(R->Start + R->Size, First + N);
+        for (uint64_t i = From; i < To; ++i) {
+          Elements[i - First] = element(Init, *R, i - R->Start, Elem);
+        }
+      }
+    } else {
+      uint64_t Stride = T->Elem->bytes() / 4;
+      for (uint32_t i = 0; i < T->Size; ++i) {
+        Elements.push_back(constant(T->Elem, Init, First + i * Stride));
+      }
+    }
+    auto *ArrTy = llvm::cast<llvm::ArrayType>(type(T));
+    return llvm::ConstantArray::get(ArrTy, Elements);
+  }
+
+  void declare(const Function *F) {
+    vector<llvm::Type *> Params;
+    for (const Var *P : F->Params) {
+      Params.push_back(type(P->Ty));
+    }
+    auto *FnTy = llvm::FunctionType::get(type(F->RetTy), Params, false);
+    bool Internal = F->Body != nullptr && F->Name.str() != "main";
+    auto *Fn = llvm::Function::Create(
+        FnTy,
+        Internal ? llvm::GlobalValue::InternalLinkage
+                 : llvm::GlobalValue::ExternalLinkage,
+        F->Name.str(), *Out);
+    Functions[F] = Fn;
+  }
+
+  // The attributes of array parameters that every call site allows.
+  // Nothing in SysY can keep a pointer, so they are all nocapture.
+  void annotate(const ParamAnalysis &A) {
+    for (const Function *F : M.Functions) {
+      if (F->Body == nullptr) {
+        continue;
+      }
+      llvm::Function *Fn = Functions[F];
+      for (size_t i = 0; i < F->Params.size(); ++i) {
+        const Var *P = F->Params[i];
+        if (!P->Ty->isPointer()) {
+          continue;
+        }
+        Fn->addParamAttr(i, llvm::Attribute::NoCapture);
+        auto It = A.Facts.find(P);
+        if (It == A.Facts.end()) {
+          continue; // never called
+        }
+        if (It->second.NoAlias) {
+          Fn->addParamAttr(i, llvm::Attribute::NoAlias);
+        }
+        uint64_t Bytes = It->second.Bytes;
+        if (Bytes != 0 && Bytes != ~uint64_t(0)) {
+          Fn->addParamAttr(
+              i, llvm::Attribute::getWithDereferenceableBytes(Ctx, Bytes));
+        }
+      }
+    }
+  }
+
+  void global(const Var *G) {
+    llvm::Type *T = type(G->Ty);
+    llvm::Constant *Init = G->Init ? constant(G->Ty, *G->Init, 0)
+                                   : llvm::Constant::getNullValue(T);
+    auto *GV = new llvm::GlobalVariable(*Out, T, G->IsConst,
+                                        llvm::GlobalValue::InternalLinkage,
+                                        Init, G->Name.str());
+    GV->setAlignment(llvm::Align(4));
+    Globals.push_back(GV);
+  }
+
+  // Blocks are created detached and placed when code goes into them, so
+  // they come out in source order.
+  llvm::BasicBlock *block(const char *Name) {
+    return llvm::BasicBlock::Create(Ctx, Name);
+  }
+  void start(llvm::BasicBlock *BB) {
+    BB->insertInto(Fn);
+    B.SetInsertPoint(BB);
+  }
+  // Continues at `End`, or nowhere if no branch reaches it.
+  void join(llvm::BasicBlock *End) {
+    if (End->hasNPredecessorsOrMore(1)) {
+      start(End);
+    } else {
+      delete End;
+      B.ClearInsertionPoint();
+    }
+  }
+  void branch(llvm::BasicBlock *To) {
+    if (B.GetInsertBlock() != nullptr) {
+      B.CreateBr(To);
+    }
+  }
+
+  void function(const Function *F) {
+    Current = F;
+    Fn = Functions[F];
+    start(block("entry"));
+    Locals.assign(F->Params.size() + F->Locals.size(), nullptr);
+    // Every alloca up front in the entry block, where mem2reg and SROA
+    // look for them.
+    for (const Var *V : F->Params) {
+      Fn->getArg(V->Id)->setName(V->Name.str());
+      string Name = string(V->Name.str()) + ".addr";
+      Locals[V->Id] = B.CreateAlloca(type(V->Ty), nullptr, Name);
+    }
+    for (const Var *V : F->Locals) {
+      Locals[V->Id] = B.CreateAlloca(type(V->Ty), nullptr, V->Name.str());
+    }
+    for (const Var *V : F->Params) {
+      B.CreateStore(Fn->getArg(V->Id), Locals[V->Id]);
+    }
+    body(F->Body);
+    if (B.GetInsertBlock() != nullptr) {
+      // Falling off the end; main returns 0 as in C.
+      if (F->RetTy->isVoid()) {
+        B.CreateRetVoid();
+      } else {
+        B.CreateRet(llvm::Constant::getNullValue(type(F->RetTy)));
+      }
+    }
+  }
+
+  // Statements. Code after a return, break or continue is unreachable and
+  // there is no goto, so it is skipped rather than emitted.
+  void body(const Stmt *Body) {
+    StmtWork.push_back({Body, 0, nullptr, nullptr});
+    while (!StmtWork.empty()) {
+      StmtItem I = StmtWork.back();
+      StmtWork.pop_back();
+      if (I.Step == 0 && B.GetInsertBlock() == nullptr) {
+        continue;
+      }
+      switch (I.S->Kind) {
+      case StmtKind::Expr:
+        emit(cast<ExprStmt>(I.S)->E);
+        break;
+      case StmtKind::Init:
+        init(cast<InitStmt>(I.S)->V);
+        break;
+      case StmtKind::If:
+        ifStmt(cast<If>(I.S), I);
+        break;
+      case StmtKind::While:
+        whileStmt(cast<While>(I.S), I);
+        break;
+      case StmtKind::Break:
+      case StmtKind::Continue: {
+        const Loop &L = Loops.back();
+        B.CreateBr(I.S->Kind == StmtKind::Break ? L.Break : L.Continue);
+        B.ClearInsertionPoint();
+        break;
+      }
+      case StmtKind::Return:
+        if (Expr *Value = cast<Return>(I.S)->Value) {
+          B.CreateRet(emit(Value));
+        } else {
+          B.CreateRetVoid();
+        }
+        B.ClearInsertionPoint();
+        break;
+      case StmtKind::Block: {
+        Span<Stmt *> Stmts = cast<Block>(I.S)->Stmts;
+        for (size_t i = Stmts.size(); i-- > 0;) {
+          StmtWork.push_back({Stmts[i], 0, nullptr, nullptr});
+        }
+        break;
+      }
+      }
+    }
+  }
+
+  // Step 0 branches on the condition into the then block, step 1 follows
+  // the then branch and step 2 the else branch.
+  void ifStmt(const If *S, const StmtItem &I) {
+    switch (I.Step) {
+    case 0: {
+      llvm::BasicBlock *Then = block("if.then"), *End = block("if.end");
+      llvm::BasicBlock *Else = S->Else ? block("if.else") : End;
+      B.CreateCondBr(truth(emit(S->Cond)), Then, Else);
+      start(Then);
+      StmtWork.push_back({S, 1, Else, End});
+      StmtWork.push_back({S->Then, 0, nullptr, nullptr});
+      return;
+    }
+    case 1:
+      branch(I.End);
+      if (S->Else != nullptr) {
+        start(I.Next);
+        StmtWork.push_back({S, 2, nullptr, I.End});
+        StmtWork.push_back({S->Else, 0, nullptr, nullptr});
+        return;
+      }
+      join(I.End);
+      return;
+    default:
+      branch(I.End);
+      join(I.End);
+    }
+  }
+
+  void whileStmt(const While *S, const StmtItem &I) {
+    if (I.Step == 0) {
+      llvm::BasicBlock *Cond = block("while.cond"), *Body = block("while.body");
+      llvm::BasicBlock *End = block("while.end");
+      B.CreateBr(Cond);
+      start(Cond);
+      B.CreateCondBr(truth(emit(S->Cond)), Body, End);
+      start(Body);
+      Loops.push_back({S, Cond, End});
+      StmtWork.push_back({S, 1, Cond, End});
+      StmtWork.push_back({S->Body, 0, nullptr, nullptr});
+      return;
+    }
+    branch(I.Next);
+    Loops.pop_back();
+    join(I.End);
+  }
+
+  // The address of element `i` of the flattened variable at `Addr`.
+  llvm::Value *flat(const Var *V, llvm::Value *Addr, uint64_t i) {
+    if (V->Ty->isScalar()) {
+      return Addr;
+    }
+    llvm::Type *Elem = type(V->Ty->base());
+    Addr = B.CreateBitCast(Addr, llvm::PointerType::getUnqual(Elem));
+    return B.CreateInBoundsGEP(Elem, Addr, B.getInt64(i));
+  }
+
+  // Runs at least this long are copied from a constant instead of stored
+  // one by one.
+  static constexpr uint32_t CopyRun = 16;
+
+  void init(const Var *V) {
+    const Initializer &Init = *V->Init;
+    llvm::Value *Addr = Locals[V->Id];
+    const Type *Elem = V->Ty->base();
+    if (!V->Ty->isScalar()) {
+      B.CreateMemSet(Addr, B.getInt8(0), V->Ty->bytes(), llvm::MaybeAlign(4));
+    } else if (Init.Runs.empty() && Init.Exprs.empty()) {
+      B.CreateStore(llvm::Constant::getNullValue(type(Elem)), Addr);
+    }
+    for (const ast::ArrayInit::Run &R : Init.Runs) {
+      if (R.Size < CopyRun) {
+        for (uint32_t i = 0; i < R.Size; ++i) {
+          B.CreateStore(element(Init, R, i, Elem), flat(V, Addr, R.Start + i));
+        }
+        continue;
+      }
+      vector<llvm::Constant *> Elements;
+      for (uint32_t i = 0; i < R.Size; ++i) {
+        Elements.push_back(element(Init, R, i, Elem));
+      }
+      auto *T = llvm::ArrayType::get(type(Elem), R.Size);
+      string Name = string(V->Name.str()) + ".init";
+      auto *GV = new llvm::GlobalVariable(
+          *Out, T, true, llvm::GlobalValue::PrivateLinkage,
+          llvm::ConstantArray::get(T, Elements), Name);
+      GV->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+      GV->setAlignment(llvm::Align(4));
+      B.CreateMemCpy(flat(V, Addr, R.Start), llvm::MaybeAlign(4), GV,
+                     llvm::MaybeAlign(4), uint64_t(R.Size) * 4);
+    }
+    for (const Initializer::Element &E : Init.Exprs) {
+      llvm::Value *Value = emit(E.Value);
+      B.CreateStore(Value, flat(V, Locals[V->Id], E.Index));
+    }
+  }
+
+  // Expressions.
+
+  // `V`, an int or float, as an i1. A comparison just made for it is used
+  // as it is instead of being widened and compared again.
+  llvm::Value *truth(llvm::Value *V) {
+    if (auto *Z = llvm::dyn_cast<llvm::ZExtInst>(V)) {
+      if (Z->getSrcTy()->isIntegerTy(1) && Z->use_empty()) {
+        llvm::Value *Cmp = Z->getOperand(0);
+        Z->eraseFromParent();
+        return Cmp;
+      }
+    }
+    if (V->getType()->isFloatTy()) {
+      return B.CreateFCmpUNE(V, llvm::ConstantFP::get(F32, 0.0));
+    }
+    return B.CreateICmpNE(V, B.getInt32(0));
+  }
+
+  llvm::Value *storage(const Var *V) {
+    if (V->S == Var::Storage::Global) {
+      return Globals[V->Id];
+    }
+    return Locals[V->Id];
+  }
+
+  // The value of `Root`, or its address if it is an lvalue. Every
+  // expression with operands is visited twice: first to queue them, then
+  // with their values on `Values`.
+  llvm::Value *emit(const Expr *Root) {
+    ExprWork.push_back({Root, 0});
+    while (!ExprWork.empty()) {
+      ExprItem I = ExprWork.back();
+      ExprWork.pop_back();
+      const Expr *E = I.E;
+      switch (E->Kind) {
+      case ExprKind::IntConst:
+        Values.push_back(B.getInt32(cast<IntConst>(E)->Value));
+        continue;
+      case ExprKind::FloatConst:
+        Values.push_back(
+            llvm::ConstantFP::get(F32, cast<FloatConst>(E)->Value));
+        continue;
+      case ExprKind::VarRef:
+        Values.push_back(storage(cast<VarRef>(E)->V));
+        continue;
+      case ExprKind::Logical:
+        logical(cast<BinaryExpr>(E), I.Step);
+        continue;
+      default:
+        break;
+      }
+      unsigned N = E->numOperands();
+      if (I.Step == 0) {
+        ExprWork.push_back({E, 1});
+        for (unsigned i = N; i-- > 0;) {
+          ExprWork.push_back({E->operand(i), 0});
+        }
+        continue;
+      }
+      llvm::Value **Ops = Values.data() + Values.size() - N;
+      llvm::Value *V = apply(E, Ops);
+      Values.resize(Values.size() - N);
+      Values.push_back(V);
+    }
+    llvm::Value *V = Values.back();
+    Values.pop_back();
+    return V;
+  }
+
+  // `E` of its operands' values `Ops`.
+  llvm::Value *apply(const Expr *E, llvm::Value **Ops) {
+    switch (E->Kind) {
+    case ExprKind::Index: {
+      const Type *BaseTy = cast<Index>(E)->Base->Ty;
+      llvm::Value *Idx = B.CreateSExt(Ops[1], I64);
+      if (BaseTy->isPointer()) {
+        llvm::Value *Ptr = B.CreateLoad(type(BaseTy), Ops[0]);
+        return B.CreateInBoundsGEP(type(E->Ty), Ptr, Idx);
+      }
+      return B.CreateInBoundsGEP(type(BaseTy), Ops[0], {B.getInt64(0), Idx});
+    }
+    case ExprKind::Decay: {
+      const Type *ArrTy = cast<UnaryExpr>(E)->Operand->Ty;
+      return B.CreateInBoundsGEP(type(ArrTy), Ops[0],
+                                 {B.getInt64(0), B.getInt64(0)});
+    }
+    case ExprKind::Load:
+      return B.CreateLoad(type(E->Ty), Ops[0]);
+    case ExprKind::Convert:
+      return E->Ty->isFloat() ? B.CreateSIToFP(Ops[0], F32)
+                              : B.CreateFPToSI(Ops[0], I32);
+    case ExprKind::Unary:
+      return unary(cast<UnaryExpr>(E)->O, Ops[0]);
+    case ExprKind::Binary:
+      return binary(cast<BinaryExpr>(E)->O, Ops[0], Ops[1]);
+    case ExprKind::Assign:
+      B.CreateStore(Ops[1], Ops[0]);
+      return Ops[1];
+    case ExprKind::Call: {
+      auto *C = cast<Call>(E);
+      llvm::ArrayRef<llvm::Value *> Args(Ops, C->Args.size());
+      return B.CreateCall(Functions[C->Callee], Args);
+    }
+    default:
+      break;
+    }
+    return nullptr;
+  }
+
+  llvm::Value *unary(Op O, llvm::Value *X) {
+    bool Float = X->getType()->isFloatTy();
+    if (O == Op::Neg) {
+      return Float ? B.CreateFNeg(X) : B.CreateNSWNeg(X);
+    }
+    llvm::Value *Zero = Float ? llvm::ConstantFP::get(F32, 0.0)
+                              : llvm::cast<llvm::Constant>(B.getInt32(0));
+    llvm::Value *IsZero =
+        Float ? B.CreateFCmpOEQ(X, Zero) : B.CreateICmpEQ(X, Zero);
+    return B.CreateZExt(IsZero, I32);
+  }
+
+  llvm::Value *binary(Op O, llvm::Value *L, llvm::Value *R) {
+    using P = llvm::CmpInst::Predicate;
+    bool Float = L->getType()->isFloatTy();
+    P Pred;
+    switch (O) {
+    case Op::Add:
+      return Float ? B.CreateFAdd(L, R) : B.CreateNSWAdd(L, R);
+    case Op::Sub:
+      return Float ? B.CreateFSub(L, R) : B.CreateNSWSub(L, R);
+    case Op::Mul:
+      return Float ? B.CreateFMul(L, R) : B.CreateNSWMul(L, R);
+    case Op::Div:
+      return Float ? B.CreateFDiv(L, R) : B.CreateSDiv(L, R);
+    case Op::Mod:
+      return B.CreateSRem(L, R);
+    case Op::Lt:
+      Pred = Float ? P::FCMP_OLT : P::ICMP_SLT;
+      break;
+    case Op::Le:
+      Pred = Float ? P::FCMP_OLE : P::ICMP_SLE;
+      break;
+    case Op::Gt:
+      Pred = Float ? P::FCMP_OGT : P::ICMP_SGT;
+      break;
+    case Op::Ge:
+      Pred = Float ? P::FCMP_OGE : P::ICMP_SGE;
+      break;
+    case Op::Eq:
+      Pred = Float ? P::FCMP_OEQ : P::ICMP_EQ;
+      break;
+    case Op::Ne:
+      Pred = Float ? P::FCMP_UNE : P::ICMP_NE;
+      break;
+    default:
+      return nullptr;
+    }
+    return B.CreateZExt(B.CreateCmp(Pred, L, R), I32);
+  }
+
+  // && and ||: step 0 evaluates the lhs, step 1 branches on it and
+  // evaluates the rhs in a block of its own, step 2 joins the two.
+  void logical(const BinaryExpr *E, unsigned Step) {
+    bool And = E->O == Op::And;
+    if (Step == 0) {
+      ExprWork.push_back({E, 1});
+      ExprWork.push_back({E->LHS, 0});
+      return;
+    }
+    llvm::Value *Value = truth(Values.back());
+    Values.pop_back();
+    if (Step == 1) {
+      llvm::BasicBlock *RHS = block(And ? "and.rhs" : "or.rhs");
+      llvm::BasicBlock *End = block(And ? "and.end" : "or.end");
+      Joins.push_back({B.GetInsertBlock(), End});
+      if (And) {
+        B.CreateCondBr(Value, RHS, End);
+      } else {
+        B.CreateCondBr(Value, End, RHS);
+      }
+      start(RHS);
+      ExprWork.push_back({E, 2});
+      ExprWork.push_back({E->RHS, 0});
+      return;
+    }
+    auto [From, End] = Joins.back();
+    Joins.pop_back();
+    llvm::BasicBlock *RHSEnd = B.GetInsertBlock();
+    B.CreateBr(End);
+    start(End);
+    llvm::PHINode *Phi = B.CreatePHI(B.getInt1Ty(), 2);
+    Phi->addIncoming(B.getInt1(!And), From);
+    Phi->addIncoming(Value, RHSEnd);
+    Values.push_back(B.CreateZExt(Phi, I32));
+  }
+
+  std::unique_ptr<llvm::Module> run() {
+    for (const Function *F : M.Functions) {
+      declare(F);
+    }
+    annotate(ParamAnalysis(M));
+    for (const Var *G : M.Globals) {
+      global(G);
+    }
+    for (const Function *F : M.Functions) {
+      if (F->Body != nullptr) {
+        function(F);
+      }
+    }
+    string Error;
+    llvm::raw_string_ostream OS(Error);
+    if (llvm::verifyModule(*Out, &OS)) {
+      throw format("Invalid LLVM IR: {}", OS.str());
+    }
+    return std::move(Out);
+  }
+};
+} // namespace
+
+std::unique_ptr<llvm::Module> EmitLLVM(const Module &M, llvm::LLVMContext &Ctx,
+                                       string_view Name) {
+  Codegen G(M, Ctx, Name);
+  return G.run();
+}
+
+} // namespace hir
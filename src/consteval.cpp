@@ -0,0 +1,408 @@
+#include "consteval.hpp"
+#include "casting.hpp"
+#include "recursiveastvisitor.hpp"
+#include <climits>
+#include <format>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+// An operand on the folder's stack.
+struct Operand {
+  enum Kind : uint8_t { Number, Array, Unknown } K = Unknown;
+  ConstValue V;
+  // Array: a `const` array, indexed Dim times so far, which leaves the
+  // sub-array at element Offset.
+  const DeclStmt *Decl = nullptr;
+  uint32_t Dim = 0;
+  uint64_t Offset = 0;
+  // Unknown: set if it is an error, such as a division by zero, rather
+  // than something that is not constant.
+  const char *Error = nullptr;
+  SourceLoc Loc;
+
+  static Operand number(ConstValue V) {
+    Operand Op;
+    Op.K = Number;
+    Op.V = V;
+    return Op;
+  }
+  static Operand error(const char *Error, SourceLoc Loc) {
+    Operand Op;
+    Op.Error = Error;
+    Op.Loc = Loc;
+    return Op;
+  }
+};
+
+int32_t Wrap(int64_t V) { return int32_t(uint32_t(uint64_t(V))); }
+} // namespace
+
+struct ConstPass;
+
+// Folds one expression bottom-up on a stack of operands, on top of the
+// visitor so that deeply nested expressions are safe too.
+struct ConstFolder : RecursiveASTVisitor<ConstFolder> {
+  ConstPass &Pass;
+  vector<Operand> Stack;
+
+  ConstFolder(ConstPass &Pass) : Pass(Pass) {}
+
+  Operand pop() {
+    Operand Op = Stack.back();
+    Stack.pop_back();
+    return Op;
+  }
+  // The operand that makes an operation not constant: the first error, or
+  // the first operand that is not a number.
+  static Operand unknown(const Operand &L, const Operand &R) {
+    if (L.K == Operand::Unknown && L.Error != nullptr) {
+      return L;
+    }
+    return R.K == Operand::Unknown ? R : Operand();
+  }
+
+  void leaveIntegerExpr(IntegerExpr *E) {
+    Stack.push_back(Operand::number(ConstValue::ofInt(E->Value)));
+  }
+  void leaveFloatExpr(FloatExpr *E) {
+    Stack.push_back(Operand::number(ConstValue::ofFloat(E->Value)));
+  }
+  void leaveVariableExpr(VariableExpr *E);
+  void leaveNegateExpr(NegateExpr *) {
+    Operand Op = pop();
+    if (Op.K != Operand::Number) {
+      Stack.push_back(Op.K == Operand::Unknown ? Op : Operand());
+    } else if (Op.V.isFloat()) {
+      Stack.push_back(Operand::number(ConstValue::ofFloat(-Op.V.Float)));
+    } else {
+      int32_t V = Wrap(-int64_t(Op.V.Int));
+      Stack.push_back(Operand::number(ConstValue::ofInt(V)));
+    }
+  }
+  void leaveNotExpr(NotExpr *) {
+    Operand Op = pop();
+    if (Op.K != Operand::Number) {
+      Stack.push_back(Op.K == Operand::Unknown ? Op : Operand());
+    } else {
+      bool Zero = Op.V.isFloat() ? Op.V.Float == 0 : Op.V.Int == 0;
+      Stack.push_back(Operand::number(ConstValue::ofInt(Zero)));
+    }
+  }
+  void leaveBinopExpr(BinopExpr *E);
+  void leaveCmpExpr(CmpExpr *E);
+  void leaveLogicalExpr(LogicalExpr *E);
+  void leaveIndexExpr(IndexExpr *E);
+  void leaveAssignExpr(AssignExpr *) {
+    pop();
+    pop();
+    Stack.push_back(Operand());
+  }
+  void leaveFunctionCallExpr(FunctionCallExpr *E) {
+    Stack.resize(Stack.size() - E->RealParameters.size());
+    Stack.push_back(Operand());
+  }
+};
+
+// Walks the program in order, evaluating the dims and initializers as it
+// meets them, so every constant a name refers to is known by its use.
+struct ConstPass : RecursiveASTVisitor<ConstPass> {
+  ConstEvaluator &CE;
+  ConstFolder Folder;
+
+  bool InFunction = false;
+  const DeclStmt *Declaring = nullptr; // whose initializer is being laid out
+  uint64_t FrameBytes = 0, PeakFrameBytes = 0;
+  vector<uint64_t> BlockFrameBytes;
+  vector<uint32_t> Shape;
+
+  ConstPass(ConstEvaluator &CE) : CE(CE), Folder(*this) {}
+
+  [[noreturn]] void fail(SourceLoc Loc, string_view Message) {
+    throw format("{}: {}", CE.SM.describe(Loc), Message);
+  }
+
+  // Folds `E`, remembering the result.
+  optional<ConstValue> fold(Expr *E, Operand *Result = nullptr) {
+    if (optional<ConstValue> V = FoldLiteral(E)) {
+      return V;
+    }
+    Folder.Stack.clear();
+    Folder.traverse(E);
+    Operand Op = Folder.Stack.back();
+    if (Result != nullptr) {
+      *Result = Op;
+    }
+    optional<ConstValue> V;
+    if (Op.K == Operand::Number) {
+      V = Op.V;
+    }
+    CE.Values[E] = V;
+    return V;
+  }
+
+  // Folds `E` where a constant is required.
+  ConstValue require(Expr *E, const char *What) {
+    Operand Op;
+    if (optional<ConstValue> V = fold(E, &Op)) {
+      return *V;
+    }
+    if (Op.Error != nullptr) {
+      fail(Op.Loc.isValid() ? Op.Loc : E->Loc, Op.Error);
+    }
+    fail(E->Loc, format("{} is not a constant.", What));
+  }
+
+  Span<uint32_t> shape(Span<Expr *> Dims, Symbol Name) {
+    Shape.clear();
+    for (Expr *Dim : Dims) {
+      if (Dim == nullptr) {
+        Shape.push_back(0);
+        continue;
+      }
+      string What = format("The size of '{}'", Name.str());
+      ConstValue V = require(Dim, What.c_str());
+      if (V.isFloat()) {
+        fail(Dim->Loc, format("The size of '{}' is not an int.", Name.str()));
+      }
+      if (V.Int < 0) {
+        fail(Dim->Loc, format("The size of '{}' is negative.", Name.str()));
+      }
+      Shape.push_back(V.Int);
+    }
+    return CE.Storage.Copy(Shape);
+  }
+
+  void enterParam(Param *P) {
+    CE.Params[P] = shape(P->dims_, P->paraname_);
+  }
+
+  void enterFunc(Func *) {
+    InFunction = true;
+    FrameBytes = PeakFrameBytes = 0;
+  }
+  void leaveFunc(Func *F) {
+    InFunction = false;
+    CE.Frames[F] = PeakFrameBytes;
+  }
+
+  void enterBlockStmt(BlockStmt *) {
+    BlockFrameBytes.push_back(FrameBytes);
+  }
+  void leaveBlockStmt(BlockStmt *) {
+    FrameBytes = BlockFrameBytes.back();
+    BlockFrameBytes.pop_back();
+  }
+
+  void enterDeclStmt(DeclStmt *D) {
+    DeclLayout &L = CE.Decls[D];
+    L.Shape = shape(D->Dims, D->VarName);
+    bool Constant = D->isConst || !InFunction;
+    if (D->initvals_ != nullptr) {
+      Span<const uint32_t> S(L.Shape.Data, L.Shape.size());
+      Declaring = D;
+      try {
+        L.Init = LayoutInit(*D, S, CE.Storage,
+                            [&](Expr *E) { return fold(E); });
+      } catch (const string &Message) {
+        fail(D->Loc, Message);
+      }
+      Declaring = nullptr;
+      if (Constant && !L.Init->Exprs.empty()) {
+        require(L.Init->Exprs[0].Value,
+                format("The initializer of '{}'", D->VarName.str()).c_str());
+      }
+    } else {
+      L.Init = nullptr;
+    }
+    uint64_t Elements = 1;
+    for (uint32_t Dim : L.Shape) {
+      Elements *= Dim;
+    }
+    L.Bytes = Elements * 4;
+    if (InFunction) {
+      FrameBytes += L.Bytes;
+      PeakFrameBytes = max(PeakFrameBytes, FrameBytes);
+    } else {
+      CE.GlobalBytes += L.Bytes;
+    }
+  }
+};
+
+void ConstFolder::leaveVariableExpr(VariableExpr *E) {
+  const DeclStmt *D = nullptr;
+  if (E->Decl.Cls == NodeRef::Class::Stmt) {
+    D = cast<DeclStmt>(E->Decl.stmt());
+  }
+  if (D == nullptr || !D->isConst || D == Pass.Declaring) {
+    Stack.push_back(Operand());
+    return;
+  }
+  const DeclLayout &L = Pass.CE.Decls.at(D);
+  if (!L.Shape.empty()) {
+    Operand Op;
+    Op.K = Operand::Array;
+    Op.Decl = D;
+    Stack.push_back(Op);
+    return;
+  }
+  ConstValue V = ConstValue::ofInt(0);
+  if (L.Init != nullptr) {
+    V = D->basetype_ == BaseType::FLOAT
+            ? ConstValue::ofFloat(L.Init->floatAt(0))
+            : ConstValue::ofInt(L.Init->intAt(0));
+  } else if (D->basetype_ == BaseType::FLOAT) {
+    V = ConstValue::ofFloat(0);
+  }
+  Stack.push_back(Operand::number(V));
+}
+
+void ConstFolder::leaveBinopExpr(BinopExpr *E) {
+  Operand R = pop(), L = pop();
+  if (L.K != Operand::Number || R.K != Operand::Number) {
+    Stack.push_back(unknown(L, R));
+    return;
+  }
+  if (L.V.isFloat() || R.V.isFloat()) {
+    float A = L.V.asFloat(), B = R.V.asFloat(), V = 0;
+    switch (E->op) {
+    case BinOpKind::Add:
+      V = A + B;
+      break;
+    case BinOpKind::Sub:
+      V = A - B;
+      break;
+    case BinOpKind::Mul:
+      V = A * B;
+      break;
+    case BinOpKind::Div:
+      V = A / B;
+      break;
+    case BinOpKind::Mod:
+      Stack.push_back(Operand::error("'%' needs int operands.", E->Loc));
+      return;
+    }
+    Stack.push_back(Operand::number(ConstValue::ofFloat(V)));
+    return;
+  }
+  int64_t A = L.V.Int, B = R.V.Int, V = 0;
+  switch (E->op) {
+  case BinOpKind::Add:
+    V = A + B;
+    break;
+  case BinOpKind::Sub:
+    V = A - B;
+    break;
+  case BinOpKind::Mul:
+    V = A * B;
+    break;
+  case BinOpKind::Div:
+  case BinOpKind::Mod:
+    if (B == 0) {
+      Stack.push_back(Operand::error("Division by zero.", E->Loc));
+      return;
+    }
+    // INT_MIN / -1 overflows: it wraps to INT_MIN, and the remainder is 0.
+    V = E->op == BinOpKind::Div ? A / B : A % B;
+    break;
+  }
+  Stack.push_back(Operand::number(ConstValue::ofInt(Wrap(V))));
+}
+
+void ConstFolder::leaveCmpExpr(CmpExpr *E) {
+  Operand R = pop(), L = pop();
+  if (L.K != Operand::Number || R.K != Operand::Number) {
+    Stack.push_back(unknown(L, R));
+    return;
+  }
+  auto Compare = [&](auto A, auto B) {
+    switch (E->op) {
+    case CmpOpKind::GT:
+      return A > B;
+    case CmpOpKind::GE:
+      return A >= B;
+    case CmpOpKind::LT:
+      return A < B;
+    case CmpOpKind::LE:
+      return A <= B;
+    case CmpOpKind::EE:
+      return A == B;
+    case CmpOpKind::NE:
+      return A != B;
+    }
+    return false;
+  };
+  bool V = L.V.isFloat() || R.V.isFloat()
+               ? Compare(L.V.asFloat(), R.V.asFloat())
+               : Compare(L.V.Int, R.V.Int);
+  Stack.push_back(Operand::number(ConstValue::ofInt(V)));
+}
+
+void ConstFolder::leaveLogicalExpr(LogicalExpr *E) {
+  Operand R = pop(), L = pop();
+  auto Truth = [](const Operand &Op) {
+    return Op.V.isFloat() ? Op.V.Float != 0 : Op.V.Int != 0;
+  };
+  // The right operand does not matter once the left one decides.
+  bool Decides = E->op == LogicalOpKind::Or;
+  if (L.K == Operand::Number && Truth(L) == Decides) {
+    Stack.push_back(Operand::number(ConstValue::ofInt(Decides)));
+    return;
+  }
+  if (L.K != Operand::Number || R.K != Operand::Number) {
+    Stack.push_back(unknown(L, R));
+    return;
+  }
+  Stack.push_back(Operand::number(ConstValue::ofInt(Truth(R))));
+}
+
+void ConstFolder::leaveIndexExpr(IndexExpr *E) {
+  Operand Index = pop(), Base = pop();
+  if (Base.K != Operand::Array || Index.K != Operand::Number) {
+    Stack.push_back(unknown(Base, Index));
+    return;
+  }
+  if (Index.V.isFloat()) {
+    Stack.push_back(Operand::error("An array index is not an int.", E->Loc));
+    return;
+  }
+  const DeclLayout &L = Pass.CE.Decls.at(Base.Decl);
+  if (Base.Dim >= L.Shape.size()) {
+    Stack.push_back(Operand());
+    return;
+  }
+  uint32_t Size = L.Shape[Base.Dim];
+  if (Index.V.Int < 0 || uint32_t(Index.V.Int) >= Size) {
+    Stack.push_back(Operand::error("Index out of bounds.", E->Index->Loc));
+    return;
+  }
+  Base.Offset = Base.Offset * Size + Index.V.Int;
+  if (++Base.Dim < L.Shape.size()) {
+    Stack.push_back(Base);
+    return;
+  }
+  ConstValue V = ConstValue::ofInt(0);
+  if (Base.Decl->basetype_ == BaseType::FLOAT) {
+    V = ConstValue::ofFloat(L.Init ? L.Init->floatAt(Base.Offset) : 0);
+  } else if (L.Init != nullptr) {
+    V = ConstValue::ofInt(L.Init->intAt(Base.Offset));
+  }
+  Stack.push_back(Operand::number(V));
+}
+
+void ConstEvaluator::run(Program &P) {
+  ConstPass Pass(*this);
+  Pass.traverse(P);
+}
+
+optional<ConstValue> ConstEvaluator::value(const Expr *E) const {
+  if (optional<ConstValue> V = FoldLiteral(const_cast<Expr *>(E))) {
+    return V;
+  }
+  auto It = Values.find(E);
+  return It == Values.end() ? nullopt : It->second;
+}
+
+} // namespace ast
@@ -0,0 +1,88 @@
+#include "dominators.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace ssa {
+
+DomTree::DomTree(const Function &F)
+    : Order(F.NumBlocks, ~0u), IDom(F.NumBlocks, nullptr),
+      Children(F.NumBlocks), In(F.NumBlocks, 0), Out(F.NumBlocks, 0) {
+  if (F.isDeclaration()) {
+    return;
+  }
+  // Postorder by an explicit stack of (block, next successor).
+  vector<pair<Block *, unsigned>> Stack{{F.entry(), 0}};
+  vector<bool> Seen(F.NumBlocks);
+  Seen[F.entry()->Id] = true;
+  while (!Stack.empty()) {
+    auto &[B, i] = Stack.back();
+    Instr *T = B->terminator();
+    if (T != nullptr && i < T->numSuccessors()) {
+      Block *S = T->successor(i++);
+      if (!Seen[S->Id]) {
+        Seen[S->Id] = true;
+        Stack.push_back({S, 0});
+      }
+      continue;
+    }
+    RPO.push_back(B);
+    Stack.pop_back();
+  }
+  reverse(RPO.begin(), RPO.end());
+  for (size_t i = 0; i < RPO.size(); ++i) {
+    Order[RPO[i]->Id] = i;
+  }
+
+  auto Intersect = [&](Block *A, Block *B) {
+    while (A != B) {
+      while (Order[A->Id] > Order[B->Id]) {
+        A = IDom[A->Id];
+      }
+      while (Order[B->Id] > Order[A->Id]) {
+        B = IDom[B->Id];
+      }
+    }
+    return A;
+  };
+  Block *Entry = RPO.front();
+  IDom[Entry->Id] = Entry;
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (size_t i = 1; i < RPO.size(); ++i) {
+      Block *B = RPO[i], *New = nullptr;
+      for (Block *P : B->Preds) {
+        if (IDom[P->Id] == nullptr) {
+          continue; // unreachable, or not processed yet
+        }
+        New = New == nullptr ? P : Intersect(P, New);
+      }
+      if (IDom[B->Id] != New) {
+        IDom[B->Id] = New;
+        Changed = true;
+      }
+    }
+  }
+  IDom[Entry->Id] = nullptr;
+
+  for (size_t i = 1; i < RPO.size(); ++i) {
+    Children[IDom[RPO[i]->Id]->Id].push_back(RPO[i]);
+  }
+  uint32_t Clock = 0;
+  vector<pair<Block *, size_t>> Walk{{Entry, 0}};
+  In[Entry->Id] = Clock++;
+  while (!Walk.empty()) {
+    auto &[B, i] = Walk.back();
+    if (i < Children[B->Id].size()) {
+      Block *C = Children[B->Id][i++];
+      In[C->Id] = Clock++;
+      Walk.push_back({C, 0});
+      continue;
+    }
+    Out[B->Id] = Clock++;
+    Walk.pop_back();
+  }
+}
+
+} // namespace ssa
@@ -0,0 +1,420 @@
+#include "flatast.hpp"
+#include "ast.hpp"
+#include "casting.hpp"
+#include <bit>
+#include <variant>
+
+namespace ast {
+
+size_t FlatAST::bytes() const {
+  return Kinds.capacity() * sizeof(FlatKind) + Ops.capacity() +
+         (A.capacity() + B.capacity() + Extra.capacity() + Roots.capacity()) *
+             sizeof(uint32_t) +
+         Locs.capacity() * sizeof(SourceLoc);
+}
+
+unsigned FlatASTRef::numChildren(uint32_t Node) const {
+  switch (Kinds[Node]) {
+  case FlatKind::Integer:
+  case FlatKind::Float:
+  case FlatKind::Variable:
+  case FlatKind::Continue:
+  case FlatKind::Break:
+    return 0;
+  case FlatKind::Negate:
+  case FlatKind::Not:
+  case FlatKind::ExprStmt:
+  case FlatKind::Return:
+    return 1;
+  case FlatKind::Binop:
+  case FlatKind::Cmp:
+  case FlatKind::Logical:
+  case FlatKind::Index:
+  case FlatKind::Assign:
+  case FlatKind::While:
+    return 2;
+  case FlatKind::If:
+    return 3;
+  case FlatKind::Call:
+  case FlatKind::Block:
+  case FlatKind::InitList:
+  case FlatKind::Param:
+    return Extra[B[Node]];
+  case FlatKind::Decl:
+  case FlatKind::Func:
+    return Extra[B[Node]] + 1;
+  }
+  return 0;
+}
+
+uint32_t FlatASTRef::child(uint32_t Node, unsigned i) const {
+  switch (Kinds[Node]) {
+  case FlatKind::If:
+    return i == 0 ? A[Node] : Extra[B[Node] + i - 1];
+  case FlatKind::Call:
+  case FlatKind::Block:
+  case FlatKind::InitList:
+  case FlatKind::Param:
+  case FlatKind::Decl:
+  case FlatKind::Func:
+    // Decl and Func keep their last slot right after the list.
+    return Extra[B[Node] + 1 + i];
+  default:
+    return i == 0 ? A[Node] : B[Node];
+  }
+}
+
+namespace {
+// Emits each node when the walk leaves it, which is post-order. The indices
+// of finished nodes wait on `Values` until their parent is emitted; an
+// empty child slot is recorded as None.
+struct Flattener : ASTWalker {
+  FlatAST &F;
+  vector<uint32_t> Values;
+
+  Flattener(FlatAST &F) : F(F) {}
+
+  uint32_t pop() {
+    uint32_t V = Values.back();
+    Values.pop_back();
+    return V;
+  }
+
+  // Moves the top `N` values into Extra as a list and returns where it
+  // starts.
+  uint32_t popList(size_t N) {
+    uint32_t At = F.Extra.size();
+    F.Extra.push_back(N);
+    F.Extra.insert(F.Extra.end(), Values.end() - N, Values.end());
+    Values.resize(Values.size() - N);
+    return At;
+  }
+
+  void push(FlatKind Kind, uint8_t Op, uint32_t A, uint32_t B,
+            SourceLoc Loc) {
+    Values.push_back(F.addNode(Kind, Op, A, B, Loc));
+  }
+
+  void after(NodeRef, unsigned, NodeRef Child) {
+    if (Child.isNull()) {
+      Values.push_back(FlatAST::None);
+    }
+  }
+
+  void leave(NodeRef N) {
+    switch (N.Cls) {
+    case NodeRef::Class::None:
+      break;
+    case NodeRef::Class::Expr:
+      return expr(N.expr());
+    case NodeRef::Class::Stmt:
+      return stmt(N.stmt());
+    case NodeRef::Class::InitVals: {
+      // A single expression is its own value.
+      InitVals *IV = N.initVals();
+      if (IV->val == nullptr) {
+        push(FlatKind::InitList, 0, 0, popList(IV->vals.size()), SourceLoc());
+      }
+      break;
+    }
+    case NodeRef::Class::Param: {
+      Param *P = N.param();
+      push(FlatKind::Param, uint8_t(P->basetype_), P->paraname_.Id,
+           popList(P->dims_.size()), P->Loc);
+      break;
+    }
+    case NodeRef::Class::Func: {
+      Func *Fn = N.func();
+      uint32_t Body = pop();
+      uint32_t Params = popList(Fn->formal_paras_.size());
+      F.Extra.push_back(Body);
+      push(FlatKind::Func, uint8_t(Fn->return_type_), Fn->function_name_.Id,
+           Params, Fn->Loc);
+      break;
+    }
+    }
+  }
+
+  void expr(Expr *E) {
+    switch (E->Kind) {
+    case ExprKind::Integer:
+      return push(FlatKind::Integer, 0,
+                  bit_cast<uint32_t>(cast<IntegerExpr>(E)->Value), 0, E->Loc);
+    case ExprKind::Float:
+      return push(FlatKind::Float, 0,
+                  bit_cast<uint32_t>(cast<FloatExpr>(E)->Value), 0, E->Loc);
+    case ExprKind::Variable:
+      return push(FlatKind::Variable, 0, cast<VariableExpr>(E)->VariName.Id,
+                  0, E->Loc);
+    case ExprKind::Negate:
+      return push(FlatKind::Negate, 0, pop(), 0, E->Loc);
+    case ExprKind::Not:
+      return push(FlatKind::Not, 0, pop(), 0, E->Loc);
+    case ExprKind::Binop:
+      return binary(FlatKind::Binop, uint8_t(cast<BinopExpr>(E)->op), E);
+    case ExprKind::Cmp:
+      return binary(FlatKind::Cmp, uint8_t(cast<CmpExpr>(E)->op), E);
+    case ExprKind::Logical:
+      return binary(FlatKind::Logical, uint8_t(cast<LogicalExpr>(E)->op), E);
+    case ExprKind::Index:
+      return binary(FlatKind::Index, 0, E);
+    case ExprKind::Assign:
+      return binary(FlatKind::Assign, 0, E);
+    case ExprKind::FunctionCall: {
+      auto *FCE = cast<FunctionCallExpr>(E);
+      uint32_t Args = popList(FCE->RealParameters.size());
+      return push(FlatKind::Call, 0, FCE->FuncName.Id, Args, E->Loc);
+    }
+    }
+  }
+
+  void binary(FlatKind Kind, uint8_t Op, Expr *E) {
+    uint32_t R = pop();
+    uint32_t L = pop();
+    push(Kind, Op, L, R, E->Loc);
+  }
+
+  void stmt(Stmt *S) {
+    switch (S->Kind) {
+    case StmtKind::Expr:
+      return push(FlatKind::ExprStmt, 0, pop(), 0, S->Loc);
+    case StmtKind::If: {
+      uint32_t Else = pop();
+      uint32_t Then = pop();
+      uint32_t Cond = pop();
+      uint32_t Branches = F.Extra.size();
+      F.Extra.push_back(Then);
+      F.Extra.push_back(Else);
+      return push(FlatKind::If, 0, Cond, Branches, S->Loc);
+    }
+    case StmtKind::While: {
+      uint32_t Body = pop();
+      uint32_t Cond = pop();
+      return push(FlatKind::While, 0, Cond, Body, S->Loc);
+    }
+    case StmtKind::Return:
+      return push(FlatKind::Return, 0, pop(), 0, S->Loc);
+    case StmtKind::Block: {
+      uint32_t Stmts = popList(cast<BlockStmt>(S)->Stmts.size());
+      return push(FlatKind::Block, 0, 0, Stmts, S->Loc);
+    }
+    case StmtKind::Continue:
+      return push(FlatKind::Continue, 0, 0, 0, S->Loc);
+    case StmtKind::Break:
+      return push(FlatKind::Break, 0, 0, 0, S->Loc);
+    case StmtKind::Decl: {
+      auto *DS = cast<DeclStmt>(S);
+      uint32_t Init = pop();
+      uint32_t Dims = popList(DS->Dims.size());
+      F.Extra.push_back(Init);
+      uint8_t Flags =
+          (DS->isConst ? FlatAST::DeclConst : 0) |
+          (DS->basetype_ == BaseType::FLOAT ? FlatAST::DeclFloat : 0);
+      return push(FlatKind::Decl, Flags, DS->VarName.Id, Dims, S->Loc);
+    }
+    }
+  }
+};
+} // namespace
+
+FlatAST Flatten(Program &P) {
+  FlatAST Result;
+  Flattener Builder(Result);
+  for (auto &Item : P.instrs) {
+    if (auto F = get_if<Func>(&Item)) {
+      Builder.walk(F);
+    } else {
+      Builder.walk(&get<DeclStmt>(Item));
+    }
+    Result.Roots.push_back(Builder.pop());
+  }
+  return Result;
+}
+
+namespace {
+// Rebuilds the nodes in post-order, so the children of a node already exist
+// when it is made. Built[i] is node i as an Expr*, Stmt* or InitVals*; Param
+// and Func nodes are built by the Func root that holds them.
+struct Unflattener {
+  FlatASTRef F;
+  ASTContext &Ctx;
+  vector<Symbol> Symbols; // the global symbol of each string in F's table
+  vector<void *> Built;
+  vector<Expr *> Exprs;
+  vector<Stmt *> Stmts;
+  vector<InitVals> Inits;
+  vector<Param> Params;
+
+  Unflattener(FlatASTRef F, ASTContext &Ctx)
+      : F(F), Ctx(Ctx), Built(F.size()) {
+    if (F.StringData != nullptr) {
+      Symbols.reserve(F.StringOffsets.size() - 1);
+      for (uint32_t i = 0; i + 1 < F.StringOffsets.size(); ++i) {
+        Symbols.push_back(Interner::global().intern(F.name(i)));
+      }
+    }
+  }
+
+  Symbol symbol(uint32_t Id) {
+    return F.StringData == nullptr ? Symbol{Id} : Symbols[Id];
+  }
+  Expr *expr(uint32_t Node) {
+    return Node == FlatAST::None ? nullptr : static_cast<Expr *>(Built[Node]);
+  }
+  Stmt *stmt(uint32_t Node) {
+    return Node == FlatAST::None ? nullptr : static_cast<Stmt *>(Built[Node]);
+  }
+  // An initializer slot holds an InitList or a bare expression.
+  InitVals initVals(uint32_t Node) {
+    if (F.Kinds[Node] == FlatKind::InitList) {
+      return *static_cast<InitVals *>(Built[Node]);
+    }
+    return InitVals(expr(Node));
+  }
+
+  Span<Expr *> exprs(Span<const uint32_t> Nodes) {
+    Exprs.clear();
+    for (uint32_t Node : Nodes) {
+      Exprs.push_back(expr(Node));
+    }
+    return Ctx.Copy(Exprs);
+  }
+
+  void build(uint32_t N) {
+    uint32_t A = F.A[N], B = F.B[N];
+    uint8_t Op = F.Ops[N];
+    Expr *E = nullptr;
+    Stmt *S = nullptr;
+    switch (F.Kinds[N]) {
+    case FlatKind::Integer:
+      E = Ctx.New<IntegerExpr>(bit_cast<int>(A));
+      break;
+    case FlatKind::Float:
+      E = Ctx.New<FloatExpr>(bit_cast<float>(A));
+      break;
+    case FlatKind::Variable:
+      E = Ctx.New<VariableExpr>(symbol(A));
+      break;
+    case FlatKind::Negate:
+      E = Ctx.New<NegateExpr>(expr(A));
+      break;
+    case FlatKind::Not:
+      E = Ctx.New<NotExpr>(expr(A));
+      break;
+    case FlatKind::Binop:
+      E = Ctx.New<BinopExpr>(BinOpKind(Op), expr(A), expr(B));
+      break;
+    case FlatKind::Cmp:
+      E = Ctx.New<CmpExpr>(CmpOpKind(Op), expr(A), expr(B));
+      break;
+    case FlatKind::Logical:
+      E = Ctx.New<LogicalExpr>(LogicalOpKind(Op), expr(A), expr(B));
+      break;
+    case FlatKind::Index:
+      if (auto *V = dyn_cast<VariableExpr>(expr(A))) {
+        E = Ctx.New<IndexExpr>(V, expr(B));
+      } else {
+        E = Ctx.New<IndexExpr>(cast<IndexExpr>(expr(A)), expr(B));
+      }
+      break;
+    case FlatKind::Assign:
+      if (auto *V = dyn_cast<VariableExpr>(expr(A))) {
+        E = Ctx.New<AssignExpr>(V, expr(B));
+      } else {
+        E = Ctx.New<AssignExpr>(cast<IndexExpr>(expr(A)), expr(B));
+      }
+      break;
+    case FlatKind::Call:
+      E = Ctx.New<FunctionCallExpr>(symbol(A), exprs(F.list(B)));
+      break;
+
+    case FlatKind::ExprStmt:
+      S = Ctx.New<ExprStmt>(expr(A));
+      break;
+    case FlatKind::If:
+      S = Ctx.New<IfStmt>(expr(A), stmt(F.Extra[B]), stmt(F.Extra[B + 1]));
+      break;
+    case FlatKind::While:
+      S = Ctx.New<WhileStmt>(expr(A), stmt(B));
+      break;
+    case FlatKind::Return:
+      S = Ctx.New<ReturnStmt>(expr(A));
+      break;
+    case FlatKind::Block:
+      Stmts.clear();
+      for (uint32_t Child : F.list(B)) {
+        Stmts.push_back(stmt(Child));
+      }
+      S = Ctx.New<BlockStmt>(Ctx.Copy(Stmts));
+      break;
+    case FlatKind::Continue:
+      S = Ctx.New<ContinueStmt>();
+      break;
+    case FlatKind::Break:
+      S = Ctx.New<BreakStmt>();
+      break;
+    case FlatKind::Decl: {
+      uint32_t Init = F.afterList(B);
+      InitVals *IV = nullptr;
+      if (Init != FlatAST::None) {
+        IV = Ctx.New<InitVals>(initVals(Init));
+      }
+      S = Ctx.New<DeclStmt>(bool(Op & FlatAST::DeclConst),
+                            Op & FlatAST::DeclFloat ? BaseType::FLOAT
+                                                    : BaseType::INT,
+                            symbol(A), exprs(F.list(B)), IV);
+      break;
+    }
+    case FlatKind::InitList:
+      Inits.clear();
+      for (uint32_t Child : F.list(B)) {
+        Inits.push_back(initVals(Child));
+      }
+      Built[N] = Ctx.New<InitVals>(Ctx.Copy(Inits));
+      return;
+    case FlatKind::Param:
+    case FlatKind::Func:
+      return;
+    }
+    if (E != nullptr) {
+      E->Loc = F.loc(N);
+      Built[N] = E;
+    } else {
+      S->Loc = F.loc(N);
+      Built[N] = S;
+    }
+  }
+
+  Func func(uint32_t N) {
+    Params.clear();
+    for (uint32_t P : F.list(F.B[N])) {
+      Params.push_back(Param{BaseType(F.Ops[P]), symbol(F.A[P]),
+                             exprs(F.list(F.B[P])), F.loc(P)});
+    }
+    Stmt *Body = stmt(F.afterList(F.B[N]));
+    Func Fn(ReturnType(F.Ops[N]), symbol(F.A[N]), Ctx.Copy(Params),
+            Body == nullptr ? nullptr : cast<BlockStmt>(Body));
+    Fn.Loc = F.loc(N);
+    return Fn;
+  }
+};
+} // namespace
+
+Program Unflatten(FlatASTRef F) {
+  Program P{make_unique<ASTContext>(), {}};
+  Unflattener Builder(F, *P.Context);
+  for (uint32_t N = 0; N < F.size(); ++N) {
+    Builder.build(N);
+  }
+  P.instrs.reserve(F.Roots.size());
+  for (uint32_t Root : F.Roots) {
+    if (F.Kinds[Root] == FlatKind::Func) {
+      P.instrs.push_back(Builder.func(Root));
+    } else {
+      P.instrs.push_back(*cast<DeclStmt>(Builder.stmt(Root)));
+    }
+  }
+  return P;
+}
+
+} // namespace ast
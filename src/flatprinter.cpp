@@ -0,0 +1,240 @@
+#include "flatast.hpp"
+#include <bit>
+
+namespace ast {
+
+static const char *BinOpSpelling[] = {"+", "-", "*", "/", "%"};
+static const char *CmpOpSpelling[] = {">", ">=", "<", "<=", "==", "!="};
+static const char *LogicalOpSpelling[] = {"&&", "||"};
+
+static const char *TypeSpelling(bool isFloat) {
+  return isFloat ? "float " : "int ";
+}
+
+void FlatPrinter::Indent() { Out.fill('\t', IndentDepth); }
+
+void FlatPrinter::print() {
+  for (uint32_t Root : AST.Roots) {
+    print(Root);
+    Out << '\n';
+  }
+}
+
+void FlatPrinter::print(uint32_t Root) {
+  enter(Root);
+  Stack.push_back({Root, 0, AST.numChildren(Root)});
+  while (!Stack.empty()) {
+    Frame &F = Stack.back();
+    if (F.Next == F.Count) {
+      uint32_t Done = F.Node;
+      Stack.pop_back();
+      leave(Done);
+      if (!Stack.empty()) {
+        after(Stack.back().Node, Stack.back().Next++);
+      }
+      continue;
+    }
+    uint32_t Node = F.Node;
+    unsigned i = F.Next;
+    uint32_t Child = AST.child(Node, i);
+    before(Node, i, Child);
+    if (Child == FlatAST::None) {
+      F.Next++;
+      after(Node, i);
+      continue;
+    }
+    enter(Child);
+    Stack.push_back({Child, 0, AST.numChildren(Child)});
+  }
+}
+
+void FlatPrinter::enter(uint32_t Node) {
+  uint32_t A = AST.A[Node];
+  uint8_t Op = AST.Ops[Node];
+  switch (AST.Kinds[Node]) {
+  case FlatKind::Integer:
+    Out << bit_cast<int>(A);
+    break;
+  case FlatKind::Float:
+    Out << bit_cast<float>(A);
+    break;
+  case FlatKind::Variable:
+    Out << AST.name(A);
+    break;
+  case FlatKind::Negate:
+    Out << "-(";
+    break;
+  case FlatKind::Not:
+    Out << "!(";
+    break;
+  case FlatKind::Binop:
+  case FlatKind::Cmp:
+  case FlatKind::Logical:
+    Out << '(';
+    break;
+  case FlatKind::Call:
+    Out << AST.name(A) << '(';
+    break;
+  case FlatKind::If:
+    Out << "if" << '(';
+    break;
+  case FlatKind::While:
+    Out << "while(";
+    break;
+  case FlatKind::Return:
+    Out << "return ";
+    break;
+  case FlatKind::Block:
+    IndentDepth++;
+    Out << "{\n";
+    break;
+  case FlatKind::Continue:
+    Out << "continue;";
+    break;
+  case FlatKind::Break:
+    Out << "break;";
+    break;
+  case FlatKind::Decl:
+    if (Op & FlatAST::DeclConst)
+      Out << "const ";
+    Out << TypeSpelling(Op & FlatAST::DeclFloat) << AST.name(A);
+    break;
+  case FlatKind::InitList:
+    Out << '{';
+    break;
+  case FlatKind::Param:
+    Out << TypeSpelling(BaseType(Op) == BaseType::FLOAT) << AST.name(A);
+    break;
+  case FlatKind::Func:
+    switch (ReturnType(Op)) {
+    case ReturnType::INT:
+      Out << "int";
+      break;
+    case ReturnType::FLOAT:
+      Out << "float";
+      break;
+    case ReturnType::VOID:
+      Out << "void";
+      break;
+    }
+    Out << ' ' << AST.name(A) << '(';
+    break;
+  default:
+    break;
+  }
+}
+
+void FlatPrinter::before(uint32_t Node, unsigned i, uint32_t Child) {
+  uint8_t Op = AST.Ops[Node];
+  switch (AST.Kinds[Node]) {
+  case FlatKind::Binop:
+    if (i == 1)
+      Out << ')' << BinOpSpelling[Op] << '(';
+    break;
+  case FlatKind::Cmp:
+    if (i == 1)
+      Out << ')' << CmpOpSpelling[Op] << '(';
+    break;
+  case FlatKind::Logical:
+    if (i == 1)
+      Out << ')' << LogicalOpSpelling[Op] << '(';
+    break;
+  case FlatKind::Index:
+    if (i == 1)
+      Out << '[';
+    break;
+  case FlatKind::Assign:
+    if (i == 1)
+      Out << " = ";
+    break;
+  case FlatKind::Call:
+  case FlatKind::InitList:
+    if (i > 0)
+      Out << ',';
+    break;
+  case FlatKind::If:
+    if (i == 1)
+      Out << ')';
+    else if (i == 2 && Child != FlatAST::None)
+      Out << "else ";
+    break;
+  case FlatKind::While:
+    if (i == 1)
+      Out << ")";
+    break;
+  case FlatKind::Block:
+    Indent();
+    break;
+  case FlatKind::Decl:
+    if (i < AST.list(AST.B[Node]).size())
+      Out << '[';
+    else if (Child != FlatAST::None)
+      Out << " = ";
+    break;
+  case FlatKind::Param:
+    Out << '[';
+    break;
+  case FlatKind::Func:
+    if (i == AST.list(AST.B[Node]).size())
+      Out << ')';
+    else if (i > 0)
+      Out << ',';
+    break;
+  default:
+    break;
+  }
+}
+
+void FlatPrinter::after(uint32_t Node, unsigned i) {
+  switch (AST.Kinds[Node]) {
+  case FlatKind::Block:
+    Out << "\n";
+    break;
+  case FlatKind::Decl:
+    if (i < AST.list(AST.B[Node]).size())
+      Out << ']';
+    break;
+  case FlatKind::Param:
+    Out << ']';
+    break;
+  default:
+    break;
+  }
+}
+
+void FlatPrinter::leave(uint32_t Node) {
+  switch (AST.Kinds[Node]) {
+  case FlatKind::Negate:
+  case FlatKind::Not:
+  case FlatKind::Binop:
+  case FlatKind::Cmp:
+  case FlatKind::Logical:
+  case FlatKind::Call:
+    Out << ')';
+    break;
+  case FlatKind::Index:
+    Out << ']';
+    break;
+  case FlatKind::ExprStmt:
+  case FlatKind::Return:
+  case FlatKind::Decl:
+    Out << ';';
+    break;
+  case FlatKind::Block:
+    IndentDepth--;
+    Indent();
+    Out << "}";
+    break;
+  case FlatKind::InitList:
+    Out << '}';
+    break;
+  case FlatKind::Func:
+    if (AST.afterList(AST.B[Node]) == FlatAST::None)
+      Out << ';';
+    break;
+  default:
+    break;
+  }
+}
+
+} // namespace ast
@@ -0,0 +1,298 @@
+#include "dominators.hpp"
+#include "passes.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ssa {
+
+namespace {
+// What an instruction computes. Loads are keyed by their address, with
+// the stores that forward to them.
+struct Key {
+  Opcode Op;
+  Type Ty;
+  Pred P;
+  uint32_t Imm;
+  Value *A, *B;
+  bool operator==(const Key &) const = default;
+};
+
+struct KeyHash {
+  size_t operator()(const Key &K) const {
+    uint64_t H = uint64_t(K.Op) | uint64_t(K.Ty) << 8 | uint64_t(K.P) << 16 |
+                 uint64_t(K.Imm) << 32;
+    H ^= reinterpret_cast<uintptr_t>(K.A) * 0x9e3779b97f4a7c15ull;
+    H ^= (reinterpret_cast<uintptr_t>(K.B) >> 3) * 0xc2b2ae3d27d4eb4full;
+    return H ^ H >> 29;
+  }
+};
+
+// A value some dominating instruction has, and for loads when it was
+// had, by the clock of GVN.
+struct Avail {
+  Value *V = nullptr;
+  uint32_t Time = 0;
+};
+
+static bool isZero(Value *V) {
+  return V->Op == Opcode::ConstInt && cast<ConstInt>(V)->V == 0;
+}
+static bool isOne(Value *V) {
+  return V->Op == Opcode::ConstInt && cast<ConstInt>(V)->V == 1;
+}
+static bool isCommutative(Opcode Op) {
+  return Op == Opcode::Add || Op == Opcode::Mul || Op == Opcode::FAdd ||
+         Op == Opcode::FMul;
+}
+
+// Walks the dominator tree in preorder with scoped tables, so a value is
+// only reused where its definition dominates.
+//
+// Memory is versioned instead of tracked: every store, zero and writing
+// call moves the clock and stamps what it may have written, and a load
+// reuses a value only if nothing its address may point into was stamped
+// after the value was had. What a pointer may point into follows from
+// its root: an alloca whose address no call sees is only written through
+// itself; a global or an argument may be the same memory as any argument.
+// Blocks with more than one predecessor stamp everything, as paths from
+// elsewhere join there.
+struct GVNPass {
+  Function &F;
+  DomTree DT;
+  unordered_map<Key, Avail, KeyHash> Table;
+  vector<pair<Key, Avail>> TableLog; // what scoped insertions replaced
+
+  uint32_t Clock = 0;
+  uint32_t Epoch = 0, ArgGen = 0, GlobalGen = 0, CallGen = 0;
+  vector<uint32_t> RootGen; // by Value::Id of allocas and globals
+  vector<bool> Escapes;     // by Value::Id of allocas
+  vector<pair<uint32_t *, uint32_t>> GenLog;
+  bool Changed = false;
+
+  explicit GVNPass(Function &F)
+      : F(F), DT(F), RootGen(F.NumValues), Escapes(F.NumValues) {}
+
+  void stamp(uint32_t &Gen) {
+    GenLog.push_back({&Gen, Gen});
+    Gen = ++Clock;
+  }
+
+  // When memory at `Addr` was last written, as far as can be told.
+  uint32_t lastWrite(Value *Addr) {
+    Value *R = PointerRoot(Addr);
+    if (R->Op == Opcode::Alloca) {
+      uint32_t T = max(Epoch, RootGen[R->Id]);
+      return Escapes[R->Id] ? max(T, CallGen) : T;
+    }
+    if (R->Op == Opcode::GlobalAddr) {
+      return max({Epoch, RootGen[R->Id], ArgGen, CallGen});
+    }
+    return max({Epoch, ArgGen, GlobalGen, CallGen});
+  }
+
+  void clobber(Value *Addr) {
+    Value *R = PointerRoot(Addr);
+    if (R->Op == Opcode::Alloca) {
+      stamp(RootGen[R->Id]);
+    } else if (R->Op == Opcode::GlobalAddr) {
+      stamp(RootGen[R->Id]);
+      stamp(GlobalGen);
+    } else if (R->Op == Opcode::Argument) {
+      stamp(ArgGen);
+    } else {
+      stamp(Epoch);
+    }
+  }
+
+  void insert(const Key &K, Avail A) {
+    auto [It, New] = Table.try_emplace(K, A);
+    TableLog.push_back({K, New ? Avail{} : It->second});
+    It->second = A;
+  }
+
+  void replace(Instr *I, Value *V) {
+    I->replaceAllUsesWith(V);
+    F.erase(I);
+    Changed = true;
+  }
+
+  // An existing value equal to `I`, from its operands alone.
+  Value *simplify(Instr *I) {
+    if (I->Op >= Opcode::Add && I->Op <= Opcode::FPToSI) {
+      Value *Ops[2];
+      bool Constant = true;
+      for (uint32_t i = 0; i < I->NumOps; ++i) {
+        Ops[i] = I->operand(i);
+        Constant &= Ops[i]->Op == Opcode::ConstInt ||
+                    Ops[i]->Op == Opcode::ConstFloat;
+      }
+      if (Constant) {
+        return Fold(F, I, Ops);
+      }
+    }
+    Value *L = I->NumOps > 0 ? I->operand(0) : nullptr;
+    Value *R = I->NumOps > 1 ? I->operand(1) : nullptr;
+    switch (I->Op) {
+    case Opcode::Add:
+      return isZero(R) ? L : nullptr;
+    case Opcode::Sub:
+      return isZero(R) ? L : L == R ? F.getInt(0) : nullptr;
+    case Opcode::Mul:
+      return isOne(R) ? L : isZero(R) ? R : nullptr;
+    case Opcode::SDiv:
+      return isOne(R) ? L : nullptr;
+    case Opcode::SRem:
+      return isOne(R) ? F.getInt(0) : nullptr;
+    case Opcode::ICmp:
+      if (L == R) {
+        return F.getBool(I->P == Pred::Eq || I->P == Pred::Le ||
+                         I->P == Pred::Ge);
+      }
+      return nullptr;
+    case Opcode::PtrAdd:
+      return isZero(R) ? L : nullptr;
+    default:
+      return nullptr;
+    }
+  }
+
+  void phi(Instr *I) {
+    Value *Same = nullptr;
+    for (uint32_t i = 0; i < I->NumOps; ++i) {
+      Value *V = I->operand(i);
+      if (V == I || V == Same) {
+        continue;
+      }
+      if (Same != nullptr) {
+        return;
+      }
+      Same = V;
+    }
+    replace(I, Same ? Same : F.getUndef(I->Ty));
+  }
+
+  void block(Block *B) {
+    if (B != F.entry() && B->Preds.size() != 1) {
+      stamp(Epoch);
+    }
+    for (Instr *I : *B) {
+      switch (I->Op) {
+      case Opcode::Phi:
+        phi(I);
+        continue;
+      case Opcode::Load: {
+        Key K{Opcode::Load, I->Ty, Pred::Eq, 0, I->operand(0), nullptr};
+        auto It = Table.find(K);
+        if (It != Table.end() && It->second.V != nullptr &&
+            lastWrite(I->operand(0)) <= It->second.Time) {
+          replace(I, It->second.V);
+        } else {
+          insert(K, {I, Clock});
+        }
+        continue;
+      }
+      case Opcode::Store: {
+        Value *V = I->operand(0), *Addr = I->operand(1);
+        clobber(Addr);
+        insert({Opcode::Load, V->Ty, Pred::Eq, 0, Addr, nullptr}, {V, Clock});
+        continue;
+      }
+      case Opcode::Zero:
+        clobber(I->operand(0));
+        continue;
+      case Opcode::Call:
+        if (cast<CallInstr>(I)->Callee->WritesMemory) {
+          stamp(CallGen);
+        }
+        continue;
+      default:
+        break;
+      }
+      if (I->Op < Opcode::Add || I->Op > Opcode::PtrAdd ||
+          I->Op == Opcode::Alloca || I->Op == Opcode::Zero) {
+        continue;
+      }
+      // Constants go right, so the identities only look there.
+      if (isCommutative(I->Op) && I->operand(0)->isConstant() &&
+          !I->operand(1)->isConstant()) {
+        Value *L = I->operand(0);
+        I->setOperand(0, I->operand(1));
+        I->setOperand(1, L);
+      }
+      if (Value *V = simplify(I)) {
+        replace(I, V);
+        continue;
+      }
+      Value *A = I->operand(0);
+      Value *C = I->NumOps > 1 ? I->operand(1) : nullptr;
+      if (isCommutative(I->Op) && C < A) {
+        swap(A, C);
+      }
+      Key K{I->Op, I->Ty, I->P, I->Imm, A, C};
+      auto It = Table.find(K);
+      if (It != Table.end() && It->second.V != nullptr) {
+        replace(I, It->second.V);
+      } else {
+        insert(K, {I, 0});
+      }
+    }
+  }
+
+  bool run() {
+    for (Block *B : F.Blocks) {
+      for (Instr *I : *B) {
+        if (I->Op != Opcode::Call) {
+          continue;
+        }
+        for (uint32_t i = 0; i < I->NumOps; ++i) {
+          Value *R = PointerRoot(I->operand(i));
+          if (R->Op == Opcode::Alloca) {
+            Escapes[R->Id] = true;
+          }
+        }
+      }
+    }
+    struct Scope {
+      Block *B;
+      size_t Child, Table, Gens;
+    };
+    vector<Scope> Stack;
+    auto Enter = [&](Block *B) {
+      Stack.push_back({B, 0, TableLog.size(), GenLog.size()});
+      block(B);
+    };
+    Enter(F.entry());
+    while (!Stack.empty()) {
+      Scope &S = Stack.back();
+      if (S.Child < DT.Children[S.B->Id].size()) {
+        Enter(DT.Children[S.B->Id][S.Child++]);
+        continue;
+      }
+      while (TableLog.size() > S.Table) {
+        auto &[K, Old] = TableLog.back();
+        if (Old.V == nullptr) {
+          Table.erase(K);
+        } else {
+          Table[K] = Old;
+        }
+        TableLog.pop_back();
+      }
+      while (GenLog.size() > S.Gens) {
+        *GenLog.back().first = GenLog.back().second;
+        GenLog.pop_back();
+      }
+      Stack.pop_back();
+    }
+    return Changed;
+  }
+};
+} // namespace
+
+bool GVN(Function &F) {
+  GVNPass P(F);
+  return P.run();
+}
+
+} // namespace ssa
@@ -0,0 +1,404 @@
+#include "hir.hpp"
+#include <vector>
+
+using namespace std;
+
+namespace hir {
+
+const Type *Type::base() const {
+  const Type *T = this;
+  while (T->Elem != nullptr) {
+    T = T->Elem;
+  }
+  return T;
+}
+
+uint64_t Type::bytes() const {
+  switch (K) {
+  case Kind::Void:
+    return 0;
+  case Kind::Int:
+  case Kind::Float:
+    return 4;
+  case Kind::Array:
+    return Size * Elem->bytes();
+  case Kind::Pointer:
+    return 8;
+  }
+  return 0;
+}
+
+string Type::str() const {
+  const Type *T = this;
+  string Dims;
+  if (T->isPointer()) {
+    Dims = "[]";
+    T = T->Elem;
+  }
+  for (; T->isArray(); T = T->Elem) {
+    Dims += "[" + to_string(T->Size) + "]";
+  }
+  const char *Name = T->isVoid() ? "void" : T->isInt() ? "int" : "float";
+  return Name + Dims;
+}
+
+TypeContext::TypeContext() {
+  Void = Storage.New<Type>(Type{Type::Kind::Void});
+  Int = Storage.New<Type>(Type{Type::Kind::Int});
+  Float = Storage.New<Type>(Type{Type::Kind::Float});
+}
+
+size_t TypeContext::KeyHash::operator()(const Key &K) const {
+  uint64_t h = reinterpret_cast<uintptr_t>(K.Elem);
+  h = (h ^ (uint64_t(K.Size) << 8) ^ uint64_t(K.K)) * 0x9E3779B97F4A7C15ull;
+  return h ^ (h >> 29);
+}
+
+const Type *TypeContext::get(const Key &K) {
+  auto [It, New] = Uniqued.try_emplace(K, nullptr);
+  if (New) {
+    It->second = Storage.New<Type>(Type{K.K, K.Size, K.Elem});
+  }
+  return It->second;
+}
+
+const Type *TypeContext::getArray(const Type *Elem, uint32_t Size) {
+  return get({Type::Kind::Array, Size, Elem});
+}
+
+const Type *TypeContext::getPointer(const Type *Pointee) {
+  return get({Type::Kind::Pointer, 0, Pointee});
+}
+
+const char *OpName(Op O) {
+  switch (O) {
+  case Op::Neg:
+    return "neg";
+  case Op::Not:
+    return "not";
+  case Op::Add:
+    return "add";
+  case Op::Sub:
+    return "sub";
+  case Op::Mul:
+    return "mul";
+  case Op::Div:
+    return "div";
+  case Op::Mod:
+    return "mod";
+  case Op::Lt:
+    return "lt";
+  case Op::Le:
+    return "le";
+  case Op::Gt:
+    return "gt";
+  case Op::Ge:
+    return "ge";
+  case Op::Eq:
+    return "eq";
+  case Op::Ne:
+    return "ne";
+  case Op::And:
+    return "and";
+  case Op::Or:
+    return "or";
+  }
+  return "?";
+}
+
+unsigned Expr::numOperands() const {
+  switch (Kind) {
+  case ExprKind::IntConst:
+  case ExprKind::FloatConst:
+  case ExprKind::VarRef:
+    return 0;
+  case ExprKind::Decay:
+  case ExprKind::Load:
+  case ExprKind::Convert:
+  case ExprKind::Unary:
+    return 1;
+  case ExprKind::Index:
+  case ExprKind::Binary:
+  case ExprKind::Logical:
+  case ExprKind::Assign:
+    return 2;
+  case ExprKind::Call:
+    return cast<Call>(this)->Args.size();
+  }
+  return 0;
+}
+
+Expr *Expr::operand(unsigned i) const {
+  switch (Kind) {
+  case ExprKind::IntConst:
+  case ExprKind::FloatConst:
+  case ExprKind::VarRef:
+    break;
+  case ExprKind::Decay:
+  case ExprKind::Load:
+  case ExprKind::Convert:
+  case ExprKind::Unary:
+    return cast<UnaryExpr>(this)->Operand;
+  case ExprKind::Index:
+    return i == 0 ? cast<Index>(this)->Base : cast<Index>(this)->Idx;
+  case ExprKind::Binary:
+  case ExprKind::Logical:
+    return i == 0 ? cast<BinaryExpr>(this)->LHS : cast<BinaryExpr>(this)->RHS;
+  case ExprKind::Assign:
+    return i == 0 ? cast<Assign>(this)->Target : cast<Assign>(this)->Value;
+  case ExprKind::Call:
+    return cast<Call>(this)->Args[i];
+  }
+  return nullptr;
+}
+
+namespace {
+// Prints with a stack of work items instead of recursion, since a lowered
+// program is as deep as its source.
+struct Printer {
+  OutputSink &Out;
+
+  struct Item {
+    enum Kind : uint8_t { Stmt, Expr, Text, Index, Spaces } K;
+    unsigned Depth; // Stmt and Spaces
+    const void *Ptr; // the node or the text
+    uint64_t N;      // printed as ` [N] `
+  };
+  vector<Item> Work;
+
+  Printer(OutputSink &Out) : Out(Out) {}
+
+  void name(const Var *V) {
+    if (V->S == Var::Storage::Global) {
+      Out << '@' << V->Name.str();
+    } else {
+      Out << '%' << V->Name.str() << '.';
+      Out.writeInt(V->Id);
+    }
+  }
+
+  void type(const Type *T) { Out << string_view(T->str()); }
+
+  void text(const char *s) { Work.push_back({Item::Text, 0, s, 0}); }
+  void index(uint64_t I) { Work.push_back({Item::Index, 0, nullptr, I}); }
+  void indent(unsigned N) { Work.push_back({Item::Spaces, N, nullptr, 0}); }
+  void expr(const hir::Expr *E) { Work.push_back({Item::Expr, 0, E, 0}); }
+  void stmt(const hir::Stmt *S, unsigned N) {
+    Work.push_back({Item::Stmt, N, S, 0});
+  }
+
+  void run() {
+    while (!Work.empty()) {
+      Item I = Work.back();
+      Work.pop_back();
+      switch (I.K) {
+      case Item::Text:
+        Out << static_cast<const char *>(I.Ptr);
+        break;
+      case Item::Index:
+        Out << " [";
+        Out.writeInt(I.N);
+        Out << "] ";
+        break;
+      case Item::Spaces:
+        Out.fill(' ', I.Depth);
+        break;
+      case Item::Expr:
+        print(static_cast<const hir::Expr *>(I.Ptr));
+        break;
+      case Item::Stmt:
+        print(static_cast<const hir::Stmt *>(I.Ptr), I.Depth);
+        break;
+      }
+    }
+  }
+
+  // Prints `(kind:type ` and queues the operands and the `)`.
+  void print(const hir::Expr *E) {
+    switch (E->Kind) {
+    case ExprKind::IntConst:
+      Out.writeInt(cast<IntConst>(E)->Value);
+      return;
+    case ExprKind::FloatConst:
+      Out.writeFloatExact(cast<FloatConst>(E)->Value);
+      Out << 'f';
+      return;
+    case ExprKind::VarRef:
+      name(cast<VarRef>(E)->V);
+      return;
+    case ExprKind::Index:
+      Out << "(index";
+      break;
+    case ExprKind::Decay:
+      Out << "(decay";
+      break;
+    case ExprKind::Load:
+      Out << "(load";
+      break;
+    case ExprKind::Convert:
+      Out << "(conv";
+      break;
+    case ExprKind::Unary:
+    case ExprKind::Binary:
+    case ExprKind::Logical: {
+      auto *U = dyn_cast<UnaryExpr>(E);
+      Out << '(' << OpName(U ? U->O : cast<BinaryExpr>(E)->O);
+      break;
+    }
+    case ExprKind::Assign:
+      Out << "(assign";
+      break;
+    case ExprKind::Call:
+      Out << "(call";
+      break;
+    }
+    Out << ':';
+    type(E->Ty);
+    if (auto *C = dyn_cast<Call>(E)) {
+      Out << " @" << C->Callee->Name.str();
+    }
+    text(")");
+    for (unsigned i = E->numOperands(); i-- > 0;) {
+      expr(E->operand(i));
+      text(" ");
+    }
+  }
+
+  void print(const hir::Stmt *S, unsigned Indent) {
+    Out.fill(' ', Indent);
+    switch (S->Kind) {
+    case StmtKind::Expr:
+      Out << "expr ";
+      text("\n");
+      expr(cast<ExprStmt>(S)->E);
+      break;
+    case StmtKind::Init: {
+      const Var *V = cast<InitStmt>(S)->V;
+      Out << "init ";
+      name(V);
+      initializer(V);
+      text("\n");
+      for (size_t i = V->Init->Exprs.size(); i-- > 0;) {
+        expr(V->Init->Exprs[i].Value);
+        index(V->Init->Exprs[i].Index);
+      }
+      break;
+    }
+    case StmtKind::If: {
+      auto *I = cast<If>(S);
+      Out << "if ";
+      if (I->Else != nullptr) {
+        stmt(I->Else, Indent + 2);
+        text("else\n");
+        indent(Indent);
+      }
+      stmt(I->Then, Indent + 2);
+      text("\n");
+      expr(I->Cond);
+      break;
+    }
+    case StmtKind::While: {
+      auto *W = cast<While>(S);
+      Out << "while ";
+      stmt(W->Body, Indent + 2);
+      text("\n");
+      expr(W->Cond);
+      break;
+    }
+    case StmtKind::Break:
+      Out << "break\n";
+      break;
+    case StmtKind::Continue:
+      Out << "continue\n";
+      break;
+    case StmtKind::Return: {
+      Out << "return";
+      if (Expr *Value = cast<Return>(S)->Value) {
+        Out << ' ';
+        text("\n");
+        expr(Value);
+      } else {
+        Out << '\n';
+      }
+      break;
+    }
+    case StmtKind::Block: {
+      auto *B = cast<Block>(S);
+      Out << "{\n";
+      text("}\n");
+      indent(Indent);
+      for (size_t i = B->Stmts.size(); i-- > 0;) {
+        stmt(B->Stmts[i], Indent + 2);
+      }
+      break;
+    }
+    }
+  }
+
+  // The constant elements of `V`'s initializer, as ` [start] v v v`.
+  void initializer(const Var *V) {
+    const Initializer &Init = *V->Init;
+    bool Float = V->Ty->base()->isFloat();
+    for (const ast::ArrayInit::Run &R : Init.Runs) {
+      Out << " [";
+      Out.writeInt(R.Start);
+      Out << ']';
+      for (uint32_t i = 0; i < R.Size; ++i) {
+        Out << ' ';
+        if (Float) {
+          Out.writeFloatExact(Init.Floats[R.Offset + i]);
+        } else {
+          Out.writeInt(Init.Ints[R.Offset + i]);
+        }
+      }
+    }
+  }
+
+  void print(const Module &M) {
+    for (const Var *G : M.Globals) {
+      Out << "global ";
+      type(G->Ty);
+      Out << ' ';
+      name(G);
+      if (G->Init != nullptr) {
+        Out << " =";
+        initializer(G);
+      }
+      Out << '\n';
+    }
+    for (const Function *F : M.Functions) {
+      Out << (F->Body ? "func " : "declare ");
+      type(F->RetTy);
+      Out << " @" << F->Name.str() << '(';
+      for (size_t i = 0; i < F->Params.size(); ++i) {
+        Out << (i ? ", " : "");
+        type(F->Params[i]->Ty);
+        if (F->Body != nullptr) {
+          Out << ' ';
+          name(F->Params[i]);
+        }
+      }
+      Out << ")\n";
+      if (F->Body == nullptr) {
+        continue;
+      }
+      for (const Var *L : F->Locals) {
+        Out << "  local ";
+        type(L->Ty);
+        Out << ' ';
+        name(L);
+        Out << '\n';
+      }
+      stmt(F->Body, 0);
+      run();
+    }
+  }
+};
+} // namespace
+
+void PrintHIR(const Module &M, OutputSink &Out) {
+  Printer P(Out);
+  P.print(M);
+}
+
+} // namespace hir
@@ -0,0 +1,467 @@
+#include "consteval.hpp"
+#include "hir.hpp"
+#include "recursiveastvisitor.hpp"
+#include "resolve.hpp"
+#include "symboltable.hpp"
+#include <format>
+
+using namespace std;
+
+namespace hir {
+
+namespace {
+// Lowers in post-order on top of the AST visitor: every expression leaves
+// its HIR on `Exprs` and every statement on `Stmts`, where its parent
+// picks them up, checking their types. Deep trees are as safe as they are
+// for the visitor.
+struct Lowering : ast::RecursiveASTVisitor<Lowering> {
+  Module &M;
+  const ast::ConstEvaluator &Consts;
+  const SourceManager &SM;
+  TypeContext &Types;
+  Arena &Nodes;
+
+  // By the pointer of the DeclStmt (as a Stmt) or Param that NodeRefs to
+  // them hold.
+  unordered_map<const void *, Var *> Vars;
+  SymbolMap<Function *> Funcs;
+
+  vector<Expr *> Exprs;
+  vector<Stmt *> Stmts; // nullptr for a statement that does nothing
+  vector<size_t> Blocks;
+  vector<While *> Loops;
+  Function *Current = nullptr;
+  bool Redeclared = false; // Current was declared before
+  vector<Var *> Locals; // the params and locals of Current
+  // The initializer elements of the DeclStmt being lowered, in order.
+  vector<pair<const ast::Expr *, Expr *>> InitValues;
+
+  Lowering(Module &M, const ast::ConstEvaluator &Consts,
+           const SourceManager &SM)
+      : M(M), Consts(Consts), SM(SM), Types(M.Types), Nodes(M.Nodes) {}
+
+  [[noreturn]] void fail(SourceLoc Loc, string_view Message) {
+    throw format("{}: {}", SM.describe(Loc), Message);
+  }
+
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    return Nodes.New<T>(std::forward<Args>(args)...);
+  }
+
+  template <typename T>
+  Span<T> copy(const vector<T> &Elements, size_t From = 0) {
+    return Nodes.Copy(Elements.data() + From, Elements.size() - From);
+  }
+
+  Expr *pop() {
+    Expr *E = Exprs.back();
+    Exprs.pop_back();
+    return E;
+  }
+  Stmt *popStmt() {
+    Stmt *S = Stmts.back();
+    Stmts.pop_back();
+    return S;
+  }
+
+  const Type *scalarType(ast::BaseType T) {
+    return T == ast::BaseType::FLOAT ? Types.getFloat() : Types.getInt();
+  }
+  const Type *returnType(ast::ReturnType T) {
+    switch (T) {
+    case ast::ReturnType::INT:
+      return Types.getInt();
+    case ast::ReturnType::FLOAT:
+      return Types.getFloat();
+    case ast::ReturnType::VOID:
+      break;
+    }
+    return Types.getVoid();
+  }
+  // `Elem` with the dims `Shape` around it.
+  const Type *arrayType(const Type *Elem, Span<uint32_t> Shape, size_t From) {
+    for (size_t d = Shape.size(); d-- > From;) {
+      Elem = Types.getArray(Elem, Shape[d]);
+    }
+    return Elem;
+  }
+
+  // The value of `E` as an int or float: variables and elements are
+  // loaded, and `const` scalars replaced by their values.
+  Expr *scalar(Expr *E) {
+    auto *R = dyn_cast<VarRef>(E);
+    if (R != nullptr && R->V->IsConst && E->Ty->isScalar()) {
+      const Initializer *Init = R->V->Init;
+      bool Set = Init != nullptr && !Init->Runs.empty();
+      if (E->Ty->isFloat()) {
+        return make<FloatConst>(E->Ty, Set ? Init->Floats[0] : 0, E->Loc);
+      }
+      return make<IntConst>(E->Ty, Set ? Init->Ints[0] : 0, E->Loc);
+    }
+    if (E->isLValue() && E->Ty->isScalar()) {
+      return make<UnaryExpr>(ExprKind::Load, E->Ty, E, E->Loc);
+    }
+    if (!E->Ty->isScalar()) {
+      fail(E->Loc, E->Ty->isVoid()
+                       ? "A void value is used."
+                       : format("An array of type '{}' is used as a value.",
+                                E->Ty->str()));
+    }
+    return E;
+  }
+
+  // Converts the scalar `E` to `T`, folding constants.
+  Expr *convert(Expr *E, const Type *T) {
+    if (E->Ty == T) {
+      return E;
+    }
+    if (auto *I = dyn_cast<IntConst>(E)) {
+      return make<FloatConst>(T, float(I->Value), E->Loc);
+    }
+    if (auto *F = dyn_cast<FloatConst>(E)) {
+      ast::ConstValue V = ast::ConstValue::ofFloat(F->Value);
+      return make<IntConst>(T, V.asInt(), E->Loc);
+    }
+    return make<UnaryExpr>(ExprKind::Convert, T, E, E->Loc);
+  }
+
+  // Pops two scalar operands and converts them to their common type.
+  pair<Expr *, Expr *> arithmetic() {
+    Expr *R = scalar(pop()), *L = scalar(pop());
+    if (L->Ty != R->Ty) {
+      L = convert(L, Types.getFloat());
+      R = convert(R, Types.getFloat());
+    }
+    return {L, R};
+  }
+
+  // Expressions.
+  void leaveIntegerExpr(ast::IntegerExpr *E) {
+    Exprs.push_back(make<IntConst>(Types.getInt(), E->Value, E->Loc));
+  }
+  void leaveFloatExpr(ast::FloatExpr *E) {
+    Exprs.push_back(make<FloatConst>(Types.getFloat(), E->Value, E->Loc));
+  }
+  void leaveVariableExpr(ast::VariableExpr *E) {
+    Exprs.push_back(make<VarRef>(Vars.at(E->Decl.Ptr), E->Loc));
+  }
+  void leaveNegateExpr(ast::NegateExpr *E) {
+    Expr *X = scalar(pop());
+    if (auto *I = dyn_cast<IntConst>(X)) {
+      int32_t V = int32_t(0u - uint32_t(I->Value));
+      Exprs.push_back(make<IntConst>(X->Ty, V, E->Loc));
+    } else if (auto *F = dyn_cast<FloatConst>(X)) {
+      Exprs.push_back(make<FloatConst>(X->Ty, -F->Value, E->Loc));
+    } else {
+      Exprs.push_back(make<UnaryExpr>(ExprKind::Unary, X->Ty, Op::Neg, X,
+                                      E->Loc));
+    }
+  }
+  void leaveNotExpr(ast::NotExpr *E) {
+    Expr *X = scalar(pop());
+    Exprs.push_back(make<UnaryExpr>(ExprKind::Unary, Types.getInt(), Op::Not,
+                                    X, E->Loc));
+  }
+  void leaveBinopExpr(ast::BinopExpr *E) {
+    auto [L, R] = arithmetic();
+    static constexpr Op Ops[] = {Op::Add, Op::Sub, Op::Mul, Op::Div, Op::Mod};
+    Op O = Ops[int(E->op)];
+    if (O == Op::Mod && L->Ty->isFloat()) {
+      fail(E->Loc, "'%' needs int operands.");
+    }
+    Exprs.push_back(
+        make<BinaryExpr>(ExprKind::Binary, L->Ty, O, L, R, E->Loc));
+  }
+  void leaveCmpExpr(ast::CmpExpr *E) {
+    auto [L, R] = arithmetic();
+    static constexpr Op Ops[] = {Op::Gt, Op::Ge, Op::Lt,
+                                 Op::Le, Op::Eq, Op::Ne};
+    Exprs.push_back(make<BinaryExpr>(ExprKind::Binary, Types.getInt(),
+                                     Ops[int(E->op)], L, R, E->Loc));
+  }
+  void leaveLogicalExpr(ast::LogicalExpr *E) {
+    Expr *R = scalar(pop()), *L = scalar(pop());
+    Op O = E->op == ast::LogicalOpKind::And ? Op::And : Op::Or;
+    Exprs.push_back(
+        make<BinaryExpr>(ExprKind::Logical, Types.getInt(), O, L, R, E->Loc));
+  }
+  void leaveIndexExpr(ast::IndexExpr *E) {
+    Expr *Idx = scalar(pop()), *Base = pop();
+    if (!Base->Ty->isArray() && !Base->Ty->isPointer()) {
+      fail(E->Loc, format("'{}' has too many subscripts.",
+                          E->BaseArrayName.str()));
+    }
+    if (!Idx->Ty->isInt()) {
+      fail(E->Index->Loc, "An array subscript is not an int.");
+    }
+    Exprs.push_back(make<Index>(Base->Ty->Elem, Base, Idx, E->Loc));
+  }
+  void leaveAssignExpr(ast::AssignExpr *E) {
+    Expr *Value = scalar(pop()), *Target = pop();
+    Expr *Root = Target;
+    while (auto *I = dyn_cast<Index>(Root)) {
+      Root = I->Base;
+    }
+    Var *V = cast<VarRef>(Root)->V;
+    if (V->IsConst) {
+      fail(E->Loc, format("'{}' is const.", V->Name.str()));
+    }
+    if (!Target->Ty->isScalar()) {
+      fail(E->Loc, format("An array of type '{}' is assigned to.",
+                          Target->Ty->str()));
+    }
+    Value = convert(Value, Target->Ty);
+    Exprs.push_back(make<Assign>(Target, Value, E->Loc));
+  }
+  void leaveFunctionCallExpr(ast::FunctionCallExpr *E) {
+    Function *F = function(E->Callee);
+    size_t N = E->RealParameters.size();
+    if (N != F->Params.size()) {
+      fail(E->Loc, format("'{}' takes {} arguments, not {}.", F->Name.str(),
+                          F->Params.size(), N));
+    }
+    Expr **Args = Exprs.data() + Exprs.size() - N;
+    for (size_t i = 0; i < N; ++i) {
+      Args[i] = argument(Args[i], F->Params[i]->Ty, F, i);
+    }
+    Span<Expr *> Copied = Nodes.Copy(Args, N);
+    Exprs.resize(Exprs.size() - N);
+    Exprs.push_back(make<Call>(F->RetTy, F, Copied, E->Loc));
+  }
+
+  // `A` passed for a parameter of type `T`.
+  Expr *argument(Expr *A, const Type *T, Function *F, size_t i) {
+    if (T->isScalar()) {
+      return convert(scalar(A), T);
+    }
+    // Arrays decay to a pointer to their first element; a pointer, which
+    // is an array parameter, is passed on as it is.
+    const Type *Passed = nullptr;
+    if (A->Ty->isArray()) {
+      Passed = Types.getPointer(A->Ty->Elem);
+      A = make<UnaryExpr>(ExprKind::Decay, Passed, A, A->Loc);
+    } else if (A->Ty->isPointer() && A->isLValue()) {
+      Passed = A->Ty;
+      A = make<UnaryExpr>(ExprKind::Load, Passed, A, A->Loc);
+    }
+    if (Passed != T) {
+      fail(A->Loc, format("Argument {} of '{}' is '{}', not '{}'.", i + 1,
+                          F->Name.str(), A->Ty->str(), T->str()));
+    }
+    return A;
+  }
+
+  // The Function of the definition or declaration `F`.
+  Function *function(const ast::Func *F) {
+    if (Function **Known = Funcs.find(F->function_name_)) {
+      return *Known;
+    }
+    Function *Fn = make<Function>();
+    Fn->Name = F->function_name_;
+    Fn->RetTy = returnType(F->return_type_);
+    Fn->Body = nullptr;
+    Fn->Loc = F->Loc;
+    Funcs.set(F->function_name_, Fn);
+    M.Functions.push_back(Fn);
+    Span<ast::Func> Runtime = ast::RuntimeFunctions();
+    if (F >= Runtime.begin() && F < Runtime.end()) {
+      // A runtime function, whose parameters are not visited. Its array
+      // parameters are one-dimensional.
+      static uint32_t Unsized[] = {0};
+      vector<Var *> Params;
+      for (const ast::Param &P : F->formal_paras_) {
+        Span<uint32_t> Shape(Unsized, P.dims_.size());
+        Params.push_back(param(P, Params.size(), Shape));
+      }
+      Fn->Params = copy(Params);
+    }
+    return Fn;
+  }
+
+  Var *param(const ast::Param &P, uint32_t Id, Span<uint32_t> Shape) {
+    const Type *T = scalarType(P.basetype_);
+    if (!Shape.empty()) {
+      T = Types.getPointer(arrayType(T, Shape, 1));
+    }
+    return make<Var>(Var{P.paraname_, T, Var::Storage::Param, false, Id,
+                         nullptr, P.Loc});
+  }
+  // Statements.
+  void leaveExprStmt(ast::ExprStmt *S) {
+    Stmts.push_back(make<ExprStmt>(pop(), S->Loc));
+  }
+  void leaveIfStmt(ast::IfStmt *S) {
+    Stmt *Else = S->ElseBranch ? popStmt() : nullptr;
+    Stmt *Then = S->IfBranch ? popStmt() : nullptr;
+    Expr *Cond = scalar(pop());
+    Stmts.push_back(make<If>(Cond, body(Then, S->Loc), Else, S->Loc));
+  }
+  // Before the body, so break and continue find their loop.
+  void beforeWhileStmt(ast::WhileStmt *S, unsigned i, ast::NodeRef) {
+    if (i == 1) {
+      Loops.push_back(make<While>(scalar(pop()), S->Loc));
+    }
+  }
+  void leaveWhileStmt(ast::WhileStmt *S) {
+    While *W = Loops.back();
+    Loops.pop_back();
+    W->Body = body(S->LoopBody ? popStmt() : nullptr, S->Loc);
+    Stmts.push_back(W);
+  }
+  Stmt *body(Stmt *S, SourceLoc Loc) {
+    return S != nullptr ? S : make<Block>(Span<Stmt *>(), Loc);
+  }
+  void leaveBreakStmt(ast::BreakStmt *S) { jump(StmtKind::Break, S->Loc); }
+  void leaveContinueStmt(ast::ContinueStmt *S) {
+    jump(StmtKind::Continue, S->Loc);
+  }
+  void jump(StmtKind Kind, SourceLoc Loc) {
+    if (Loops.empty()) {
+      fail(Loc, format("'{}' is not in a loop.",
+                       Kind == StmtKind::Break ? "break" : "continue"));
+    }
+    Stmts.push_back(make<Jump>(Kind, Loops.back(), Loc));
+  }
+  void leaveReturnStmt(ast::ReturnStmt *S) {
+    const Type *T = Current->RetTy;
+    Expr *Value = nullptr;
+    if (S->ReturnExpr != nullptr) {
+      if (T->isVoid()) {
+        fail(S->Loc, format("'{}' returns void.", Current->Name.str()));
+      }
+      Value = convert(scalar(pop()), T);
+    } else if (!T->isVoid()) {
+      fail(S->Loc, format("'{}' must return a value.", Current->Name.str()));
+    }
+    Stmts.push_back(make<Return>(Value, S->Loc));
+  }
+  void enterBlockStmt(ast::BlockStmt *) { Blocks.push_back(Stmts.size()); }
+  void leaveBlockStmt(ast::BlockStmt *S) {
+    size_t Mark = Blocks.back(), Size = 0;
+    Blocks.pop_back();
+    for (size_t i = Mark; i < Stmts.size(); ++i) {
+      if (Stmts[i] != nullptr) {
+        Stmts[Mark + Size++] = Stmts[i];
+      }
+    }
+    Span<Stmt *> Body = Nodes.Copy(Stmts.data() + Mark, Size);
+    Stmts.resize(Mark);
+    Stmts.push_back(make<Block>(Body, S->Loc));
+  }
+
+  // Declarations. The Var exists before the initializer, which may refer
+  // to it.
+  void enterDeclStmt(ast::DeclStmt *D) {
+    const ast::DeclLayout &L = Consts.layout(D);
+    bool Global = Current == nullptr;
+    uint32_t Id = Global ? M.Globals.size() : Locals.size();
+    Var *V = make<Var>(Var{D->VarName,
+                           arrayType(scalarType(D->basetype_), L.Shape, 0),
+                           Global ? Var::Storage::Global : Var::Storage::Local,
+                           D->isConst, Id, nullptr, D->Loc});
+    Vars[static_cast<ast::Stmt *>(D)] = V;
+    (Global ? M.Globals : Locals).push_back(V);
+    InitValues.clear();
+  }
+  // The dims were evaluated already.
+  void afterDeclStmt(ast::DeclStmt *D, unsigned i, ast::NodeRef) {
+    if (i < D->Dims.size()) {
+      pop();
+    }
+  }
+  void leaveInitVals(ast::InitVals *IV) {
+    if (IV->val != nullptr) {
+      InitValues.push_back({IV->val, pop()});
+    }
+  }
+  void leaveDeclStmt(ast::DeclStmt *D) {
+    Var *V = Vars.at(static_cast<ast::Stmt *>(D));
+    const ast::ArrayInit *Layout = Consts.layout(D).Init;
+    if (Layout == nullptr) {
+      Stmts.push_back(nullptr);
+      return;
+    }
+    Initializer *Init = make<Initializer>();
+    Init->NumElements = Layout->NumElements;
+    Init->Runs = Nodes.Copy(Layout->Runs.Data, Layout->Runs.size());
+    Init->Ints = Nodes.Copy(Layout->Ints.Data, Layout->Ints.size());
+    Init->Floats = Nodes.Copy(Layout->Floats.Data, Layout->Floats.size());
+    // The elements left to run time are among InitValues, in order.
+    vector<Initializer::Element> Elements;
+    const Type *Elem = V->Ty->base();
+    size_t j = 0;
+    for (const ast::ArrayInit::Element &E : Layout->Exprs) {
+      while (InitValues[j].first != E.Value) {
+        j++;
+      }
+      Expr *Value = convert(scalar(InitValues[j++].second), Elem);
+      Elements.push_back({E.Index, Value});
+    }
+    Init->Exprs = copy(Elements);
+    V->Init = Init;
+    Stmts.push_back(Current ? make<InitStmt>(V, D->Loc) : nullptr);
+  }
+
+  // Functions.
+  void enterFunc(ast::Func *F) {
+    Redeclared = Funcs.find(F->function_name_) != nullptr;
+    Current = function(F);
+    Locals.clear();
+    if (Redeclared && Current->RetTy != returnType(F->return_type_)) {
+      conflict(F);
+    }
+  }
+  void conflict(ast::Func *F) {
+    fail(F->Loc, format("'{}' was declared with other types.",
+                        F->function_name_.str()));
+  }
+  void afterParam(ast::Param *, unsigned, ast::NodeRef C) {
+    if (!C.isNull()) {
+      pop();
+    }
+  }
+  void leaveParam(ast::Param *P) {
+    Var *V = param(*P, Locals.size(), Consts.shape(P));
+    Vars[P] = V;
+    Locals.push_back(V);
+  }
+  // Before the body: the params are the Vars so far. A declaration after
+  // the definition keeps the definition's.
+  void beforeFunc(ast::Func *F, unsigned i, ast::NodeRef) {
+    if (i != F->formal_paras_.size()) {
+      return;
+    }
+    if (Redeclared) {
+      bool Same = Current->Params.size() == Locals.size();
+      for (size_t j = 0; Same && j < Locals.size(); ++j) {
+        Same = Current->Params[j]->Ty == Locals[j]->Ty;
+      }
+      if (!Same) {
+        conflict(F);
+      }
+    }
+    if (F->body_ != nullptr || Current->Body == nullptr) {
+      Current->Params = copy(Locals);
+    }
+  }
+  void leaveFunc(ast::Func *F) {
+    if (F->body_ != nullptr) {
+      Current->Body = cast<Block>(popStmt());
+      Current->Loc = F->Loc;
+      size_t NumParams = Current->Params.size();
+      Current->Locals = copy(Locals, NumParams);
+    }
+    Current = nullptr;
+  }
+};
+} // namespace
+
+Module LowerToHIR(ast::Program &P, const ast::ConstEvaluator &Consts,
+                  const SourceManager &SM) {
+  Module M;
+  Lowering L(M, Consts, SM);
+  L.traverse(P);
+  return M;
+}
+
+} // namespace hir
@@ -0,0 +1,99 @@
+#include "jit.hpp"
+#include "backend.hpp"
+#include "sylib.h"
+#include <cstdio>
+#include <format>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+
+using namespace std;
+namespace orc = llvm::orc;
+
+namespace {
+// The value of `E`, or a thrown message saying what went wrong.
+template <typename T> T check(llvm::Expected<T> E, const char *What) {
+  if (!E) {
+    throw format("{}: {}", What, llvm::toString(E.takeError()));
+  }
+  return std::move(*E);
+}
+void check(llvm::Error E, const char *What) {
+  if (E) {
+    throw format("{}: {}", What, llvm::toString(std::move(E)));
+  }
+}
+
+// The host implementation of every runtime function.
+orc::SymbolMap RuntimeSymbols(orc::LLLazyJIT &J) {
+  struct Binding {
+    const char *Name;
+    void *Address;
+  };
+  const Binding Bindings[] = {
+      {"getint", (void *)&getint},       {"getch", (void *)&getch},
+      {"getfloat", (void *)&getfloat},   {"getarray", (void *)&getarray},
+      {"getfarray", (void *)&getfarray}, {"input", (void *)&input},
+      {"putint", (void *)&putint},       {"putch", (void *)&putch},
+      {"putfloat", (void *)&putfloat},   {"putarray", (void *)&putarray},
+      {"putfarray", (void *)&putfarray}, {"starttime", (void *)&starttime},
+      {"stoptime", (void *)&stoptime},
+  };
+  orc::SymbolMap Symbols;
+  auto Flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+  for (const Binding &B : Bindings) {
+#if LLVM_VERSION_MAJOR >= 17
+    Symbols[J.mangleAndIntern(B.Name)] = {
+        orc::ExecutorAddr::fromPtr(B.Address), Flags};
+#else
+    Symbols[J.mangleAndIntern(B.Name)] = llvm::JITEvaluatedSymbol(
+        llvm::pointerToJITTargetAddress(B.Address), Flags);
+#endif
+  }
+  return Symbols;
+}
+} // namespace
+
+int RunJIT(unique_ptr<llvm::LLVMContext> Ctx, unique_ptr<llvm::Module> IR,
+           unsigned Level) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  auto JTMB = check(orc::JITTargetMachineBuilder::detectHost(),
+                    "Cannot target the host");
+  // The whole module is optimized up front, so inlining and the other
+  // interprocedural passes still see every function; only the machine
+  // code is left until a function is called.
+  auto TM = check(JTMB.createTargetMachine(), "Cannot target the host");
+  OptimizeModule(*IR, *TM, Level);
+
+  auto J = check(orc::LLLazyJITBuilder()
+                     .setJITTargetMachineBuilder(std::move(JTMB))
+                     .create(),
+                 "Cannot start the JIT");
+  J->setPartitionFunction(orc::CompileOnDemandLayer::compileRequested);
+  orc::JITDylib &Main = J->getMainJITDylib();
+  check(Main.define(orc::absoluteSymbols(RuntimeSymbols(*J))),
+        "Cannot bind the runtime");
+  // memset and memcpy, which LLVM may call, come from the host's libc.
+  Main.addGenerator(check(
+      orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          J->getDataLayout().getGlobalPrefix()),
+      "Cannot search the host"));
+  check(J->addLazyIRModule(
+            orc::ThreadSafeModule(std::move(IR), std::move(Ctx))),
+        "Cannot add the program");
+
+  auto Symbol = check(J->lookup("main"), "Cannot find main");
+#if LLVM_VERSION_MAJOR >= 15
+  auto *Entry = Symbol.toPtr<int (*)()>();
+#else
+  auto *Entry = llvm::jitTargetAddressToPointer<int (*)()>(Symbol.getAddress());
+#endif
+  int Result = Entry();
+  fflush(stdout);
+  return Result;
+}
@@ -1,28 +1,199 @@
 #include "lexer.hpp"
+#include "literal.hpp"
+#include "symbol.hpp"
 #include "token.hpp"
-#include <cmath>
+#include <array>
+#include <bit>
 #include <cstdio>
 #include <format>
 
-bool isalpha(char c) {
-  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Character classes of the scanning core. Every byte is classified by a
+// single table load instead of a chain of comparisons.
+enum CharClass : uint8_t {
+  CC_Space = 1,   // ' ', '\t', '\r', '\v', '\f'
+  CC_Newline = 2, // '\n'
+  CC_Alpha = 4,   // [A-Za-z_]
+  CC_Digit = 8,   // [0-9]
+};
+
+constexpr array<uint8_t, 256> MakeCharClassTable() {
+  array<uint8_t, 256> Table{};
+  for (int c = 'a'; c <= 'z'; ++c)
+    Table[c] = CC_Alpha;
+  for (int c = 'A'; c <= 'Z'; ++c)
+    Table[c] = CC_Alpha;
+  for (int c = '0'; c <= '9'; ++c)
+    Table[c] = CC_Digit;
+  Table['_'] = CC_Alpha;
+  Table[' '] = Table['\t'] = Table['\r'] = Table['\v'] = Table['\f'] =
+      CC_Space;
+  Table['\n'] = CC_Newline;
+  return Table;
+}
+static constexpr array<uint8_t, 256> CharClasses = MakeCharClassTable();
+
+static inline bool hasClass(char c, uint8_t cc) {
+  return CharClasses[static_cast<uint8_t>(c)] & cc;
 }
-bool isdigit(char c) { return '0' <= c && c <= '9'; }
-bool check(Lexer &lexer, const char *Content, int length) {
-  string &src = lexer.src;
-  if (length != lexer.CurrentPosition - lexer.BeginingPosition) {
-    return false;
+static inline bool isalpha(char c) { return hasClass(c, CC_Alpha); }
+static inline bool isdigit(char c) { return hasClass(c, CC_Digit); }
+
+// A block of source bytes compared in parallel. Each query returns a bitmask
+// with bit i set when byte i of the block satisfies it.
+#if defined(__AVX2__)
+struct Block {
+  static constexpr int Size = 32;
+  static constexpr uint32_t Full = 0xFFFFFFFFu;
+  __m256i v;
+
+  explicit Block(const char *p)
+      : v(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))) {}
+  uint32_t eq(char c) const {
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+  }
+  // Bytes >= 0x80 compare as negative and therefore never fall in range.
+  static uint32_t inRange(__m256i x, char lo, char hi) {
+    __m256i ge = _mm256_cmpgt_epi8(x, _mm256_set1_epi8(lo - 1));
+    __m256i le = _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), x);
+    return _mm256_movemask_epi8(_mm256_and_si256(ge, le));
+  }
+  uint32_t ident() const {
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    return inRange(lower, 'a', 'z') | inRange(v, '0', '9') | eq('_');
   }
-  for (int i = 0; i < length; ++i) {
-    if (src[lexer.BeginingPosition + i] != Content[i]) {
-      return false;
+};
+#elif defined(__SSE2__)
+struct Block {
+  static constexpr int Size = 16;
+  static constexpr uint32_t Full = 0xFFFFu;
+  __m128i v;
+
+  explicit Block(const char *p)
+      : v(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) {}
+  uint32_t eq(char c) const {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+  }
+  static uint32_t inRange(__m128i x, char lo, char hi) {
+    __m128i ge = _mm_cmpgt_epi8(x, _mm_set1_epi8(lo - 1));
+    __m128i le = _mm_cmplt_epi8(x, _mm_set1_epi8(hi + 1));
+    return _mm_movemask_epi8(_mm_and_si128(ge, le));
+  }
+  uint32_t ident() const {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return inRange(lower, 'a', 'z') | inRange(v, '0', '9') | eq('_');
+  }
+};
+#else
+// Portable fallback, written so the compiler can still vectorize the loops.
+struct Block {
+  static constexpr int Size = 16;
+  static constexpr uint32_t Full = 0xFFFFu;
+  const char *p;
+
+  explicit Block(const char *p) : p(p) {}
+  uint32_t eq(char c) const {
+    uint32_t m = 0;
+    for (int i = 0; i < Size; ++i)
+      m |= uint32_t(p[i] == c) << i;
+    return m;
+  }
+  uint32_t ident() const {
+    uint32_t m = 0;
+    for (int i = 0; i < Size; ++i)
+      m |= uint32_t(hasClass(p[i], CC_Alpha | CC_Digit)) << i;
+    return m;
+  }
+};
+#endif
+static_assert(static_cast<int>(TokenType::KW_void) -
+                      static_cast<int>(TokenType::KW_break) + 1 ==
+                  Interner::NumKeywords,
+              "keyword tokens must match the pre-interned keywords");
+static_assert(SourcePadding >= Block::Size,
+              "the sentinel padding must cover one full block");
+
+static inline uint32_t below(int n) { return (uint64_t(1) << n) - 1; }
+
+// Skips blanks and newlines, counting the latter into `Lines`.
+static const char *ScanBlanks(const char *p, uint32_t &Lines) {
+  while (true) {
+    Block b(p);
+    uint32_t nl = b.eq('\n');
+    uint32_t blank = nl | b.eq(' ') | b.eq('\t') | b.eq('\r');
+    uint32_t stop = ~blank & Block::Full;
+    if (stop == 0) {
+      Lines += popcount(nl);
+      p += Block::Size;
+      continue;
+    }
+    int n = countr_zero(stop);
+    Lines += popcount(nl & below(n));
+    p += n;
+    if (hasClass(*p, CC_Space)) { // '\v' and '\f' are rare enough.
+      ++p;
+      continue;
+    }
+    return p;
+  }
+}
+
+// Returns the position of the newline (or sentinel) ending a `//` comment.
+static const char *ScanLineComment(const char *p) {
+  while (true) {
+    Block b(p);
+    uint32_t stop = b.eq('\n') | b.eq('\0');
+    if (stop != 0)
+      return p + countr_zero(stop);
+    p += Block::Size;
+  }
+}
+
+// Returns the position after the closing `*/`, or nullptr if the comment
+// runs into the end of input.
+static const char *ScanBlockComment(const char *p, uint32_t &Lines) {
+  while (true) {
+    Block b(p);
+    uint32_t nl = b.eq('\n');
+    uint32_t stop = b.eq('*') | b.eq('\0');
+    if (stop == 0) {
+      Lines += popcount(nl);
+      p += Block::Size;
+      continue;
     }
+    int n = countr_zero(stop);
+    Lines += popcount(nl & below(n));
+    p += n;
+    if (*p == '\0')
+      return nullptr;
+    if (p[1] == '/')
+      return p + 2;
+    ++p;
   }
-  return true;
 }
+
+// Returns the position after a run of [A-Za-z0-9_].
+static const char *ScanIdentifier(const char *p) {
+  while (true) {
+    uint32_t stop = ~Block(p).ident() & Block::Full;
+    if (stop != 0)
+      return p + countr_zero(stop);
+    p += Block::Size;
+  }
+}
+
 Token Lexer::NextToken() {
   SkipWhitespaces();
+  Token Result = LexToken();
+  Result.Loc = File.getLoc(BeginingPosition);
+  Result.Length = CurrentPosition - BeginingPosition;
+  return Result;
+}
 
+Token Lexer::LexToken() {
   BeginingPosition = CurrentPosition;
   char head = next();
 
@@ -92,117 +263,56 @@ Token Lexer::NextToken() {
     throw format("Expect '|'.");
   }
 
-  case EOF:
+  case '\0':
+    if (BeginingPosition < src.size()) {
+      throw format("Unexpected '\\0' at line {}.", LineNo);
+    }
+    CurrentPosition = BeginingPosition;
     return SimpleToken(TokenType::Eof);
   default:
     break;
   }
   if (head == '"') {
-    while (peek(0) != '"') {
-      next();
+    while (peek(0) != '"' && peek(0) != '\0') {
+      if (next() == '\n')
+        LineNo++;
     }
-    next();
-    return StringToken(src.substr(BeginingPosition + 1,
-                                  CurrentPosition - BeginingPosition - 2));
+    if (!match('"')) {
+      throw format("Unterminated string at line {}.", LineNo);
+    }
+    return SimpleToken(TokenType::String);
   }
   if (isalpha(head)) { // Keywords or identifier.
-    while (isalpha(peek(0)) || isdigit(peek(0)))
-      next();
+    CurrentPosition = ScanIdentifier(src.data() + CurrentPosition) - src.data();
 
-    switch (head) {
-    case 'b': {
-      if (check(*this, "break", 5)) {
-        return SimpleToken(TokenType::KW_break);
-      }
-    } break;
-    case 'c': {
-      if (check(*this, "const", 5)) {
-        return SimpleToken(TokenType::KW_const);
-      }
-      if (check(*this, "continue", 8)) {
-        return SimpleToken(TokenType::KW_continue);
-      }
-    } break;
-    case 'e': {
-      if (check(*this, "else", 4)) {
-        return SimpleToken(TokenType::KW_else);
-      }
-    } break;
-    case 'f': {
-      if (check(*this, "float", 5)) {
-        return SimpleToken(TokenType::KW_float);
-      }
-    } break;
-    case 'i': {
-      if (check(*this, "int", 3)) {
-        return SimpleToken(TokenType::KW_int);
-      }
-      if (check(*this, "if", 2)) {
-        return SimpleToken(TokenType::KW_if);
-      }
-    } break;
-    case 'r': {
-      if (check(*this, "return", 6)) {
-        return SimpleToken(TokenType::KW_return);
-      }
-    } break;
-    case 'v': {
-      if (check(*this, "void", 4)) {
-        return SimpleToken(TokenType::KW_void);
-      }
-    } break;
-    case 'w': {
-      if (check(*this, "while", 5)) {
-        return SimpleToken(TokenType::KW_while);
-      }
-    } break;
+    // Keywords are pre-interned with the lowest ids.
+    Symbol S = Interner::global().intern(string_view(
+        src.data() + BeginingPosition, CurrentPosition - BeginingPosition));
+    if (S.Id < Interner::NumKeywords) {
+      return SimpleToken(
+          TokenType(static_cast<uint8_t>(TokenType::KW_break) + S.Id));
     }
-    return IdentifierToken(
-        src.substr(BeginingPosition, CurrentPosition - BeginingPosition));
+    return IdentifierToken(S);
   }
 
-  if (isdigit(head)) {
-    int Result = head - '0';
-    while (isdigit(peek(0))) {
-      char d = next();
-      Result = 10 * Result + (d - '0');
+  if (isdigit(head) || (head == '.' && isdigit(peek(0)))) {
+    NumericLiteral L = ScanNumber(src.data() + BeginingPosition);
+    CurrentPosition = L.End - src.data();
+    if (L.Error != nullptr) {
+      throw format("{} at line {}.", L.Error, LineNo);
     }
-    float fs = Result;
-    if (match('.')) {
-      float frac = 0.1;
-      while (isdigit(peek(0))) {
-        char d = next();
-        fs += frac * (d - '0');
-        frac *= 0.1;
-      }
-      if (peek(0) != 'e') {
-        return FloatToken(fs);
-      }
-    }
-    if (match('e')) {
-      int exp10 = 0, neg = 1;
-      if (match('-'))
-        neg = -1;
-      while (isdigit(peek(0))) {
-        char d = next();
-        exp10 = 10 * exp10 + (d - '0');
-      }
-      return FloatToken(fs * exp(log(10) * neg * exp10));
+    if (L.isFloat) {
+      return FloatToken(L.FloatValue);
     }
-    return IntegerToken(Result);
+    return IntegerToken(L.IntValue);
   }
 
-  return SimpleToken(TokenType::Eof);
+  throw format("Unexpected character '{}' at line {}.", head, LineNo);
 }
 
-char Lexer::peek(int step) {
-  if (CurrentPosition + step >= src.size()) {
-    return EOF;
-  }
-  return src[CurrentPosition + step];
-}
+char Lexer::peek(int step) { return src.data()[CurrentPosition + step]; }
 bool Lexer::match(char c) {
-  if (src[CurrentPosition] == c) {
+  if (src.data()[CurrentPosition] == c) {
     CurrentPosition++;
     return true;
   }
@@ -214,16 +324,26 @@ char Lexer::next() {
   return Result;
 }
 
+// Skips whitespace, `//` and `/* */` comments.
 void Lexer::SkipWhitespaces() {
+  const char *Base = src.data();
+  const char *p = Base + CurrentPosition;
   while (true) {
-    switch (peek(0)) {
-    case '\n':
-      LineNo++;
-    case '\t':
-    case ' ':
-      CurrentPosition++;
-      continue;
+    p = ScanBlanks(p, LineNo);
+    if (p[0] != '/') {
+      break;
+    }
+    if (p[1] == '/') {
+      p = ScanLineComment(p + 2);
+    } else if (p[1] == '*') {
+      uint32_t Line = LineNo;
+      p = ScanBlockComment(p + 2, LineNo);
+      if (p == nullptr) {
+        throw format("Unterminated comment starting at line {}.", Line);
+      }
+    } else {
+      break;
     }
-    break;
   }
-}
\ No newline at end of file
+  CurrentPosition = p - Base;
+}
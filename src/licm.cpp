@@ -0,0 +1,151 @@
+#include "loops.hpp"
+#include "passes.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace ssa {
+
+namespace {
+// Whether two pointer roots may be the same memory: allocas and globals
+// are distinct objects, while an argument may be any global.
+bool mayAlias(Value *A, Value *B) {
+  if (A == B) {
+    return true;
+  }
+  auto Object = [](Value *V) {
+    return V->Op == Opcode::Alloca || V->Op == Opcode::GlobalAddr;
+  };
+  auto Known = [&](Value *V) {
+    return Object(V) || V->Op == Opcode::Argument;
+  };
+  if (!Known(A) || !Known(B)) {
+    return true;
+  }
+  if (A->Op == Opcode::Alloca || B->Op == Opcode::Alloca) {
+    return false;
+  }
+  return !(Object(A) && Object(B));
+}
+
+struct LICMPass {
+  Function &F;
+  DomTree DT;
+  LoopInfo LI;
+  vector<bool> Escapes; // allocas whose address a call sees, by Value::Id
+  bool Changed = false;
+
+  explicit LICMPass(Function &F)
+      : F(F), DT(F), LI(F, DT), Escapes(F.NumValues) {
+    for (Block *B : F.Blocks) {
+      for (Instr *I : *B) {
+        for (uint32_t i = 0; I->Op == Opcode::Call && i < I->NumOps; ++i) {
+          Value *R = PointerRoot(I->operand(i));
+          if (R->Op == Opcode::Alloca) {
+            Escapes[R->Id] = true;
+          }
+        }
+      }
+    }
+  }
+
+  bool outside(const Loop &L, Value *V) {
+    auto *I = dyn_cast<Instr>(V);
+    return I == nullptr || !LI.contains(&L, I->Parent);
+  }
+
+  // Hoists what `L` computes the same way on every iteration into its
+  // preheader. Loads move only if nothing in the loop may write their
+  // memory and they run whenever the loop does, so no load moves onto a
+  // path that did not have it.
+  void hoist(Loop &L) {
+    Block *Pre = LI.preheader(L);
+    if (Pre == nullptr) {
+      return;
+    }
+    vector<Value *> Written; // the roots of stores in the loop
+    bool Calls = false;
+    vector<Block *> Exiting;
+    for (Block *B : L.Blocks) {
+      for (Instr *I : *B) {
+        if (I->Op == Opcode::Store) {
+          Written.push_back(PointerRoot(I->operand(1)));
+        } else if (I->Op == Opcode::Zero) {
+          Written.push_back(PointerRoot(I->operand(0)));
+        } else if (I->Op == Opcode::Call) {
+          Calls |= cast<CallInstr>(I)->Callee->WritesMemory;
+        }
+      }
+      Instr *T = B->terminator();
+      for (unsigned i = 0; i < T->numSuccessors(); ++i) {
+        if (!LI.contains(&L, T->successor(i))) {
+          Exiting.push_back(B);
+          break;
+        }
+      }
+    }
+    auto Invariant = [&](Instr *I) {
+      for (uint32_t i = 0; i < I->NumOps; ++i) {
+        if (!outside(L, I->operand(i))) {
+          return false;
+        }
+      }
+      return true;
+    };
+    auto Safe = [&](Instr *I) {
+      switch (I->Op) {
+      case Opcode::SDiv:
+      case Opcode::SRem: {
+        auto *C = dyn_cast<ConstInt>(I->operand(1));
+        return C != nullptr && C->V != 0 && C->V != -1;
+      }
+      case Opcode::Load: {
+        if (Exiting.empty()) {
+          return false;
+        }
+        for (Block *E : Exiting) {
+          if (!DT.dominates(I->Parent, E)) {
+            return false;
+          }
+        }
+        Value *R = PointerRoot(I->operand(0));
+        if (Calls && !(R->Op == Opcode::Alloca && !Escapes[R->Id])) {
+          return false;
+        }
+        return none_of(Written.begin(), Written.end(),
+                       [&](Value *W) { return mayAlias(W, R); });
+      }
+      default:
+        return (I->Op >= Opcode::Add && I->Op <= Opcode::FPToSI) ||
+               I->Op == Opcode::PtrAdd;
+      }
+    };
+    // In dominator order, so operands move before their users.
+    Instr *Before = Pre->terminator();
+    for (Block *B : DT.RPO) {
+      if (!LI.contains(&L, B)) {
+        continue;
+      }
+      for (Instr *I : *B) {
+        if (Safe(I) && Invariant(I)) {
+          B->unlink(I);
+          Pre->insert(I, Before);
+          Changed = true;
+        }
+      }
+    }
+  }
+};
+} // namespace
+
+bool LICM(Function &F) {
+  bool Changed = NormalizeLoops(F);
+  LICMPass P(F);
+  // Inner loops first, so what leaves one can go on leaving the next.
+  for (auto &L : P.LI.Loops) {
+    P.hoist(*L);
+  }
+  return P.Changed || Changed;
+}
+
+} // namespace ssa
@@ -0,0 +1,231 @@
+#include "literal.hpp"
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static bool isDigit(char c) { return static_cast<unsigned>(c - '0') < 10; }
+static bool isHexDigit(char c) {
+  return isDigit(c) || ('a' <= c && c <= 'f') || ('A' <= c && c <= 'F');
+}
+static bool isIdentChar(char c) {
+  return isDigit(c) || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ||
+         c == '_' || c == '.';
+}
+static int HexValue(char c) {
+  if (c <= '9')
+    return c - '0';
+  return (c | 0x20) - 'a' + 10;
+}
+
+static NumericLiteral Fail(const char *End, const char *Error) {
+  NumericLiteral Result;
+  Result.isFloat = false;
+  Result.End = End;
+  Result.Error = Error;
+  Result.IntValue = 0;
+  return Result;
+}
+
+static NumericLiteral Int(const char *End, uint64_t Value, uint64_t Limit) {
+  if (isIdentChar(*End)) {
+    return Fail(End, "Invalid suffix on integer literal");
+  }
+  if (Value > Limit) {
+    return Fail(End, "Integer literal is too large");
+  }
+  NumericLiteral Result;
+  Result.isFloat = false;
+  Result.End = End;
+  Result.Error = nullptr;
+  Result.IntValue = static_cast<int>(static_cast<uint32_t>(Value));
+  return Result;
+}
+
+// Converts [Begin, End), a validated decimal or hexadecimal (without the
+// `0x`) float, with correct rounding. Only overflow fails: a literal too
+// small for a float is 0 or a subnormal, as in C.
+static bool ConvertFloat(const char *Begin, const char *End, bool Hex,
+                         float &Value) {
+#if defined(__cpp_lib_to_chars)
+  auto Format = Hex ? std::chars_format::hex : std::chars_format::general;
+  auto [Stop, Ec] = std::from_chars(Begin, End, Value, Format);
+  if (Ec != std::errc::result_out_of_range) {
+    return Ec == std::errc() && Stop == End;
+  }
+  // from_chars leaves Value alone on a range error, for underflow too.
+#endif
+  // strtof is correctly rounded as well, and stops exactly at End because
+  // the literal has already been validated. It needs the `0x` back.
+  char *Ptr;
+  errno = 0;
+  Value = strtof(Hex ? Begin - 2 : Begin, &Ptr);
+  return Ptr == End && !(errno == ERANGE && std::isinf(Value));
+}
+
+static NumericLiteral Float(const char *Begin, const char *End, bool Hex) {
+  if (isIdentChar(*End)) {
+    return Fail(End, "Invalid suffix on floating literal");
+  }
+  NumericLiteral Result;
+  Result.isFloat = true;
+  Result.End = End;
+  Result.Error = nullptr;
+  if (!ConvertFloat(Begin, End, Hex, Result.FloatValue)) {
+    return Fail(End, "Floating literal is out of range");
+  }
+  return Result;
+}
+
+// Powers of ten that are exact doubles.
+static const double Pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                               1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                               1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Clinger's fast path, evaluated in double: Mantissa and 10^|Exp10| are
+// exact doubles, so one multiplication or division gives the correctly
+// rounded double. Rounding that to float is correct too, unless the double
+// landed exactly halfway between two floats; that case, and anything
+// outside the exact range, is left to the slow path.
+static bool FastPath(uint64_t Mantissa, int Exp10, float &Value) {
+  if (Mantissa >= (uint64_t(1) << 53) || Exp10 < -22 || Exp10 > 22) {
+    return false;
+  }
+  double m = static_cast<double>(Mantissa);
+  double d = Exp10 < 0 ? m / Pow10[-Exp10] : m * Pow10[Exp10];
+  // d >= 1e-22 is far from the float subnormals, so a float keeps the top
+  // 24 of its 53 significand bits and the 29 dropped bits are exactly
+  // 1000...0 at a halfway point.
+  uint64_t Bits;
+  memcpy(&Bits, &d, sizeof(d));
+  if ((Bits & ((uint64_t(1) << 29) - 1)) == (uint64_t(1) << 28)) {
+    return false;
+  }
+  float f = static_cast<float>(d);
+  if (std::isinf(f)) {
+    return false;
+  }
+  Value = f;
+  return true;
+}
+
+// Hexadecimal literals, after the `0x`.
+static NumericLiteral ScanHex(const char *Begin) {
+  const char *p = Begin;
+  uint64_t Value = 0;
+  while (isHexDigit(*p)) {
+    Value = (Value << 4) | HexValue(*p++);
+    if (Value > UINT32_MAX) {
+      Value = UINT64_MAX >> 4; // saturate, reported as too large
+    }
+  }
+  bool Digits = p != Begin;
+  if (*p != '.' && *p != 'p' && *p != 'P') {
+    if (!Digits) {
+      return Fail(p, "Expect hexadecimal digits after '0x'");
+    }
+    return Int(p, Value, UINT32_MAX);
+  }
+  if (*p == '.') {
+    ++p;
+    while (isHexDigit(*p))
+      ++p;
+    Digits |= isHexDigit(p[-1]);
+  }
+  if (!Digits) {
+    return Fail(p, "Expect hexadecimal digits after '0x'");
+  }
+  if (*p != 'p' && *p != 'P') {
+    return Fail(p, "Hexadecimal floating literal requires an exponent");
+  }
+  ++p;
+  if (*p == '+' || *p == '-')
+    ++p;
+  if (!isDigit(*p)) {
+    return Fail(p, "Expect digits in exponent");
+  }
+  while (isDigit(*p))
+    ++p;
+  return Float(Begin, p, true);
+}
+
+NumericLiteral ScanNumber(const char *Begin) {
+  const char *p = Begin;
+  if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+    return ScanHex(p + 2);
+  }
+
+  // Integer part. Leading zeros are skipped so that `Digits` counts
+  // significant digits; with at most 19 of them Mantissa is exact.
+  bool Octal = *p == '0';
+  while (*p == '0')
+    ++p;
+  const char *Significant = p;
+  uint64_t Mantissa = 0;
+  for (; isDigit(*p); ++p) {
+    Mantissa = Mantissa * 10 + (*p - '0');
+  }
+  int Digits = p - Significant;
+
+  if (*p != '.' && *p != 'e' && *p != 'E') {
+    if (Octal) {
+      uint64_t Value = 0;
+      for (const char *q = Significant; q != p; ++q) {
+        if (*q >= '8') {
+          return Fail(p, "Invalid digit in octal literal");
+        }
+        Value = (Value << 3) | (*q - '0');
+        if (Value > UINT32_MAX) {
+          Value = UINT64_MAX >> 3; // saturate, reported as too large
+        }
+      }
+      return Int(p, Value, UINT32_MAX);
+    }
+    return Int(p, Digits > 10 ? UINT64_MAX : Mantissa, 2147483648u);
+  }
+
+  // Decimal float, tracked as Mantissa * 10^Exp10 for the fast path.
+  int Exp10 = 0;
+  if (*p == '.') {
+    const char *Fraction = ++p;
+    for (; isDigit(*p); ++p) {
+      Mantissa = Mantissa * 10 + (*p - '0');
+    }
+    Exp10 = Fraction - p;
+    if (Digits == 0) {
+      // Zeros right after the point are not significant either.
+      while (*Fraction == '0')
+        ++Fraction;
+    }
+    Digits += p - Fraction;
+  }
+  if (*p == 'e' || *p == 'E') {
+    ++p;
+    bool Negative = *p == '-';
+    if (*p == '+' || *p == '-')
+      ++p;
+    if (!isDigit(*p)) {
+      return Fail(p, "Expect digits in exponent");
+    }
+    int Exp = 0;
+    for (; isDigit(*p); ++p) {
+      if (Exp < 100000)
+        Exp = Exp * 10 + (*p - '0');
+    }
+    Exp10 += Negative ? -Exp : Exp;
+  }
+  if (isIdentChar(*p)) {
+    return Fail(p, "Invalid suffix on floating literal");
+  }
+
+  NumericLiteral Result;
+  Result.isFloat = true;
+  Result.End = p;
+  Result.Error = nullptr;
+  if (Digits <= 19 && FastPath(Mantissa, Exp10, Result.FloatValue)) {
+    return Result;
+  }
+  return Float(Begin, p, false);
+}
@@ -0,0 +1,184 @@
+#include "loops.hpp"
+#include "passes.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ssa {
+
+// Headers larger than this are not copied.
+static const unsigned MaxHeaderSize = 16;
+
+// Turns the while loop `L`, whose header tests and either enters the body
+// or leaves, into a guarded do-while loop: the preheader tests the first
+// time and jumps into the body, the latch tests every other time, and
+// the header goes away. Each copy of the header computes from what flows
+// into the header from its side, and the values of the header get phis
+// in the body and at the exit where both copies meet.
+static bool rotate(Function &F, const LoopInfo &LI, Loop &L) {
+  Block *H = L.Header;
+  Block *Pre = LI.preheader(L);
+  if (Pre == nullptr || L.Latches.size() != 1) {
+    return false;
+  }
+  Block *Latch = L.Latches[0];
+  Instr *T = H->terminator();
+  if (Latch == H || Latch->terminator()->Op != Opcode::Br ||
+      T->Op != Opcode::CondBr) {
+    return false;
+  }
+  bool ThenIn = LI.contains(&L, T->successor(0));
+  bool ElseIn = LI.contains(&L, T->successor(1));
+  if (ThenIn == ElseIn) {
+    return false;
+  }
+  // Only the header may leave, so the exit is all that sees its values
+  // from outside.
+  for (Block *B : L.Blocks) {
+    Instr *BT = B->terminator();
+    for (unsigned i = 0; B != H && i < BT->numSuccessors(); ++i) {
+      if (!LI.contains(&L, BT->successor(i))) {
+        return false;
+      }
+    }
+  }
+  unsigned Size = 0;
+  for (Instr *I = H->firstNonPhi(); I != T; I = I->Next) {
+    if (++Size > MaxHeaderSize) {
+      return false;
+    }
+  }
+
+  // The body and the exit get the edges of both copies, so each must be
+  // entered from the header alone.
+  Block *Body = T->successor(ThenIn ? 0 : 1);
+  Block *Exit = T->successor(ThenIn ? 1 : 0);
+  if (Body->Preds.size() != 1 || Body->First->Op == Opcode::Phi) {
+    Body = SplitPreds(F, Body, {H});
+  }
+  if (Exit->Preds.size() != 1 || Exit->First->Op == Opcode::Phi) {
+    Exit = SplitPreds(F, Exit, {H});
+  }
+  size_t FromPre = H->Preds[0] == Pre ? 0 : 1;
+
+  // The values of the header on the way in and at the end of an
+  // iteration, where the body phis stand for the header's own.
+  unordered_map<Value *, Value *> InPre, InLatch, BodyPhi;
+  Builder Build(F);
+  for (Instr *I : *H) {
+    if (I->Ty != Type::Void) {
+      BodyPhi[I] = Build.phi(I->Ty, Body);
+    }
+  }
+  auto Map = [&](unordered_map<Value *, Value *> &M, Value *V) {
+    auto It = M.find(V);
+    return It != M.end() ? It->second : V;
+  };
+  for (Instr *I = H->First; I->Op == Opcode::Phi; I = I->Next) {
+    InPre[I] = I->operand(FromPre);
+    Value *V = I->operand(1 - FromPre);
+    InLatch[I] = V->Op >= Opcode::Add && cast<Instr>(V)->Parent == H
+                     ? BodyPhi[V]
+                     : V;
+  }
+  auto Copy = [&](Block *B, unordered_map<Value *, Value *> &M) {
+    F.erase(B->terminator());
+    Build.setBlock(B);
+    for (Instr *I = H->firstNonPhi(); I != T; I = I->Next) {
+      Instr *C;
+      if (auto *Call = dyn_cast<CallInstr>(I)) {
+        vector<Value *> Args;
+        for (uint32_t i = 0; i < I->NumOps; ++i) {
+          Args.push_back(Map(M, I->operand(i)));
+        }
+        C = Build.call(Call->Callee, {Args.data(), Args.size()});
+      } else {
+        C = F.create(I->Op, I->Ty, I->NumOps);
+        for (uint32_t i = 0; i < I->NumOps; ++i) {
+          C->setOperand(i, Map(M, I->operand(i)));
+        }
+        C->P = I->P;
+        C->Imm = I->Imm;
+        B->insert(C);
+      }
+      M[I] = C;
+    }
+  };
+  Body->Preds.erase(0);
+  Exit->Preds.erase(0);
+  Copy(Pre, InPre);
+  Copy(Latch, InLatch);
+  for (Block *B : {Pre, Latch}) {
+    auto &M = B == Pre ? InPre : InLatch;
+    Build.setBlock(B);
+    Value *Cond = Map(M, T->operand(0));
+    if (ThenIn) {
+      Build.condBr(Cond, Body, Exit);
+    } else {
+      Build.condBr(Cond, Exit, Body);
+    }
+  }
+
+  // Uses inside the loop now see the body phis, and uses after it phis
+  // at the exit. Neither copy is used by the header any more.
+  for (Instr *I : *H) {
+    if (I->Ty == Type::Void) {
+      continue;
+    }
+    Phi *P = cast<Phi>(BodyPhi[I]);
+    for (Block *B : Body->Preds) {
+      F.addIncoming(P, Map(B == Pre ? InPre : InLatch, I));
+    }
+    Phi *Out = nullptr;
+    while (Use *U = I->Uses) {
+      Block *At = U->User->Parent;
+      if (At == H) {
+        U->set(nullptr);
+        continue;
+      }
+      if (At != nullptr && LI.contains(&L, At)) {
+        U->set(P);
+        continue;
+      }
+      if (Out == nullptr) {
+        Out = Build.phi(I->Ty, Exit);
+        for (Block *B : Exit->Preds) {
+          F.addIncoming(Out, Map(B == Pre ? InPre : InLatch, I));
+        }
+      }
+      U->set(Out);
+    }
+  }
+  for (Instr *I : *H) {
+    for (uint32_t i = 0; i < I->NumOps; ++i) {
+      I->Ops[i].set(nullptr);
+    }
+  }
+  vector<bool> Keep(F.NumBlocks, true);
+  Keep[H->Id] = false;
+  F.removeBlocks(Keep);
+  return true;
+}
+
+bool RotateLoops(Function &F) {
+  bool Changed = NormalizeLoops(F);
+  // One loop at a time, as each rotation changes the blocks of the loops
+  // around it; a rotated loop ends in its latch and is not tried again.
+  bool Rotated = true;
+  while (Rotated) {
+    Rotated = false;
+    DomTree DT(F);
+    LoopInfo LI(F, DT);
+    for (auto &L : LI.Loops) {
+      if (rotate(F, LI, *L)) {
+        Rotated = Changed = true;
+        NormalizeLoops(F);
+        break;
+      }
+    }
+  }
+  return Changed;
+}
+
+} // namespace ssa
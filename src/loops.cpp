@@ -0,0 +1,115 @@
+#include "loops.hpp"
+#include "passes.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace ssa {
+
+LoopInfo::LoopInfo(const Function &F, const DomTree &DT)
+    : Of(F.NumBlocks, nullptr) {
+  auto Outermost = [](Loop *L) {
+    while (L->Parent != nullptr) {
+      L = L->Parent;
+    }
+    return L;
+  };
+  // Headers in postorder, so inner loops are found first and an outer one
+  // takes them whole as it walks back from its latches.
+  vector<Block *> Work;
+  for (auto It = DT.RPO.rbegin(); It != DT.RPO.rend(); ++It) {
+    Block *H = *It;
+    for (Block *P : H->Preds) {
+      if (DT.reachable(P) && DT.dominates(H, P) &&
+          find(Work.begin(), Work.end(), P) == Work.end()) {
+        Work.push_back(P);
+      }
+    }
+    if (Work.empty()) {
+      continue;
+    }
+    Loops.push_back(make_unique<Loop>(H));
+    Loop *L = Loops.back().get();
+    L->Latches = Work;
+    L->Blocks.push_back(H);
+    Of[H->Id] = L;
+    while (!Work.empty()) {
+      Block *B = Work.back();
+      Work.pop_back();
+      if (Of[B->Id] == nullptr) {
+        Of[B->Id] = L;
+        L->Blocks.push_back(B);
+        for (Block *P : B->Preds) {
+          if (DT.reachable(P)) {
+            Work.push_back(P);
+          }
+        }
+        continue;
+      }
+      Loop *Sub = Outermost(Of[B->Id]);
+      if (Sub == L) {
+        continue;
+      }
+      Sub->Parent = L;
+      L->Children.push_back(Sub);
+      for (Block *P : Sub->Header->Preds) {
+        if (DT.reachable(P) && (Of[P->Id] == nullptr ||
+                                Outermost(Of[P->Id]) != L)) {
+          Work.push_back(P);
+        }
+      }
+    }
+    for (Loop *C : L->Children) {
+      L->Blocks.insert(L->Blocks.end(), C->Blocks.begin(), C->Blocks.end());
+    }
+  }
+  for (auto It = Loops.rbegin(); It != Loops.rend(); ++It) {
+    Loop *L = It->get();
+    L->Depth = L->Parent ? L->Parent->Depth + 1 : 1;
+  }
+}
+
+Block *LoopInfo::preheader(const Loop &L) const {
+  Block *Pre = nullptr;
+  for (Block *P : L.Header->Preds) {
+    if (contains(&L, P)) {
+      continue;
+    }
+    if (Pre != nullptr) {
+      return nullptr;
+    }
+    Pre = P;
+  }
+  if (Pre == nullptr || Pre->terminator()->Op != Opcode::Br) {
+    return nullptr;
+  }
+  return Pre;
+}
+
+bool NormalizeLoops(Function &F) {
+  DomTree DT(F);
+  LoopInfo LI(F, DT);
+  bool Changed = false;
+  for (auto &L : LI.Loops) {
+    // Each split only adds a predecessor to this header, so the loop info
+    // stays right for the other loops.
+    if (LI.preheader(*L) == nullptr) {
+      vector<Block *> Outside;
+      for (Block *P : L->Header->Preds) {
+        if (!LI.contains(L.get(), P) &&
+            find(Outside.begin(), Outside.end(), P) == Outside.end()) {
+          Outside.push_back(P);
+        }
+      }
+      SplitPreds(F, L->Header, Outside);
+      Changed = true;
+    }
+    if (L->Latches.size() > 1) {
+      SplitPreds(F, L->Header, L->Latches);
+      Changed = true;
+    }
+  }
+  return Changed;
+}
+
+} // namespace ssa
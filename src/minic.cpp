@@ -1,46 +1,219 @@
 #include "ast.hpp"
+#include "astdump.hpp"
+#include "backend.hpp"
+#include "binast.hpp"
+#include "codegen.hpp"
+#include "consteval.hpp"
+#include "flatast.hpp"
+#include "hir.hpp"
+#include "jit.hpp"
 #include "lexer.hpp"
+#include "outputsink.hpp"
 #include "parser.hpp"
-#include <fstream>
+#include "passes.hpp"
+#include "resolve.hpp"
+#include "source.hpp"
+#include "ssa.hpp"
+#include <cstring>
 #include <iostream>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
 #include <string>
+#include <string_view>
+#include <thread>
 
-std::string ReadFile(const char *FilePath) {
-  std::ifstream Input(FilePath);
-  if (!Input.is_open()) {
-    return "";
-  }
-  return std::string(std::istreambuf_iterator<char>(Input),
-                     std::istreambuf_iterator<char>());
-}
 using namespace ast;
 int main(int argc, char **argv) {
-  if (argc == 1) {
+  // minic [--emit-ast=text|sexpr|json|bin] FILE
+  // minic [--emit-ast=...] --from-ast=FILE, to start from a binary AST;
+  //   it also takes the place of FILE in every mode below
+  // minic --check FILE, to resolve names, evaluate constants and check
+  //   types; an error goes to stderr and exits with 1, as for every mode
+  // minic --emit-hir FILE, to print the typed HIR
+  // minic [-O0|-O1|-O2|-O3] -o OUT FILE, to compile to an executable, or
+  //   to an object file if OUT ends in .o
+  // minic [-O...] --emit-llvm FILE, to print the optimized LLVM IR
+  // minic [-O...] --run FILE, to compile in memory and run it; exits with
+  //   what main returns
+  // minic --emit-ssa FILE, to print minic's own SSA IR
+  // minic --ssa ..., to compile or run by way of the SSA IR
+  // minic --opt-ssa ..., to also run minic's own passes on it first, and
+  //   --time-passes to report what each of them took and removed
+  const char *Input = nullptr;
+  const char *FromAST = nullptr;
+  const char *Output = nullptr;
+  ASTFormat Format = ASTFormat::Text;
+  bool Check = false, EmitHIR = false, EmitLLVM = false, Run = false;
+  bool EmitSSA = false, ViaSSA = false, OptSSA = false, TimePasses = false;
+  unsigned OptLevel = 0;
+  for (int i = 1; i < argc; ++i) {
+    string_view Arg = argv[i];
+    if (Arg.starts_with("--emit-ast=")) {
+      if (!ParseASTFormat(Arg.substr(strlen("--emit-ast=")), Format)) {
+        cerr << "Unknown AST format '" << Arg << "'.\n";
+        return 1;
+      }
+    } else if (Arg == "--check") {
+      Check = true;
+    } else if (Arg == "--emit-hir") {
+      EmitHIR = true;
+    } else if (Arg == "--run") {
+      Run = true;
+    } else if (Arg == "--emit-ssa") {
+      EmitSSA = true;
+    } else if (Arg == "--ssa") {
+      ViaSSA = true;
+    } else if (Arg == "--opt-ssa") {
+      OptSSA = ViaSSA = true;
+    } else if (Arg == "--time-passes") {
+      TimePasses = true;
+    } else if (Arg == "--emit-llvm") {
+      EmitLLVM = true;
+    } else if (Arg.size() == 3 && Arg.starts_with("-O") && Arg[2] >= '0' &&
+               Arg[2] <= '3') {
+      OptLevel = Arg[2] - '0';
+    } else if (Arg == "-o" && i + 1 < argc) {
+      Output = argv[++i];
+    } else if (Arg.starts_with("--from-ast=")) {
+      FromAST = argv[i] + strlen("--from-ast=");
+    } else {
+      Input = argv[i];
+    }
+  }
+  if (Input == nullptr && FromAST == nullptr) {
     printf("This program take one input file and output an exectuable.");
     return 1;
   }
 
-  std::string src = ReadFile(argv[1]);
-
-  Lexer lexer(src);
-  std::cout << lexer.src << std::endl;
-  // while (true) {
-  //   Token t = lexer.NextToken();
-  //   if (t.isKind(TokenType::Eof))
-  //     break;
-  //   std::cout << t << std::endl;
-  // }
-  // return 0;
+  if (Input != nullptr && FromAST != nullptr) {
+    cerr << "Give either a source file or --from-ast=FILE, not both.\n";
+    return 1;
+  }
 
-  Parser parser(lexer);
+  SourceManager SM;
   try {
-    Program program = parser.ParseProgram();
-    TreePrinter Printer;
-    Printer.accept(program);
+    bool Compile = Output != nullptr || EmitLLVM;
+    bool Lower = Check || EmitHIR || EmitSSA || Compile || Run;
+    const char *Name = Input != nullptr ? Input : FromAST;
+    const SourceFile *Source = nullptr;
+    Program program;
+    if (FromAST != nullptr) {
+      BinaryAST File(FromAST);
+      // The source is only needed for the locations, which stay unknown if
+      // it has gone or changed.
+      try {
+        Source = &SM.getFile(SM.LoadFile(string(File.sourceName()).c_str()));
+        if (!File.attachSource(*Source)) {
+          Source = nullptr;
+        }
+      } catch (string) {
+      }
+      if (!Lower) {
+        OutputSink Out(stdout);
+        if (Format == ASTFormat::Text) {
+          // Printed straight from the mapping.
+          FlatPrinter Printer(File.ref(), Out);
+          Printer.print();
+        } else if (Format == ASTFormat::Binary) {
+          WriteBinaryAST(File.ref(), Source, Out);
+        } else {
+          Program program = Unflatten(File.ref());
+          EmitAST(program, Format, Out, Source);
+        }
+        return 0;
+      }
+      // The later stages start from the tree, as for a source file.
+      program = Unflatten(File.ref());
+    } else {
+      uint32_t FileId = SM.LoadFile(Input);
+      Source = &SM.getFile(FileId);
+      Lexer lexer(*Source);
+      // while (true) {
+      //   Token t = lexer.NextToken();
+      //   if (t.isKind(TokenType::Eof))
+      //     break;
+      //   std::cout << t << std::endl;
+      // }
+      // return 0;
+
+      Parser parser(lexer);
+      program = parser.ParseProgram(thread::hardware_concurrency());
+    }
+    if (Lower) {
+      ResolveNames(program, SM);
+      ConstEvaluator Consts(SM);
+      Consts.run(program);
+      hir::Module M = hir::LowerToHIR(program, Consts, SM);
+      if (EmitHIR) {
+        OutputSink Out(stdout);
+        hir::PrintHIR(M, Out);
+      }
+      unique_ptr<llvm::LLVMContext> Ctx;
+      unique_ptr<llvm::Module> IR;
+      if (EmitSSA || ViaSSA) {
+        ssa::Module S = ssa::BuildSSA(M);
+        ssa::Verify(S);
+        if (OptSSA) {
+          ssa::PassManager PM;
+          ssa::AddScalarPasses(PM);
+          ssa::AddLoopPasses(PM, OptLevel);
+          ssa::AddScalarPasses(PM);
+          PM.Counting = TimePasses;
+          PM.run(S);
+          ssa::Verify(S);
+          if (TimePasses) {
+            PM.report(stderr);
+          }
+        }
+        if (EmitSSA) {
+          OutputSink Out(stdout);
+          ssa::Print(S, Out);
+        }
+        if (Compile || Run) {
+          Ctx = make_unique<llvm::LLVMContext>();
+          IR = ssa::EmitLLVM(S, *Ctx, Name);
+        }
+      } else if (Compile || Run) {
+        Ctx = make_unique<llvm::LLVMContext>();
+        IR = hir::EmitLLVM(M, *Ctx, Name);
+      }
+      if (Run) {
+        return RunJIT(std::move(Ctx), std::move(IR), OptLevel);
+      }
+      if (Compile) {
+        auto TM = HostTargetMachine(OptLevel);
+        OptimizeModule(*IR, *TM, OptLevel);
+        if (EmitLLVM) {
+          IR->print(llvm::outs(), nullptr);
+        }
+        if (Output != nullptr && string_view(Output).ends_with(".o")) {
+          WriteObjectFile(*IR, *TM, Output);
+        } else if (Output != nullptr) {
+          llvm::SmallString<128> Object;
+          if (llvm::sys::fs::createTemporaryFile("minic", "o", Object)) {
+            throw string("Cannot create a temporary object file.");
+          }
+          try {
+            WriteObjectFile(*IR, *TM, Object.c_str());
+            LinkExecutable(Object.c_str(), Output);
+          } catch (...) {
+            llvm::sys::fs::remove(Object);
+            throw;
+          }
+          llvm::sys::fs::remove(Object);
+        }
+      }
+      return 0;
+    }
+    OutputSink Out(stdout);
+    EmitAST(program, Format, Out, Source);
 
   } catch (string s) {
-    cout << "Exception : " << s;
+    cerr << "Exception : " << s << '\n';
+    return 1;
   }
   return 0;
-}
\ No newline at end of file
+}
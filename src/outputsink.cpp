@@ -0,0 +1,56 @@
+#include "outputsink.hpp"
+#include <charconv>
+#include <algorithm>
+#include <cstring>
+
+OutputSink::OutputSink(FILE *File)
+    : File(File), Buffer(new char[BufferSize]), Cur(Buffer.get()),
+      End(Buffer.get() + BufferSize) {}
+
+OutputSink::~OutputSink() { flush(); }
+
+void OutputSink::drain() {
+  fwrite(Buffer.get(), 1, Cur - Buffer.get(), File);
+  Cur = Buffer.get();
+}
+
+void OutputSink::flush() {
+  drain();
+  fflush(File);
+}
+
+void OutputSink::writeSlow(const char *Data, size_t Size) {
+  drain();
+  if (Size >= BufferSize) {
+    fwrite(Data, 1, Size, File);
+    return;
+  }
+  memcpy(Cur, Data, Size);
+  Cur += Size;
+}
+
+void OutputSink::fill(char c, size_t N) {
+  while (N > 0) {
+    if (Cur == End) {
+      drain();
+    }
+    size_t Chunk = std::min(N, size_t(End - Cur));
+    memset(Cur, c, Chunk);
+    Cur += Chunk;
+    N -= Chunk;
+  }
+}
+
+void OutputSink::writeFloat(float V) {
+  if (End - Cur < 32) {
+    drain();
+  }
+  Cur = std::to_chars(Cur, End, V, std::chars_format::general, 6).ptr;
+}
+
+void OutputSink::writeFloatExact(float V) {
+  if (End - Cur < 32) {
+    drain();
+  }
+  Cur = std::to_chars(Cur, End, V).ptr;
+}
@@ -3,27 +3,34 @@
 #include "common.hpp"
 #include "lexer.hpp"
 #include "token.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
 #include <format>
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <thread>
 #include <utility>
 #include <variant>
 #include <vector>
 
 using namespace ast;
 
-Parser::Parser(Lexer &lexer) : Current(0) {
+Parser::Parser(Lexer &lexer)
+    : src(Tokens), File(lexer.File), Current(0) {
   while (true) {
     Token t = lexer.NextToken();
-    src.push_back(t);
+    Tokens.push_back(t);
     if (t.isKind(TokenType::Eof)) {
       break;
     }
   }
 }
+
+Parser::Parser(const vector<Token> &src, const SourceFile &File)
+    : src(src), File(File), Current(0) {}
 const int PREC_ASSIGN = 1, PREC_OR = 3, PREC_AND = 5, PREC_EQUAL = 7,
           PREC_COMPARE = 9, PREC_ADD = 11, PREC_MUL = 13, PREC_UNARY = 15,
           PREC_INDEX_CALL = 17;
@@ -59,108 +66,188 @@ pair<int8_t, int8_t> InfixBindPower(TokenType kind) {
   }
   }
 }
-shared_ptr<Expr> Parser::ParseExpr(int8_t min_bp) {
-  shared_ptr<Expr> lhs = nullptr;
-  Token token = next();
-  if (token.isKind(TokenType::Integer)) {
-    // a int literal
-    lhs = make_shared<IntegerExpr>(std::get<int>(token.content));
-  } else if (token.isKind(TokenType::Float)) {
-    // a float literal
-    lhs = make_shared<FloatExpr>(get<float>(token.content));
-  } else if (token.isKind(TokenType::Identifier)) {
-    // variable or function call
-    string &VarName = std::get<string>(token.content);
-    if (match(TokenType::LeftParen)) {
-      vector<shared_ptr<Expr>> params;
-      while (!peek(0).isKind(TokenType::RightParen)) {
-        params.push_back(ParseExpr());
+template <typename T> static T *At(T *Node, SourceLoc Loc) {
+  Node->Loc = Loc;
+  return Node;
+}
+
+// Operator-precedence parsing with an explicit stack. It is the usual
+// recursive Pratt parser turned inside out: wherever that one would call
+// ParseExpr(bp) for an operand, this pushes an ExprFrame remembering what
+// to do with the operand, and starts parsing it with min_bp = bp. Once an
+// operand is complete, the innermost frame resumes with it. Native stack
+// use does not depend on how deeply the input nests.
+Expr *Parser::ParseExpr(int8_t min_bp) {
+  using Frame = ExprFrame;
+  size_t Base = ExprFrames.size();
+  Expr *lhs;
+  while (true) {
+    // An operand starts here.
+    lhs = nullptr;
+    size_t Start = Current;
+    Token token = next();
+    if (token.isKind(TokenType::Integer)) {
+      // a int literal
+      lhs = Ctx->New<IntegerExpr>(token.IntValue);
+    } else if (token.isKind(TokenType::Float)) {
+      // a float literal
+      lhs = Ctx->New<FloatExpr>(token.FloatValue);
+    } else if (token.isKind(TokenType::Identifier)) {
+      // variable or function call
+      if (match(TokenType::LeftParen)) {
+        size_t Mark = ExprStack.size();
         if (!peek(0).isKind(TokenType::RightParen)) {
-          expect(TokenType::Comma, "Expect ',' between parameters.");
+          ExprFrames.push_back({Frame::Argument, min_bp, token, Mark});
+          min_bp = 0;
+          continue;
         }
+        expect(TokenType::RightParen, "Expect ')' after parameter(s).");
+        lhs = Ctx->New<FunctionCallExpr>(token.Sym, Take(ExprStack, Mark));
+      } else {
+        lhs = Ctx->New<VariableExpr>(token.Sym);
       }
-      expect(TokenType::RightParen, "Expect ')' after parameter(s).");
-      lhs = make_shared<FunctionCallExpr>(VarName,params);
+    } else if (token.isNotOp() || token.isNegOp()) {
+      ExprFrames.push_back({Frame::Prefix, min_bp, token});
+      min_bp = PrefixBindPower();
+      continue;
+    } else if (token.isKind(TokenType::LeftParen)) {
+      ExprFrames.push_back({Frame::Paren, min_bp, token});
+      min_bp = 0;
+      continue;
     } else {
-      lhs = make_shared<VariableExpr>(VarName);
+      Current = Start; // at the token that cannot start one
+      error("Expect expression.");
     }
-  } else if (token.isNotOp()) {
-    // Not op
-    int8_t bp = PrefixBindPower();
-    lhs = make_shared<NotExpr>(ParseExpr(bp));
-  } else if (token.isNegOp()) {
-    // negate op
-    int8_t bp = PrefixBindPower();
-    lhs = make_shared<NegateExpr>(ParseExpr(bp));
-  } else if (token.isKind(TokenType::LeftParen)) {
-    // '('
-    lhs = ParseExpr(0);
-    expect(TokenType::RightParen, "Expect ')'");
-  }
+    lhs->Loc = token.Loc;
+
+    // Postfix and infix operators. Leaves the loop when an operator needs
+    // an operand; returns when the outermost operand is complete.
+    while (true) {
+      Token optoken = peek(0);
+
+      if (optoken.isKind(TokenType::LeftBracket)) {
+        next();
+        ExprFrames.push_back({Frame::Index, min_bp, optoken, 0, lhs});
+        min_bp = 0;
+        break;
+      }
 
-  while (true) {
-    Token optoken = peek(0);
-
-    if (optoken.isKind(TokenType::LeftBracket)) {
-      next();
-      auto index = ParseExpr();
-      expect(TokenType::RightBracket, "Expect ']' after index.");
-
-      if (auto base = dynamic_pointer_cast<VariableExpr>(lhs);
-          base != nullptr) {
-        lhs = make_shared<IndexExpr>(base, index);
-      } else if (auto sub = dynamic_pointer_cast<IndexExpr>(lhs);
-                 lhs != nullptr) {
-        lhs = make_shared<IndexExpr>(sub, index);
-      } else {
-        throw format("Expect array or subarray in index expr.");
+      auto bp = InfixBindPower(optoken.type);
+      int8_t l_bp = bp.first;
+      int8_t r_bp = bp.second;
+      if (l_bp >= min_bp) {
+        next();
+        ExprFrames.push_back({Frame::Infix, min_bp, optoken, 0, lhs});
+        min_bp = r_bp;
+        break;
+      }
+
+      // `lhs` is complete: hand it to the innermost frame.
+      if (ExprFrames.size() == Base) {
+        return lhs;
+      }
+      Frame F = ExprFrames.back();
+      ExprFrames.pop_back();
+      min_bp = F.MinBp;
+      if (ResumeExpr(F, lhs, min_bp)) {
+        break;
       }
-      continue;
     }
+  }
+}
 
-    auto bp = InfixBindPower(optoken.type);
-    int8_t l_bp = bp.first;
-    int8_t r_bp = bp.second;
-    if (l_bp < min_bp)
-      break;
-    next();
-    auto rhs = ParseExpr(r_bp);
+// Continues the frame `F` now that its operand `lhs` is parsed. Returns true
+// if it needs another operand, having pushed a frame and set `min_bp` for
+// it; otherwise `lhs` is the frame's result.
+bool Parser::ResumeExpr(ExprFrame &F, Expr *&lhs, int8_t &min_bp) {
+  Token optoken = F.Tok;
+  switch (F.Kind) {
+  case ExprFrame::Prefix: {
+    if (optoken.isNotOp()) {
+      lhs = Ctx->New<NotExpr>(lhs);
+    } else {
+      lhs = Ctx->New<NegateExpr>(lhs);
+    }
+    lhs->Loc = optoken.Loc;
+    return false;
+  }
+  case ExprFrame::Paren: {
+    expect(TokenType::RightParen, "Expect ')'");
+    return false;
+  }
+  case ExprFrame::Argument: {
+    ExprStack.push_back(lhs);
+    if (!peek(0).isKind(TokenType::RightParen)) {
+      expect(TokenType::Comma, "Expect ',' between parameters.");
+    }
+    if (!peek(0).isKind(TokenType::RightParen)) {
+      ExprFrames.push_back(F);
+      min_bp = 0;
+      return true;
+    }
+    expect(TokenType::RightParen, "Expect ')' after parameter(s).");
+    lhs = Ctx->New<FunctionCallExpr>(optoken.Sym, Take(ExprStack, F.Mark));
+    lhs->Loc = optoken.Loc;
+    return false;
+  }
+  case ExprFrame::Index: {
+    expect(TokenType::RightBracket, "Expect ']' after index.");
+    Expr *index = lhs;
+    if (auto base = dyn_cast_or_null<VariableExpr>(F.Lhs)) {
+      lhs = Ctx->New<IndexExpr>(base, index);
+    } else if (auto sub = dyn_cast_or_null<IndexExpr>(F.Lhs)) {
+      lhs = Ctx->New<IndexExpr>(sub, index);
+    } else {
+      throw format("Expect array or subarray in index expr.");
+    }
+    lhs->Loc = optoken.Loc;
+    return false;
+  }
+  case ExprFrame::Infix: {
+    Expr *rhs = lhs;
+    lhs = F.Lhs;
     if (optoken.isBinOp()) {
       BinOpKind op = BinOpKindFromTokenType(optoken.type);
-      lhs = make_shared<BinopExpr>(op, lhs, rhs);
+      lhs = Ctx->New<BinopExpr>(op, lhs, rhs);
     } else if (optoken.isCmpOp()) {
       CmpOpKind op = CmpKindFromTokenType(optoken.type);
-      lhs = make_shared<CmpExpr>(op, lhs, rhs);
+      lhs = Ctx->New<CmpExpr>(op, lhs, rhs);
     } else if (optoken.isLogicOp()) {
       LogicalOpKind op = LogicalOpKindFromTokenType(optoken.type);
-      lhs = make_shared<LogicalExpr>(op, lhs, rhs);
+      lhs = Ctx->New<LogicalExpr>(op, lhs, rhs);
     } else if(optoken.isKind(TokenType::OpEqual)){
-      if(auto v = dynamic_pointer_cast<VariableExpr>(lhs); v != nullptr){
-        lhs = make_shared<AssignExpr>(v,rhs);
-      }else if(auto v = dynamic_pointer_cast<IndexExpr>(lhs); v != nullptr){
-        lhs = make_shared<AssignExpr>(v,rhs);
+      if(auto v = dyn_cast_or_null<VariableExpr>(lhs)){
+        lhs = Ctx->New<AssignExpr>(v,rhs);
+      }else if(auto v = dyn_cast_or_null<IndexExpr>(lhs)){
+        lhs = Ctx->New<AssignExpr>(v,rhs);
       }else{
         throw string("Can only assign to variable or element of array.");
       }
     }
+    lhs->Loc = optoken.Loc;
+    return false;
   }
-  return lhs;
+  }
+  unreachable("Unknown expression frame.");
 }
 
-shared_ptr<Expr> Parser::ParseExpr() { return ParseExpr(0); }
+Expr *Parser::ParseExpr() { return ParseExpr(0); }
 
-shared_ptr<Stmt> Parser::ParseStmt() {
+Stmt *Parser::ParseStmt() {
   switch (peek(0).type) {
   case TokenType::Semicolon:{
+    next();
     return nullptr;
   }
   case TokenType::KW_continue: {
-    next();
-    return make_shared<ContinueStmt>();
+    auto S = At(Ctx->New<ContinueStmt>(), next().Loc);
+    expect(TokenType::Semicolon, "Expect ';' after continue.");
+    return S;
   }
   case TokenType::KW_break: {
-    next();
-    return make_shared<BreakStmt>();
+    auto S = At(Ctx->New<BreakStmt>(), next().Loc);
+    expect(TokenType::Semicolon, "Expect ';' after break.");
+    return S;
   }
   case TokenType::KW_if: {
     return ParseIfStmt();
@@ -174,7 +261,7 @@ shared_ptr<Stmt> Parser::ParseStmt() {
   case TokenType::KW_const:
   case TokenType::KW_int:
   case TokenType::KW_float: {
-    return make_shared<DeclStmt>(ParseDeclStmt());
+    return Ctx->New<DeclStmt>(ParseDeclStmt());
   }
   case TokenType::LeftBrace: {
     return ParseBlockStmt();
@@ -182,7 +269,7 @@ shared_ptr<Stmt> Parser::ParseStmt() {
   default: {
     auto e = ParseExpr();
     expect(TokenType::Semicolon, "Expect ';' after expr.");
-    return make_shared<ExprStmt>(e);
+    return At(Ctx->New<ExprStmt>(e), e->Loc);
   }
   }
   stringstream ss;
@@ -190,39 +277,46 @@ shared_ptr<Stmt> Parser::ParseStmt() {
   unreachable(format("Unsupported syntax : at {}", ss.str()));
 }
 
-shared_ptr<IfStmt> Parser::ParseIfStmt() {
-  next();
+IfStmt *Parser::ParseIfStmt() {
+  SourceLoc Loc = next().Loc;
   expect(TokenType::LeftParen, "Expect '(' after `if`.");
-  shared_ptr<Expr> cond = ParseExpr();
+  Expr *cond = ParseExpr();
   expect(TokenType::RightParen, "Expect ')' after condition.");
 
-  shared_ptr<Stmt> IfBranch = ParseStmt();
-  shared_ptr<Stmt> ElseBranch = nullptr;
+  Stmt *IfBranch = ParseStmt();
+  Stmt *ElseBranch = nullptr;
   if (match(TokenType::KW_else)) {
     ElseBranch = ParseStmt();
   }
-  return make_shared<IfStmt>(cond, IfBranch, ElseBranch);
+  return At(Ctx->New<IfStmt>(cond, IfBranch, ElseBranch), Loc);
+}
+
+IntegerExpr *Parser::CharNode(char c) {
+  IntegerExpr *&Node = CharNodes[uint8_t(c)];
+  if (Node == nullptr) {
+    Node = Ctx->New<IntegerExpr>(c);
+  }
+  return Node;
 }
 
 InitVals ParseInit(Parser &p) {
+  size_t Mark = p.InitStack.size();
   if (p.peek(0).isKind(TokenType::String)){
-    vector<InitVals> ivs;
     Token t = p.next();
-    for(auto c : get<string>(t.content)){
-      ivs.push_back(InitVals(make_shared<IntegerExpr>(c)));
+    for(auto c : t.stringValue(p.File)){
+      p.InitStack.push_back(InitVals(p.CharNode(c)));
     }
-    return ivs;
+    return InitVals(p.Take(p.InitStack, Mark));
   }
   if (p.match(TokenType::LeftBrace)) {
-    vector<InitVals> ivs;
     while (!p.peek(0).isKind(TokenType::RightBrace)) {
-      ivs.push_back(ParseInit(p));
+      p.InitStack.push_back(ParseInit(p));
       if (!p.peek(0).isKind(TokenType::RightBrace)) {
         p.expect(TokenType::Comma, "Expect ',' between initvals.");
       }
     }
     p.expect(TokenType::RightBrace, "Expect '}'.");
-    return InitVals(std::move(ivs));
+    return InitVals(p.Take(p.InitStack, Mark));
   } else {
     return InitVals(p.ParseExpr());
   }
@@ -246,55 +340,57 @@ DeclStmt Parser::ParseDeclStmt() {
     throw string("Expect 'int' or 'float'.");
   }
 
-  string varname = get<string>(
-      expect(TokenType::Identifier, "Expect variable name.").content);
+  Token Name = expect(TokenType::Identifier, "Expect variable name.");
 
-  vector<shared_ptr<Expr>> dims;
+  size_t Mark = ExprStack.size();
   while (match(TokenType::LeftBracket)) {
-    dims.push_back(ParseExpr());
+    ExprStack.push_back(ParseExpr());
     expect(TokenType::RightBracket, "Expect ']'");
   }
+  Span<Expr *> dims = Take(ExprStack, Mark);
 
-  shared_ptr<InitVals> initval;
+  InitVals *initval = nullptr;
   if (match(TokenType::OpEqual)) {
-    initval = make_shared<InitVals>(ParseInit(*this));
+    initval = Ctx->New<InitVals>(ParseInit(*this));
   }
 
   expect(TokenType::Semicolon, "Expect ';' after decl.");
 
-  return DeclStmt(isConst, basetype, varname, dims, initval);
+  DeclStmt Result(isConst, basetype, Name.Sym, dims, initval);
+  Result.Loc = Name.Loc;
+  return Result;
 }
 
-shared_ptr<ReturnStmt> Parser::ParseReturnStmt() {
-  next();
+ReturnStmt *Parser::ParseReturnStmt() {
+  SourceLoc Loc = next().Loc;
   if (match(TokenType::Semicolon)) {
-    return make_shared<ReturnStmt>(nullptr);
+    return At(Ctx->New<ReturnStmt>(nullptr), Loc);
   }
   auto e = ParseExpr();
   expect(TokenType::Semicolon, "Expect ';' after return expr.");
-  return make_shared<ReturnStmt>(e);
+  return At(Ctx->New<ReturnStmt>(e), Loc);
 }
 
-shared_ptr<BlockStmt> Parser::ParseBlockStmt() {
-  vector<shared_ptr<Stmt>> Stmts;
-  expect(TokenType::LeftBrace, "Expect '{'");
+BlockStmt *Parser::ParseBlockStmt() {
+  size_t Mark = StmtStack.size();
+  SourceLoc Loc = expect(TokenType::LeftBrace, "Expect '{'").Loc;
   while (!match(TokenType::RightBrace)) {
-    shared_ptr<Stmt> R = ParseStmt();
+    Stmt *R = ParseStmt();
     if (R != nullptr) {
-      Stmts.push_back(R);
+      StmtStack.push_back(R);
     }
   }
-  return make_shared<BlockStmt>(Stmts);
+  return At(Ctx->New<BlockStmt>(Take(StmtStack, Mark)), Loc);
 }
 
-shared_ptr<WhileStmt> Parser::ParseWhileStmt() {
-  next();
+WhileStmt *Parser::ParseWhileStmt() {
+  SourceLoc Loc = next().Loc;
   expect(TokenType::LeftParen, "Expect '(' after while.");
   auto cond = ParseExpr();
   expect(TokenType::RightParen, "Expect ')' after while condition.");
   auto body = ParseStmt();
 
-  return make_shared<WhileStmt>(cond, body);
+  return At(Ctx->New<WhileStmt>(cond, body), Loc);
 }
 
 Func Parser::ParseFunction() {
@@ -313,9 +409,8 @@ Func Parser::ParseFunction() {
     unreachable("Unknown return type.");
   }
 
-  string FunctionName = get<string>(
-      expect(TokenType::Identifier, "Expect identifier in function definition.")
-          .content);
+  Token FunctionName =
+      expect(TokenType::Identifier, "Expect identifier in function definition.");
 
   // Parse parameters.
   expect(TokenType::LeftParen, "Expect '(' after function name.");
@@ -334,41 +429,55 @@ Func Parser::ParseFunction() {
       throw string("Expect 'int' or 'float'.");
     }
 
-    string paraname = get<string>(
-        expect(TokenType::Identifier, "Expect identifier name.").content);
-
-    vector<shared_ptr<Expr>> dims;
+    Token paraname = expect(TokenType::Identifier, "Expect identifier name.");
 
+    size_t Mark = ExprStack.size();
     while (match(TokenType::LeftBracket)) {
       if (match(TokenType::RightBracket)) {
-        dims.push_back(nullptr);
+        ExprStack.push_back(nullptr);
       } else {
-        dims.push_back(ParseExpr());
+        ExprStack.push_back(ParseExpr());
         expect(TokenType::RightBracket, "Expect ']'.");
       }
     }
+    Span<Expr *> dims = Take(ExprStack, Mark);
 
     if (!peek(0).isKind(TokenType::RightParen)) {
       expect(TokenType::Comma, "Expect ',' between parameters.");
     }
 
-    params_.emplace_back(bt, paraname, dims);
+    params_.emplace_back(bt, paraname.Sym, dims, paraname.Loc);
   }
 
   expect(TokenType::RightParen, "Expect ')'.");
-  shared_ptr<BlockStmt> FunctionBody;
+  BlockStmt *FunctionBody;
   if (match(TokenType::Semicolon)) {
     FunctionBody = nullptr;
   } else {
     FunctionBody = ParseBlockStmt();
   }
 
-  return Func{ReturnType, FunctionName, std::move(params_), FunctionBody};
+  Func Result{ReturnType, FunctionName.Sym, Ctx->Copy(params_), FunctionBody};
+  Result.Loc = FunctionName.Loc;
+  return Result;
+}
+
+Program Parser::ParseProgram(unsigned Threads) {
+  Program P{make_unique<ASTContext>(), {}};
+  if (Threads > 1 && ParseParallel(Threads, P)) {
+    return P;
+  }
+  Ctx = P.Context.get();
+  fill(begin(CharNodes), end(CharNodes), nullptr);
+  Current = 0;
+  ExprFrames.clear();
+  ParseItems(src.size() - 1, P.instrs);
+  Ctx = nullptr;
+  return P;
 }
 
-Program Parser::ParseProgram() {
-  vector<variant<Func, DeclStmt>> instrs;
-  while (!peek(0).isKind(TokenType::Eof)) {
+void Parser::ParseItems(size_t End, vector<variant<Func, DeclStmt>> &instrs) {
+  while (Current < End && !peek(0).isKind(TokenType::Eof)) {
     if (peek(0).isKind(TokenType::KW_const)) {
       instrs.push_back(ParseDeclStmt());
       continue;
@@ -383,7 +492,119 @@ Program Parser::ParseProgram() {
     }
     instrs.push_back(ParseDeclStmt());
   }
-  return Program{instrs};
+}
+
+// The token index one past each top-level item. A declaration ends at its
+// ';' and a function at the '}' closing its body (or the ';' of a
+// prototype); neither can end inside braces, so matching braces is enough
+// to find them without parsing. Returns nothing if the tokens do not look
+// like a sequence of items, leaving the error to the sequential parse.
+vector<uint32_t> Parser::SplitItems() const {
+  vector<uint32_t> Ends;
+  uint32_t Eof = src.size() - 1;
+  uint32_t i = 0;
+  while (i < Eof) {
+    TokenType Type = src[i].type;
+    if (Type != TokenType::KW_const && Type != TokenType::KW_int &&
+        Type != TokenType::KW_float && Type != TokenType::KW_void) {
+      return {};
+    }
+    bool IsFunction =
+        Type == TokenType::KW_void ||
+        (Type != TokenType::KW_const && i + 2 < Eof &&
+         src[i + 2].isKind(TokenType::LeftParen));
+    int Depth = 0;
+    bool Done = false;
+    for (; i < Eof && !Done; ++i) {
+      if (src[i].isKind(TokenType::LeftBrace)) {
+        Depth++;
+      } else if (src[i].isKind(TokenType::RightBrace)) {
+        if (--Depth < 0) {
+          return {};
+        }
+        Done = Depth == 0 && IsFunction;
+      } else if (src[i].isKind(TokenType::Semicolon)) {
+        Done = Depth == 0;
+      }
+    }
+    if (!Done) {
+      return {};
+    }
+    Ends.push_back(i);
+  }
+  return Ends;
+}
+
+// Chunks smaller than this are not worth a thread's time.
+static constexpr uint32_t MinChunkTokens = 16 * 1024;
+
+// Parses runs of whole top-level items ("chunks") on `Threads` threads. Each
+// thread has its own Parser over the shared tokens and its own ASTContext,
+// so nothing is locked but the chunk counter; the items are stitched back
+// in source order and `P.Context` adopts the threads' arenas. Returns false
+// if the input is too small or any chunk failed to parse.
+bool Parser::ParseParallel(unsigned Threads, Program &P) {
+  vector<uint32_t> Ends = SplitItems();
+  uint32_t Target =
+      max<uint32_t>(MinChunkTokens, src.size() / (size_t(Threads) * 8));
+  vector<uint32_t> Chunks; // the end of each chunk
+  uint32_t Begin = 0;
+  for (size_t i = 0; i < Ends.size(); ++i) {
+    if (Ends[i] - Begin >= Target || i + 1 == Ends.size()) {
+      Chunks.push_back(Ends[i]);
+      Begin = Ends[i];
+    }
+  }
+  if (Chunks.size() < 2) {
+    return false;
+  }
+  Threads = min<size_t>(Threads, Chunks.size());
+
+  vector<vector<variant<Func, DeclStmt>>> Items(Chunks.size());
+  vector<ASTContext> Contexts(Threads);
+  atomic<size_t> NextChunk = 0;
+  atomic<bool> Failed = false;
+  auto Work = [&](unsigned Thread) {
+    Parser Part(src, File);
+    Part.Worker = true;
+    Part.Ctx = &Contexts[Thread];
+    while (!Failed) {
+      size_t i = NextChunk++;
+      if (i >= Chunks.size()) {
+        break;
+      }
+      Part.Current = i == 0 ? 0 : Chunks[i - 1];
+      try {
+        Part.ParseItems(Chunks[i], Items[i]);
+      } catch (...) {
+        Failed = true;
+      }
+      if (Part.Current != Chunks[i]) {
+        Failed = true;
+      }
+    }
+  };
+  vector<thread> Pool;
+  for (unsigned Thread = 1; Thread < Threads; ++Thread) {
+    Pool.emplace_back(Work, Thread);
+  }
+  Work(0);
+  for (thread &T : Pool) {
+    T.join();
+  }
+  if (Failed) {
+    return false;
+  }
+
+  for (auto &Chunk : Items) {
+    for (auto &Item : Chunk) {
+      P.instrs.push_back(std::move(Item));
+    }
+  }
+  for (ASTContext &Context : Contexts) {
+    P.Context->adopt(std::move(Context));
+  }
+  return true;
 }
 
 // Implement four auxiliary functions.
@@ -395,7 +616,7 @@ bool Parser::match(TokenType type) {
   return false;
 }
 
-Token &Parser::peek(int offset) {
+const Token &Parser::peek(int offset) {
   if (Current + offset >= src.size()) {
     return src.back();
   }
@@ -410,13 +631,22 @@ Token Parser::next() {
 }
 
 Token Parser::expect(TokenType type, const char *ErrorMsg) {
-  if (src[Current].isKind(type)) {
-    return src[Current++];
-  } else {
-    std::cerr << ErrorMsg << "in the " << Current << "token.";
-    for (int i = Current; i < src.size() && i < Current + 2; ++i) {
-      std::cout << src[i] << '\n';
-    }
-    exit(1);
+  if (!src[Current].isKind(type)) {
+    error(ErrorMsg);
+  }
+  return src[Current++];
+}
+
+void Parser::error(const char *ErrorMsg) {
+  if (Worker) {
+    throw string(ErrorMsg);
+  }
+  Current = std::min(Current, src.size() - 1);
+  auto [Line, Col] = File.getLineCol(File.getOffset(src[Current].Loc));
+  std::cerr << File.Name << ':' << Line << ':' << Col << ": " << ErrorMsg
+            << '\n';
+  for (size_t i = Current; i < src.size() && i < Current + 2; ++i) {
+    std::cout << src[i] << " '" << src[i].spelling(File) << "'\n";
   }
+  exit(1);
 }
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "passes.hpp"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+namespace ssa {
+
+static Value *stripPtrAdds(Value *P) {
+  while (P->Op == Opcode::PtrAdd) {
+    P = cast<Instr>(P)->operand(0);
+  }
+  return P;
+}
+
+Value *PointerRoot(Value *P) {
+  // Strength reduction makes pointer phis that step through one object;
+  // their root is that of everything that flows into them.
+  Value *Start = stripPtrAdds(P);
+  if (Start->Op != Opcode::Phi) {
+    return Start;
+  }
+  Value *Root = nullptr;
+  vector<Value *> Phis{Start};
+  for (size_t i = 0; i < Phis.size(); ++i) {
+    auto *Q = cast<Instr>(Phis[i]);
+    for (uint32_t j = 0; j < Q->NumOps; ++j) {
+      Value *V = stripPtrAdds(Q->operand(j));
+      if (V->Op != Opcode::Phi) {
+        if (Root != nullptr && Root != V) {
+          return Start;
+        }
+        Root = V;
+      } else if (find(Phis.begin(), Phis.end(), V) == Phis.end()) {
+        if (Phis.size() == 8) {
+          return Start;
+        }
+        Phis.push_back(V);
+      }
+    }
+  }
+  return Root ? Root : Start;
+}
+
+void ComputeEffects(Module &M) {
+  // Of the runtime library, only the array readers store through their
+  // arguments.
+  for (auto &F : M.Functions) {
+    if (F->isDeclaration()) {
+      string_view Name = F->Name.str();
+      F->WritesMemory = Name == "getarray" || Name == "getfarray";
+    } else {
+      F->WritesMemory = false;
+    }
+  }
+  // A function writes if it stores outside its own frame or calls one
+  // that writes; grown to a fixpoint for recursion.
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (auto &F : M.Functions) {
+      if (F->WritesMemory) {
+        continue;
+      }
+      for (Block *B : F->Blocks) {
+        for (Instr *I : *B) {
+          bool Writes = false;
+          if (I->Op == Opcode::Store || I->Op == Opcode::Zero) {
+            Value *P = I->operand(I->Op == Opcode::Store ? 1 : 0);
+            Writes = PointerRoot(P)->Op != Opcode::Alloca;
+          } else if (auto *C = dyn_cast<CallInstr>(I)) {
+            Writes = C->Callee->WritesMemory;
+          }
+          if (Writes) {
+            F->WritesMemory = Changed = true;
+            break;
+          }
+        }
+        if (F->WritesMemory) {
+          break;
+        }
+      }
+    }
+  }
+}
+
+void RemoveBlocks(Function &F, const vector<bool> &Live) {
+  for (Block *B : F.Blocks) {
+    if (Live[B->Id]) {
+      continue;
+    }
+    Instr *T = B->terminator();
+    for (unsigned i = 0; T != nullptr && i < T->numSuccessors(); ++i) {
+      Block *S = T->successor(i);
+      if (Live[S->Id]) {
+        S->removePred(find(S->Preds.begin(), S->Preds.end(), B) -
+                      S->Preds.begin());
+      }
+    }
+  }
+  // Dead blocks may use each other's values, so all operands go first.
+  for (Block *B : F.Blocks) {
+    if (!Live[B->Id]) {
+      for (Instr *I : *B) {
+        for (uint32_t i = 0; i < I->NumOps; ++i) {
+          I->Ops[i].set(nullptr);
+        }
+      }
+    }
+  }
+  F.removeBlocks(Live);
+}
+
+bool RemoveUnreachable(Function &F) {
+  vector<bool> Seen(F.NumBlocks);
+  vector<Block *> Stack{F.entry()};
+  Seen[F.entry()->Id] = true;
+  size_t Reached = 1;
+  while (!Stack.empty()) {
+    Instr *T = Stack.back()->terminator();
+    Stack.pop_back();
+    for (unsigned i = 0; T != nullptr && i < T->numSuccessors(); ++i) {
+      Block *S = T->successor(i);
+      if (!Seen[S->Id]) {
+        Seen[S->Id] = true;
+        Reached++;
+        Stack.push_back(S);
+      }
+    }
+  }
+  if (Reached == F.Blocks.size()) {
+    return false;
+  }
+  RemoveBlocks(F, Seen);
+  return true;
+}
+
+void JumpTo(Function &F, Block *B, Block *To) {
+  Instr *T = B->terminator();
+  bool Kept = false;
+  for (unsigned i = 0; i < T->numSuccessors(); ++i) {
+    Block *S = T->successor(i);
+    if (S == To && !Kept) {
+      Kept = true; // its edge and phi operands stay
+      continue;
+    }
+    S->removePred(find(S->Preds.begin(), S->Preds.end(), B) -
+                  S->Preds.begin());
+  }
+  F.erase(T);
+  Builder Build(F);
+  Build.setBlock(B);
+  Build.br(To);
+  if (Kept) {
+    To->Preds.erase(To->Preds.size() - 1); // added again by Builder::br
+    return;
+  }
+  for (Instr *I = To->First; I && I->Op == Opcode::Phi; I = I->Next) {
+    F.addIncoming(cast<Phi>(I), F.getUndef(I->Ty));
+  }
+}
+
+Block *SplitPreds(Function &F, Block *To, const vector<Block *> &From) {
+  Block *N = F.addBlock();
+  vector<size_t> Moved;
+  for (size_t i = 0; i < To->Preds.size(); ++i) {
+    if (find(From.begin(), From.end(), To->Preds[i]) != From.end()) {
+      Moved.push_back(i);
+      N->Preds.push_back(F.Storage, To->Preds[i]);
+    }
+  }
+  Builder Build(F);
+  vector<Value *> Incoming;
+  for (Instr *I = To->First; I && I->Op == Opcode::Phi; I = I->Next) {
+    if (Moved.size() == 1) {
+      Incoming.push_back(I->operand(Moved[0]));
+      continue;
+    }
+    Phi *P = Build.phi(I->Ty, N);
+    for (size_t i : Moved) {
+      F.addIncoming(P, I->operand(i));
+    }
+    Incoming.push_back(P);
+  }
+  for (auto It = Moved.rbegin(); It != Moved.rend(); ++It) {
+    To->removePred(*It);
+  }
+  size_t k = 0;
+  for (Instr *I = To->First; I && I->Op == Opcode::Phi; I = I->Next) {
+    F.addIncoming(cast<Phi>(I), Incoming[k++]);
+  }
+  for (Block *P : From) {
+    Instr *T = P->terminator();
+    for (unsigned i = 0; i < T->numSuccessors(); ++i) {
+      if (T->successor(i) == To) {
+        T->setSuccessor(i, N);
+      }
+    }
+  }
+  Build.setBlock(N);
+  Build.br(To);
+  return N;
+}
+
+void PassManager::run(Module &M) {
+  ComputeEffects(M);
+  for (auto &F : M.Functions) {
+    if (F->isDeclaration()) {
+      continue;
+    }
+    for (Entry &E : Passes) {
+      size_t Before = Counting ? F->numInstrs() : 0;
+      auto Start = chrono::steady_clock::now();
+      bool Changed = E.Run(*F);
+      chrono::duration<double> Elapsed = chrono::steady_clock::now() - Start;
+      E.Seconds += Elapsed.count();
+      E.Changed += Changed;
+      if (Counting) {
+        E.InstrsRemoved += int64_t(Before) - int64_t(F->numInstrs());
+      }
+    }
+  }
+}
+
+void PassManager::report(FILE *Out) const {
+  double Total = 0;
+  for (const Entry &E : Passes) {
+    Total += E.Seconds;
+  }
+  fprintf(Out, "%-12s %10s %6s %10s %10s\n", "pass", "seconds", "%",
+          "changed", "removed");
+  for (const Entry &E : Passes) {
+    fprintf(Out, "%-12s %10.6f %6.1f %10zu %10lld\n", E.Name, E.Seconds,
+            Total > 0 ? 100 * E.Seconds / Total : 0.0, E.Changed,
+            static_cast<long long>(E.InstrsRemoved));
+  }
+  fprintf(Out, "%-12s %10.6f\n", "total", Total);
+}
+
+void AddScalarPasses(PassManager &PM) {
+  PM.add("sccp", SCCP);
+  PM.add("gvn", GVN);
+  PM.add("adce", ADCE);
+  PM.add("simplifycfg", SimplifyCFG);
+}
+
+void AddLoopPasses(PassManager &PM, unsigned OptLevel) {
+  PM.add("rotate", RotateLoops);
+  PM.add("licm", LICM);
+  if (OptLevel == 0) {
+    PM.add("strength", StrengthReduce);
+  }
+}
+
+} // namespace ssa
@@ -0,0 +1,146 @@
+#include "resolve.hpp"
+#include "recursiveastvisitor.hpp"
+#include "symboltable.hpp"
+#include <format>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+bool IsRuntime(const Func *F) {
+  Span<Func> Runtime = RuntimeFunctions();
+  return F >= Runtime.begin() && F < Runtime.end();
+}
+
+struct Resolver : RecursiveASTVisitor<Resolver> {
+  const SourceManager &SM;
+  ScopedSymbolTable<NodeRef> Vars;
+  SymbolMap<Func *> Funcs;
+  Func *Current = nullptr; // the function being resolved
+
+  Resolver(const SourceManager &SM) : SM(SM) {
+    for (Func &F : RuntimeFunctions()) {
+      Funcs.set(F.function_name_, &F);
+    }
+  }
+
+  [[noreturn]] void fail(SourceLoc Loc, string_view Message) {
+    throw format("{}: {}", SM.describe(Loc), Message);
+  }
+
+  void declare(Symbol Name, NodeRef Decl, SourceLoc Loc) {
+    if (Vars.lookupLocal(Name) != nullptr) {
+      fail(Loc, format("Redefinition of '{}'.", Name.str()));
+    }
+    Vars.declare(Name, Decl);
+  }
+
+  // A function may be declared any number of times, but defined once, and
+  // the runtime functions are defined already.
+  void enterFunc(Func *F) {
+    Func **Prior = Funcs.find(F->function_name_);
+    if (Prior != nullptr && F->body_ != nullptr &&
+        ((*Prior)->body_ != nullptr || IsRuntime(*Prior))) {
+      fail(F->Loc,
+           format("Redefinition of function '{}'.", F->function_name_.str()));
+    }
+    if (Prior == nullptr || F->body_ != nullptr) {
+      Funcs.set(F->function_name_, F);
+    }
+    Current = F;
+    Vars.pushScope();
+  }
+  void leaveFunc(Func *) {
+    Vars.popScope();
+    Current = nullptr;
+  }
+
+  // After its dims, which may only refer to the names before it.
+  void leaveParam(Param *P) { declare(P->paraname_, P, P->Loc); }
+
+  void enterBlockStmt(BlockStmt *B) {
+    if (B != Current->body_) {
+      Vars.pushScope();
+    }
+  }
+  void leaveBlockStmt(BlockStmt *B) {
+    if (B != Current->body_) {
+      Vars.popScope();
+    }
+  }
+
+  // Before the initializer, which is the last slot.
+  void beforeDeclStmt(DeclStmt *D, unsigned i, NodeRef) {
+    if (i == D->Dims.size()) {
+      declare(D->VarName, static_cast<Stmt *>(D), D->Loc);
+    }
+  }
+
+  void enterVariableExpr(VariableExpr *E) {
+    const auto *B = Vars.lookup(E->VariName);
+    if (B == nullptr) {
+      fail(E->Loc,
+           format("Use of undeclared identifier '{}'.", E->VariName.str()));
+    }
+    E->Decl = B->Value;
+  }
+  void enterFunctionCallExpr(FunctionCallExpr *E) {
+    Func **F = Funcs.find(E->FuncName);
+    if (F == nullptr) {
+      fail(E->Loc,
+           format("Use of undeclared function '{}'.", E->FuncName.str()));
+    }
+    E->Callee = *F;
+  }
+};
+} // namespace
+
+void ResolveNames(Program &P, const SourceManager &SM) {
+  Resolver R(SM);
+  R.traverse(P);
+}
+
+Span<Func> RuntimeFunctions() {
+  struct Runtime {
+    Expr *Unsized[1] = {nullptr}; // the dims of an `int a[]` parameter
+    vector<Param> Params;
+    vector<Func> Funcs;
+
+    Runtime() {
+      Params.reserve(16); // Formals point into it
+      auto Add = [&](ReturnType Type, const char *Name,
+                     initializer_list<pair<BaseType, bool>> Types) {
+        size_t First = Params.size();
+        for (auto [Base, Array] : Types) {
+          Span<Expr *> Dims;
+          if (Array) {
+            Dims = Span<Expr *>(Unsized, 1);
+          }
+          Params.push_back({Base, Symbol(), Dims, SourceLoc()});
+        }
+        Span<Param> Formals(Params.data() + First, Params.size() - First);
+        Funcs.emplace_back(Type, Interner::global().intern(Name), Formals,
+                           nullptr);
+      };
+      const BaseType Int = BaseType::INT, Float = BaseType::FLOAT;
+      Add(ReturnType::INT, "getint", {});
+      Add(ReturnType::INT, "getch", {});
+      Add(ReturnType::FLOAT, "getfloat", {});
+      Add(ReturnType::INT, "input", {});
+      Add(ReturnType::INT, "getarray", {{Int, true}});
+      Add(ReturnType::INT, "getfarray", {{Float, true}});
+      Add(ReturnType::VOID, "putint", {{Int, false}});
+      Add(ReturnType::VOID, "putch", {{Int, false}});
+      Add(ReturnType::VOID, "putfloat", {{Float, false}});
+      Add(ReturnType::VOID, "putarray", {{Int, false}, {Int, true}});
+      Add(ReturnType::VOID, "putfarray", {{Int, false}, {Float, true}});
+      Add(ReturnType::VOID, "starttime", {});
+      Add(ReturnType::VOID, "stoptime", {});
+    }
+  };
+  static Runtime R;
+  return Span<Func>(R.Funcs.data(), R.Funcs.size());
+}
+
+} // namespace ast
@@ -0,0 +1,335 @@
+#include "passes.hpp"
+#include <algorithm>
+#include <bit>
+#include <climits>
+
+using namespace std;
+
+namespace ssa {
+
+static int32_t intOf(const Value *V) { return cast<ConstInt>(V)->V; }
+static float floatOf(const Value *V) { return cast<ConstFloat>(V)->V; }
+
+template <typename T> static bool compare(Pred P, T L, T R) {
+  switch (P) {
+  case Pred::Eq:
+    return L == R;
+  case Pred::Ne:
+    return L != R;
+  case Pred::Lt:
+    return L < R;
+  case Pred::Le:
+    return L <= R;
+  case Pred::Gt:
+    return L > R;
+  case Pred::Ge:
+    return L >= R;
+  }
+  return false;
+}
+
+Value *Fold(Function &F, const Instr *I, Value *const *Ops) {
+  auto Int = [&](uint32_t V) { return F.getInt(int32_t(V)); };
+  switch (I->Op) {
+  case Opcode::Add:
+    return Int(uint32_t(intOf(Ops[0])) + uint32_t(intOf(Ops[1])));
+  case Opcode::Sub:
+    return Int(uint32_t(intOf(Ops[0])) - uint32_t(intOf(Ops[1])));
+  case Opcode::Mul:
+    return Int(uint32_t(intOf(Ops[0])) * uint32_t(intOf(Ops[1])));
+  case Opcode::SDiv:
+  case Opcode::SRem: {
+    int32_t L = intOf(Ops[0]), R = intOf(Ops[1]);
+    if (R == 0 || (L == INT_MIN && R == -1)) {
+      return nullptr; // undefined; left for the program to trip over
+    }
+    return F.getInt(I->Op == Opcode::SDiv ? L / R : L % R);
+  }
+  case Opcode::FAdd:
+    return F.getFloat(floatOf(Ops[0]) + floatOf(Ops[1]));
+  case Opcode::FSub:
+    return F.getFloat(floatOf(Ops[0]) - floatOf(Ops[1]));
+  case Opcode::FMul:
+    return F.getFloat(floatOf(Ops[0]) * floatOf(Ops[1]));
+  case Opcode::FDiv:
+    return F.getFloat(floatOf(Ops[0]) / floatOf(Ops[1]));
+  case Opcode::FNeg:
+    return F.getFloat(-floatOf(Ops[0]));
+  case Opcode::ICmp:
+    return F.getBool(compare(I->P, intOf(Ops[0]), intOf(Ops[1])));
+  case Opcode::FCmp:
+    return F.getBool(compare(I->P, floatOf(Ops[0]), floatOf(Ops[1])));
+  case Opcode::ZExt:
+    return F.getInt(intOf(Ops[0]));
+  case Opcode::SIToFP:
+    return F.getFloat(float(intOf(Ops[0])));
+  case Opcode::FPToSI: {
+    float X = floatOf(Ops[0]);
+    if (!(X > -2147483904.0f && X < 2147483648.0f)) {
+      return nullptr; // out of range or NaN
+    }
+    return F.getInt(int32_t(X));
+  }
+  default:
+    return nullptr;
+  }
+}
+
+// Element `Index` of the global `G`, or zero if no run covers it.
+static uint32_t wordAt(const Global *G, uint64_t Index) {
+  auto *R = partition_point(G->Runs.begin(), G->Runs.end(),
+                            [&](const ast::ArrayInit::Run &R) {
+                              return R.Start + R.Size <= Index;
+                            });
+  if (R == G->Runs.end() || R->Start > Index) {
+    return 0;
+  }
+  return G->Words[R->Offset + (Index - R->Start)];
+}
+
+namespace {
+struct Solver {
+  enum State : uint8_t { Unknown, Constant, Overdefined };
+
+  Function &F;
+  vector<State> States;  // by Value::Id of the instructions
+  vector<Value *> Known; // the constant of each Constant one
+  vector<bool> Executable; // by Block::Id
+  vector<bool> Feasible; // by Block::Id * 2 + successor
+  vector<Block *> EdgeWork; // the targets of new edges
+  vector<Instr *> InstrWork;
+  vector<Instr *> Users; // scratch for set
+
+  explicit Solver(Function &F)
+      : F(F), States(F.NumValues, Unknown), Known(F.NumValues),
+        Executable(F.NumBlocks), Feasible(F.NumBlocks * 2) {}
+
+  // The state of an operand; constants are their own.
+  State state(Value *V, Value *&C) {
+    if (auto *I = dyn_cast<Instr>(V)) {
+      C = Known[I->Id];
+      return States[I->Id];
+    }
+    if (V->Op == Opcode::ConstInt || V->Op == Opcode::ConstFloat) {
+      C = V;
+      return Constant;
+    }
+    C = nullptr;
+    return Overdefined; // arguments, globals and undef
+  }
+
+  void set(Instr *I, State S, Value *C) {
+    if (States[I->Id] == Constant && S == Constant && Known[I->Id] != C) {
+      S = Overdefined;
+    }
+    if (S <= States[I->Id]) {
+      return;
+    }
+    States[I->Id] = S;
+    Known[I->Id] = S == Constant ? C : nullptr;
+    // Loads see through the addresses they are computed from.
+    Users.push_back(I);
+    while (!Users.empty()) {
+      Instr *U = Users.back();
+      Users.pop_back();
+      for (Use *Us = U->Uses; Us != nullptr; Us = Us->Next) {
+        InstrWork.push_back(Us->User);
+        if (Us->User->Op == Opcode::PtrAdd) {
+          Users.push_back(Us->User);
+        }
+      }
+    }
+  }
+
+  // Successor `i` of `From` can be taken.
+  void edge(Block *From, unsigned i) {
+    if (!Feasible[From->Id * 2 + i]) {
+      Feasible[From->Id * 2 + i] = true;
+      EdgeWork.push_back(From->terminator()->successor(i));
+    }
+  }
+  // A new edge into `To` makes it executable, or changes its phis.
+  void reach(Block *To) {
+    if (!Executable[To->Id]) {
+      Executable[To->Id] = true;
+      for (Instr *I : *To) {
+        visit(I);
+      }
+      return;
+    }
+    for (Instr *I = To->First; I && I->Op == Opcode::Phi; I = I->Next) {
+      visit(I);
+    }
+  }
+  bool executable(Block *From, Block *To) const {
+    Instr *T = From->terminator();
+    for (unsigned i = 0; i < T->numSuccessors(); ++i) {
+      if (T->successor(i) == To && Feasible[From->Id * 2 + i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The constant a load from a const global reads, found by walking its
+  // address back through PtrAdds with constant indices.
+  void load(Instr *I) {
+    uint64_t Offset = 0;
+    Value *P = I->operand(0);
+    while (P->Op == Opcode::PtrAdd) {
+      auto *Add = cast<Instr>(P);
+      Value *C;
+      State S = state(Add->operand(1), C);
+      if (S != Constant) {
+        set(I, S, nullptr);
+        return;
+      }
+      Offset += int64_t(intOf(C)) * Add->Imm;
+      P = Add->operand(0);
+    }
+    auto *G = dyn_cast<GlobalAddr>(P);
+    if (G == nullptr || !G->G->IsConst || Offset % 4 != 0 ||
+        Offset >= G->G->Bytes || I->Ty != G->G->Elem) {
+      set(I, Overdefined, nullptr);
+      return;
+    }
+    uint32_t W = wordAt(G->G, Offset / 4);
+    if (I->Ty == Type::F32) {
+      set(I, Constant, F.getFloat(bit_cast<float>(W)));
+    } else {
+      set(I, Constant, F.getInt(int32_t(W)));
+    }
+  }
+
+  void visit(Instr *I) {
+    Block *B = I->Parent;
+    switch (I->Op) {
+    case Opcode::Br:
+      edge(B, 0);
+      return;
+    case Opcode::CondBr: {
+      Value *C;
+      State S = state(I->operand(0), C);
+      if (S == Overdefined) {
+        edge(B, 0);
+        edge(B, 1);
+      } else if (S == Constant) {
+        edge(B, intOf(C) ? 0 : 1);
+      }
+      return;
+    }
+    case Opcode::Phi: {
+      State S = Unknown;
+      Value *Same = nullptr;
+      for (uint32_t i = 0; i < I->NumOps && S != Overdefined; ++i) {
+        if (!executable(B->Preds[i], B)) {
+          continue;
+        }
+        Value *C;
+        State Op = state(I->operand(i), C);
+        if (Op == Overdefined || (Op == Constant && Same && Same != C)) {
+          S = Overdefined;
+        } else if (Op == Constant) {
+          S = Constant;
+          Same = C;
+        }
+      }
+      set(I, S, Same);
+      return;
+    }
+    case Opcode::Load:
+      load(I);
+      return;
+    case Opcode::PtrAdd: {
+      // Unknown while its index is, so loads are revisited when it is
+      // known; otherwise a pointer, which is no constant.
+      Value *C;
+      bool Pending = state(I->operand(1), C) == Unknown;
+      if (I->operand(0)->Op == Opcode::PtrAdd) {
+        Pending |= state(I->operand(0), C) == Unknown;
+      }
+      set(I, Pending ? Unknown : Overdefined, nullptr);
+      return;
+    }
+    default:
+      break;
+    }
+    if (!foldable(I->Op)) {
+      if (I->Ty != Type::Void) {
+        set(I, Overdefined, nullptr); // allocas and calls
+      }
+      return;
+    }
+    Value *Ops[2];
+    for (uint32_t i = 0; i < I->NumOps; ++i) {
+      State S = state(I->operand(i), Ops[i]);
+      if (S != Constant) {
+        set(I, S, nullptr);
+        return;
+      }
+    }
+    Value *C = Fold(F, I, Ops);
+    set(I, C ? Constant : Overdefined, C);
+  }
+
+  static bool foldable(Opcode Op) {
+    return Op >= Opcode::Add && Op <= Opcode::FPToSI;
+  }
+
+  void solve() {
+    EdgeWork.push_back(F.entry());
+    while (!EdgeWork.empty() || !InstrWork.empty()) {
+      if (!EdgeWork.empty()) {
+        Block *To = EdgeWork.back();
+        EdgeWork.pop_back();
+        reach(To);
+        continue;
+      }
+      Instr *I = InstrWork.back();
+      InstrWork.pop_back();
+      if (Executable[I->Parent->Id]) {
+        visit(I);
+      }
+    }
+  }
+};
+} // namespace
+
+bool SCCP(Function &F) {
+  Solver S(F);
+  S.solve();
+  bool Changed = false;
+  // Branches that can only go one way become jumps.
+  for (Block *B : F.Blocks) {
+    Instr *T = B->terminator();
+    if (!S.Executable[B->Id] || T->Op != Opcode::CondBr) {
+      continue;
+    }
+    bool Then = S.Feasible[B->Id * 2], Else = S.Feasible[B->Id * 2 + 1];
+    if (Then == Else) {
+      continue;
+    }
+    JumpTo(F, B, T->successor(Then ? 0 : 1));
+    Changed = true;
+  }
+  if (any_of(F.Blocks.begin(), F.Blocks.end(),
+             [&](Block *B) { return !S.Executable[B->Id]; })) {
+    RemoveBlocks(F, S.Executable);
+    Changed = true;
+  }
+  for (Block *B : F.Blocks) {
+    for (Instr *I : *B) {
+      if (S.States[I->Id] != Solver::Constant) {
+        continue;
+      }
+      I->replaceAllUsesWith(S.Known[I->Id]);
+      if (!I->hasSideEffects()) {
+        F.erase(I);
+      }
+      Changed = true;
+    }
+  }
+  return Changed;
+}
+
+} // namespace ssa
@@ -0,0 +1,87 @@
+#include "passes.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace ssa {
+
+// Points the edge of `From` into `Old` at `New` instead.
+static void retarget(Block *From, Block *Old, Block *New) {
+  Instr *T = From->terminator();
+  for (unsigned i = 0; i < T->numSuccessors(); ++i) {
+    if (T->successor(i) == Old) {
+      T->setSuccessor(i, New);
+    }
+  }
+}
+
+bool SimplifyCFG(Function &F) {
+  bool Changed = false;
+  vector<bool> Live(F.NumBlocks, true);
+  for (Block *B : F.Blocks) {
+    if (B == F.entry()) {
+      continue;
+    }
+    // A block entered one way needs no phis.
+    if (B->Preds.size() == 1) {
+      while (B->First->Op == Opcode::Phi) {
+        Instr *P = B->First;
+        P->replaceAllUsesWith(P->operand(0));
+        F.erase(P);
+        Changed = true;
+      }
+    }
+    // Merged into its only predecessor, if that only jumps to it.
+    if (B->Preds.size() == 1 && B->Preds[0] != B &&
+        B->Preds[0]->terminator()->Op == Opcode::Br) {
+      Block *P = B->Preds[0];
+      F.erase(P->terminator());
+      while (Instr *I = B->First) {
+        B->unlink(I);
+        P->insert(I);
+      }
+      Instr *T = P->terminator();
+      for (unsigned i = 0; i < T->numSuccessors(); ++i) {
+        Block *S = T->successor(i);
+        replace(S->Preds.begin(), S->Preds.end(), B, P);
+      }
+      Live[B->Id] = false;
+      Changed = true;
+      continue;
+    }
+    // Bypassed if it only jumps on, when its successor can take its
+    // edges without phis to tell them apart.
+    Instr *T = B->terminator();
+    if (B->First != T || T->Op != Opcode::Br || T->successor(0) == B) {
+      continue;
+    }
+    Block *S = T->successor(0);
+    size_t Edge = find(S->Preds.begin(), S->Preds.end(), B) - S->Preds.begin();
+    if (S == F.entry()) {
+      continue;
+    } else if (S->First->Op != Opcode::Phi) {
+      S->removePred(Edge);
+      for (Block *P : B->Preds) {
+        S->Preds.push_back(F.Storage, P); // one per edge, as in B
+      }
+    } else if (B->Preds.size() == 1 &&
+               find(S->Preds.begin(), S->Preds.end(), B->Preds[0]) ==
+                   S->Preds.end()) {
+      S->Preds[Edge] = B->Preds[0]; // the phis keep their operand
+    } else {
+      continue;
+    }
+    for (Block *P : B->Preds) {
+      retarget(P, B, S);
+    }
+    F.erase(T);
+    Live[B->Id] = false;
+    Changed = true;
+  }
+  if (Changed) {
+    F.removeBlocks(Live);
+  }
+  return Changed;
+}
+
+} // namespace ssa
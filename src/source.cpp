@@ -0,0 +1,160 @@
+#include "source.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+SourceFile::~SourceFile() {
+  if (Mapping != nullptr) {
+    munmap(Mapping, MappingSize);
+  }
+}
+
+pair<uint32_t, uint32_t> SourceFile::getLineCol(uint32_t Offset) const {
+  if (LineOffsets.empty()) {
+    LineOffsets.push_back(0);
+    const char *p = Data, *End = Data + Size;
+    while ((p = static_cast<const char *>(memchr(p, '\n', End - p)))) {
+      ++p;
+      LineOffsets.push_back(p - Data);
+    }
+  }
+  auto It = upper_bound(LineOffsets.begin(), LineOffsets.end(), Offset);
+  uint32_t Line = It - LineOffsets.begin();
+  return {Line, Offset - LineOffsets[Line - 1] + 1};
+}
+
+// Maps a regular file so that at least SourcePadding zero bytes follow it:
+// an anonymous zero-filled region is reserved first and the file is mapped
+// over its beginning. The tail of the file's last page is zero as well.
+static void *MapFile(int fd, size_t Size, size_t &MappingSize) {
+  size_t Page = sysconf(_SC_PAGESIZE);
+  MappingSize = (Size + SourcePadding + Page - 1) / Page * Page;
+  void *Region = mmap(nullptr, MappingSize, PROT_READ,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (Region == MAP_FAILED) {
+    return nullptr;
+  }
+  if (mmap(Region, Size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+      MAP_FAILED) {
+    munmap(Region, MappingSize);
+    return nullptr;
+  }
+#ifdef MADV_SEQUENTIAL
+  madvise(Region, Size, MADV_SEQUENTIAL);
+#endif
+  return Region;
+}
+
+// Reads everything from `fd` into one padded buffer. `SizeHint` is the file
+// size when it is known, in which case a single read() normally suffices.
+static unique_ptr<char[]> ReadAll(int fd, size_t SizeHint, size_t &Size) {
+  size_t Capacity = SizeHint > 0 ? SizeHint : 64 * 1024;
+  unique_ptr<char[]> Buffer(new char[Capacity + SourcePadding]);
+  Size = 0;
+  while (true) {
+    if (Size == Capacity) {
+      if (SizeHint > 0) {
+        break;
+      }
+      unique_ptr<char[]> Bigger(new char[2 * Capacity + SourcePadding]);
+      memcpy(Bigger.get(), Buffer.get(), Size);
+      Buffer = std::move(Bigger);
+      Capacity *= 2;
+    }
+    ssize_t n = read(fd, Buffer.get() + Size, Capacity - Size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      if (n < 0) {
+        return nullptr;
+      }
+      break;
+    }
+    Size += n;
+  }
+  memset(Buffer.get() + Size, 0, SourcePadding);
+  return Buffer;
+}
+
+uint32_t SourceManager::LoadFile(const char *Path) {
+  bool IsStdin = strcmp(Path, "-") == 0;
+  int fd = IsStdin ? STDIN_FILENO : open(Path, O_RDONLY);
+  if (fd < 0) {
+    throw format("Cannot open '{}': {}.", Path, strerror(errno));
+  }
+  auto File = make_unique<SourceFile>(IsStdin ? "<stdin>" : Path);
+
+  struct stat St;
+  bool Regular = fstat(fd, &St) == 0 && S_ISREG(St.st_mode);
+  size_t Size = Regular ? St.st_size : 0;
+  if (Regular && Size > 0) {
+    File->Mapping = MapFile(fd, Size, File->MappingSize);
+  }
+  if (File->Mapping != nullptr) {
+    File->Data = static_cast<const char *>(File->Mapping);
+  } else {
+    // Pipes, stdin or a failed mapping.
+    File->Buffer = ReadAll(fd, Size, Size);
+    File->Data = File->Buffer.get();
+  }
+  int Error = errno;
+  if (!IsStdin) {
+    close(fd);
+  }
+  if (File->Data == nullptr) {
+    throw format("Cannot read '{}': {}.", Path, strerror(Error));
+  }
+  if (Size >= UINT32_MAX - SourcePadding) {
+    throw format("'{}' is too large.", Path);
+  }
+  File->Size = Size;
+  return addFile(std::move(File));
+}
+
+uint32_t SourceManager::AddBuffer(string Name, string_view Contents) {
+  auto File = make_unique<SourceFile>(std::move(Name));
+  File->Buffer.reset(new char[Contents.size() + SourcePadding]);
+  memcpy(File->Buffer.get(), Contents.data(), Contents.size());
+  memset(File->Buffer.get() + Contents.size(), 0, SourcePadding);
+  File->Data = File->Buffer.get();
+  File->Size = Contents.size();
+  return addFile(std::move(File));
+}
+
+uint32_t SourceManager::addFile(unique_ptr<SourceFile> File) {
+  if (uint64_t(NextBase) + File->Size + 1 > UINT32_MAX) {
+    throw format("Too much source: '{}' does not fit in the 4 GiB location "
+                 "space.",
+                 File->Name);
+  }
+  File->Base = NextBase;
+  NextBase += File->Size + 1;
+  Files.push_back(std::move(File));
+  return Files.size() - 1;
+}
+
+const SourceFile &SourceManager::getFile(SourceLoc Loc) const {
+  // Files are laid out in the order they were added.
+  auto It = upper_bound(Files.begin(), Files.end(), Loc.Raw,
+                        [](uint32_t Raw, const unique_ptr<SourceFile> &F) {
+                          return Raw < F->Base;
+                        });
+  return **(It - 1);
+}
+
+string SourceManager::describe(SourceLoc Loc) const {
+  if (!Loc.isValid()) {
+    return "<unknown>";
+  }
+  const SourceFile &File = getFile(Loc);
+  auto [Line, Col] = File.getLineCol(File.getOffset(Loc));
+  return format("{}:{}:{}", File.Name, Line, Col);
+}
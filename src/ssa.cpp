@@ -0,0 +1,457 @@
+#include "ssa.hpp"
+#include <bit>
+#include <cassert>
+
+using namespace std;
+
+namespace ssa {
+
+const char *TypeName(Type T) {
+  switch (T) {
+  case Type::Void:
+    return "void";
+  case Type::I1:
+    return "i1";
+  case Type::I32:
+    return "i32";
+  case Type::F32:
+    return "f32";
+  case Type::Ptr:
+    return "ptr";
+  }
+  return "?";
+}
+
+const char *OpcodeName(Opcode Op) {
+  static const char *const Names[] = {
+      "arg",    "const",  "const", "global", "undef", "add",    "sub",
+      "mul",    "sdiv",   "srem",  "fadd",   "fsub",  "fmul",   "fdiv",
+      "fneg",   "icmp",   "fcmp",  "zext",   "sitofp", "fptosi", "alloca",
+      "load",   "store",  "zero",  "ptradd", "call",  "phi",    "br",
+      "condbr", "ret"};
+  static_assert(size(Names) == size_t(Opcode::Ret) + 1);
+  return Names[size_t(Op)];
+}
+
+const char *PredName(Pred P) {
+  static const char *const Names[] = {"eq", "ne", "lt", "le", "gt", "ge"};
+  return Names[size_t(P)];
+}
+
+void Use::set(Value *V) {
+  if (Val != nullptr) {
+    *Prev = Next;
+    if (Next != nullptr) {
+      Next->Prev = Prev;
+    }
+  }
+  Val = V;
+  if (V != nullptr) {
+    Next = V->Uses;
+    if (Next != nullptr) {
+      Next->Prev = &Next;
+    }
+    Prev = &V->Uses;
+    V->Uses = this;
+  }
+}
+
+unsigned Instr::numSuccessors() const {
+  return Op == Opcode::Br ? 1 : Op == Opcode::CondBr ? 2 : 0;
+}
+Block *Instr::successor(unsigned i) const {
+  return static_cast<const Branch *>(this)->Succ[i];
+}
+void Instr::setSuccessor(unsigned i, Block *B) {
+  static_cast<Branch *>(this)->Succ[i] = B;
+}
+
+void Block::insert(Instr *I, Instr *Before) {
+  I->Parent = this;
+  I->Next = Before;
+  I->Prev = Before ? Before->Prev : Last;
+  (I->Prev ? I->Prev->Next : First) = I;
+  (Before ? Before->Prev : Last) = I;
+}
+
+void Block::unlink(Instr *I) {
+  (I->Prev ? I->Prev->Next : First) = I->Next;
+  (I->Next ? I->Next->Prev : Last) = I->Prev;
+  I->Prev = I->Next = nullptr;
+  I->Parent = nullptr;
+}
+
+Instr *Block::firstNonPhi() const {
+  Instr *I = First;
+  while (I != nullptr && I->Op == Opcode::Phi) {
+    I = I->Next;
+  }
+  return I;
+}
+
+void Block::removePred(size_t i) {
+  Preds.erase(i);
+  for (Instr *I = First; I != nullptr && I->Op == Opcode::Phi; I = I->Next) {
+    for (uint32_t j = i; j + 1 < I->NumOps; ++j) {
+      I->Ops[j].set(I->Ops[j + 1].Val);
+    }
+    I->Ops[--I->NumOps].set(nullptr);
+  }
+}
+
+Argument *Function::addArg(Type Ty) {
+  Args.push_back(Storage.New<Argument>(Ty, NumValues++, Args.size()));
+  return Args.back();
+}
+
+Block *Function::createBlock() {
+  return Storage.New<Block>(NumBlocks++, this);
+}
+
+Value *Function::constant(uint64_t Key, Value *(*Make)(Function &, uint64_t)) {
+  auto [It, New] = Constants.try_emplace(Key, nullptr);
+  if (New) {
+    It->second = Make(*this, Key);
+  }
+  return It->second;
+}
+
+// The keys put the opcode, and the type for I32/I1 and Undef, above the
+// 32 bits of the value.
+ConstInt *Function::getInt(int32_t V) {
+  uint64_t Key = uint64_t(Opcode::ConstInt) << 40 | uint32_t(V);
+  return static_cast<ConstInt *>(constant(Key, [](Function &F, uint64_t K) {
+    return static_cast<Value *>(
+        F.Storage.New<ConstInt>(Type::I32, F.NumValues++, int32_t(K)));
+  }));
+}
+
+ConstInt *Function::getBool(bool V) {
+  uint64_t Key = uint64_t(Opcode::ConstInt) << 40 | 1ull << 32 | V;
+  return static_cast<ConstInt *>(constant(Key, [](Function &F, uint64_t K) {
+    return static_cast<Value *>(
+        F.Storage.New<ConstInt>(Type::I1, F.NumValues++, int32_t(K & 1)));
+  }));
+}
+
+ConstFloat *Function::getFloat(float V) {
+  uint64_t Key = uint64_t(Opcode::ConstFloat) << 40 | bit_cast<uint32_t>(V);
+  return static_cast<ConstFloat *>(constant(Key, [](Function &F, uint64_t K) {
+    float V = bit_cast<float>(uint32_t(K));
+    return static_cast<Value *>(F.Storage.New<ConstFloat>(F.NumValues++, V));
+  }));
+}
+
+GlobalAddr *Function::getGlobal(Global *G) {
+  // User-space pointers fit below the opcode in the top byte.
+  uint64_t Key = uint64_t(Opcode::GlobalAddr) << 56 |
+                 reinterpret_cast<uintptr_t>(G);
+  auto [It, New] = Constants.try_emplace(Key, nullptr);
+  if (New) {
+    It->second = Storage.New<GlobalAddr>(NumValues++, G);
+  }
+  return static_cast<GlobalAddr *>(It->second);
+}
+
+Undef *Function::getUndef(Type Ty) {
+  uint64_t Key = uint64_t(Opcode::Undef) << 40 | uint64_t(Ty);
+  return static_cast<Undef *>(constant(Key, [](Function &F, uint64_t K) {
+    return static_cast<Value *>(
+        F.Storage.New<Undef>(Type(K & 0xff), F.NumValues++));
+  }));
+}
+
+void Function::addIncoming(Phi *P, Value *V) {
+  if (P->NumOps == P->Capacity) {
+    uint32_t Capacity = P->Capacity == 0 ? 2 : P->Capacity * 2;
+    Use *Ops = static_cast<Use *>(
+        Storage.Allocate(Capacity * sizeof(Use), alignof(Use)));
+    for (uint32_t i = 0; i < Capacity; ++i) {
+      new (&Ops[i]) Use{nullptr, P, nullptr, nullptr};
+    }
+    for (uint32_t i = 0; i < P->NumOps; ++i) {
+      Ops[i].set(P->Ops[i].Val);
+      P->Ops[i].set(nullptr);
+    }
+    P->Ops = Ops;
+    P->Capacity = Capacity;
+  }
+  P->Ops[P->NumOps++].set(V);
+}
+
+void Function::erase(Instr *I) {
+  assert(!I->hasUses() && "erasing a used instruction");
+  for (uint32_t i = 0; i < I->NumOps; ++i) {
+    I->Ops[i].set(nullptr);
+  }
+  if (I->Parent != nullptr) {
+    I->Parent->unlink(I);
+  }
+}
+
+void Function::removeBlocks(const vector<bool> &Keep) {
+  size_t N = 0;
+  for (Block *B : Blocks) {
+    if (Keep[B->Id]) {
+      Blocks[N++] = B;
+    }
+  }
+  Blocks.resize(N);
+}
+
+size_t Function::numInstrs() const {
+  size_t N = 0;
+  for (const Block *B : Blocks) {
+    for (const Instr *I = B->First; I != nullptr; I = I->Next) {
+      N++;
+    }
+  }
+  return N;
+}
+
+size_t Module::numInstrs() const {
+  size_t N = 0;
+  for (const auto &F : Functions) {
+    N += F->numInstrs();
+  }
+  return N;
+}
+
+size_t Module::bytesReserved() const {
+  size_t N = Storage.BytesReserved();
+  for (const auto &F : Functions) {
+    N += F->Storage.BytesReserved();
+  }
+  return N;
+}
+
+template <typename T>
+T *Builder::append(Opcode Op, Type Ty, initializer_list<Value *> Ops) {
+  T *I = F.create<T>(Op, Ty, Ops.size());
+  unsigned i = 0;
+  for (Value *V : Ops) {
+    I->Ops[i++].set(V);
+  }
+  BB->insert(I, Before);
+  return I;
+}
+
+Instr *Builder::binary(Opcode Op, Value *L, Value *R) {
+  return append(Op, L->Ty, {L, R});
+}
+
+Instr *Builder::unary(Opcode Op, Type Ty, Value *X) {
+  return append(Op, Ty, {X});
+}
+
+Instr *Builder::cmp(Pred P, Value *L, Value *R) {
+  Opcode Op = L->Ty == Type::F32 ? Opcode::FCmp : Opcode::ICmp;
+  Instr *I = append(Op, Type::I1, {L, R});
+  I->P = P;
+  return I;
+}
+
+Instr *Builder::alloca(uint32_t Bytes) {
+  Instr *I = append(Opcode::Alloca, Type::Ptr, {});
+  I->Imm = Bytes;
+  return I;
+}
+
+Instr *Builder::load(Type Ty, Value *Ptr) {
+  return append(Opcode::Load, Ty, {Ptr});
+}
+
+Instr *Builder::store(Value *V, Value *Ptr) {
+  return append(Opcode::Store, Type::Void, {V, Ptr});
+}
+
+Instr *Builder::zero(Value *Ptr, uint32_t Bytes) {
+  Instr *I = append(Opcode::Zero, Type::Void, {Ptr});
+  I->Imm = Bytes;
+  return I;
+}
+
+Instr *Builder::ptrAdd(Value *Ptr, Value *Index, uint32_t Size) {
+  Instr *I = append(Opcode::PtrAdd, Type::Ptr, {Ptr, Index});
+  I->Imm = Size;
+  return I;
+}
+
+CallInstr *Builder::call(Function *Callee, Span<Value *> Args) {
+  CallInstr *I = F.create<CallInstr>(Opcode::Call, Callee->RetTy, Args.size());
+  for (size_t i = 0; i < Args.size(); ++i) {
+    I->Ops[i].set(Args[i]);
+  }
+  I->Callee = Callee;
+  BB->insert(I, Before);
+  return I;
+}
+
+Phi *Builder::phi(Type Ty, Block *B) {
+  Phi *P = F.create<Phi>(Opcode::Phi, Ty, 0);
+  B->insert(P, B->First);
+  return P;
+}
+
+Branch *Builder::br(Block *To) {
+  Branch *I = append<Branch>(Opcode::Br, Type::Void, {});
+  I->Succ[0] = To;
+  To->Preds.push_back(F.Storage, BB);
+  return I;
+}
+
+Branch *Builder::condBr(Value *Cond, Block *Then, Block *Else) {
+  Branch *I = append<Branch>(Opcode::CondBr, Type::Void, {Cond});
+  I->Succ[0] = Then;
+  I->Succ[1] = Else;
+  Then->Preds.push_back(F.Storage, BB);
+  Else->Preds.push_back(F.Storage, BB);
+  return I;
+}
+
+Instr *Builder::ret(Value *V) {
+  if (V == nullptr) {
+    return append(Opcode::Ret, Type::Void, {});
+  }
+  return append(Opcode::Ret, Type::Void, {V});
+}
+
+namespace {
+struct Printer {
+  const Function &F;
+  OutputSink &Out;
+
+  void value(const Value *V) {
+    switch (V->Op) {
+    case Opcode::ConstInt:
+      if (V->Ty == Type::I1) {
+        Out << (cast<ConstInt>(V)->V ? "true" : "false");
+      } else {
+        Out.writeInt(cast<ConstInt>(V)->V);
+      }
+      return;
+    case Opcode::ConstFloat:
+      Out.writeFloatExact(cast<ConstFloat>(V)->V);
+      Out << 'f';
+      return;
+    case Opcode::GlobalAddr:
+      Out << '@' << cast<GlobalAddr>(V)->G->Name;
+      return;
+    case Opcode::Undef:
+      Out << "undef";
+      return;
+    default:
+      Out << '%';
+      Out.writeInt(V->Id);
+    }
+  }
+
+  void block(const Block *B) {
+    Out << 'b';
+    Out.writeInt(B->Id);
+  }
+
+  void instr(const Instr *I) {
+    Out << "  ";
+    if (I->Ty != Type::Void) {
+      value(I);
+      Out << " = ";
+    }
+    Out << OpcodeName(I->Op);
+    if (I->Op == Opcode::ICmp || I->Op == Opcode::FCmp) {
+      Out << ' ' << PredName(I->P);
+    }
+    if (I->Ty != Type::Void) {
+      Out << ' ' << TypeName(I->Ty);
+    }
+    if (auto *C = dyn_cast<CallInstr>(I)) {
+      Out << " @" << C->Callee->Name;
+    }
+    for (uint32_t i = 0; i < I->NumOps; ++i) {
+      Out << (i ? ", " : " ");
+      if (I->Op == Opcode::Phi) {
+        Out << '[';
+        value(I->operand(i));
+        Out << ", ";
+        block(I->Parent->Preds[i]);
+        Out << ']';
+      } else {
+        value(I->operand(i));
+      }
+    }
+    if (I->Op == Opcode::Alloca || I->Op == Opcode::Zero ||
+        I->Op == Opcode::PtrAdd) {
+      Out << (I->NumOps ? " x " : " ");
+      Out.writeInt(I->Imm);
+    }
+    for (unsigned i = 0; i < I->numSuccessors(); ++i) {
+      Out << (i || I->NumOps ? ", " : " ");
+      block(I->successor(i));
+    }
+    Out << '\n';
+  }
+
+  void print() {
+    Out << (F.isDeclaration() ? "declare " : "func ") << TypeName(F.RetTy)
+        << " @" << F.Name << '(';
+    for (const Argument *A : F.Args) {
+      Out << (A->Index ? ", " : "") << TypeName(A->Ty) << ' ';
+      value(A);
+    }
+    Out << ')';
+    if (F.isDeclaration()) {
+      Out << '\n';
+      return;
+    }
+    Out << " {\n";
+    for (const Block *B : F.Blocks) {
+      block(B);
+      Out << ':';
+      if (!B->Preds.empty()) {
+        Out << " ; preds";
+        for (const Block *P : B->Preds) {
+          Out << ' ';
+          block(P);
+        }
+      }
+      Out << '\n';
+      for (const Instr *I : *B) {
+        instr(I);
+      }
+    }
+    Out << "}\n";
+  }
+};
+} // namespace
+
+void Print(const Function &F, OutputSink &Out) {
+  Printer P{F, Out};
+  P.print();
+}
+
+void Print(const Module &M, OutputSink &Out) {
+  for (const Global *G : M.Globals) {
+    Out << "global " << TypeName(G->Elem) << " @" << G->Name << " x ";
+    Out.writeInt(G->Bytes / 4);
+    for (const ast::ArrayInit::Run &R : G->Runs) {
+      Out << " [";
+      Out.writeInt(R.Start);
+      Out << ']';
+      for (uint32_t i = 0; i < R.Size; ++i) {
+        Out << ' ';
+        uint32_t W = G->Words[R.Offset + i];
+        if (G->Elem == Type::F32) {
+          Out.writeFloatExact(bit_cast<float>(W));
+        } else {
+          Out.writeInt(int32_t(W));
+        }
+      }
+    }
+    Out << '\n';
+  }
+  for (const auto &F : M.Functions) {
+    Print(*F, Out);
+  }
+}
+
+} // namespace ssa
@@ -0,0 +1,284 @@
+#include "codegen.hpp"
+#include "dominators.hpp"
+#include <format>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ssa {
+
+namespace {
+struct Codegen {
+  const Module &M;
+  llvm::LLVMContext &Ctx;
+  std::unique_ptr<llvm::Module> Out;
+  llvm::IRBuilder<> B;
+  llvm::Type *I8, *I32, *I64, *F32;
+  llvm::PointerType *Ptr;
+
+  unordered_map<const Global *, llvm::Constant *> Globals; // as i8*
+  unordered_map<const Function *, llvm::Function *> Functions;
+
+  // The function being emitted.
+  llvm::Function *Fn = nullptr;
+  vector<llvm::Value *> Values;      // by Value::Id
+  vector<llvm::BasicBlock *> Blocks; // by Block::Id
+
+  Codegen(const Module &M, llvm::LLVMContext &Ctx, string_view Name)
+      : M(M), Ctx(Ctx),
+        Out(std::make_unique<llvm::Module>(llvm::StringRef(Name), Ctx)),
+        B(Ctx), I8(B.getInt8Ty()), I32(B.getInt32Ty()), I64(B.getInt64Ty()),
+        F32(B.getFloatTy()), Ptr(B.getInt8PtrTy()) {}
+
+  llvm::Type *type(Type T) {
+    switch (T) {
+    case Type::Void:
+      return B.getVoidTy();
+    case Type::I1:
+      return B.getInt1Ty();
+    case Type::I32:
+      return I32;
+    case Type::F32:
+      return F32;
+    case Type::Ptr:
+      return Ptr;
+    }
+    return nullptr;
+  }
+
+  // A global is a packed struct of its runs and the zeros between them,
+  // so a large sparse array costs about as much as its runs.
+  void global(const Global *G) {
+    llvm::Type *Elem = type(G->Elem);
+    vector<llvm::Constant *> Parts;
+    auto Zeros = [&](uint64_t N) {
+      if (N != 0) {
+        auto *T = llvm::ArrayType::get(Elem, N);
+        Parts.push_back(llvm::ConstantAggregateZero::get(T));
+      }
+    };
+    uint64_t At = 0;
+    for (const ast::ArrayInit::Run &R : G->Runs) {
+      Zeros(R.Start - At);
+      vector<llvm::Constant *> Elements;
+      for (uint32_t i = 0; i < R.Size; ++i) {
+        uint32_t W = G->Words[R.Offset + i];
+        Elements.push_back(
+            G->Elem == Type::F32
+                ? llvm::ConstantFP::get(F32, bit_cast<float>(W))
+                : static_cast<llvm::Constant *>(B.getInt32(W)));
+      }
+      auto *T = llvm::ArrayType::get(Elem, R.Size);
+      Parts.push_back(llvm::ConstantArray::get(T, Elements));
+      At = R.Start + R.Size;
+    }
+    Zeros(G->Bytes / 4 - At);
+    llvm::Constant *Init = llvm::ConstantStruct::getAnon(Ctx, Parts, true);
+    auto *GV = new llvm::GlobalVariable(*Out, Init->getType(), G->IsConst,
+                                        llvm::GlobalValue::InternalLinkage,
+                                        Init, G->Name.str());
+    GV->setAlignment(llvm::Align(4));
+    Globals[G] = llvm::ConstantExpr::getBitCast(GV, Ptr);
+  }
+
+  void declare(const Function *F) {
+    vector<llvm::Type *> Params;
+    for (const Argument *A : F->Args) {
+      Params.push_back(type(A->Ty));
+    }
+    auto *FnTy = llvm::FunctionType::get(type(F->RetTy), Params, false);
+    bool Internal = !F->isDeclaration() && F->Name.str() != "main";
+    Functions[F] = llvm::Function::Create(
+        FnTy,
+        Internal ? llvm::GlobalValue::InternalLinkage
+                 : llvm::GlobalValue::ExternalLinkage,
+        F->Name.str(), *Out);
+  }
+
+  llvm::Value *value(const Value *V) {
+    switch (V->Op) {
+    case Opcode::Argument:
+      return Fn->getArg(cast<Argument>(V)->Index);
+    case Opcode::ConstInt:
+      return llvm::ConstantInt::get(type(V->Ty), cast<ConstInt>(V)->V);
+    case Opcode::ConstFloat:
+      return llvm::ConstantFP::get(F32, cast<ConstFloat>(V)->V);
+    case Opcode::GlobalAddr:
+      return Globals[cast<GlobalAddr>(V)->G];
+    case Opcode::Undef:
+      return llvm::UndefValue::get(type(V->Ty));
+    default:
+      return Values[V->Id];
+    }
+  }
+
+  llvm::Value *typed(llvm::Value *P, Type T) {
+    return B.CreateBitCast(P, llvm::PointerType::getUnqual(type(T)));
+  }
+  static llvm::Align align(Type T) {
+    return llvm::Align(T == Type::Ptr ? 8 : 4);
+  }
+
+  llvm::CmpInst::Predicate predicate(const Instr *I) {
+    using P = llvm::CmpInst::Predicate;
+    bool Float = I->Op == Opcode::FCmp;
+    switch (I->P) {
+    case Pred::Eq:
+      return Float ? P::FCMP_OEQ : P::ICMP_EQ;
+    case Pred::Ne:
+      return Float ? P::FCMP_UNE : P::ICMP_NE;
+    case Pred::Lt:
+      return Float ? P::FCMP_OLT : P::ICMP_SLT;
+    case Pred::Le:
+      return Float ? P::FCMP_OLE : P::ICMP_SLE;
+    case Pred::Gt:
+      return Float ? P::FCMP_OGT : P::ICMP_SGT;
+    case Pred::Ge:
+      return Float ? P::FCMP_OGE : P::ICMP_SGE;
+    }
+    return P::BAD_ICMP_PREDICATE;
+  }
+
+  llvm::Value *instr(const Instr *I) {
+    auto Op = [&](unsigned i) { return value(I->operand(i)); };
+    switch (I->Op) {
+    case Opcode::Add:
+      return B.CreateNSWAdd(Op(0), Op(1));
+    case Opcode::Sub:
+      return B.CreateNSWSub(Op(0), Op(1));
+    case Opcode::Mul:
+      return B.CreateNSWMul(Op(0), Op(1));
+    case Opcode::SDiv:
+      return B.CreateSDiv(Op(0), Op(1));
+    case Opcode::SRem:
+      return B.CreateSRem(Op(0), Op(1));
+    case Opcode::FAdd:
+      return B.CreateFAdd(Op(0), Op(1));
+    case Opcode::FSub:
+      return B.CreateFSub(Op(0), Op(1));
+    case Opcode::FMul:
+      return B.CreateFMul(Op(0), Op(1));
+    case Opcode::FDiv:
+      return B.CreateFDiv(Op(0), Op(1));
+    case Opcode::FNeg:
+      return B.CreateFNeg(Op(0));
+    case Opcode::ICmp:
+    case Opcode::FCmp:
+      return B.CreateCmp(predicate(I), Op(0), Op(1));
+    case Opcode::ZExt:
+      return B.CreateZExt(Op(0), I32);
+    case Opcode::SIToFP:
+      return B.CreateSIToFP(Op(0), F32);
+    case Opcode::FPToSI:
+      return B.CreateFPToSI(Op(0), I32);
+    case Opcode::Alloca: {
+      auto *A = B.CreateAlloca(llvm::ArrayType::get(I8, I->Imm));
+      A->setAlignment(llvm::Align(I->Imm % 8 == 0 ? 8 : 4));
+      return B.CreateBitCast(A, Ptr);
+    }
+    case Opcode::Load:
+      return B.CreateAlignedLoad(type(I->Ty), typed(Op(0), I->Ty),
+                                 align(I->Ty));
+    case Opcode::Store: {
+      Type T = I->operand(0)->Ty;
+      return B.CreateAlignedStore(Op(0), typed(Op(1), T), align(T));
+    }
+    case Opcode::Zero:
+      return B.CreateMemSet(Op(0), B.getInt8(0), I->Imm, llvm::MaybeAlign(4));
+    case Opcode::PtrAdd: {
+      llvm::Value *Offset = B.CreateNSWMul(B.CreateSExt(Op(1), I64),
+                                           B.getInt64(I->Imm));
+      return B.CreateInBoundsGEP(I8, Op(0), Offset);
+    }
+    case Opcode::Call: {
+      vector<llvm::Value *> Args;
+      for (uint32_t i = 0; i < I->NumOps; ++i) {
+        Args.push_back(Op(i));
+      }
+      return B.CreateCall(Functions[cast<CallInstr>(I)->Callee], Args);
+    }
+    case Opcode::Phi:
+      return B.CreatePHI(type(I->Ty), I->NumOps);
+    case Opcode::Br:
+      return B.CreateBr(Blocks[I->successor(0)->Id]);
+    case Opcode::CondBr:
+      return B.CreateCondBr(Op(0), Blocks[I->successor(0)->Id],
+                            Blocks[I->successor(1)->Id]);
+    case Opcode::Ret:
+      return I->NumOps ? B.CreateRet(Op(0)) : B.CreateRetVoid();
+    default:
+      return nullptr;
+    }
+  }
+
+  // Blocks go in reverse postorder, where every definition comes before
+  // the instructions it dominates; phis get their operands at the end.
+  // A block nothing reaches only gets an `unreachable`.
+  void function(const Function *F) {
+    Fn = Functions[F];
+    Values.assign(F->NumValues, nullptr);
+    Blocks.assign(F->NumBlocks, nullptr);
+    for (const Block *BB : F->Blocks) {
+      Blocks[BB->Id] = llvm::BasicBlock::Create(Ctx, "", Fn);
+    }
+    DomTree DT(*F);
+    for (const Block *BB : DT.RPO) {
+      B.SetInsertPoint(Blocks[BB->Id]);
+      for (const Instr *I : *BB) {
+        Values[I->Id] = instr(I);
+      }
+    }
+    for (const Block *BB : F->Blocks) {
+      if (!DT.reachable(BB)) {
+        B.SetInsertPoint(Blocks[BB->Id]);
+        B.CreateUnreachable();
+        continue;
+      }
+      for (const Instr *I = BB->First; I && I->Op == Opcode::Phi;
+           I = I->Next) {
+        auto *P = llvm::cast<llvm::PHINode>(Values[I->Id]);
+        for (uint32_t i = 0; i < I->NumOps; ++i) {
+          const Block *From = BB->Preds[i];
+          llvm::Value *V = DT.reachable(From)
+                               ? value(I->operand(i))
+                               : llvm::UndefValue::get(P->getType());
+          P->addIncoming(V, Blocks[From->Id]);
+        }
+      }
+    }
+  }
+
+  std::unique_ptr<llvm::Module> run() {
+    for (const Global *G : M.Globals) {
+      global(G);
+    }
+    for (const auto &F : M.Functions) {
+      declare(F.get());
+    }
+    for (const auto &F : M.Functions) {
+      if (!F->isDeclaration()) {
+        function(F.get());
+      }
+    }
+    string Error;
+    llvm::raw_string_ostream OS(Error);
+    if (llvm::verifyModule(*Out, &OS)) {
+      throw format("Invalid LLVM IR: {}", OS.str());
+    }
+    return std::move(Out);
+  }
+};
+} // namespace
+
+std::unique_ptr<llvm::Module> EmitLLVM(const Module &M, llvm::LLVMContext &Ctx,
+                                       string_view Name) {
+  Codegen G(M, Ctx, Name);
+  return G.run();
+}
+
+} // namespace ssa
@@ -0,0 +1,730 @@
+#include "hir.hpp"
+#include "ssa.hpp"
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ssa {
+
+namespace {
+using hir::ExprKind;
+using hir::Op;
+using hir::StmtKind;
+
+Type type(const hir::Type *T) {
+  switch (T->K) {
+  case hir::Type::Kind::Void:
+    return Type::Void;
+  case hir::Type::Kind::Int:
+    return Type::I32;
+  case hir::Type::Kind::Float:
+    return Type::F32;
+  case hir::Type::Kind::Array:
+  case hir::Type::Kind::Pointer:
+    return Type::Ptr;
+  }
+  return Type::Void;
+}
+
+// The value of each variable at the end of each block, keyed by both
+// Ids: open-addressed like SymbolMap, since SSA construction does little
+// else but look these up.
+struct DefMap {
+  DefMap() : Slots(64) {}
+
+  Value **find(uint64_t Key) {
+    for (size_t i = home(Key);; i = (i + 1) & mask()) {
+      if (Slots[i].Key == Key) {
+        return &Slots[i].V;
+      }
+      if (Slots[i].Key == Empty) {
+        return nullptr;
+      }
+    }
+  }
+  void set(uint64_t Key, Value *V) {
+    size_t i = home(Key);
+    while (Slots[i].Key != Key && Slots[i].Key != Empty) {
+      i = (i + 1) & mask();
+    }
+    if (Slots[i].Key == Empty) {
+      if ((Count + 1) * 2 > Slots.size()) {
+        grow();
+        return set(Key, V);
+      }
+      Count++;
+    }
+    Slots[i] = {Key, V};
+  }
+  void clear() {
+    if (Count != 0) {
+      fill(Slots.begin(), Slots.end(), Slot());
+      Count = 0;
+    }
+  }
+
+private:
+  static constexpr uint64_t Empty = ~0ull;
+  struct Slot {
+    uint64_t Key = Empty;
+    Value *V = nullptr;
+  };
+
+  size_t mask() const { return Slots.size() - 1; }
+  size_t home(uint64_t Key) const {
+    return (Key * 0x9E3779B97F4A7C15ull >> 32) & mask();
+  }
+  void grow() {
+    vector<Slot> Old(Slots.size() * 2);
+    Old.swap(Slots);
+    for (const Slot &E : Old) {
+      if (E.Key != Empty) {
+        size_t i = home(E.Key);
+        while (Slots[i].Key != Empty) {
+          i = (i + 1) & mask();
+        }
+        Slots[i] = E;
+      }
+    }
+  }
+
+  vector<Slot> Slots;
+  size_t Count = 0;
+};
+
+// Lowers the functions of a module one at a time, like hir::EmitLLVM
+// does: statements and expressions with work stacks instead of recursion,
+// and blocks placed in source order as code goes into them.
+struct Lowering {
+  const hir::Module &HM;
+  Module M;
+  vector<Global *> Globals; // by Var::Id
+  unordered_map<const hir::Function *, Function *> Functions;
+
+  // The function being lowered.
+  Function *F = nullptr;
+  Builder *B = nullptr;
+  vector<Value *> Slots; // the allocas of array locals, by Var::Id
+  struct Loop {
+    Block *Continue, *Break;
+  };
+  vector<Loop> Loops;
+
+  struct ExprItem {
+    const hir::Expr *E;
+    unsigned Step;
+  };
+  vector<ExprItem> ExprWork;
+  vector<Value *> Values;
+  vector<pair<Block *, Block *>> Joins;
+  struct StmtItem {
+    const hir::Stmt *S;
+    unsigned Step;
+    Block *Next, *End;
+  };
+  vector<StmtItem> StmtWork;
+
+  // SSA construction as Braun et al. describe it ("Simple and Efficient
+  // Construction of Static Single Assignment Form", CC 2013). Defs maps
+  // a block and a variable to the value the variable has at the end of
+  // the block, as far as it is known. A block is sealed once all of its
+  // predecessors are; until then a read makes an incomplete phi, which
+  // gets its operands when the block is sealed.
+  DefMap Defs;
+  // The definitions of the current block, by Var::Id, which most reads
+  // look for; they move to Defs when code moves on to another block.
+  vector<Value *> Here;
+  vector<uint32_t> Written; // the Var::Ids set in Here
+  vector<bool> Sealed; // by Block::Id
+  struct PendingPhi {
+    const hir::Var *V;
+    Phi *P;
+  };
+  vector<vector<PendingPhi>> Incomplete; // by Block::Id
+  vector<PendingPhi> PhiWork;            // need their operands
+  vector<Phi *> Filled;                  // have them, maybe trivially
+  // What each removed phi was replaced by, by Value::Id. Defs is not a
+  // use list, so it may still name one.
+  vector<Value *> Replaced;
+
+  explicit Lowering(const hir::Module &HM) : HM(HM) {}
+
+  void global(const hir::Var *V) {
+    Global *G = M.Storage.New<Global>();
+    G->Name = V->Name;
+    G->Elem = type(V->Ty->base());
+    G->IsConst = V->IsConst;
+    G->Bytes = V->Ty->bytes();
+    if (const hir::Initializer *Init = V->Init) {
+      G->Runs = M.Storage.Copy(Init->Runs.begin(), Init->Runs.size());
+      vector<uint32_t> Words;
+      for (int32_t I : Init->Ints) {
+        Words.push_back(uint32_t(I));
+      }
+      for (float X : Init->Floats) {
+        Words.push_back(bit_cast<uint32_t>(X));
+      }
+      G->Words = M.Storage.Copy(Words.data(), Words.size());
+    }
+    M.Globals.push_back(G);
+    Globals.push_back(G);
+  }
+
+  void declare(const hir::Function *HF) {
+    auto Fn = make_unique<Function>(HF->Name, type(HF->RetTy));
+    for (const hir::Var *P : HF->Params) {
+      Fn->addArg(type(P->Ty));
+    }
+    Functions[HF] = Fn.get();
+    M.Functions.push_back(std::move(Fn));
+  }
+
+  // Scalars and array parameters, which are read and written as a whole
+  // and never have their address taken; the rest is memory.
+  static const hir::Var *variable(const hir::Expr *E) {
+    auto *R = dyn_cast<hir::VarRef>(E);
+    if (R == nullptr || R->V->S == hir::Var::Storage::Global ||
+        R->V->Ty->isArray()) {
+      return nullptr;
+    }
+    return R->V;
+  }
+  static uint64_t key(const hir::Var *V, const Block *BB) {
+    return uint64_t(BB->Id) << 32 | V->Id;
+  }
+  void define(const hir::Var *V, Block *BB, Value *X) {
+    if (BB != B->BB) {
+      Defs.set(key(V, BB), X);
+      return;
+    }
+    if (Here[V->Id] == nullptr) {
+      Written.push_back(V->Id);
+    }
+    Here[V->Id] = X;
+  }
+  void moveTo(Block *BB) {
+    for (uint32_t Id : Written) {
+      Defs.set(uint64_t(B->BB->Id) << 32 | Id, Here[Id]);
+      Here[Id] = nullptr;
+    }
+    Written.clear();
+    B->setBlock(BB);
+  }
+  Value *resolve(Value *X) {
+    while (X->Id < Replaced.size() && Replaced[X->Id] != nullptr) {
+      X = Replaced[X->Id];
+    }
+    return X;
+  }
+  bool sealed(const Block *BB) const {
+    return BB->Id < Sealed.size() && Sealed[BB->Id];
+  }
+
+  Value *read(const hir::Var *V) { return read(V, B->BB); }
+  void write(const hir::Var *V, Value *X) { define(V, B->BB, X); }
+
+  Value *read(const hir::Var *V, Block *BB) {
+    Value *X = lookup(V, BB);
+    complete();
+    return resolve(X);
+  }
+
+  // The value of `V` at the end of `BB`. It walks up through blocks with a
+  // single predecessor and stops at the first that knows `V` or that needs
+  // a phi for it; a phi that needs operands is queued on PhiWork rather
+  // than recursed into, since chains of blocks are as long as the source.
+  Value *lookup(const hir::Var *V, Block *BB) {
+    size_t Chain = Path.size();
+    Value *X;
+    while (true) {
+      if (BB == B->BB && Here[V->Id] != nullptr) {
+        X = resolve(Here[V->Id]);
+        break;
+      }
+      if (Value **Def = Defs.find(key(V, BB))) {
+        X = resolve(*Def);
+        break;
+      }
+      if (!sealed(BB)) {
+        Phi *P = B->phi(type(V->Ty), BB);
+        Incomplete[BB->Id].push_back({V, P});
+        X = P;
+      } else if (BB->Preds.size() == 1) {
+        Path.push_back(BB);
+        BB = BB->Preds[0];
+        continue;
+      } else if (BB->Preds.empty()) {
+        X = F->getUndef(type(V->Ty)); // read before any write
+      } else {
+        Phi *P = B->phi(type(V->Ty), BB);
+        PhiWork.push_back({V, P});
+        X = P;
+      }
+      define(V, BB, X);
+      break;
+    }
+    for (size_t i = Chain; i < Path.size(); ++i) {
+      define(V, Path[i], X);
+    }
+    Path.resize(Chain);
+    return X;
+  }
+  vector<Block *> Path;
+
+  // Gives the queued phis their operands, which may queue more, and then
+  // removes those that turn out trivial.
+  void complete() {
+    while (!PhiWork.empty()) {
+      auto [V, P] = PhiWork.back();
+      PhiWork.pop_back();
+      for (Block *Pred : P->Parent->Preds) {
+        F->addIncoming(P, lookup(V, Pred));
+      }
+      Filled.push_back(P);
+    }
+    while (!Filled.empty()) {
+      Phi *P = Filled.back();
+      Filled.pop_back();
+      if (P->Parent != nullptr) {
+        removeTrivial(P);
+      }
+    }
+  }
+
+  // Replaces `P` by its one operand other than itself, or by undef if it
+  // has none; the phis that used it may be trivial now too.
+  void removeTrivial(Phi *P) {
+    Value *Same = nullptr;
+    for (uint32_t i = 0; i < P->NumOps; ++i) {
+      Value *Op = P->operand(i);
+      if (Op == Same || Op == P) {
+        continue;
+      }
+      if (Same != nullptr) {
+        return;
+      }
+      Same = Op;
+    }
+    if (Same == nullptr) {
+      Same = F->getUndef(P->Ty);
+    }
+    for (Use *U = P->Uses; U != nullptr; U = U->Next) {
+      // Incomplete phis have no operands to judge yet.
+      if (U->User != P && U->User->Op == Opcode::Phi &&
+          sealed(U->User->Parent)) {
+        Filled.push_back(cast<Phi>(U->User));
+      }
+    }
+    P->replaceAllUsesWith(Same);
+    F->erase(P);
+    if (Replaced.size() <= P->Id) {
+      Replaced.resize(F->NumValues, nullptr);
+    }
+    Replaced[P->Id] = Same;
+  }
+
+  void seal(Block *BB) {
+    Sealed[BB->Id] = true;
+    for (const PendingPhi &Pending : Incomplete[BB->Id]) {
+      PhiWork.push_back(Pending);
+    }
+    Incomplete[BB->Id].clear();
+    complete();
+  }
+
+  // Places `BB` and continues in it; it is sealed unless it is a loop
+  // header, whose back edges are still to come.
+  void start(Block *BB, bool Seal = true) {
+    F->appendBlock(BB);
+    moveTo(BB);
+    if (Sealed.size() < F->NumBlocks) {
+      Sealed.resize(F->NumBlocks);
+      Incomplete.resize(F->NumBlocks);
+    }
+    if (Seal) {
+      seal(BB);
+    }
+  }
+  void join(Block *End) {
+    if (!End->Preds.empty()) {
+      start(End);
+    } else {
+      moveTo(nullptr);
+    }
+  }
+  void branch(Block *To) {
+    if (B->BB != nullptr) {
+      B->br(To);
+    }
+  }
+
+  Value *zero(Type Ty) {
+    return Ty == Type::F32 ? static_cast<Value *>(F->getFloat(0))
+                           : F->getInt(0);
+  }
+
+  void function(const hir::Function *HF) {
+    F = Functions[HF];
+    Builder Build(*F);
+    B = &Build;
+    start(F->createBlock());
+    Slots.assign(HF->Params.size() + HF->Locals.size(), nullptr);
+    Here.assign(Slots.size(), nullptr);
+    for (const hir::Var *V : HF->Locals) {
+      if (V->Ty->isArray()) {
+        Slots[V->Id] = B->alloca(V->Ty->bytes());
+      }
+    }
+    for (const hir::Var *V : HF->Params) {
+      write(V, F->Args[V->Id]);
+    }
+    body(HF->Body);
+    if (B->BB != nullptr) {
+      B->ret(F->RetTy == Type::Void ? nullptr : zero(F->RetTy));
+    }
+    moveTo(nullptr);
+    B = nullptr;
+    Defs.clear();
+    Sealed.clear();
+    Incomplete.clear();
+    Replaced.clear();
+  }
+
+  void body(const hir::Stmt *Body) {
+    StmtWork.push_back({Body, 0, nullptr, nullptr});
+    while (!StmtWork.empty()) {
+      StmtItem I = StmtWork.back();
+      StmtWork.pop_back();
+      if (I.Step == 0 && B->BB == nullptr) {
+        continue;
+      }
+      switch (I.S->Kind) {
+      case StmtKind::Expr:
+        emit(cast<hir::ExprStmt>(I.S)->E);
+        break;
+      case StmtKind::Init:
+        init(cast<hir::InitStmt>(I.S)->V);
+        break;
+      case StmtKind::If:
+        ifStmt(cast<hir::If>(I.S), I);
+        break;
+      case StmtKind::While:
+        whileStmt(cast<hir::While>(I.S), I);
+        break;
+      case StmtKind::Break:
+      case StmtKind::Continue: {
+        const Loop &L = Loops.back();
+        B->br(I.S->Kind == StmtKind::Break ? L.Break : L.Continue);
+        moveTo(nullptr);
+        break;
+      }
+      case StmtKind::Return: {
+        hir::Expr *Value = cast<hir::Return>(I.S)->Value;
+        B->ret(Value ? emit(Value) : nullptr);
+        moveTo(nullptr);
+        break;
+      }
+      case StmtKind::Block: {
+        Span<hir::Stmt *> Stmts = cast<hir::Block>(I.S)->Stmts;
+        for (size_t i = Stmts.size(); i-- > 0;) {
+          StmtWork.push_back({Stmts[i], 0, nullptr, nullptr});
+        }
+        break;
+      }
+      }
+    }
+  }
+
+  void ifStmt(const hir::If *S, const StmtItem &I) {
+    switch (I.Step) {
+    case 0: {
+      Block *Then = F->createBlock(), *End = F->createBlock();
+      Block *Else = S->Else ? F->createBlock() : End;
+      B->condBr(truth(emit(S->Cond)), Then, Else);
+      start(Then);
+      StmtWork.push_back({S, 1, Else, End});
+      StmtWork.push_back({S->Then, 0, nullptr, nullptr});
+      return;
+    }
+    case 1:
+      branch(I.End);
+      if (S->Else != nullptr) {
+        start(I.Next);
+        StmtWork.push_back({S, 2, nullptr, I.End});
+        StmtWork.push_back({S->Else, 0, nullptr, nullptr});
+        return;
+      }
+      join(I.End);
+      return;
+    default:
+      branch(I.End);
+      join(I.End);
+    }
+  }
+
+  void whileStmt(const hir::While *S, const StmtItem &I) {
+    if (I.Step == 0) {
+      Block *Cond = F->createBlock(), *Body = F->createBlock();
+      Block *End = F->createBlock();
+      B->br(Cond);
+      start(Cond, false);
+      B->condBr(truth(emit(S->Cond)), Body, End);
+      start(Body);
+      Loops.push_back({Cond, End});
+      StmtWork.push_back({S, 1, Cond, End});
+      StmtWork.push_back({S->Body, 0, nullptr, nullptr});
+      return;
+    }
+    branch(I.Next);
+    seal(I.Next);
+    Loops.pop_back();
+    join(I.End);
+  }
+
+  Value *element(const hir::Initializer &Init, const ast::ArrayInit::Run &R,
+                 uint64_t i, Type Elem) {
+    if (Elem == Type::F32) {
+      return F->getFloat(Init.Floats[R.Offset + i]);
+    }
+    return F->getInt(Init.Ints[R.Offset + i]);
+  }
+
+  void init(const hir::Var *V) {
+    const hir::Initializer &Init = *V->Init;
+    Type Elem = type(V->Ty->base());
+    if (V->Ty->isScalar()) {
+      Value *X = zero(Elem);
+      if (!Init.Exprs.empty()) {
+        X = emit(Init.Exprs[0].Value);
+      } else if (!Init.Runs.empty()) {
+        X = element(Init, Init.Runs[0], 0, Elem);
+      }
+      write(V, X);
+      return;
+    }
+    Value *Addr = Slots[V->Id];
+    B->zero(Addr, V->Ty->bytes());
+    for (const ast::ArrayInit::Run &R : Init.Runs) {
+      for (uint32_t i = 0; i < R.Size; ++i) {
+        Value *At = B->ptrAdd(Addr, F->getInt(R.Start + i), 4);
+        B->store(element(Init, R, i, Elem), At);
+      }
+    }
+    for (const hir::Initializer::Element &E : Init.Exprs) {
+      Value *X = emit(E.Value);
+      B->store(X, B->ptrAdd(Addr, F->getInt(E.Index), 4));
+    }
+  }
+
+  // `X`, an int or float, as an I1. A widened comparison is used as it
+  // is. The zext stays: it may be a variable's value in Defs, which does
+  // not count as a use, and ADCE removes it if nothing else reads it.
+  Value *truth(Value *X) {
+    if (X->Op == Opcode::ZExt) {
+      return cast<Instr>(X)->operand(0);
+    }
+    return B->cmp(Pred::Ne, X, zero(X->Ty));
+  }
+
+  // The value of `Root`, or its address if it is an lvalue. As in
+  // hir::EmitLLVM, an expression is visited once to queue its operands
+  // and again with their values on `Values`. An assignment to a variable,
+  // or an index into a parameter, leaves the variable out of its operands
+  // and reads or writes it itself.
+  Value *emit(const hir::Expr *Root) {
+    ExprWork.push_back({Root, 0});
+    while (!ExprWork.empty()) {
+      ExprItem I = ExprWork.back();
+      ExprWork.pop_back();
+      const hir::Expr *E = I.E;
+      switch (E->Kind) {
+      case ExprKind::IntConst:
+        Values.push_back(F->getInt(cast<hir::IntConst>(E)->Value));
+        continue;
+      case ExprKind::FloatConst:
+        Values.push_back(F->getFloat(cast<hir::FloatConst>(E)->Value));
+        continue;
+      case ExprKind::VarRef: {
+        const hir::Var *V = cast<hir::VarRef>(E)->V;
+        if (V->S == hir::Var::Storage::Global) {
+          Values.push_back(F->getGlobal(Globals[V->Id]));
+        } else {
+          Values.push_back(Slots[V->Id]);
+        }
+        continue;
+      }
+      case ExprKind::Load:
+        if (const hir::Var *V = variable(cast<hir::UnaryExpr>(E)->Operand)) {
+          Values.push_back(read(V));
+          continue;
+        }
+        break;
+      case ExprKind::Logical:
+        logical(cast<hir::BinaryExpr>(E), I.Step);
+        continue;
+      default:
+        break;
+      }
+      const hir::Var *Target = nullptr;
+      if (E->Kind == ExprKind::Assign || E->Kind == ExprKind::Index) {
+        Target = variable(E->operand(0));
+      }
+      unsigned First = Target ? 1 : 0, N = E->numOperands() - First;
+      if (I.Step == 0) {
+        ExprWork.push_back({E, 1});
+        for (unsigned i = N; i-- > 0;) {
+          ExprWork.push_back({E->operand(First + i), 0});
+        }
+        continue;
+      }
+      Value **Ops = Values.data() + Values.size() - N;
+      Value *X = apply(E, Target, Ops);
+      Values.resize(Values.size() - N);
+      Values.push_back(X);
+    }
+    Value *X = Values.back();
+    Values.pop_back();
+    return X;
+  }
+
+  // `E` of its operands' values `Ops`, which leave out `Target` if it is
+  // not nullptr.
+  Value *apply(const hir::Expr *E, const hir::Var *Target, Value **Ops) {
+    switch (E->Kind) {
+    case ExprKind::Index: {
+      Value *Base = Target ? read(Target) : Ops[0];
+      return B->ptrAdd(Base, Ops[Target ? 0 : 1], E->Ty->bytes());
+    }
+    case ExprKind::Decay:
+      return Ops[0];
+    case ExprKind::Load:
+      return B->load(type(E->Ty), Ops[0]);
+    case ExprKind::Convert:
+      return E->Ty->isFloat() ? B->unary(Opcode::SIToFP, Type::F32, Ops[0])
+                              : B->unary(Opcode::FPToSI, Type::I32, Ops[0]);
+    case ExprKind::Unary:
+      return unary(cast<hir::UnaryExpr>(E)->O, Ops[0]);
+    case ExprKind::Binary:
+      return binary(cast<hir::BinaryExpr>(E)->O, Ops[0], Ops[1]);
+    case ExprKind::Assign:
+      if (Target) {
+        write(Target, Ops[0]);
+        return Ops[0];
+      }
+      B->store(Ops[1], Ops[0]);
+      return Ops[1];
+    case ExprKind::Call: {
+      auto *C = cast<hir::Call>(E);
+      return B->call(Functions[C->Callee], Span(Ops, C->Args.size()));
+    }
+    default:
+      break;
+    }
+    return nullptr;
+  }
+
+  Value *unary(Op O, Value *X) {
+    if (O == Op::Neg) {
+      return X->Ty == Type::F32 ? B->unary(Opcode::FNeg, Type::F32, X)
+                                : B->binary(Opcode::Sub, F->getInt(0), X);
+    }
+    return B->unary(Opcode::ZExt, Type::I32, B->cmp(Pred::Eq, X, zero(X->Ty)));
+  }
+
+  Value *binary(Op O, Value *L, Value *R) {
+    bool Float = L->Ty == Type::F32;
+    Pred P;
+    switch (O) {
+    case Op::Add:
+      return B->binary(Float ? Opcode::FAdd : Opcode::Add, L, R);
+    case Op::Sub:
+      return B->binary(Float ? Opcode::FSub : Opcode::Sub, L, R);
+    case Op::Mul:
+      return B->binary(Float ? Opcode::FMul : Opcode::Mul, L, R);
+    case Op::Div:
+      return B->binary(Float ? Opcode::FDiv : Opcode::SDiv, L, R);
+    case Op::Mod:
+      return B->binary(Opcode::SRem, L, R);
+    case Op::Lt:
+      P = Pred::Lt;
+      break;
+    case Op::Le:
+      P = Pred::Le;
+      break;
+    case Op::Gt:
+      P = Pred::Gt;
+      break;
+    case Op::Ge:
+      P = Pred::Ge;
+      break;
+    case Op::Eq:
+      P = Pred::Eq;
+      break;
+    case Op::Ne:
+      P = Pred::Ne;
+      break;
+    default:
+      return nullptr;
+    }
+    return B->unary(Opcode::ZExt, Type::I32, B->cmp(P, L, R));
+  }
+
+  // && and ||, in the steps hir::EmitLLVM takes.
+  void logical(const hir::BinaryExpr *E, unsigned Step) {
+    bool And = E->O == Op::And;
+    if (Step == 0) {
+      ExprWork.push_back({E, 1});
+      ExprWork.push_back({E->LHS, 0});
+      return;
+    }
+    Value *X = truth(Values.back());
+    Values.pop_back();
+    if (Step == 1) {
+      Block *RHS = F->createBlock(), *End = F->createBlock();
+      Joins.push_back({B->BB, End});
+      if (And) {
+        B->condBr(X, RHS, End);
+      } else {
+        B->condBr(X, End, RHS);
+      }
+      start(RHS);
+      ExprWork.push_back({E, 2});
+      ExprWork.push_back({E->RHS, 0});
+      return;
+    }
+    Block *End = Joins.back().second;
+    Joins.pop_back();
+    B->br(End);
+    start(End);
+    // End->Preds is the branch on the lhs, then the end of the rhs.
+    Phi *P = B->phi(Type::I1, End);
+    F->addIncoming(P, F->getBool(!And));
+    F->addIncoming(P, X);
+    Values.push_back(B->unary(Opcode::ZExt, Type::I32, P));
+  }
+
+  Module run() {
+    for (const hir::Var *G : HM.Globals) {
+      global(G);
+    }
+    for (const hir::Function *HF : HM.Functions) {
+      declare(HF);
+    }
+    for (const hir::Function *HF : HM.Functions) {
+      if (HF->Body != nullptr) {
+        function(HF);
+      }
+    }
+    return std::move(M);
+  }
+};
+} // namespace
+
+Module BuildSSA(const hir::Module &HM) {
+  Lowering L(HM);
+  return L.run();
+}
+
+} // namespace ssa
@@ -0,0 +1,259 @@
+#include "dominators.hpp"
+#include "ssa.hpp"
+#include <format>
+
+using namespace std;
+
+namespace ssa {
+
+namespace {
+struct Verifier {
+  const Function &F;
+  vector<bool> InFunction; // by Block::Id
+  vector<uint32_t> Position; // of an instruction in its block, by Id
+
+  explicit Verifier(const Function &F)
+      : F(F), InFunction(F.NumBlocks), Position(F.NumValues) {}
+
+  [[noreturn]] void fail(string_view Message) {
+    throw format("Invalid SSA in '{}': {}", F.Name.str(), Message);
+  }
+  [[noreturn]] void fail(const Instr *I, string_view Message) {
+    fail(format("b{} %{} ({}): {}", I->Parent ? I->Parent->Id : ~0u, I->Id,
+                OpcodeName(I->Op), Message));
+  }
+
+  void expect(const Instr *I, bool Holds, string_view Message) {
+    if (!Holds) {
+      fail(I, Message);
+    }
+  }
+
+  // The operand types and count each opcode needs.
+  void types(const Instr *I) {
+    auto Op = [&](unsigned i) { return I->operand(i)->Ty; };
+    auto Operands = [&](initializer_list<Type> Types) {
+      expect(I, I->NumOps == Types.size(), "wrong operand count");
+      unsigned i = 0;
+      for (Type T : Types) {
+        expect(I, Op(i++) == T, "wrong operand type");
+      }
+    };
+    switch (I->Op) {
+    case Opcode::Add:
+    case Opcode::Sub:
+    case Opcode::Mul:
+    case Opcode::SDiv:
+    case Opcode::SRem:
+      Operands({Type::I32, Type::I32});
+      expect(I, I->Ty == Type::I32, "wrong result type");
+      break;
+    case Opcode::FAdd:
+    case Opcode::FSub:
+    case Opcode::FMul:
+    case Opcode::FDiv:
+      Operands({Type::F32, Type::F32});
+      expect(I, I->Ty == Type::F32, "wrong result type");
+      break;
+    case Opcode::FNeg:
+      Operands({Type::F32});
+      expect(I, I->Ty == Type::F32, "wrong result type");
+      break;
+    case Opcode::ICmp:
+      Operands({Type::I32, Type::I32});
+      expect(I, I->Ty == Type::I1, "wrong result type");
+      break;
+    case Opcode::FCmp:
+      Operands({Type::F32, Type::F32});
+      expect(I, I->Ty == Type::I1, "wrong result type");
+      break;
+    case Opcode::ZExt:
+      Operands({Type::I1});
+      expect(I, I->Ty == Type::I32, "wrong result type");
+      break;
+    case Opcode::SIToFP:
+      Operands({Type::I32});
+      expect(I, I->Ty == Type::F32, "wrong result type");
+      break;
+    case Opcode::FPToSI:
+      Operands({Type::F32});
+      expect(I, I->Ty == Type::I32, "wrong result type");
+      break;
+    case Opcode::Alloca:
+      Operands({});
+      expect(I, I->Ty == Type::Ptr, "wrong result type");
+      break;
+    case Opcode::Load:
+      Operands({Type::Ptr});
+      expect(I, I->Ty == Type::I32 || I->Ty == Type::F32 || I->Ty == Type::Ptr,
+             "wrong result type");
+      break;
+    case Opcode::Store:
+      expect(I, I->NumOps == 2, "wrong operand count");
+      expect(I, Op(0) == Type::I32 || Op(0) == Type::F32 || Op(0) == Type::Ptr,
+             "wrong operand type");
+      expect(I, Op(1) == Type::Ptr, "wrong operand type");
+      break;
+    case Opcode::Zero:
+      Operands({Type::Ptr});
+      break;
+    case Opcode::PtrAdd:
+      Operands({Type::Ptr, Type::I32});
+      expect(I, I->Ty == Type::Ptr, "wrong result type");
+      break;
+    case Opcode::Call: {
+      const Function *Callee = cast<CallInstr>(I)->Callee;
+      expect(I, I->NumOps == Callee->Args.size(), "wrong argument count");
+      for (uint32_t i = 0; i < I->NumOps; ++i) {
+        expect(I, Op(i) == Callee->Args[i]->Ty, "wrong argument type");
+      }
+      expect(I, I->Ty == Callee->RetTy, "wrong result type");
+      break;
+    }
+    case Opcode::Phi:
+      expect(I, I->NumOps == I->Parent->Preds.size(),
+             "not one operand per predecessor");
+      for (uint32_t i = 0; i < I->NumOps; ++i) {
+        expect(I, Op(i) == I->Ty, "wrong operand type");
+      }
+      break;
+    case Opcode::Br:
+      Operands({});
+      break;
+    case Opcode::CondBr:
+      Operands({Type::I1});
+      break;
+    case Opcode::Ret:
+      if (F.RetTy == Type::Void) {
+        Operands({});
+      } else {
+        Operands({F.RetTy});
+      }
+      break;
+    default:
+      fail(I, "not an instruction");
+    }
+  }
+
+  // Each operand is on its value's use list, and each use on a value's
+  // list is an operand of a live instruction of this function.
+  void uses(const Instr *I) {
+    for (uint32_t i = 0; i < I->NumOps; ++i) {
+      const Use &U = I->Ops[i];
+      expect(I, U.Val != nullptr, "null operand");
+      expect(I, U.User == I && *U.Prev == &U, "operand off its use list");
+      if (auto *D = dyn_cast<Instr>(U.Val)) {
+        expect(I, D->Parent != nullptr && D->Parent->Parent == &F &&
+                      InFunction[D->Parent->Id],
+               "operand not in the function");
+      } else if (auto *A = dyn_cast<Argument>(U.Val)) {
+        expect(I, A->Index < F.Args.size() && F.Args[A->Index] == A,
+               "argument of another function");
+      }
+    }
+    for (const Use *U = I->Uses; U != nullptr; U = U->Next) {
+      const Instr *User = U->User;
+      expect(I,
+             U->Val == I && User->Parent != nullptr &&
+                 User->Parent->Parent == &F && U >= User->Ops &&
+                 U < User->Ops + User->NumOps,
+             "stale use");
+    }
+  }
+
+  void run() {
+    if (F.isDeclaration()) {
+      return;
+    }
+    for (const Block *B : F.Blocks) {
+      if (B->Parent != &F || B->Id >= F.NumBlocks || InFunction[B->Id]) {
+        fail(format("b{} is misplaced", B->Id));
+      }
+      InFunction[B->Id] = true;
+    }
+    if (!F.entry()->Preds.empty()) {
+      fail("the entry block has predecessors");
+    }
+
+    size_t Edges = 0, PredEntries = 0;
+    for (const Block *B : F.Blocks) {
+      if (B->terminator() == nullptr) {
+        fail(format("b{} does not end in a terminator", B->Id));
+      }
+      bool Phis = true;
+      uint32_t Pos = 0;
+      for (const Instr *I = B->First; I != nullptr; I = I->Next) {
+        expect(I, I->Parent == B, "wrong parent");
+        expect(I, (I->Next ? I->Next->Prev : B->Last) == I, "broken list");
+        expect(I, !I->isTerminator() || I == B->Last,
+               "terminator in the middle of a block");
+        expect(I, I->Op != Opcode::Phi || Phis, "phi after a non-phi");
+        expect(I, I->Id < F.NumValues, "Id out of range");
+        Phis = I->Op == Opcode::Phi;
+        Position[I->Id] = Pos++;
+      }
+      const Instr *T = B->terminator();
+      for (unsigned i = 0; i < T->numSuccessors(); ++i) {
+        const Block *S = T->successor(i);
+        if (S == nullptr || !InFunction[S->Id]) {
+          fail(T, "branch out of the function");
+        }
+        unsigned Here = 0, There = 0;
+        for (unsigned j = 0; j < T->numSuccessors(); ++j) {
+          Here += T->successor(j) == S;
+        }
+        for (const Block *P : S->Preds) {
+          There += P == B;
+        }
+        expect(T, Here == There, "successor does not list it as a pred");
+      }
+      Edges += T->numSuccessors();
+      PredEntries += B->Preds.size();
+    }
+    if (Edges != PredEntries) {
+      fail("a predecessor list names a block that does not branch there");
+    }
+
+    DomTree DT(F);
+    for (const Block *B : F.Blocks) {
+      for (const Instr *I = B->First; I != nullptr; I = I->Next) {
+        types(I);
+        uses(I);
+        if (!DT.reachable(B)) {
+          continue;
+        }
+        for (uint32_t i = 0; i < I->NumOps; ++i) {
+          auto *D = dyn_cast<Instr>(I->operand(i));
+          if (D == nullptr) {
+            continue;
+          }
+          bool Dominated;
+          if (I->Op == Opcode::Phi) {
+            const Block *From = B->Preds[i];
+            Dominated = !DT.reachable(From) || DT.dominates(D->Parent, From);
+          } else if (D->Parent == B) {
+            Dominated = Position[D->Id] < Position[I->Id];
+          } else {
+            Dominated = DT.dominates(D->Parent, B);
+          }
+          expect(I, Dominated,
+                 format("operand %{} does not dominate it", D->Id));
+        }
+      }
+    }
+  }
+};
+} // namespace
+
+void Verify(const Function &F) {
+  Verifier V(F);
+  V.run();
+}
+
+void Verify(const Module &M) {
+  for (const auto &F : M.Functions) {
+    Verify(*F);
+  }
+}
+
+} // namespace ssa
@@ -0,0 +1,156 @@
+#include "loops.hpp"
+#include "passes.hpp"
+#include <climits>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ssa {
+
+namespace {
+// A value that grows by a constant on every iteration of a loop: Start,
+// computed in the preheader, on the first, and Step more (in bytes for a
+// pointer) on each one after. Start is nullptr for any other value.
+struct Affine {
+  Value *Start = nullptr;
+  int64_t Step = 0;
+};
+
+struct StrengthReducer {
+  Function &F;
+  DomTree DT;
+  LoopInfo LI;
+  Builder Build;
+  bool Changed = false;
+
+  // The loop being reduced.
+  Loop *L = nullptr;
+  Block *Pre = nullptr, *Latch = nullptr;
+  uint32_t Limit = 0; // the Ids from here on are what it made
+  unordered_map<Value *, Affine> Known;
+
+  explicit StrengthReducer(Function &F) : F(F), DT(F), LI(F, DT), Build(F) {}
+
+  Value *inPreheader(Opcode Op, Value *A, Value *B, uint32_t Imm) {
+    Build.setInsertPoint(Pre->terminator());
+    if (Op == Opcode::PtrAdd) {
+      return Build.ptrAdd(A, B, Imm);
+    }
+    return Build.binary(Op, A, B);
+  }
+
+  Affine affine(Value *V) {
+    auto *I = dyn_cast<Instr>(V);
+    if (I == nullptr || !LI.contains(L, I->Parent)) {
+      return {V, 0}; // the same on every iteration
+    }
+    auto It = Known.find(V);
+    if (It != Known.end()) {
+      return It->second;
+    }
+    Affine A = compute(I);
+    Known[V] = A;
+    return A;
+  }
+
+  Affine compute(Instr *I) {
+    switch (I->Op) {
+    case Opcode::Phi: {
+      // A basic induction variable: i = phi [start, i + c].
+      if (I->Parent != L->Header) {
+        return {};
+      }
+      size_t FromPre = L->Header->Preds[0] == Pre ? 0 : 1;
+      auto *Next = dyn_cast<Instr>(I->operand(1 - FromPre));
+      if (Next == nullptr || Next->Op != Opcode::Add ||
+          Next->operand(0) != I || !isa<ConstInt>(Next->operand(1))) {
+        return {};
+      }
+      return {I->operand(FromPre), cast<ConstInt>(Next->operand(1))->V};
+    }
+    case Opcode::Add:
+    case Opcode::Sub: {
+      Affine A = affine(I->operand(0)), B = affine(I->operand(1));
+      if (A.Start == nullptr || B.Start == nullptr) {
+        return {};
+      }
+      int64_t Step = I->Op == Opcode::Add ? A.Step + B.Step : A.Step - B.Step;
+      return {inPreheader(I->Op, A.Start, B.Start, 0), Step};
+    }
+    case Opcode::Mul: {
+      auto *C = dyn_cast<ConstInt>(I->operand(1));
+      Affine A = affine(I->operand(0));
+      if (C == nullptr || A.Start == nullptr) {
+        return {};
+      }
+      return {inPreheader(Opcode::Mul, A.Start, C, 0), A.Step * C->V};
+    }
+    case Opcode::PtrAdd: {
+      Affine A = affine(I->operand(0)), B = affine(I->operand(1));
+      if (A.Start == nullptr || B.Start == nullptr) {
+        return {};
+      }
+      return {inPreheader(Opcode::PtrAdd, A.Start, B.Start, I->Imm),
+              A.Step + B.Step * I->Imm};
+    }
+    default:
+      return {};
+    }
+  }
+
+  // Replaces the multiplications and address computations of `L` that
+  // are affine in its induction variables by phis of their own that step
+  // by an addition, so a[i][j] walks a pointer instead of computing
+  // a + i * 4 * n + j * 4 again on every iteration.
+  void reduce(Loop &Loop) {
+    L = &Loop;
+    Pre = LI.preheader(Loop);
+    if (Pre == nullptr || Loop.Header->Preds.size() != 2) {
+      return;
+    }
+    Latch = Loop.Latches[0];
+    Known.clear();
+    Limit = F.NumValues;
+    for (Block *B : DT.RPO) {
+      if (!LI.contains(L, B)) {
+        continue;
+      }
+      for (Instr *I : *B) {
+        if ((I->Op != Opcode::Mul && I->Op != Opcode::PtrAdd) ||
+            I->Id >= Limit) {
+          continue;
+        }
+        Affine A = affine(I);
+        int64_t Step = I->Ty == Type::I32 ? int32_t(A.Step) : A.Step;
+        if (A.Start == nullptr || Step == 0 || Step < INT32_MIN ||
+            Step > INT32_MAX) {
+          continue;
+        }
+        Phi *P = Build.phi(I->Ty, L->Header);
+        Build.setInsertPoint(Latch->terminator());
+        Value *Next = I->Ty == Type::Ptr
+                          ? Build.ptrAdd(P, F.getInt(Step), 1)
+                          : Build.binary(Opcode::Add, P, F.getInt(Step));
+        for (Block *From : L->Header->Preds) {
+          F.addIncoming(P, From == Pre ? A.Start : Next);
+        }
+        I->replaceAllUsesWith(P);
+        F.erase(I);
+        Known[P] = A;
+        Changed = true;
+      }
+    }
+  }
+};
+} // namespace
+
+bool StrengthReduce(Function &F) {
+  bool Changed = NormalizeLoops(F);
+  StrengthReducer R(F);
+  for (auto &L : R.LI.Loops) {
+    R.reduce(*L);
+  }
+  return R.Changed || Changed;
+}
+
+} // namespace ssa
@@ -0,0 +1,76 @@
+#include "symbol.hpp"
+#include <cstring>
+
+static uint64_t Mix(uint64_t h) {
+  h ^= h >> 32;
+  h *= 0x9E3779B97F4A7C15ull;
+  return h ^ (h >> 29);
+}
+
+// Hashes eight bytes at a time; identifiers are short, so this is a handful
+// of multiplies per lookup.
+static uint32_t Hash(std::string_view s) {
+  uint64_t h = s.size();
+  const char *p = s.data();
+  size_t n = s.size();
+  for (; n >= 8; p += 8, n -= 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    h = Mix(h ^ w);
+  }
+  if (n > 0) {
+    uint64_t w = 0;
+    memcpy(&w, p, n);
+    h = Mix(h ^ w ^ 0xFF);
+  }
+  return static_cast<uint32_t>(h);
+}
+
+Interner &Interner::global() {
+  static Interner Instance;
+  return Instance;
+}
+
+Interner::Interner() : Slots(1024, 0) {
+  for (const char *Keyword : {"break", "const", "continue", "else", "float",
+                              "if", "int", "return", "while", "void"}) {
+    intern(Keyword);
+  }
+}
+
+Symbol Interner::intern(std::string_view s) {
+  uint32_t h = Hash(s);
+  size_t Mask = Slots.size() - 1;
+  size_t i = h & Mask;
+  while (Slots[i] != 0) {
+    uint32_t Id = Slots[i] - 1;
+    if (Hashes[Id] == h && Spellings[Id] == s) {
+      return Symbol{Id};
+    }
+    i = (i + 1) & Mask;
+  }
+
+  uint32_t Id = Spellings.size();
+  Spellings.push_back(Storage.CopyString(s));
+  Hashes.push_back(h);
+  Slots[i] = Id + 1;
+  if (Spellings.size() * 2 > Slots.size()) {
+    grow();
+  }
+  return Symbol{Id};
+}
+
+void Interner::grow() {
+  std::vector<uint32_t> NewSlots(Slots.size() * 2, 0);
+  size_t Mask = NewSlots.size() - 1;
+  for (uint32_t Id = 0; Id < Spellings.size(); ++Id) {
+    size_t i = Hashes[Id] & Mask;
+    while (NewSlots[i] != 0) {
+      i = (i + 1) & Mask;
+    }
+    NewSlots[i] = Id + 1;
+  }
+  Slots = std::move(NewSlots);
+}
+
+std::ostream &operator<<(std::ostream &os, Symbol S) { return os << S.str(); }
@@ -1,7 +1,6 @@
 #include "token.hpp"
-#include <string>
 
-std::ostream &operator<<(std::ostream &os, Token &token) {
+std::ostream &operator<<(std::ostream &os, const Token &token) {
   switch (token.type) {
   case TokenType::LeftParen:
     os << "LeftParen";
@@ -108,16 +107,16 @@ std::ostream &operator<<(std::ostream &os, Token &token) {
     break;
 
   case TokenType::Integer:
-    os << "Integer(" << std::get<int>(token.content) << ")";
+    os << "Integer(" << token.IntValue << ")";
     break;
   case TokenType::Float:
-    os << "Float(" << std::get<float>(token.content) << ")";
+    os << "Float(" << token.FloatValue << ")";
     break;
   case TokenType::Identifier:
-    os << "Identifier(" << std::get<std::string>(token.content) << ")";
+    os << "Identifier(" << token.Sym << ")";
     break;
   case TokenType::String:
-    os << "String(" << std::get<std::string>(token.content) << ")";
+    os << "String";
     break;
   case TokenType::Eof:
     break;
@@ -128,46 +127,12 @@ std::ostream &operator<<(std::ostream &os, Token &token) {
 
   return os;
 }
-Token SimpleToken(TokenType type) {
-  Token Result;
-  Result.type = type;
-  return Result;
-}
-
-Token IntegerToken(int v) {
-  Token Result;
-  Result.type = TokenType::Integer;
-  Result.content = v;
-  return Result;
-}
-
-Token FloatToken(float v) {
-  Token Result;
-  Result.type = TokenType::Float;
-  Result.content = v;
-  return Result;
-}
-
-Token IdentifierToken(std::string name) {
-  Token Result;
-  Result.type = TokenType::Identifier;
-  Result.content = name;
-  return Result;
-}
-
-Token StringToken(std::string str) {
-  Token Result;
-  Result.type = TokenType::String;
-  Result.content = str;
-  return Result;
-}
-
-bool Token::isKind(TokenType type) { return this->type == type; }
-bool Token::isBinOp() { return ::isBinOp(this->type); }
-bool Token::isNegOp() { return ::isNegOp(this->type); }
-bool Token::isNotOp() { return ::isNotOp(this->type); }
-bool Token::isCmpOp() { return ::isCmpOp(this->type); }
-bool Token::isLogicOp() { return ::isLogicOp(this->type); }
+bool Token::isKind(TokenType type) const { return this->type == type; }
+bool Token::isBinOp() const { return ::isBinOp(this->type); }
+bool Token::isNegOp() const { return ::isNegOp(this->type); }
+bool Token::isNotOp() const { return ::isNotOp(this->type); }
+bool Token::isCmpOp() const { return ::isCmpOp(this->type); }
+bool Token::isLogicOp() const { return ::isLogicOp(this->type); }
 
 bool isBinOp(TokenType type) {
   switch (type) {
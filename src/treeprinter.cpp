@@ -1,275 +1,214 @@
+#include "treeprinter.hpp"
 #include "ast.hpp"
-#include <iostream>
-#include <variant>
 
 namespace ast {
 
-void TreePrinter::Indent() {
-  for (int i = 0; i < IndentDepth; ++i) {
-    std::cout << '\t';
+static const char *BinOpSpelling[] = {"+", "-", "*", "/", "%"};
+static const char *CmpOpSpelling[] = {">", ">=", "<", "<=", "==", "!="};
+static const char *LogicalOpSpelling[] = {"&&", "||"};
+
+static const char *TypeSpelling(BaseType T) {
+  return T == BaseType::FLOAT ? "float " : "int ";
+}
+
+void TreePrinter::Indent() { Out.fill('\t', IndentDepth); }
+
+void TreePrinter::accept(Program &p) {
+  for (auto &Item : p.instrs) {
+    if (auto f = std::get_if<Func>(&Item); f != nullptr) {
+      traverse(f);
+    } else {
+      traverse(&std::get<DeclStmt>(Item));
+    }
+    Out << '\n';
   }
 }
 
-void TreePrinter::accept(Expr &e) { }
-void TreePrinter::accept(Stmt &s) { }
+// Expressions.
+
+void TreePrinter::enterIntegerExpr(IntegerExpr *E) { Out << E->Value; }
+
+void TreePrinter::enterFloatExpr(FloatExpr *E) { Out << E->Value; }
+
+void TreePrinter::enterVariableExpr(VariableExpr *E) { Out << E->VariName; }
+
+void TreePrinter::enterNegateExpr(NegateExpr *) { Out << "-("; }
 
-void TreePrinter::accept(IntegerExpr &e) { std::cout << e.Value; }
-void TreePrinter::accept(FloatExpr &e) { std::cout << e.Value; }
-void TreePrinter::accept(NegateExpr &pe) {
-  std::cout << '-';
-  std::cout << '(';
-  pe.operand->accept(*this);
-  std::cout << ')';
+void TreePrinter::leaveNegateExpr(NegateExpr *) { Out << ')'; }
+
+void TreePrinter::enterNotExpr(NotExpr *) { Out << "!("; }
+
+void TreePrinter::leaveNotExpr(NotExpr *) { Out << ')'; }
+
+void TreePrinter::enterBinopExpr(BinopExpr *) { Out << '('; }
+
+void TreePrinter::beforeBinopExpr(BinopExpr *E, unsigned i, NodeRef) {
+  if (i == 1)
+    Out << ')' << BinOpSpelling[int(E->op)] << '(';
 }
-void TreePrinter::accept(BinopExpr &be) {
-  std::cout << '(';
-  be.lhs->accept(*this);
-  std::cout << ')';
-
-  switch (be.op) {
-  case BinOpKind::Add:
-    std::cout << '+';
-    break;
-  case BinOpKind::Sub:
-    std::cout << '-';
-    break;
-  case BinOpKind::Mul:
-    std::cout << '*';
-    break;
-  case BinOpKind::Div:
-    std::cout << '/';
-    break;
-  case BinOpKind::Mod:
-    std::cout << "%";
-    break;
-  }
 
-  std::cout << '(';
-  be.rhs->accept(*this);
-  std::cout << ')';
+void TreePrinter::leaveBinopExpr(BinopExpr *) { Out << ')'; }
+
+void TreePrinter::enterCmpExpr(CmpExpr *) { Out << '('; }
+
+void TreePrinter::beforeCmpExpr(CmpExpr *E, unsigned i, NodeRef) {
+  if (i == 1)
+    Out << ')' << CmpOpSpelling[int(E->op)] << '(';
 }
 
-void TreePrinter::accept(CmpExpr &CE) {
-  std::cout << '(';
-  CE.lhs->accept(*this);
-  std::cout << ')';
+void TreePrinter::leaveCmpExpr(CmpExpr *) { Out << ')'; }
 
-  switch (CE.op) {
-  case CmpOpKind::GT:
-    std::cout << '>';
-    break;
-  case CmpOpKind::GE:
-    std::cout << ">=";
-    break;
-  case CmpOpKind::LT:
-    std::cout << '<';
-    break;
-  case CmpOpKind::LE:
-    std::cout << "<=";
-    break;
-  case CmpOpKind::EE:
-    std::cout << "==";
-    break;
-  case CmpOpKind::NE:
-    std::cout << "!=";
-    break;
-  }
+void TreePrinter::enterLogicalExpr(LogicalExpr *) { Out << '('; }
 
-  std::cout << '(';
-  CE.rhs->accept(*this);
-  std::cout << ')';
+void TreePrinter::beforeLogicalExpr(LogicalExpr *E, unsigned i, NodeRef) {
+  if (i == 1)
+    Out << ')' << LogicalOpSpelling[int(E->op)] << '(';
 }
 
-void TreePrinter::accept(NotExpr &NE) {
-  std::cout << "!(";
-  NE.operand->accept(*this);
-  std::cout << ")";
+void TreePrinter::leaveLogicalExpr(LogicalExpr *) { Out << ')'; }
+
+void TreePrinter::beforeIndexExpr(IndexExpr *, unsigned i, NodeRef) {
+  if (i == 1)
+    Out << '[';
 }
 
-void TreePrinter::accept(LogicalExpr &LE) {
-  std::cout << '(';
-  LE.lhs->accept(*this);
-  std::cout << ')';
+void TreePrinter::leaveIndexExpr(IndexExpr *) { Out << ']'; }
 
-  switch (LE.op) {
-  case LogicalOpKind::And:
-    std::cout << "&&";
-    break;
-  case LogicalOpKind::Or:
-    std::cout << "||";
-    break;
-  }
+void TreePrinter::beforeAssignExpr(AssignExpr *, unsigned i, NodeRef) {
+  if (i == 1)
+    Out << " = ";
+}
 
-  std::cout << '(';
-  LE.rhs->accept(*this);
-  std::cout << ')';
+void TreePrinter::enterFunctionCallExpr(FunctionCallExpr *E) {
+  Out << E->FuncName << '(';
 }
 
-void TreePrinter::accept(VariableExpr &ve) { std::cout << ve.VariName; }
+void TreePrinter::beforeFunctionCallExpr(FunctionCallExpr *, unsigned i,
+                                         NodeRef) {
+  if (i > 0)
+    Out << ',';
+}
+
+void TreePrinter::leaveFunctionCallExpr(FunctionCallExpr *) { Out << ')'; }
+
+// Statements.
 
-void TreePrinter::accept(IndexExpr &IE) {
-  if (IE.BaseArray)
-    IE.BaseArray->accept(*this);
-  if (IE.SubArray)
-    IE.SubArray->accept(*this);
-  std::cout << '[';
-  IE.Index->accept(*this);
-  std::cout << ']';
+void TreePrinter::leaveExprStmt(ExprStmt *) { Out << ';'; }
+
+void TreePrinter::enterIfStmt(IfStmt *) { Out << "if" << '('; }
+
+void TreePrinter::beforeIfStmt(IfStmt *, unsigned i, NodeRef Child) {
+  if (i == 1)
+    Out << ')';
+  else if (i == 2 && !Child.isNull())
+    Out << "else ";
 }
 
-void TreePrinter::accept(AssignExpr &AE) {
-  if (AE.Target)
-    AE.Target->accept(*this);
-  if (AE.ArrayTarget)
-    AE.ArrayTarget->accept(*this);
-  std::cout << " = ";
-  AE.Assignment->accept(*this);
+void TreePrinter::enterWhileStmt(WhileStmt *) { Out << "while("; }
+
+void TreePrinter::beforeWhileStmt(WhileStmt *, unsigned i, NodeRef) {
+  if (i == 1)
+    Out << ")";
 }
 
-void TreePrinter::accept(FunctionCallExpr &FCE) {
-  std::cout << FCE.FuncName << '(';
-  if (FCE.RealParameters.size() > 0) {
-    FCE.RealParameters[0]->accept(*this);
-  }
-  for (int i = 1; i < FCE.RealParameters.size(); ++i) {
-    std::cout << ',';
-    FCE.RealParameters[i]->accept(*this);
-  }
-  std::cout << ')';
+void TreePrinter::enterReturnStmt(ReturnStmt *) { Out << "return "; }
+
+void TreePrinter::leaveReturnStmt(ReturnStmt *) { Out << ';'; }
+
+void TreePrinter::enterBlockStmt(BlockStmt *) {
+  IndentDepth++;
+  Out << "{\n";
 }
 
-void TreePrinter::accept(ExprStmt &es) {
-  es.E->accept(*this);
-  std::cout << ';';
+void TreePrinter::beforeBlockStmt(BlockStmt *, unsigned, NodeRef) { Indent(); }
+
+void TreePrinter::afterBlockStmt(BlockStmt *, unsigned, NodeRef) {
+  Out << "\n";
 }
-void TreePrinter::accept(IfStmt &is) {
-  std::cout << "if" << '(';
-  is.cond->accept(*this);
-  std::cout << ')';
-  is.IfBranch->accept(*this);
-
-  if (is.ElseBranch) {
-    std::cout << "else ";
-    is.ElseBranch->accept(*this);
-  }
+
+void TreePrinter::leaveBlockStmt(BlockStmt *) {
+  IndentDepth--;
+  Indent();
+  Out << "}";
 }
 
-void accept_inits(TreePrinter &tp, InitVals &iv) {
-  if (iv.val)
-    iv.val->accept(tp);
-  else {
-    std::cout << '{';
-    for (int i = 0; i < iv.vals.size(); ++i) {
-      if (i > 0)
-        std::cout << ',';
-      accept_inits(tp, iv.vals[i]);
-    }
-    std::cout << '}';
-  }
+void TreePrinter::enterContinueStmt(ContinueStmt *) {
+  Out << "continue;";
 }
 
-void TreePrinter::accept(DeclStmt &DS) {
-  if (DS.isConst) {
-    std::cout << "const ";
-  }
-  switch (DS.basetype_) {
-  case BaseType::INT:
-    std::cout << "int ";
-    break;
-  case BaseType::FLOAT:
-    std::cout << "float ";
-    break;
-  }
-  std::cout << DS.VarName;
+void TreePrinter::enterBreakStmt(BreakStmt *) { Out << "break;"; }
 
-  for (int i = 0; i < DS.Dims.size(); ++i) {
-    std::cout << '[';
-    DS.Dims[i]->accept(*this);
-    std::cout << ']';
+void TreePrinter::enterDeclStmt(DeclStmt *S) {
+  if (S->isConst) {
+    Out << "const ";
   }
-  if (DS.initvals_) {
-    std::cout << " = ";
-    accept_inits(*this, *DS.initvals_);
-  }
-  std::cout << ';';
+  Out << TypeSpelling(S->basetype_) << S->VarName;
 }
 
-void TreePrinter::accept(ReturnStmt &rs) {
-  std::cout << "return ";
-  rs.ReturnExpr->accept(*this);
-  std::cout << ";";
+void TreePrinter::beforeDeclStmt(DeclStmt *S, unsigned i, NodeRef Child) {
+  if (i < S->Dims.size())
+    Out << '[';
+  else if (!Child.isNull())
+    Out << " = ";
 }
-void TreePrinter::accept(BlockStmt &bs) {
-  IndentDepth++;
-  std::cout << "{\n";
-  for (auto &stmt : bs.Stmts) {
-    Indent();
-    stmt->accept(*this);
-    std::cout << "\n";
-  }
-  IndentDepth--;
-  Indent();
-  std::cout << "}";
+
+void TreePrinter::afterDeclStmt(DeclStmt *S, unsigned i, NodeRef) {
+  if (i < S->Dims.size())
+    Out << ']';
+}
+
+void TreePrinter::leaveDeclStmt(DeclStmt *) { Out << ';'; }
+
+// Initializers, parameters and functions.
+
+void TreePrinter::enterInitVals(InitVals *IV) {
+  if (IV->val == nullptr)
+    Out << '{';
 }
 
-void TreePrinter::accept(ContinueStmt &) { std::cout << "continue;"; }
-void TreePrinter::accept(BreakStmt &) { std::cout << "break"; }
+void TreePrinter::beforeInitVals(InitVals *, unsigned i, NodeRef) {
+  if (i > 0)
+    Out << ',';
+}
 
-void TreePrinter::accept(WhileStmt &WS) {
-  std::cout << "while(";
-  WS.LoopCond->accept(*this);
-  std::cout << ")";
-  WS.LoopBody->accept(*this);
+void TreePrinter::leaveInitVals(InitVals *IV) {
+  if (IV->val == nullptr)
+    Out << '}';
 }
 
-void accept_params(TreePrinter &tp, Param &p) {
-  switch (p.basetype_) {
-  case BaseType::INT:
-    std::cout << "int ";
-    break;
-  case BaseType::FLOAT:
-    std::cout << "float ";
-    break;
-  }
-  std::cout << p.paraname_;
-  for (int i = 0; i < p.dims_.size(); ++i) {
-    std::cout << '[';
-    if (p.dims_[i] != nullptr)
-      p.dims_[i]->accept(tp);
-    std::cout << ']';
-  }
+void TreePrinter::enterParam(Param *P) {
+  Out << TypeSpelling(P->basetype_) << P->paraname_;
 }
 
-void TreePrinter::accept(Func &f) {
-  switch (f.return_type_) {
+void TreePrinter::beforeParam(Param *, unsigned, NodeRef) { Out << '['; }
+
+void TreePrinter::afterParam(Param *, unsigned, NodeRef) { Out << ']'; }
+
+void TreePrinter::enterFunc(Func *F) {
+  switch (F->return_type_) {
   case ReturnType::INT:
-    std::cout << "int";
+    Out << "int";
     break;
   case ReturnType::FLOAT:
-    std::cout << "float";
+    Out << "float";
+    break;
   case ReturnType::VOID:
-    std::cout << "void";
-  }
-  std::cout << ' ' << f.function_name_ << '(';
-  for (int i = 0; i < f.formal_paras_.size(); ++i) {
-    if (i > 0)
-      std::cout << ',';
-    accept_params(*this, f.formal_paras_[i]);
+    Out << "void";
+    break;
   }
-  std::cout << ')';
-  if (f.body_)
-    f.body_->accept(*this);
-  else
-    std::cout << ';';
+  Out << ' ' << F->function_name_ << '(';
 }
-void TreePrinter::accept(Program &p) {
-  for (int i = 0; i < p.instrs.size(); ++i) {
-    if (auto f = std::get_if<Func>(&p.instrs[i]); f != nullptr) {
-      f->accept(*this);
-    } else {
-      std::get<DeclStmt>(p.instrs[i]).accept(*this);
-    }
-    std::cout << '\n';
-  }
+
+void TreePrinter::beforeFunc(Func *F, unsigned i, NodeRef) {
+  if (i == F->formal_paras_.size())
+    Out << ')';
+  else if (i > 0)
+    Out << ',';
 }
-} // namespace ast
\ No newline at end of file
+
+void TreePrinter::leaveFunc(Func *F) {
+  if (F->body_ == nullptr)
+    Out << ';';
+}
+
+} // namespace ast
@@ -1,13 +1,36 @@
 add_rules("mode.release","mode.debug")
 target("minic")
     set_kind("binary")
-    add_files("src/*.cpp")
-    add_includedirs("include")
+    -- The SysY runtime, which executables are linked with and --run binds
+    -- programs to.
+    add_files("src/*.cpp", "runtime/sylib.c")
+    add_includedirs("include", "runtime")
+    add_defines("MINIC_RUNTIME=\"$(projectdir)/runtime/sylib.c\"")
     set_languages("c++20")
+    add_cxxflags("-fno-rtti")
+    add_syslinks("pthread")
 
     if is_os("macosx") then 
         add_linkdirs("/opt/homebrew/lib")
         add_includedirs("/opt/homebrew/include")
     end
     
-    add_links("LLVM")
\ No newline at end of file
+    add_links("LLVM")
+
+-- Front-end benchmarks: `xmake run minic-bench [--functions N] ...` prints
+-- per-phase timings, allocation counts and peak RSS as JSON.
+target("minic-bench")
+    set_kind("binary")
+    add_files("src/*.cpp|minic.cpp", "bench/*.cpp", "runtime/sylib.c")
+    add_includedirs("include", "bench", "runtime")
+    add_defines("MINIC_RUNTIME=\"$(projectdir)/runtime/sylib.c\"")
+    set_languages("c++20")
+    add_cxxflags("-fno-rtti")
+    add_syslinks("pthread")
+
+    if is_os("macosx") then 
+        add_linkdirs("/opt/homebrew/lib")
+        add_includedirs("/opt/homebrew/include")
+    end
+
+    add_links("LLVM")